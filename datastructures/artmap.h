@@ -0,0 +1,1095 @@
+#ifndef ARTMAP_H
+#define ARTMAP_H
+
+/***************************************************************************************
+ * Ordered map as an adaptive radix tree, see Leis et al., "The adaptive radix tree:
+ * ARTful indexing for main-memory databases", 2013
+ *
+ * Keys are compared as strings of bytes, one byte per level of the tree, so a search
+ * reads every byte of the key at most once, however long the prefix it shares with
+ * other keys. Inner nodes grow and shrink between 4 types, with room for 4, 16, 48
+ * and 256 children, and a chain of nodes with a single child is compressed into the
+ * prefix of the node below it. The first _ARTMAP_MAX_PREFIX_LEN bytes of a prefix
+ * are stored in the node, longer prefixes are checked against a leaf instead.
+ *
+ * Every entry is a separately allocated leaf, so pointers to entries stay valid until
+ * the entry is removed. Leaves are also linked in key order, iterators simply follow
+ * these links. Children of nodes of 16 are found with SSE2 when it is available.
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "treemap.h"
+
+// prefix bytes stored in inner nodes, longer prefixes are compared against a leaf
+#ifndef _ARTMAP_MAX_PREFIX_LEN
+#define _ARTMAP_MAX_PREFIX_LEN 8
+#endif
+
+// size of the buffer the bytes of a key may be written to, see ARTMAP_DEFINE
+#define ARTMAP_KEY_BUF_SIZE 16
+
+#define _ARTMAP_NODE4 0
+#define _ARTMAP_NODE16 1
+#define _ARTMAP_NODE48 2
+#define _ARTMAP_NODE256 3
+
+/*********************************************************************
+ * Header of every inner node
+ *********************************************************************/
+typedef struct
+{
+    uint8_t type;
+    uint16_t n_children;
+    uint32_t prefix_len;                        // bytes skipped before the child byte
+    uint8_t prefix[_ARTMAP_MAX_PREFIX_LEN];     // the first of them
+} _ArtNode;
+
+typedef struct
+{
+    _ArtNode n;
+    uint8_t keys[4];            // sorted
+    void* children[4];
+} _ArtNode4;
+
+typedef struct
+{
+    _ArtNode n;
+    uint8_t keys[16];           // sorted
+    void* children[16];
+} _ArtNode16;
+
+typedef struct
+{
+    _ArtNode n;
+    uint8_t child_index[256];   // slot of each byte in children plus one, 0 if there is none
+    void* children[48];
+} _ArtNode48;
+
+typedef struct
+{
+    _ArtNode n;
+    void* children[256];
+} _ArtNode256;
+
+/*
+ * Children are either inner nodes or leaves, leaves are tagged by setting the lowest bit
+ */
+#define _artmap_is_leaf(ptr) (((uintptr_t) (ptr)) & 1)
+#define _artmap_leaf(ptr) ((void*) (((uintptr_t) (ptr)) & ~(uintptr_t) 1))
+#define _artmap_tag_leaf(ptr) ((void*) (((uintptr_t) (ptr)) | 1))
+
+static const size_t _artmap_node_sizes[4] = {
+    sizeof(_ArtNode4), sizeof(_ArtNode16), sizeof(_ArtNode48), sizeof(_ArtNode256)
+};
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Allocates an empty inner node, adding its size to n_bytes
+ *****************************************************************/
+static _ArtNode* _artmap_new_node(uint8_t type, size_t* n_bytes)
+{
+    _ArtNode* node = calloc(1, _artmap_node_sizes[type]);
+    assert(node);
+    node->type = type;
+    *n_bytes += _artmap_node_sizes[type];
+    return node;
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Frees an inner node, subtracting its size from n_bytes
+ *****************************************************************/
+static void _artmap_free_node(_ArtNode* node, size_t* n_bytes)
+{
+    *n_bytes -= _artmap_node_sizes[node->type];
+    free(node);
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Position of the first of n sorted keys greater than c
+ *****************************************************************/
+static inline unsigned _artmap_upper_bound(const uint8_t* keys, unsigned n, uint8_t c)
+{
+#ifdef __SSE2__
+    if (n > 4) {
+        /* unsigned comparison, by flipping the sign bits of both sides */
+        __m128i flip = _mm_set1_epi8((char) 0x80);
+        __m128i greater = _mm_cmplt_epi8(_mm_xor_si128(_mm_set1_epi8((char) c), flip),
+                                         _mm_xor_si128(_mm_loadu_si128((const __m128i*) keys), flip));
+        unsigned mask = (unsigned) _mm_movemask_epi8(greater) & ((1U << n) - 1);
+        return mask ? (unsigned) __builtin_ctz(mask) : n;
+    }
+#endif
+    unsigned i = 0;
+    while (i < n && keys[i] <= c)
+        i++;
+    return i;
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Slot of the child of a node for byte c, or NULL if it has none
+ *****************************************************************/
+static inline void** _artmap_find_child(_ArtNode* node, uint8_t c)
+{
+    switch (node->type) {
+    case _ARTMAP_NODE4: {
+        _ArtNode4* n = (_ArtNode4*) node;
+        for (unsigned i = 0; i < node->n_children; i++)
+            if (n->keys[i] == c)
+                return n->children + i;
+        return NULL;
+    }
+    case _ARTMAP_NODE16: {
+        _ArtNode16* n = (_ArtNode16*) node;
+#ifdef __SSE2__
+        __m128i eq = _mm_cmpeq_epi8(_mm_set1_epi8((char) c), _mm_loadu_si128((const __m128i*) n->keys));
+        unsigned mask = (unsigned) _mm_movemask_epi8(eq) & ((1U << node->n_children) - 1);
+        return mask ? n->children + __builtin_ctz(mask) : NULL;
+#else
+        for (unsigned i = 0; i < node->n_children; i++)
+            if (n->keys[i] == c)
+                return n->children + i;
+        return NULL;
+#endif
+    }
+    case _ARTMAP_NODE48: {
+        _ArtNode48* n = (_ArtNode48*) node;
+        return n->child_index[c] ? n->children + n->child_index[c] - 1 : NULL;
+    }
+    default: {
+        _ArtNode256* n = (_ArtNode256*) node;
+        return n->children[c] ? n->children + c : NULL;
+    }
+    }
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Child of a node with the smallest byte at least c, or NULL if
+ * there is none. Its byte is written to byte_out
+ *****************************************************************/
+static void* _artmap_child_ge(const _ArtNode* node, unsigned c, uint8_t* byte_out)
+{
+    if (c > 255)
+        return NULL;
+    switch (node->type) {
+    case _ARTMAP_NODE4:
+    case _ARTMAP_NODE16: {
+        const uint8_t* keys = node->type == _ARTMAP_NODE4 ? ((const _ArtNode4*) node)->keys : ((const _ArtNode16*) node)->keys;
+        void* const* children = node->type == _ARTMAP_NODE4 ? ((const _ArtNode4*) node)->children : ((const _ArtNode16*) node)->children;
+        unsigned i = c == 0 ? 0 : _artmap_upper_bound(keys, node->n_children, (uint8_t) (c - 1));
+        if (i == node->n_children)
+            return NULL;
+        *byte_out = keys[i];
+        return children[i];
+    }
+    case _ARTMAP_NODE48: {
+        const _ArtNode48* n = (const _ArtNode48*) node;
+        for (; c < 256; c++)
+            if (n->child_index[c]) {
+                *byte_out = (uint8_t) c;
+                return n->children[n->child_index[c] - 1];
+            }
+        return NULL;
+    }
+    default: {
+        const _ArtNode256* n = (const _ArtNode256*) node;
+        for (; c < 256; c++)
+            if (n->children[c]) {
+                *byte_out = (uint8_t) c;
+                return n->children[c];
+            }
+        return NULL;
+    }
+    }
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Child of a node with the largest byte at most c, or NULL if
+ * there is none. Its byte is written to byte_out
+ *****************************************************************/
+static void* _artmap_child_le(const _ArtNode* node, int c, uint8_t* byte_out)
+{
+    if (c < 0)
+        return NULL;
+    switch (node->type) {
+    case _ARTMAP_NODE4:
+    case _ARTMAP_NODE16: {
+        const uint8_t* keys = node->type == _ARTMAP_NODE4 ? ((const _ArtNode4*) node)->keys : ((const _ArtNode16*) node)->keys;
+        void* const* children = node->type == _ARTMAP_NODE4 ? ((const _ArtNode4*) node)->children : ((const _ArtNode16*) node)->children;
+        unsigned i = _artmap_upper_bound(keys, node->n_children, (uint8_t) c);
+        if (i == 0)
+            return NULL;
+        *byte_out = keys[i - 1];
+        return children[i - 1];
+    }
+    case _ARTMAP_NODE48: {
+        const _ArtNode48* n = (const _ArtNode48*) node;
+        for (; c >= 0; c--)
+            if (n->child_index[c]) {
+                *byte_out = (uint8_t) c;
+                return n->children[n->child_index[c] - 1];
+            }
+        return NULL;
+    }
+    default: {
+        const _ArtNode256* n = (const _ArtNode256*) node;
+        for (; c >= 0; c--)
+            if (n->children[c]) {
+                *byte_out = (uint8_t) c;
+                return n->children[c];
+            }
+        return NULL;
+    }
+    }
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Leaf with the smallest key below a child, untagged
+ *****************************************************************/
+static void* _artmap_minimum(void* child)
+{
+    uint8_t byte;
+    while (!_artmap_is_leaf(child))
+        child = _artmap_child_ge((const _ArtNode*) child, 0, &byte);
+    return _artmap_leaf(child);
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Leaf with the largest key below a child, untagged
+ *****************************************************************/
+static void* _artmap_maximum(void* child)
+{
+    uint8_t byte;
+    while (!_artmap_is_leaf(child))
+        child = _artmap_child_le((const _ArtNode*) child, 255, &byte);
+    return _artmap_leaf(child);
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Copies the header of a node to a node of another type
+ *****************************************************************/
+static void _artmap_copy_header(_ArtNode* dst, const _ArtNode* src)
+{
+    dst->n_children = src->n_children;
+    dst->prefix_len = src->prefix_len;
+    memcpy(dst->prefix, src->prefix, _ARTMAP_MAX_PREFIX_LEN);
+}
+
+/*************************************************************************
+ * Do not use this function
+ *
+ * Adds a child for byte c, which the node at *ref must not have yet.
+ * A full node is replaced by one of the next larger type
+ *************************************************************************/
+static void _artmap_add_child(void** ref, uint8_t c, void* child, size_t* n_bytes)
+{
+    _ArtNode* node = *ref;
+    switch (node->type) {
+    case _ARTMAP_NODE4:
+    case _ARTMAP_NODE16: {
+        unsigned cap = node->type == _ARTMAP_NODE4 ? 4 : 16;
+        uint8_t* keys = node->type == _ARTMAP_NODE4 ? ((_ArtNode4*) node)->keys : ((_ArtNode16*) node)->keys;
+        void** children = node->type == _ARTMAP_NODE4 ? ((_ArtNode4*) node)->children : ((_ArtNode16*) node)->children;
+        if (node->n_children < cap) {
+            unsigned i = _artmap_upper_bound(keys, node->n_children, c);
+            memmove(keys + i + 1, keys + i, node->n_children - i);
+            memmove(children + i + 1, children + i, (node->n_children - i) * sizeof(void*));
+            keys[i] = c;
+            children[i] = child;
+            node->n_children++;
+            return;
+        }
+        if (node->type == _ARTMAP_NODE4) {
+            _ArtNode16* grown = (_ArtNode16*) _artmap_new_node(_ARTMAP_NODE16, n_bytes);
+            _artmap_copy_header(&grown->n, node);
+            memcpy(grown->keys, keys, 4);
+            memcpy(grown->children, children, 4 * sizeof(void*));
+            *ref = grown;
+        } else {
+            _ArtNode48* grown = (_ArtNode48*) _artmap_new_node(_ARTMAP_NODE48, n_bytes);
+            _artmap_copy_header(&grown->n, node);
+            for (unsigned i = 0; i < 16; i++) {
+                grown->child_index[keys[i]] = (uint8_t) (i + 1);
+                grown->children[i] = children[i];
+            }
+            *ref = grown;
+        }
+        _artmap_free_node(node, n_bytes);
+        _artmap_add_child(ref, c, child, n_bytes);
+        return;
+    }
+    case _ARTMAP_NODE48: {
+        _ArtNode48* n = (_ArtNode48*) node;
+        if (node->n_children < 48) {
+            unsigned slot = 0;
+            while (n->children[slot])
+                slot++;
+            n->children[slot] = child;
+            n->child_index[c] = (uint8_t) (slot + 1);
+            node->n_children++;
+            return;
+        }
+        _ArtNode256* grown = (_ArtNode256*) _artmap_new_node(_ARTMAP_NODE256, n_bytes);
+        _artmap_copy_header(&grown->n, node);
+        for (unsigned b = 0; b < 256; b++)
+            if (n->child_index[b])
+                grown->children[b] = n->children[n->child_index[b] - 1];
+        *ref = grown;
+        _artmap_free_node(node, n_bytes);
+        _artmap_add_child(ref, c, child, n_bytes);
+        return;
+    }
+    default: {
+        _ArtNode256* n = (_ArtNode256*) node;
+        n->children[c] = child;
+        node->n_children++;
+        return;
+    }
+    }
+}
+
+/*************************************************************************
+ * Do not use this function
+ *
+ * Removes the child for byte c, stored in slot, from the node at *ref.
+ * A sparse node is replaced by one of the next smaller type, and a node
+ * of 4 left with a single child is merged into it
+ *************************************************************************/
+static void _artmap_remove_child(void** ref, uint8_t c, void** slot, size_t* n_bytes)
+{
+    _ArtNode* node = *ref;
+    switch (node->type) {
+    case _ARTMAP_NODE4:
+    case _ARTMAP_NODE16: {
+        uint8_t* keys = node->type == _ARTMAP_NODE4 ? ((_ArtNode4*) node)->keys : ((_ArtNode16*) node)->keys;
+        void** children = node->type == _ARTMAP_NODE4 ? ((_ArtNode4*) node)->children : ((_ArtNode16*) node)->children;
+        unsigned i = (unsigned) (slot - children);
+        memmove(keys + i, keys + i + 1, node->n_children - i - 1);
+        memmove(children + i, children + i + 1, (node->n_children - i - 1) * sizeof(void*));
+        node->n_children--;
+        if (node->type == _ARTMAP_NODE16 && node->n_children == 3) {
+            _ArtNode4* shrunk = (_ArtNode4*) _artmap_new_node(_ARTMAP_NODE4, n_bytes);
+            _artmap_copy_header(&shrunk->n, node);
+            memcpy(shrunk->keys, keys, 3);
+            memcpy(shrunk->children, children, 3 * sizeof(void*));
+            *ref = shrunk;
+            _artmap_free_node(node, n_bytes);
+        } else if (node->type == _ARTMAP_NODE4 && node->n_children == 1) {
+            void* child = children[0];
+            if (!_artmap_is_leaf(child)) {
+                /* the prefix of the child becomes: prefix of the node, byte of the child, prefix of the child */
+                _ArtNode* below = child;
+                uint8_t prefix[_ARTMAP_MAX_PREFIX_LEN];
+                size_t len = node->prefix_len < _ARTMAP_MAX_PREFIX_LEN ? node->prefix_len : _ARTMAP_MAX_PREFIX_LEN;
+                memcpy(prefix, node->prefix, len);
+                if (len < _ARTMAP_MAX_PREFIX_LEN)
+                    prefix[len++] = keys[0];
+                for (size_t i = 0; len < _ARTMAP_MAX_PREFIX_LEN && i < below->prefix_len; i++)
+                    prefix[len++] = below->prefix[i];
+                memcpy(below->prefix, prefix, len);
+                below->prefix_len += node->prefix_len + 1;
+            }
+            *ref = child;
+            _artmap_free_node(node, n_bytes);
+        }
+        return;
+    }
+    case _ARTMAP_NODE48: {
+        _ArtNode48* n = (_ArtNode48*) node;
+        *slot = NULL;
+        n->child_index[c] = 0;
+        node->n_children--;
+        if (node->n_children == 12) {
+            _ArtNode16* shrunk = (_ArtNode16*) _artmap_new_node(_ARTMAP_NODE16, n_bytes);
+            _artmap_copy_header(&shrunk->n, node);
+            unsigned i = 0;
+            for (unsigned b = 0; b < 256; b++)
+                if (n->child_index[b]) {
+                    shrunk->keys[i] = (uint8_t) b;
+                    shrunk->children[i++] = n->children[n->child_index[b] - 1];
+                }
+            *ref = shrunk;
+            _artmap_free_node(node, n_bytes);
+        }
+        return;
+    }
+    default: {
+        _ArtNode256* n = (_ArtNode256*) node;
+        *slot = NULL;
+        node->n_children--;
+        if (node->n_children == 37) {
+            _ArtNode48* shrunk = (_ArtNode48*) _artmap_new_node(_ARTMAP_NODE48, n_bytes);
+            _artmap_copy_header(&shrunk->n, node);
+            unsigned i = 0;
+            for (unsigned b = 0; b < 256; b++)
+                if (n->children[b]) {
+                    shrunk->child_index[b] = (uint8_t) (i + 1);
+                    shrunk->children[i++] = n->children[b];
+                }
+            *ref = shrunk;
+            _artmap_free_node(node, n_bytes);
+        }
+        return;
+    }
+    }
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Frees all inner nodes below a child, but not the leaves
+ *****************************************************************/
+static void _artmap_free_nodes(void* child, size_t* n_bytes)
+{
+    if (!child || _artmap_is_leaf(child))
+        return;
+    _ArtNode* node = child;
+    uint8_t byte;
+    for (void* c = _artmap_child_ge(node, 0, &byte); c; c = _artmap_child_ge(node, byte + 1U, &byte))
+        _artmap_free_nodes(c, n_bytes);
+    _artmap_free_node(node, n_bytes);
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Compares two strings of bytes, a prefix of a string is smaller
+ *****************************************************************/
+static inline int _artmap_bytes_cmp(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len)
+{
+    int res = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (res)
+        return res;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+/*
+ * Bytes of integer keys, in big endian order with flipped sign bits for signed integers,
+ * and of null terminated strings, including the terminator, to pass as ARTMAP_KEY_BYTES
+ */
+static inline const uint8_t* artmap_u32_bytes(const uint32_t* key, uint8_t* buf, size_t* len)
+{
+    uint32_t be = __builtin_bswap32(*key);
+    memcpy(buf, &be, 4);
+    *len = 4;
+    return buf;
+}
+
+static inline const uint8_t* artmap_i32_bytes(const int32_t* key, uint8_t* buf, size_t* len)
+{
+    uint32_t flipped = (uint32_t) *key ^ UINT32_C(0x80000000);
+    return artmap_u32_bytes(&flipped, buf, len);
+}
+
+static inline const uint8_t* artmap_u64_bytes(const uint64_t* key, uint8_t* buf, size_t* len)
+{
+    uint64_t be = __builtin_bswap64(*key);
+    memcpy(buf, &be, 8);
+    *len = 8;
+    return buf;
+}
+
+static inline const uint8_t* artmap_i64_bytes(const int64_t* key, uint8_t* buf, size_t* len)
+{
+    uint64_t flipped = (uint64_t) *key ^ UINT64_C(0x8000000000000000);
+    return artmap_u64_bytes(&flipped, buf, len);
+}
+
+static inline const uint8_t* artmap_str_bytes(char* const* key, uint8_t* buf, size_t* len)
+{
+    (void) buf;
+    *len = strlen(*key) + 1;
+    return (const uint8_t*) *key;
+}
+
+
+/***************************************************************************************
+ * Creates a new ArtMap type
+ *
+ * @param ARTMAP_NAME name of the map struct and prefix of every function
+ * @param ARTMAP_KEY_TYPE type of keys, stored in place in the leaves
+ * @param ARTMAP_VAL_TYPE type of values, pass TREEMAP_NO_VALUE for a set
+ * @param ARTMAP_KEY_BYTES function or macro taking a const ARTMAP_KEY_TYPE*, a buffer
+ *    of ARTMAP_KEY_BUF_SIZE bytes and a size_t* the length is written to, and returning
+ *    a const uint8_t* to the bytes of the key, either in the buffer or in the key itself.
+ *    Keys are ordered as their bytes compared with memcmp, and the bytes of a key must
+ *    not be a prefix of those of another key, see artmap_u64_bytes, artmap_str_bytes
+ ***************************************************************************************/
+#define ARTMAP_DEFINE(ARTMAP_NAME, ARTMAP_KEY_TYPE, ARTMAP_VAL_TYPE, ARTMAP_KEY_BYTES) \
+    typedef struct \
+    { \
+        ARTMAP_KEY_TYPE key; \
+        ARTMAP_VAL_TYPE value; \
+    } ARTMAP_NAME##Entry; \
+    \
+    typedef struct _##ARTMAP_NAME##Leaf _##ARTMAP_NAME##Leaf; \
+    \
+    struct _##ARTMAP_NAME##Leaf \
+    { \
+        ARTMAP_NAME##Entry entry; \
+        _##ARTMAP_NAME##Leaf* prev;     /* leaves in key order */ \
+        _##ARTMAP_NAME##Leaf* next; \
+    }; \
+    \
+    typedef struct \
+    { \
+        void* _root;                    /* inner node, tagged leaf, or NULL */ \
+        _##ARTMAP_NAME##Leaf* _min; \
+        _##ARTMAP_NAME##Leaf* _max; \
+        size_t _n_bytes;                /* of nodes and leaves */ \
+        size_t size; \
+    } ARTMAP_NAME; \
+    \
+    typedef struct \
+    { \
+        ARTMAP_NAME##Entry* current; \
+        _##ARTMAP_NAME##Leaf* _first;   /* bounds of a prefix scan, NULL otherwise */ \
+        _##ARTMAP_NAME##Leaf* _last; \
+    } ARTMAP_NAME##Iter; \
+    \
+    \
+    /*****************************************************************
+     * Initializes a new empty ArtMap
+     *****************************************************************/ \
+    static ARTMAP_NAME ARTMAP_NAME##_new() \
+    { \
+        ARTMAP_NAME ret; \
+        memset(&ret, 0, sizeof(ret)); \
+        return ret; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Bytes of the key of a leaf
+     *****************************************************************/ \
+    static inline const uint8_t* _##ARTMAP_NAME##_leaf_bytes(const _##ARTMAP_NAME##Leaf* leaf, uint8_t* buf, size_t* len) \
+    { \
+        return ARTMAP_KEY_BYTES((const ARTMAP_KEY_TYPE*) &leaf->entry.key, buf, len); \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Byte i of the prefix of a node, which starts at byte depth of
+     * every key below it
+     *****************************************************************/ \
+    static inline uint8_t _##ARTMAP_NAME##_prefix_byte(const _ArtNode* node, size_t depth, size_t i) \
+    { \
+        if (i < _ARTMAP_MAX_PREFIX_LEN) \
+            return node->prefix[i]; \
+        uint8_t buf[ARTMAP_KEY_BUF_SIZE]; \
+        size_t len; \
+        const uint8_t* bytes = _##ARTMAP_NAME##_leaf_bytes(_artmap_minimum((void*) node), buf, &len); \
+        return bytes[depth + i]; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Number of leading bytes of the prefix of a node that match the
+     * key from byte depth on, which must be at most len
+     *****************************************************************/ \
+    static size_t _##ARTMAP_NAME##_prefix_match(const _ArtNode* node, const uint8_t* bytes, size_t len, size_t depth) \
+    { \
+        size_t n = node->prefix_len < len - depth ? node->prefix_len : len - depth; \
+        size_t n_stored = n < _ARTMAP_MAX_PREFIX_LEN ? n : _ARTMAP_MAX_PREFIX_LEN; \
+        size_t i = 0; \
+        while (i < n_stored && node->prefix[i] == bytes[depth + i]) \
+            i++; \
+        if (i < n_stored || i == n) \
+            return i; \
+        uint8_t buf[ARTMAP_KEY_BUF_SIZE]; \
+        size_t leaf_len; \
+        const uint8_t* leaf_bytes = _##ARTMAP_NAME##_leaf_bytes(_artmap_minimum((void*) node), buf, &leaf_len); \
+        while (i < n && leaf_bytes[depth + i] == bytes[depth + i]) \
+            i++; \
+        return i; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Links a new leaf between prev and next
+     *****************************************************************/ \
+    static void _##ARTMAP_NAME##_link(ARTMAP_NAME* map, _##ARTMAP_NAME##Leaf* leaf, _##ARTMAP_NAME##Leaf* prev, _##ARTMAP_NAME##Leaf* next) \
+    { \
+        leaf->prev = prev; \
+        leaf->next = next; \
+        if (prev) \
+            prev->next = leaf; \
+        else \
+            map->_min = leaf; \
+        if (next) \
+            next->prev = leaf; \
+        else \
+            map->_max = leaf; \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Finds the entry of a key
+     *
+     * @param insert whether to insert the key if it is not found, its value
+     *    is then zeroed
+     * @returns the entry, or NULL if it was not found and insert is false.
+     *    Pointers to entries stay valid until they are removed
+     *******************************************************************************/ \
+    static ARTMAP_NAME##Entry* ARTMAP_NAME##_search(ARTMAP_NAME* map, const ARTMAP_KEY_TYPE* key, bool insert) \
+    { \
+        assert(map); \
+        assert(key); \
+        uint8_t buf[ARTMAP_KEY_BUF_SIZE]; \
+        size_t len; \
+        const uint8_t* bytes = ARTMAP_KEY_BYTES(key, buf, &len); \
+        \
+        /* prefixes longer than the stored bytes are not checked here, but by comparing with the leaf */ \
+        void* child = map->_root; \
+        size_t depth = 0; \
+        while (child && !_artmap_is_leaf(child)) { \
+            _ArtNode* node = child; \
+            size_t n_cmp = node->prefix_len < _ARTMAP_MAX_PREFIX_LEN ? node->prefix_len : _ARTMAP_MAX_PREFIX_LEN; \
+            if (depth + node->prefix_len >= len || memcmp(node->prefix, bytes + depth, n_cmp) != 0) { \
+                child = NULL; \
+                break; \
+            } \
+            depth += node->prefix_len; \
+            void** slot = _artmap_find_child(node, bytes[depth]); \
+            child = slot ? *slot : NULL; \
+            depth++; \
+        } \
+        if (child) { \
+            _##ARTMAP_NAME##Leaf* leaf = _artmap_leaf(child); \
+            uint8_t leaf_buf[ARTMAP_KEY_BUF_SIZE]; \
+            size_t leaf_len; \
+            const uint8_t* leaf_bytes = _##ARTMAP_NAME##_leaf_bytes(leaf, leaf_buf, &leaf_len); \
+            if (leaf_len == len && memcmp(leaf_bytes, bytes, len) == 0) \
+                return &leaf->entry; \
+        } \
+        if (!insert) \
+            return NULL; \
+        \
+        _##ARTMAP_NAME##Leaf* leaf = calloc(1, sizeof(_##ARTMAP_NAME##Leaf)); \
+        assert(leaf); \
+        leaf->entry.key = *key; \
+        map->_n_bytes += sizeof(_##ARTMAP_NAME##Leaf); \
+        map->size++; \
+        if (!map->_root) { \
+            map->_root = _artmap_tag_leaf(leaf); \
+            _##ARTMAP_NAME##_link(map, leaf, NULL, NULL); \
+            return &leaf->entry; \
+        } \
+        \
+        void** ref = &map->_root; \
+        depth = 0; \
+        for (;;) { \
+            if (_artmap_is_leaf(*ref)) { \
+                /* two leaves below a new node, with the bytes they share as its prefix */ \
+                _##ARTMAP_NAME##Leaf* other = _artmap_leaf(*ref); \
+                uint8_t other_buf[ARTMAP_KEY_BUF_SIZE]; \
+                size_t other_len; \
+                const uint8_t* other_bytes = _##ARTMAP_NAME##_leaf_bytes(other, other_buf, &other_len); \
+                size_t common = 0; \
+                while (depth + common < len && depth + common < other_len && bytes[depth + common] == other_bytes[depth + common]) \
+                    common++; \
+                assert(depth + common < len && depth + common < other_len && "no key may be a prefix of another"); \
+                _ArtNode* node = _artmap_new_node(_ARTMAP_NODE4, &map->_n_bytes); \
+                node->prefix_len = (uint32_t) common; \
+                memcpy(node->prefix, bytes + depth, common < _ARTMAP_MAX_PREFIX_LEN ? common : _ARTMAP_MAX_PREFIX_LEN); \
+                void* node_ref = node; \
+                _artmap_add_child(&node_ref, other_bytes[depth + common], *ref, &map->_n_bytes); \
+                _artmap_add_child(&node_ref, bytes[depth + common], _artmap_tag_leaf(leaf), &map->_n_bytes); \
+                *ref = node_ref; \
+                if (bytes[depth + common] < other_bytes[depth + common]) \
+                    _##ARTMAP_NAME##_link(map, leaf, other->prev, other); \
+                else \
+                    _##ARTMAP_NAME##_link(map, leaf, other, other->next); \
+                return &leaf->entry; \
+            } \
+            \
+            _ArtNode* node = *ref; \
+            size_t mismatch = _##ARTMAP_NAME##_prefix_match(node, bytes, len, depth); \
+            assert(depth + mismatch < len && "no key may be a prefix of another"); \
+            if (mismatch < node->prefix_len) { \
+                /* the node and the leaf below a new node, with the matching part of the prefix */ \
+                _ArtNode* parent = _artmap_new_node(_ARTMAP_NODE4, &map->_n_bytes); \
+                parent->prefix_len = (uint32_t) mismatch; \
+                memcpy(parent->prefix, bytes + depth, mismatch < _ARTMAP_MAX_PREFIX_LEN ? mismatch : _ARTMAP_MAX_PREFIX_LEN); \
+                uint8_t node_byte = _##ARTMAP_NAME##_prefix_byte(node, depth, mismatch); \
+                uint8_t rest[_ARTMAP_MAX_PREFIX_LEN]; \
+                size_t rest_len = node->prefix_len - mismatch - 1; \
+                for (size_t i = 0; i < rest_len && i < _ARTMAP_MAX_PREFIX_LEN; i++) \
+                    rest[i] = _##ARTMAP_NAME##_prefix_byte(node, depth, mismatch + 1 + i); \
+                memcpy(node->prefix, rest, rest_len < _ARTMAP_MAX_PREFIX_LEN ? rest_len : _ARTMAP_MAX_PREFIX_LEN); \
+                node->prefix_len = (uint32_t) rest_len; \
+                void* parent_ref = parent; \
+                _artmap_add_child(&parent_ref, node_byte, node, &map->_n_bytes); \
+                _artmap_add_child(&parent_ref, bytes[depth + mismatch], _artmap_tag_leaf(leaf), &map->_n_bytes); \
+                *ref = parent_ref; \
+                if (bytes[depth + mismatch] < node_byte) { \
+                    _##ARTMAP_NAME##Leaf* next = _artmap_minimum(node); \
+                    _##ARTMAP_NAME##_link(map, leaf, next->prev, next); \
+                } else { \
+                    _##ARTMAP_NAME##Leaf* prev = _artmap_maximum(node); \
+                    _##ARTMAP_NAME##_link(map, leaf, prev, prev->next); \
+                } \
+                return &leaf->entry; \
+            } \
+            \
+            depth += node->prefix_len; \
+            assert(depth < len && "no key may be a prefix of another"); \
+            uint8_t c = bytes[depth]; \
+            void** slot = _artmap_find_child(node, c); \
+            if (slot) { \
+                ref = slot; \
+                depth++; \
+                continue; \
+            } \
+            uint8_t byte; \
+            void* smaller = _artmap_child_le(node, (int) c - 1, &byte); \
+            if (smaller) { \
+                _##ARTMAP_NAME##Leaf* prev = _artmap_maximum(smaller); \
+                _##ARTMAP_NAME##_link(map, leaf, prev, prev->next); \
+            } else { \
+                _##ARTMAP_NAME##Leaf* next = _artmap_minimum(node); \
+                _##ARTMAP_NAME##_link(map, leaf, next->prev, next); \
+            } \
+            _artmap_add_child(ref, c, _artmap_tag_leaf(leaf), &map->_n_bytes); \
+            return &leaf->entry; \
+        } \
+    } \
+    \
+    \
+    static bool ARTMAP_NAME##_contains(const ARTMAP_NAME* map, const ARTMAP_KEY_TYPE* key) \
+    { \
+        return ARTMAP_NAME##_search((ARTMAP_NAME*) map, key, false) != NULL; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Assigns a value to a key
+     *****************************************************************/ \
+    static void ARTMAP_NAME##_insert(ARTMAP_NAME* map, ARTMAP_KEY_TYPE key, ARTMAP_VAL_TYPE value) \
+    { \
+        ARTMAP_NAME##_search(map, (const ARTMAP_KEY_TYPE*) &key, true)->value = value; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Removes the entry of a key, if there is one
+     *****************************************************************/ \
+    static void ARTMAP_NAME##_remove(ARTMAP_NAME* map, const ARTMAP_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        uint8_t buf[ARTMAP_KEY_BUF_SIZE]; \
+        size_t len; \
+        const uint8_t* bytes = ARTMAP_KEY_BYTES(key, buf, &len); \
+        \
+        void** ref = &map->_root; \
+        void** parent_ref = NULL; \
+        uint8_t c = 0; \
+        size_t depth = 0; \
+        while (*ref && !_artmap_is_leaf(*ref)) { \
+            _ArtNode* node = *ref; \
+            size_t n_cmp = node->prefix_len < _ARTMAP_MAX_PREFIX_LEN ? node->prefix_len : _ARTMAP_MAX_PREFIX_LEN; \
+            if (depth + node->prefix_len >= len || memcmp(node->prefix, bytes + depth, n_cmp) != 0) \
+                return; \
+            depth += node->prefix_len; \
+            c = bytes[depth]; \
+            void** slot = _artmap_find_child(node, c); \
+            if (!slot) \
+                return; \
+            parent_ref = ref; \
+            ref = slot; \
+            depth++; \
+        } \
+        if (!*ref) \
+            return; \
+        _##ARTMAP_NAME##Leaf* leaf = _artmap_leaf(*ref); \
+        uint8_t leaf_buf[ARTMAP_KEY_BUF_SIZE]; \
+        size_t leaf_len; \
+        const uint8_t* leaf_bytes = _##ARTMAP_NAME##_leaf_bytes(leaf, leaf_buf, &leaf_len); \
+        if (leaf_len != len || memcmp(leaf_bytes, bytes, len) != 0) \
+            return; \
+        \
+        if (parent_ref) \
+            _artmap_remove_child(parent_ref, c, ref, &map->_n_bytes); \
+        else \
+            map->_root = NULL; \
+        if (leaf->prev) \
+            leaf->prev->next = leaf->next; \
+        else \
+            map->_min = leaf->next; \
+        if (leaf->next) \
+            leaf->next->prev = leaf->prev; \
+        else \
+            map->_max = leaf->prev; \
+        free(leaf); \
+        map->_n_bytes -= sizeof(_##ARTMAP_NAME##Leaf); \
+        map->size--; \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Do not use this function
+     *
+     * Leaf with the smallest key greater than or equal to key if ge is true,
+     * otherwise with the largest key less than or equal to key, or NULL
+     *******************************************************************************/ \
+    static _##ARTMAP_NAME##Leaf* _##ARTMAP_NAME##_seek(const ARTMAP_NAME* map, const ARTMAP_KEY_TYPE* key, bool ge) \
+    { \
+        uint8_t buf[ARTMAP_KEY_BUF_SIZE]; \
+        size_t len; \
+        const uint8_t* bytes = ARTMAP_KEY_BYTES(key, buf, &len); \
+        void* child = map->_root; \
+        size_t depth = 0; \
+        if (!child) \
+            return NULL; \
+        for (;;) { \
+            if (_artmap_is_leaf(child)) { \
+                _##ARTMAP_NAME##Leaf* leaf = _artmap_leaf(child); \
+                uint8_t leaf_buf[ARTMAP_KEY_BUF_SIZE]; \
+                size_t leaf_len; \
+                const uint8_t* leaf_bytes = _##ARTMAP_NAME##_leaf_bytes(leaf, leaf_buf, &leaf_len); \
+                int cmp_res = _artmap_bytes_cmp(leaf_bytes, leaf_len, bytes, len); \
+                if (cmp_res == 0) \
+                    return leaf; \
+                if (ge) \
+                    return cmp_res > 0 ? leaf : leaf->next; \
+                return cmp_res < 0 ? leaf : leaf->prev; \
+            } \
+            /* the whole subtree is either greater or smaller than the key, unless the prefix matches */ \
+            _ArtNode* node = child; \
+            size_t match = _##ARTMAP_NAME##_prefix_match(node, bytes, len, depth); \
+            int cmp_res = 1; \
+            if (match < node->prefix_len && depth + match < len) \
+                cmp_res = (int) _##ARTMAP_NAME##_prefix_byte(node, depth, match) - (int) bytes[depth + match]; \
+            else if (match == node->prefix_len && depth + match < len) \
+                cmp_res = 0; \
+            depth += node->prefix_len; \
+            if (cmp_res > 0) { \
+                _##ARTMAP_NAME##Leaf* min = _artmap_minimum(node); \
+                return ge ? min : min->prev; \
+            } \
+            if (cmp_res < 0) { \
+                _##ARTMAP_NAME##Leaf* max = _artmap_maximum(node); \
+                return ge ? max->next : max; \
+            } \
+            uint8_t c = bytes[depth], byte; \
+            if (ge) { \
+                child = _artmap_child_ge(node, c, &byte); \
+                if (!child) \
+                    return ((_##ARTMAP_NAME##Leaf*) _artmap_maximum(node))->next; \
+                if (byte > c) \
+                    return _artmap_minimum(child); \
+            } else { \
+                child = _artmap_child_le(node, c, &byte); \
+                if (!child) \
+                    return ((_##ARTMAP_NAME##Leaf*) _artmap_minimum(node))->prev; \
+                if (byte < c) \
+                    return _artmap_maximum(child); \
+            } \
+            depth++; \
+        } \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Iterator at a leaf, bounded by first and last if they are set
+     *****************************************************************/ \
+    static ARTMAP_NAME##Iter _##ARTMAP_NAME##_iter_at(_##ARTMAP_NAME##Leaf* leaf, _##ARTMAP_NAME##Leaf* first, _##ARTMAP_NAME##Leaf* last) \
+    { \
+        ARTMAP_NAME##Iter ret; \
+        ret.current = leaf ? &leaf->entry : NULL; \
+        ret._first = first; \
+        ret._last = last; \
+        return ret; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Returns an iterator starting at key, current is NULL if the
+     * key is not found
+     *****************************************************************/ \
+    static ARTMAP_NAME##Iter ARTMAP_NAME##_iter(const ARTMAP_NAME* map, const ARTMAP_KEY_TYPE* key) \
+    { \
+        return _##ARTMAP_NAME##_iter_at((_##ARTMAP_NAME##Leaf*) ARTMAP_NAME##_search((ARTMAP_NAME*) map, key, false), NULL, NULL); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns an iterator starting at the minimum element in the map
+     *******************************************************************/ \
+    static ARTMAP_NAME##Iter ARTMAP_NAME##_min_iter(const ARTMAP_NAME* map) \
+    { \
+        assert(map); \
+        return _##ARTMAP_NAME##_iter_at(map->_min, NULL, NULL); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns an iterator starting at the maximum element in the map
+     *******************************************************************/ \
+    static ARTMAP_NAME##Iter ARTMAP_NAME##_max_iter(const ARTMAP_NAME* map) \
+    { \
+        assert(map); \
+        return _##ARTMAP_NAME##_iter_at(map->_max, NULL, NULL); \
+    } \
+    \
+    \
+    /*********************************************
+     * Returns an iterator starting at the
+     * maximum element less than or equal to key
+     *********************************************/ \
+    static ARTMAP_NAME##Iter ARTMAP_NAME##_floor_iter(const ARTMAP_NAME* map, const ARTMAP_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        return _##ARTMAP_NAME##_iter_at(_##ARTMAP_NAME##_seek(map, key, false), NULL, NULL); \
+    } \
+    \
+    \
+    /************************************************
+     * Returns an iterator starting at the
+     * minimum element greater than or equal to key
+     ************************************************/ \
+    static ARTMAP_NAME##Iter ARTMAP_NAME##_ceil_iter(const ARTMAP_NAME* map, const ARTMAP_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        return _##ARTMAP_NAME##_iter_at(_##ARTMAP_NAME##_seek(map, key, true), NULL, NULL); \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Returns an iterator over the keys whose bytes, as given by ARTMAP_KEY_BYTES,
+     * start with the len bytes of prefix, in order. Iter_inc and Iter_dec stop at
+     * the last and the first of them. For null terminated string keys, the
+     * terminator is left out of the prefix
+     *******************************************************************************/ \
+    static ARTMAP_NAME##Iter ARTMAP_NAME##_prefix_iter(const ARTMAP_NAME* map, const void* prefix, size_t len) \
+    { \
+        assert(map); \
+        assert(prefix || len == 0); \
+        const uint8_t* bytes = prefix; \
+        void* child = map->_root; \
+        size_t depth = 0; \
+        while (child) { \
+            if (depth >= len) { \
+                _##ARTMAP_NAME##Leaf* first = _artmap_minimum(child); \
+                return _##ARTMAP_NAME##_iter_at(first, first, _artmap_maximum(child)); \
+            } \
+            if (_artmap_is_leaf(child)) { \
+                _##ARTMAP_NAME##Leaf* leaf = _artmap_leaf(child); \
+                uint8_t leaf_buf[ARTMAP_KEY_BUF_SIZE]; \
+                size_t leaf_len; \
+                const uint8_t* leaf_bytes = _##ARTMAP_NAME##_leaf_bytes(leaf, leaf_buf, &leaf_len); \
+                if (leaf_len >= len && memcmp(leaf_bytes, bytes, len) == 0) \
+                    return _##ARTMAP_NAME##_iter_at(leaf, leaf, leaf); \
+                break; \
+            } \
+            _ArtNode* node = child; \
+            size_t match = _##ARTMAP_NAME##_prefix_match(node, bytes, len, depth); \
+            if (depth + match >= len) { \
+                _##ARTMAP_NAME##Leaf* first = _artmap_minimum(child); \
+                return _##ARTMAP_NAME##_iter_at(first, first, _artmap_maximum(child)); \
+            } \
+            if (match < node->prefix_len) \
+                break; \
+            depth += node->prefix_len; \
+            void** slot = _artmap_find_child(node, bytes[depth]); \
+            child = slot ? *slot : NULL; \
+            depth++; \
+        } \
+        return _##ARTMAP_NAME##_iter_at(NULL, NULL, NULL); \
+    } \
+    \
+    \
+    /**************************************************************
+     * sets the field current to be the next element in the map,
+     * if there are no more elements, current is set to NULL
+     **************************************************************/ \
+    static void ARTMAP_NAME##Iter_inc(ARTMAP_NAME##Iter* iter) \
+    { \
+        assert(iter); \
+        if (!iter->current) \
+            return; \
+        _##ARTMAP_NAME##Leaf* leaf = (_##ARTMAP_NAME##Leaf*) iter->current; \
+        iter->current = leaf == iter->_last || !leaf->next ? NULL : &leaf->next->entry; \
+    } \
+    \
+    \
+    /**************************************************************
+     * sets the field current to be the previous element in the map,
+     * if there are no more elements, current is set to NULL
+     **************************************************************/ \
+    static void ARTMAP_NAME##Iter_dec(ARTMAP_NAME##Iter* iter) \
+    { \
+        assert(iter); \
+        if (!iter->current) \
+            return; \
+        _##ARTMAP_NAME##Leaf* leaf = (_##ARTMAP_NAME##Leaf*) iter->current; \
+        iter->current = leaf == iter->_first || !leaf->prev ? NULL : &leaf->prev->entry; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Bytes used by the map, its inner nodes and leaves
+     *****************************************************************/ \
+    static size_t ARTMAP_NAME##_memory_usage(const ARTMAP_NAME* map) \
+    { \
+        assert(map); \
+        return sizeof(ARTMAP_NAME) + map->_n_bytes; \
+    } \
+    \
+    \
+    /**************************************************
+    * Deallocates all resources used by this ArtMap.
+    * It must not be used after this point
+    ***************************************************/ \
+    static void ARTMAP_NAME##_free(ARTMAP_NAME* map) \
+    { \
+        assert(map); \
+        _artmap_free_nodes(map->_root, &map->_n_bytes); \
+        for (_##ARTMAP_NAME##Leaf* leaf = map->_min; leaf;) { \
+            _##ARTMAP_NAME##Leaf* next = leaf->next; \
+            free(leaf); \
+            leaf = next; \
+        } \
+        memset(map, 0, sizeof(*map)); \
+    }
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+/***************************************************************************************
+ * Blocked Bloom filter, to skip lookups of keys that are certainly absent
+ *
+ * The bits are split into blocks of 256 bits, aligned so that no block crosses
+ * a cache line. Every key selects one block with the high half of its hash, and
+ * sets one bit in each of the 8 32 bit words of that block, chosen by multiplying
+ * the low half of its hash with 8 odd constants. Adding or querying a key touches
+ * a single cache line, and with AVX2 (-mavx2 or -march=native) all 8 bits are
+ * computed and tested with one instruction each. See Putze et al., "Cache-, hash-
+ * and space-efficient bloom filters", and the split block Bloom filter of Impala.
+ *
+ * With 10 bits per key about 1.3% of absent keys are reported as possibly present,
+ * with 16 bits per key about 0.13%. Keys can not be removed, see cuckoofilter.h.
+ *
+ * The hash function is the one passed to HASHMAP_DEFINE, for instance byte_hasher
+ * or the hash of a TUPLE_DEFINE, so the filter can be queried in front of a HashMap,
+ * or a TreeMap snapshot, to skip most lookups of absent keys. The bits of the hash
+ * should be well mixed, as they are used directly.
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// keys hashed, and their blocks prefetched, before any of them is tested by the batch queries
+#ifndef _BLOOMFILTER_BATCH
+#define _BLOOMFILTER_BATCH 16
+#endif
+
+#define _BLOOMFILTER_BLOCK_BITS 256
+#define _BLOOMFILTER_BLOCK_WORDS 8
+
+/*********************************************************************
+ * Block of a Bloom filter, every key sets one bit of every word
+ *********************************************************************/
+typedef struct
+{
+    _Alignas(32) uint32_t words[_BLOOMFILTER_BLOCK_WORDS];
+} _BloomFilterBlock;
+
+static const uint32_t _bloomfilter_salts[_BLOOMFILTER_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Index of the block of a hash, in [0, n_blocks)
+ *****************************************************************/
+static inline size_t _bloomfilter_block_index(uint64_t hash, size_t n_blocks)
+{
+    return (size_t) (((hash >> 32) * (uint64_t) n_blocks) >> 32);
+}
+
+#ifdef __AVX2__
+/*****************************************************************
+ * Do not use this function
+ *
+ * The 8 bits of a hash, one in every word of a block
+ *****************************************************************/
+static inline __m256i _bloomfilter_mask(uint32_t hash)
+{
+    __m256i salts = _mm256_loadu_si256((const __m256i*) _bloomfilter_salts);
+    __m256i shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32((int) hash), salts), 27);
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+}
+#endif
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Sets the bits of a hash in a block
+ *****************************************************************/
+static inline void _bloomfilter_block_add(_BloomFilterBlock* block, uint32_t hash)
+{
+#ifdef __AVX2__
+    __m256i* words = (__m256i*) block->words;
+    _mm256_store_si256(words, _mm256_or_si256(_mm256_load_si256(words), _bloomfilter_mask(hash)));
+#else
+    for (size_t i = 0; i < _BLOOMFILTER_BLOCK_WORDS; i++)
+        block->words[i] |= UINT32_C(1) << ((hash * _bloomfilter_salts[i]) >> 27);
+#endif
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Checks whether all bits of a hash are set in a block
+ *****************************************************************/
+static inline bool _bloomfilter_block_test(const _BloomFilterBlock* block, uint32_t hash)
+{
+#ifdef __AVX2__
+    return _mm256_testc_si256(_mm256_load_si256((const __m256i*) block->words), _bloomfilter_mask(hash));
+#else
+    uint32_t missing = 0;
+    for (size_t i = 0; i < _BLOOMFILTER_BLOCK_WORDS; i++)
+        missing |= ~block->words[i] & (UINT32_C(1) << ((hash * _bloomfilter_salts[i]) >> 27));
+    return missing == 0;
+#endif
+}
+
+
+/***************************************************************************************
+ * Creates a new Bloom filter type
+ *
+ * @param BLOOMFILTER_NAME name of the filter struct and prefix of every function
+ * @param BLOOMFILTER_KEY_TYPE type of the keys
+ * @param BLOOMFILTER_HASH_FUNC function or macro hashing a const BLOOMFILTER_KEY_TYPE*,
+ *    as for HASHMAP_DEFINE
+ ***************************************************************************************/
+#define BLOOMFILTER_DEFINE(BLOOMFILTER_NAME, BLOOMFILTER_KEY_TYPE, BLOOMFILTER_HASH_FUNC) \
+    typedef struct \
+    { \
+        size_t size;                        /* number of keys added, including duplicates */ \
+        _BloomFilterBlock* _blocks; \
+        size_t _n_blocks; \
+    } BLOOMFILTER_NAME; \
+    \
+    \
+    /***********************************************************************
+     * Creates an empty filter sized for expected_n keys with bits_per_key
+     * bits each, rounded up to whole blocks. Adding more keys than
+     * expected raises the rate of false positives
+     ***********************************************************************/ \
+    static BLOOMFILTER_NAME BLOOMFILTER_NAME##_new(size_t expected_n, size_t bits_per_key) \
+    { \
+        assert(bits_per_key > 0); \
+        BLOOMFILTER_NAME filter; \
+        filter.size = 0; \
+        filter._n_blocks = (expected_n * bits_per_key + _BLOOMFILTER_BLOCK_BITS - 1) / _BLOOMFILTER_BLOCK_BITS; \
+        if (filter._n_blocks == 0) \
+            filter._n_blocks = 1; \
+        assert(filter._n_blocks <= UINT32_MAX); \
+        filter._blocks = aligned_alloc(64, (filter._n_blocks * sizeof(_BloomFilterBlock) + 63) / 64 * 64); \
+        assert(filter._blocks); \
+        memset(filter._blocks, 0, filter._n_blocks * sizeof(_BloomFilterBlock)); \
+        return filter; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Adds a key by its hash, as computed by BLOOMFILTER_HASH_FUNC
+     *******************************************************************/ \
+    static void BLOOMFILTER_NAME##_add_hash(BLOOMFILTER_NAME* filter, size_t hash) \
+    { \
+        assert(filter); \
+        _bloomfilter_block_add(filter->_blocks + _bloomfilter_block_index(hash, filter->_n_blocks), (uint32_t) hash); \
+        filter->size++; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Adds a key, after which may_contain returns true for it
+     *******************************************************************/ \
+    static void BLOOMFILTER_NAME##_add(BLOOMFILTER_NAME* filter, const BLOOMFILTER_KEY_TYPE* key) \
+    { \
+        assert(key); \
+        BLOOMFILTER_NAME##_add_hash(filter, BLOOMFILTER_HASH_FUNC(key)); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Checks a key by its hash, as computed by BLOOMFILTER_HASH_FUNC
+     *******************************************************************/ \
+    static bool BLOOMFILTER_NAME##_may_contain_hash(const BLOOMFILTER_NAME* filter, size_t hash) \
+    { \
+        assert(filter); \
+        return _bloomfilter_block_test(filter->_blocks + _bloomfilter_block_index(hash, filter->_n_blocks), (uint32_t) hash); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * @returns false if the key was certainly never added, true if it
+     *    was added, or rarely, if it was not (a false positive)
+     *******************************************************************/ \
+    static bool BLOOMFILTER_NAME##_may_contain(const BLOOMFILTER_NAME* filter, const BLOOMFILTER_KEY_TYPE* key) \
+    { \
+        assert(key); \
+        return BLOOMFILTER_NAME##_may_contain_hash(filter, BLOOMFILTER_HASH_FUNC(key)); \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Checks n keys, writing the result of may_contain for keys[i] to out[i].
+     * Keys are hashed and their blocks prefetched _BLOOMFILTER_BATCH at a time,
+     * so the cache misses of a batch overlap instead of following each other
+     *******************************************************************************/ \
+    static void BLOOMFILTER_NAME##_may_contain_batch(const BLOOMFILTER_NAME* filter, const BLOOMFILTER_KEY_TYPE* keys, size_t n, bool out[]) \
+    { \
+        assert(filter); \
+        assert(keys || n == 0); \
+        assert(out || n == 0); \
+        size_t hashes[_BLOOMFILTER_BATCH]; \
+        const _BloomFilterBlock* blocks[_BLOOMFILTER_BATCH]; \
+        for (size_t start = 0; start < n; start += _BLOOMFILTER_BATCH) { \
+            size_t batch = n - start < _BLOOMFILTER_BATCH ? n - start : _BLOOMFILTER_BATCH; \
+            for (size_t i = 0; i < batch; i++) { \
+                hashes[i] = BLOOMFILTER_HASH_FUNC((keys + start + i)); \
+                blocks[i] = filter->_blocks + _bloomfilter_block_index(hashes[i], filter->_n_blocks); \
+                __builtin_prefetch(blocks[i]); \
+            } \
+            for (size_t i = 0; i < batch; i++) \
+                out[start + i] = _bloomfilter_block_test(blocks[i], (uint32_t) hashes[i]); \
+        } \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Removes all keys, keeping the size of the filter
+     *******************************************************************/ \
+    static void BLOOMFILTER_NAME##_clear(BLOOMFILTER_NAME* filter) \
+    { \
+        assert(filter); \
+        memset(filter->_blocks, 0, filter->_n_blocks * sizeof(_BloomFilterBlock)); \
+        filter->size = 0; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Bytes allocated by the filter
+     *******************************************************************/ \
+    static size_t BLOOMFILTER_NAME##_memory_usage(const BLOOMFILTER_NAME* filter) \
+    { \
+        assert(filter); \
+        return sizeof(BLOOMFILTER_NAME) + filter->_n_blocks * sizeof(_BloomFilterBlock); \
+    } \
+    \
+    \
+    static void BLOOMFILTER_NAME##_free(BLOOMFILTER_NAME* filter) \
+    { \
+        assert(filter); \
+        free(filter->_blocks); \
+        filter->_blocks = NULL; \
+        filter->_n_blocks = 0; \
+        filter->size = 0; \
+    }
+
+#endif
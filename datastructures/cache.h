@@ -0,0 +1,571 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+/***************************************************************************************
+ * Fixed capacity key-value caches with LRU, CLOCK or S3-FIFO eviction
+ *
+ * All entries live in one array of capacity slots, allocated by CACHE_NAME##_new,
+ * and queues are linked through 32 bit slot numbers instead of pointers.
+ * Keys are found through an open addressing index of slot numbers, sized up
+ * front so it never resizes. Nothing is allocated or freed after construction.
+ *
+ * Policies, chosen at compile time:
+ * - CACHE_LRU, evicts the least recently used entry. Every hit moves the entry
+ *   to the front of a doubly linked list
+ * - CACHE_CLOCK, approximates LRU with one reference bit per slot, set by hits
+ *   and cleared by a hand sweeping over the slots. Hits write nothing but the bit
+ * - CACHE_S3FIFO, new entries go into a small FIFO queue (_CACHE_S3FIFO_SMALL_RATIO
+ *   of the capacity), and only move to the main FIFO queue if they are hit again
+ *   before they reach its end. Entries evicted from the main queue get another
+ *   round for every hit, up to 3. Keys evicted from the small queue are remembered
+ *   in a ghost queue of capacity keys, and go straight to the main queue if they
+ *   come back. One-hit wonders and scans are evicted quickly, without flushing
+ *   the frequently used entries. See Yang et al., "FIFO queues are all you need
+ *   for cache eviction", SOSP 2023
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define CACHE_LRU 0
+#define CACHE_CLOCK 1
+#define CACHE_S3FIFO 2
+
+// fraction of the capacity used by the small queue of S3-FIFO
+#ifndef _CACHE_S3FIFO_SMALL_RATIO
+#define _CACHE_S3FIFO_SMALL_RATIO 0.1
+#endif
+
+// highest access count kept per entry by S3-FIFO
+#define _CACHE_S3FIFO_MAX_FREQ 3
+
+// the index is never more than this full, it holds live and ghost keys
+#ifndef _CACHE_INDEX_LOAD_FACTOR
+#define _CACHE_INDEX_LOAD_FACTOR 0.5
+#endif
+
+// marks an empty index bucket and the end of a queue
+#define _CACHE_NIL UINT32_MAX
+
+// queues of a slot, S3-FIFO uses both, LRU only the first
+#define _CACHE_SMALL 0
+#define _CACHE_MAIN 1
+// marks a slot freed by remove or evict, skipped by the CLOCK hand
+#define _CACHE_FREE 2
+
+/*******************************************************************
+ * Bucket of the index of a cache. The hash is kept next to the
+ * slot number, so probing only reads the slots of equal hashes
+ *******************************************************************/
+typedef struct
+{
+    uint32_t ref;   // slot number, or capacity + ghost number, _CACHE_NIL if empty
+    uint32_t hash;
+} _CacheIndexBucket;
+
+/************************************************************
+ * Counters of a cache, returned by CACHE_NAME##_stats
+ ************************************************************/
+typedef struct
+{
+    size_t hits;
+    size_t misses;
+    size_t insertions;
+    size_t evictions;
+    size_t ghost_hits;      // S3-FIFO only, insertions of keys recently evicted from the small queue
+} CacheStats;
+
+
+/***************************************************************************************
+ * Creates a new cache type
+ *
+ * @param CACHE_NAME name of the cache struct and prefix of every function
+ * @param CACHE_KEY_TYPE type of keys, stored in place
+ * @param CACHE_VAL_TYPE type of values, stored in place
+ * @param CACHE_HASH_FUNC function or macro hashing a const CACHE_KEY_TYPE*,
+ *    as for HASHMAP_DEFINE
+ * @param CACHE_KEY_EQ_FUNC function or macro comparing two const CACHE_KEY_TYPE*,
+ *    returning 1 if they are equal and 0 otherwise
+ * @param CACHE_POLICY CACHE_LRU, CACHE_CLOCK or CACHE_S3FIFO
+ ***************************************************************************************/
+#define CACHE_DEFINE(CACHE_NAME, CACHE_KEY_TYPE, CACHE_VAL_TYPE, CACHE_HASH_FUNC, CACHE_KEY_EQ_FUNC, CACHE_POLICY) \
+    typedef struct \
+    { \
+        CACHE_KEY_TYPE key; \
+        CACHE_VAL_TYPE value; \
+        uint32_t _hash; \
+        uint32_t _prev; \
+        uint32_t _next;     /* also links free slots */ \
+        uint8_t _queue; \
+        uint8_t _freq;      /* reference bit for CLOCK, access count for S3-FIFO */ \
+    } _##CACHE_NAME##Slot; \
+    \
+    typedef struct \
+    { \
+        CACHE_KEY_TYPE key; \
+        uint32_t _hash; \
+        bool _is_valid; \
+    } _##CACHE_NAME##Ghost; \
+    \
+    /* called with every evicted entry, before its slot is reused */ \
+    typedef void (*CACHE_NAME##EvictCallback)(const CACHE_KEY_TYPE* key, CACHE_VAL_TYPE* value, void* ctx); \
+    \
+    typedef struct \
+    { \
+        size_t size; \
+        size_t capacity; \
+        _##CACHE_NAME##Slot* _slots; \
+        size_t _n_used;                 /* slots before this index have been handed out */ \
+        uint32_t _free;                 /* first slot freed by remove or evict */ \
+        _CacheIndexBucket* _index; \
+        size_t _index_mask; \
+        uint32_t _heads[2]; \
+        uint32_t _tails[2]; \
+        size_t _queue_sizes[2]; \
+        size_t _small_capacity; \
+        size_t _hand;                   /* next slot checked by CLOCK */ \
+        _##CACHE_NAME##Ghost* _ghosts;  /* ring of capacity keys, S3-FIFO only */ \
+        size_t _ghost_pos; \
+        CacheStats _stats; \
+        CACHE_NAME##EvictCallback _on_evict; \
+        void* _on_evict_ctx; \
+    } CACHE_NAME; \
+    \
+    \
+    /**************************************************************************
+     * Creates a new cache, allocating everything it will ever use
+     *
+     * @param capacity number of entries kept, at least 1 and below 2^30
+     **************************************************************************/ \
+    static CACHE_NAME CACHE_NAME##_new(size_t capacity) \
+    { \
+        assert(capacity >= 1 && capacity < (1u << 30)); \
+        CACHE_NAME ret; \
+        memset(&ret, 0, sizeof(ret)); \
+        ret.capacity = capacity; \
+        ret._free = _CACHE_NIL; \
+        ret._heads[0] = ret._heads[1] = ret._tails[0] = ret._tails[1] = _CACHE_NIL; \
+        ret._slots = malloc(capacity * sizeof(_##CACHE_NAME##Slot)); \
+        assert(ret._slots); \
+        size_t n_keys = capacity; \
+        if (CACHE_POLICY == CACHE_S3FIFO) { \
+            ret._small_capacity = capacity * _CACHE_S3FIFO_SMALL_RATIO; \
+            if (ret._small_capacity == 0) \
+                ret._small_capacity = 1; \
+            ret._ghosts = calloc(capacity, sizeof(_##CACHE_NAME##Ghost)); \
+            assert(ret._ghosts); \
+            n_keys += capacity; \
+        } \
+        size_t n_buckets = 16; \
+        for (; n_keys / (double) n_buckets > _CACHE_INDEX_LOAD_FACTOR; n_buckets <<= 1); \
+        ret._index = malloc(n_buckets * sizeof(_CacheIndexBucket)); \
+        assert(ret._index); \
+        memset(ret._index, 0xff, n_buckets * sizeof(_CacheIndexBucket)); \
+        ret._index_mask = n_buckets - 1; \
+        return ret; \
+    } \
+    \
+    \
+    /*********************************************************************
+     * Sets a function called with every entry evicted to make room for
+     * a new one or by CACHE_NAME##_evict, NULL disables it. Entries
+     * removed with CACHE_NAME##_remove are not passed to it
+     *********************************************************************/ \
+    static void CACHE_NAME##_set_evict_callback(CACHE_NAME* cache, CACHE_NAME##EvictCallback on_evict, void* ctx) \
+    { \
+        assert(cache); \
+        cache->_on_evict = on_evict; \
+        cache->_on_evict_ctx = ctx; \
+    } \
+    \
+    \
+    /****************************************************
+     * Do not use this function
+     *
+     * Returns the key an index bucket refers to
+     ****************************************************/ \
+    static const CACHE_KEY_TYPE* _##CACHE_NAME##_index_key(const CACHE_NAME* cache, uint32_t ref) \
+    { \
+        if (ref < cache->capacity) \
+            return &cache->_slots[ref].key; \
+        return &cache->_ghosts[ref - cache->capacity].key; \
+    } \
+    \
+    \
+    /*********************************************************************
+     * Do not use this function
+     *
+     * Returns the bucket of the index holding key, or the empty bucket
+     * where it would be inserted, probing linearly
+     *********************************************************************/ \
+    static size_t _##CACHE_NAME##_index_find(const CACHE_NAME* cache, const CACHE_KEY_TYPE* key, uint32_t hash) \
+    { \
+        size_t ind = hash & cache->_index_mask; \
+        for (;; ind = (ind + 1) & cache->_index_mask) { \
+            _CacheIndexBucket* bucket = cache->_index + ind; \
+            if (bucket->ref == _CACHE_NIL) \
+                return ind; \
+            if (bucket->hash == hash && (CACHE_KEY_EQ_FUNC((key), (_##CACHE_NAME##_index_key(cache, bucket->ref))))) \
+                return ind; \
+        } \
+    } \
+    \
+    \
+    /************************************************************************
+     * Do not use this function
+     *
+     * Empties a bucket of the index, and shifts back the following entries
+     * of its cluster that would no longer be reachable, as in hashmap.h
+     ************************************************************************/ \
+    static void _##CACHE_NAME##_index_remove(CACHE_NAME* cache, size_t ind) \
+    { \
+        size_t hole = ind; \
+        for (size_t next = (ind + 1) & cache->_index_mask; cache->_index[next].ref != _CACHE_NIL; next = (next + 1) & cache->_index_mask) { \
+            size_t home = cache->_index[next].hash & cache->_index_mask; \
+            /* the entry stays if its home is cyclically in (hole, next] */ \
+            bool stays = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next); \
+            if (!stays) { \
+                cache->_index[hole] = cache->_index[next]; \
+                hole = next; \
+            } \
+        } \
+        cache->_index[hole].ref = _CACHE_NIL; \
+    } \
+    \
+    \
+    /*****************************************
+     * Do not use this function
+     *
+     * Links a slot in at the head of a queue
+     *****************************************/ \
+    static void _##CACHE_NAME##_push_head(CACHE_NAME* cache, uint32_t slot, uint8_t queue) \
+    { \
+        _##CACHE_NAME##Slot* s = cache->_slots + slot; \
+        s->_queue = queue; \
+        s->_prev = _CACHE_NIL; \
+        s->_next = cache->_heads[queue]; \
+        if (s->_next != _CACHE_NIL) \
+            cache->_slots[s->_next]._prev = slot; \
+        else \
+            cache->_tails[queue] = slot; \
+        cache->_heads[queue] = slot; \
+        cache->_queue_sizes[queue]++; \
+    } \
+    \
+    \
+    /*************************************
+     * Do not use this function
+     *
+     * Unlinks a slot from its queue
+     *************************************/ \
+    static void _##CACHE_NAME##_unlink(CACHE_NAME* cache, uint32_t slot) \
+    { \
+        _##CACHE_NAME##Slot* s = cache->_slots + slot; \
+        if (s->_prev != _CACHE_NIL) \
+            cache->_slots[s->_prev]._next = s->_next; \
+        else \
+            cache->_heads[s->_queue] = s->_next; \
+        if (s->_next != _CACHE_NIL) \
+            cache->_slots[s->_next]._prev = s->_prev; \
+        else \
+            cache->_tails[s->_queue] = s->_prev; \
+        cache->_queue_sizes[s->_queue]--; \
+    } \
+    \
+    \
+    /**************************************************************
+     * Do not use this function
+     *
+     * Records a hit on an entry, as required by the policy
+     **************************************************************/ \
+    static void _##CACHE_NAME##_touch(CACHE_NAME* cache, uint32_t slot) \
+    { \
+        if (CACHE_POLICY == CACHE_LRU) { \
+            if (cache->_heads[_CACHE_SMALL] != slot) { \
+                _##CACHE_NAME##_unlink(cache, slot); \
+                _##CACHE_NAME##_push_head(cache, slot, _CACHE_SMALL); \
+            } \
+        } else if (CACHE_POLICY == CACHE_CLOCK) { \
+            cache->_slots[slot]._freq = 1; \
+        } else if (cache->_slots[slot]._freq < _CACHE_S3FIFO_MAX_FREQ) { \
+            cache->_slots[slot]._freq++; \
+        } \
+    } \
+    \
+    \
+    /********************************************************************
+     * Do not use this function
+     *
+     * Remembers the key of an entry evicted from the small queue of
+     * S3-FIFO, forgetting the oldest remembered key
+     ********************************************************************/ \
+    static void _##CACHE_NAME##_add_ghost(CACHE_NAME* cache, const _##CACHE_NAME##Slot* slot) \
+    { \
+        _##CACHE_NAME##Ghost* ghost = cache->_ghosts + cache->_ghost_pos; \
+        if (ghost->_is_valid) { \
+            size_t old_ind = _##CACHE_NAME##_index_find(cache, &ghost->key, ghost->_hash); \
+            assert(cache->_index[old_ind].ref == cache->capacity + cache->_ghost_pos); \
+            _##CACHE_NAME##_index_remove(cache, old_ind); \
+        } \
+        ghost->key = slot->key; \
+        ghost->_hash = slot->_hash; \
+        ghost->_is_valid = true; \
+        size_t ind = _##CACHE_NAME##_index_find(cache, &ghost->key, ghost->_hash); \
+        assert(cache->_index[ind].ref == _CACHE_NIL); \
+        cache->_index[ind] = (_CacheIndexBucket) {cache->capacity + cache->_ghost_pos, ghost->_hash}; \
+        cache->_ghost_pos = (cache->_ghost_pos + 1) % cache->capacity; \
+    } \
+    \
+    \
+    /***************************************************************
+     * Do not use this function
+     *
+     * Chooses the slot to evict according to the policy, and
+     * unlinks it from its queue. Sets *to_ghost if S3-FIFO
+     * evicts it from the small queue
+     ***************************************************************/ \
+    static uint32_t _##CACHE_NAME##_choose_victim(CACHE_NAME* cache, bool* to_ghost) \
+    { \
+        *to_ghost = false; \
+        if (CACHE_POLICY == CACHE_LRU) { \
+            uint32_t victim = cache->_tails[_CACHE_SMALL]; \
+            _##CACHE_NAME##_unlink(cache, victim); \
+            return victim; \
+        } \
+        if (CACHE_POLICY == CACHE_CLOCK) { \
+            /* the cache holds an entry, slots never handed out or freed are skipped */ \
+            for (;; cache->_hand++) { \
+                if (cache->_hand >= cache->_n_used) \
+                    cache->_hand = 0; \
+                _##CACHE_NAME##Slot* s = cache->_slots + cache->_hand; \
+                if (s->_queue == _CACHE_FREE) \
+                    continue; \
+                if (!s->_freq) \
+                    return cache->_hand++; \
+                s->_freq = 0; \
+            } \
+        } \
+        for (;;) { \
+            if (cache->_queue_sizes[_CACHE_SMALL] >= cache->_small_capacity || cache->_queue_sizes[_CACHE_MAIN] == 0) { \
+                uint32_t victim = cache->_tails[_CACHE_SMALL]; \
+                _##CACHE_NAME##_unlink(cache, victim); \
+                if (cache->_slots[victim]._freq > 0) { \
+                    cache->_slots[victim]._freq = 0; \
+                    _##CACHE_NAME##_push_head(cache, victim, _CACHE_MAIN); \
+                    continue; \
+                } \
+                *to_ghost = true; \
+                return victim; \
+            } \
+            uint32_t victim = cache->_tails[_CACHE_MAIN]; \
+            _##CACHE_NAME##_unlink(cache, victim); \
+            if (cache->_slots[victim]._freq > 0) { \
+                cache->_slots[victim]._freq--; \
+                _##CACHE_NAME##_push_head(cache, victim, _CACHE_MAIN); \
+                continue; \
+            } \
+            return victim; \
+        } \
+    } \
+    \
+    \
+    /***************************************************************
+     * Do not use this function
+     *
+     * Evicts the entry chosen by the policy, passing it to the
+     * evict callback, and returns its slot. The cache must hold
+     * at least one entry
+     ***************************************************************/ \
+    static uint32_t _##CACHE_NAME##_evict_victim(CACHE_NAME* cache) \
+    { \
+        bool to_ghost; \
+        uint32_t slot = _##CACHE_NAME##_choose_victim(cache, &to_ghost); \
+        _##CACHE_NAME##Slot* victim = cache->_slots + slot; \
+        _##CACHE_NAME##_index_remove(cache, _##CACHE_NAME##_index_find(cache, &victim->key, victim->_hash)); \
+        if (to_ghost) \
+            _##CACHE_NAME##_add_ghost(cache, victim); \
+        if (cache->_on_evict) \
+            cache->_on_evict(&victim->key, &victim->value, cache->_on_evict_ctx); \
+        cache->_stats.evictions++; \
+        cache->size--; \
+        return slot; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns the value stored for key, or NULL if it is not cached.
+     * A hit counts as a use of the entry for the eviction policy
+     *
+     * The pointer is valid until the next put
+     *******************************************************************/ \
+    static CACHE_VAL_TYPE* CACHE_NAME##_get(CACHE_NAME* cache, const CACHE_KEY_TYPE* key) \
+    { \
+        assert(cache); \
+        assert(key); \
+        uint32_t hash = (uint32_t) (CACHE_HASH_FUNC(key)); \
+        uint32_t ref = cache->_index[_##CACHE_NAME##_index_find(cache, key, hash)].ref; \
+        if (ref == _CACHE_NIL || ref >= cache->capacity) { \
+            cache->_stats.misses++; \
+            return NULL; \
+        } \
+        cache->_stats.hits++; \
+        _##CACHE_NAME##_touch(cache, ref); \
+        return &cache->_slots[ref].value; \
+    } \
+    \
+    \
+    /**********************************************************************
+     * Checks if a key is cached, without counting it as a use
+     **********************************************************************/ \
+    static bool CACHE_NAME##_contains(const CACHE_NAME* cache, const CACHE_KEY_TYPE* key) \
+    { \
+        assert(cache); \
+        assert(key); \
+        uint32_t hash = (uint32_t) (CACHE_HASH_FUNC(key)); \
+        uint32_t ref = cache->_index[_##CACHE_NAME##_index_find(cache, key, hash)].ref; \
+        return ref != _CACHE_NIL && ref < cache->capacity; \
+    } \
+    \
+    \
+    /**********************************************************************************
+     * Stores a value for key, replacing the previous value if the key is cached.
+     * Otherwise, if the cache is full, an entry is evicted first, and passed
+     * to the evict callback
+     *
+     * @returns the stored value, valid until the next put
+     **********************************************************************************/ \
+    static CACHE_VAL_TYPE* CACHE_NAME##_put(CACHE_NAME* cache, CACHE_KEY_TYPE key, CACHE_VAL_TYPE value) \
+    { \
+        assert(cache); \
+        uint32_t hash = (uint32_t) (CACHE_HASH_FUNC((&key))); \
+        size_t ind = _##CACHE_NAME##_index_find(cache, &key, hash); \
+        uint32_t ref = cache->_index[ind].ref; \
+        if (ref != _CACHE_NIL && ref < cache->capacity) { \
+            cache->_slots[ref].value = value; \
+            _##CACHE_NAME##_touch(cache, ref); \
+            return &cache->_slots[ref].value; \
+        } \
+        uint8_t queue = _CACHE_SMALL; \
+        if (ref != _CACHE_NIL) { \
+            /* a ghost of S3-FIFO, the key was evicted too early and goes to the main queue */ \
+            cache->_ghosts[ref - cache->capacity]._is_valid = false; \
+            _##CACHE_NAME##_index_remove(cache, ind); \
+            cache->_stats.ghost_hits++; \
+            queue = _CACHE_MAIN; \
+        } \
+        \
+        uint32_t slot; \
+        if (cache->size == cache->capacity) { \
+            slot = _##CACHE_NAME##_evict_victim(cache); \
+        } else if (cache->_free != _CACHE_NIL) { \
+            slot = cache->_free; \
+            cache->_free = cache->_slots[slot]._next; \
+        } else { \
+            slot = cache->_n_used++; \
+        } \
+        \
+        _##CACHE_NAME##Slot* s = cache->_slots + slot; \
+        s->key = key; \
+        s->value = value; \
+        s->_hash = hash; \
+        s->_freq = 0; \
+        s->_queue = queue; \
+        if (CACHE_POLICY != CACHE_CLOCK) \
+            _##CACHE_NAME##_push_head(cache, slot, queue); \
+        /* evictions may have moved entries of the index, so the bucket is found again */ \
+        cache->_index[_##CACHE_NAME##_index_find(cache, &key, hash)] = (_CacheIndexBucket) {slot, hash}; \
+        cache->size++; \
+        cache->_stats.insertions++; \
+        return &s->value; \
+    } \
+    \
+    \
+    /**********************************************************
+     * Removes key from the cache, without calling the evict
+     * callback. Returns false if it was not cached
+     **********************************************************/ \
+    static bool CACHE_NAME##_remove(CACHE_NAME* cache, const CACHE_KEY_TYPE* key) \
+    { \
+        assert(cache); \
+        assert(key); \
+        uint32_t hash = (uint32_t) (CACHE_HASH_FUNC(key)); \
+        size_t ind = _##CACHE_NAME##_index_find(cache, key, hash); \
+        uint32_t ref = cache->_index[ind].ref; \
+        if (ref == _CACHE_NIL || ref >= cache->capacity) \
+            return false; \
+        _##CACHE_NAME##_index_remove(cache, ind); \
+        if (CACHE_POLICY != CACHE_CLOCK) \
+            _##CACHE_NAME##_unlink(cache, ref); \
+        cache->_slots[ref]._freq = 0; \
+        cache->_slots[ref]._queue = _CACHE_FREE; \
+        cache->_slots[ref]._next = cache->_free; \
+        cache->_free = ref; \
+        cache->size--; \
+        return true; \
+    } \
+    \
+    \
+    /****************************************************************
+     * Evicts the entry the policy would evict next to make room for
+     * a new one, and passes it to the evict callback, e.g. to shed
+     * entries under memory pressure. Returns false if it was empty
+     ****************************************************************/ \
+    static bool CACHE_NAME##_evict(CACHE_NAME* cache) \
+    { \
+        assert(cache); \
+        if (cache->size == 0) \
+            return false; \
+        uint32_t slot = _##CACHE_NAME##_evict_victim(cache); \
+        cache->_slots[slot]._freq = 0; \
+        cache->_slots[slot]._queue = _CACHE_FREE; \
+        cache->_slots[slot]._next = cache->_free; \
+        cache->_free = slot; \
+        return true; \
+    } \
+    \
+    \
+    /***********************************************
+     * Copies the hit, miss, insertion and
+     * eviction counters of the cache into out
+     ***********************************************/ \
+    static void CACHE_NAME##_stats(const CACHE_NAME* cache, CacheStats* out) \
+    { \
+        assert(cache); \
+        assert(out); \
+        *out = cache->_stats; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns the number of bytes used by the cache, which is fixed
+     * by its capacity: the slots, the index and the ghost queue
+     *******************************************************************/ \
+    static size_t CACHE_NAME##_memory_usage(const CACHE_NAME* cache) \
+    { \
+        assert(cache); \
+        size_t bytes = sizeof(CACHE_NAME) + cache->capacity * sizeof(_##CACHE_NAME##Slot) \
+                     + (cache->_index_mask + 1) * sizeof(_CacheIndexBucket); \
+        if (cache->_ghosts) \
+            bytes += cache->capacity * sizeof(_##CACHE_NAME##Ghost); \
+        return bytes; \
+    } \
+    \
+    \
+    /**************************************************
+     * Deallocates all resources used by this cache.
+     * The evict callback is not called.
+     * It must not be used after this point
+     **************************************************/ \
+    static void CACHE_NAME##_free(CACHE_NAME* cache) \
+    { \
+        assert(cache); \
+        free(cache->_slots); \
+        free(cache->_index); \
+        free(cache->_ghosts); \
+    }
+
+#endif
@@ -0,0 +1,361 @@
+#ifndef CUCKOOFILTER_H
+#define CUCKOOFILTER_H
+
+/***************************************************************************************
+ * Cuckoo filter, an approximate set like a Bloom filter that also supports removal
+ *
+ * Every key is stored as a 16 bit fingerprint of its hash, in one of two buckets
+ * of 4 fingerprints. The second bucket is found from the first and the fingerprint
+ * alone, so when both are full a fingerprint already stored can be moved to its
+ * other bucket to make room, without knowing its key. A bucket is one 64 bit word,
+ * and is searched for a fingerprint in a few word operations without branching.
+ * See Fan et al., "Cuckoo filter: practically better than Bloom", CoNEXT 2014.
+ *
+ * About 0.01% of absent keys are reported as possibly present. The number of buckets
+ * is a power of two, so a filter uses 17 to 34 bits per key depending on how close
+ * expected_n is to the next power of two.
+ *
+ * Only keys that were added may be removed, removing any other key can remove the
+ * fingerprint of an added key that happens to be equal. The same key can be added
+ * at most 8 times.
+ *
+ * The hash function is the one passed to HASHMAP_DEFINE, see bloomfilter.h.
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// buckets are allocated so that at most this fraction of expected_n slots are used
+#ifndef _CUCKOOFILTER_LOAD_FACTOR
+#define _CUCKOOFILTER_LOAD_FACTOR 0.95
+#endif
+
+// fingerprints moved by one add before the filter is considered full
+#ifndef _CUCKOOFILTER_MAX_KICKS
+#define _CUCKOOFILTER_MAX_KICKS 500
+#endif
+
+// keys hashed, and their buckets prefetched, before any of them is tested by the batch queries
+#ifndef _CUCKOOFILTER_BATCH
+#define _CUCKOOFILTER_BATCH 16
+#endif
+
+#define _CUCKOOFILTER_SLOTS 4
+
+#define _CUCKOOFILTER_LANES_LOW UINT64_C(0x0001000100010001)
+#define _CUCKOOFILTER_LANES_HIGH UINT64_C(0x8000800080008000)
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * 16 bit fingerprint of a hash, never 0, which marks empty slots
+ *****************************************************************/
+static inline uint16_t _cuckoofilter_fingerprint(uint64_t hash)
+{
+    uint16_t fingerprint = (uint16_t) (hash >> 48);
+    return fingerprint ? fingerprint : 1;
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * The other bucket of a fingerprint, the mapping is its own inverse
+ *****************************************************************/
+static inline size_t _cuckoofilter_alt_index(size_t index, uint16_t fingerprint, size_t mask)
+{
+    return (index ^ (size_t) (fingerprint * UINT64_C(0x5bd1e995))) & mask;
+}
+
+/*******************************************************************
+ * Do not use this function
+ *
+ * Lanes of a bucket equal to a fingerprint (0 to find empty slots),
+ * as the top bit of every 16 bit lane. Lanes above an equal lane may
+ * be set as well, but the lowest set lane is always equal
+ *******************************************************************/
+static inline uint64_t _cuckoofilter_match(uint64_t bucket, uint16_t fingerprint)
+{
+    uint64_t x = bucket ^ (fingerprint * _CUCKOOFILTER_LANES_LOW);
+    return (x - _CUCKOOFILTER_LANES_LOW) & ~x & _CUCKOOFILTER_LANES_HIGH;
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Stores a fingerprint in an empty slot of a bucket
+ *
+ * @returns false if the bucket is full
+ *****************************************************************/
+static inline bool _cuckoofilter_bucket_insert(uint64_t* bucket, uint16_t fingerprint)
+{
+    uint64_t empty = _cuckoofilter_match(*bucket, 0);
+    if (!empty)
+        return false;
+    *bucket |= (uint64_t) fingerprint << (__builtin_ctzll(empty) - 15);
+    return true;
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Clears one slot holding a fingerprint
+ *
+ * @returns false if the bucket does not hold it
+ *****************************************************************/
+static inline bool _cuckoofilter_bucket_remove(uint64_t* bucket, uint16_t fingerprint)
+{
+    uint64_t found = _cuckoofilter_match(*bucket, fingerprint);
+    if (!found)
+        return false;
+    *bucket &= ~(UINT64_C(0xffff) << (__builtin_ctzll(found) - 15));
+    return true;
+}
+
+
+/***************************************************************************************
+ * Creates a new cuckoo filter type
+ *
+ * @param CUCKOOFILTER_NAME name of the filter struct and prefix of every function
+ * @param CUCKOOFILTER_KEY_TYPE type of the keys
+ * @param CUCKOOFILTER_HASH_FUNC function or macro hashing a const CUCKOOFILTER_KEY_TYPE*,
+ *    as for HASHMAP_DEFINE
+ ***************************************************************************************/
+#define CUCKOOFILTER_DEFINE(CUCKOOFILTER_NAME, CUCKOOFILTER_KEY_TYPE, CUCKOOFILTER_HASH_FUNC) \
+    typedef struct \
+    { \
+        size_t size;                /* number of fingerprints stored */ \
+        uint64_t* _buckets;         /* _CUCKOOFILTER_SLOTS 16 bit fingerprints each, 0 if empty */ \
+        size_t _n_buckets;          /* power of two */ \
+        uint64_t _rng;              /* chooses the fingerprints to move */ \
+        /* fingerprint left without a slot by the last add, the filter is full while it is set */ \
+        bool _has_victim; \
+        uint16_t _victim; \
+        size_t _victim_index; \
+    } CUCKOOFILTER_NAME; \
+    \
+    \
+    /***********************************************************************
+     * Creates an empty filter with room for at least expected_n keys
+     ***********************************************************************/ \
+    static CUCKOOFILTER_NAME CUCKOOFILTER_NAME##_new(size_t expected_n) \
+    { \
+        CUCKOOFILTER_NAME filter; \
+        size_t min_buckets = (size_t) (expected_n / (_CUCKOOFILTER_SLOTS * _CUCKOOFILTER_LOAD_FACTOR)) + 1; \
+        filter._n_buckets = 1; \
+        while (filter._n_buckets < min_buckets) \
+            filter._n_buckets *= 2; \
+        filter._buckets = calloc(filter._n_buckets, sizeof(uint64_t)); \
+        assert(filter._buckets); \
+        filter.size = 0; \
+        filter._rng = UINT64_C(0x9e3779b97f4a7c15); \
+        filter._has_victim = false; \
+        filter._victim = 0; \
+        filter._victim_index = 0; \
+        return filter; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Do not use this function
+     *
+     * Next number of a xorshift generator
+     *******************************************************************/ \
+    static inline uint64_t _##CUCKOOFILTER_NAME##_random(CUCKOOFILTER_NAME* filter) \
+    { \
+        uint64_t x = filter->_rng; \
+        x ^= x << 13; \
+        x ^= x >> 7; \
+        x ^= x << 17; \
+        filter->_rng = x; \
+        return x; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Adds a key by its hash, as computed by CUCKOOFILTER_HASH_FUNC
+     *
+     * @returns false if the filter is full, the key is then not added
+     *******************************************************************/ \
+    static bool CUCKOOFILTER_NAME##_add_hash(CUCKOOFILTER_NAME* filter, size_t hash) \
+    { \
+        assert(filter); \
+        if (filter->_has_victim) \
+            return false; \
+        size_t mask = filter->_n_buckets - 1; \
+        uint16_t fingerprint = _cuckoofilter_fingerprint(hash); \
+        size_t index = hash & mask; \
+        size_t alt_index = _cuckoofilter_alt_index(index, fingerprint, mask); \
+        filter->size++; \
+        if (_cuckoofilter_bucket_insert(filter->_buckets + index, fingerprint) \
+         || _cuckoofilter_bucket_insert(filter->_buckets + alt_index, fingerprint)) \
+            return true; \
+        \
+        /* both buckets are full, move fingerprints to their other bucket until one finds an empty slot */ \
+        index = _##CUCKOOFILTER_NAME##_random(filter) & 1 ? alt_index : index; \
+        for (size_t kick = 0; kick < _CUCKOOFILTER_MAX_KICKS; kick++) { \
+            unsigned shift = 16 * (_##CUCKOOFILTER_NAME##_random(filter) % _CUCKOOFILTER_SLOTS); \
+            uint64_t* bucket = filter->_buckets + index; \
+            uint16_t kicked = (uint16_t) (*bucket >> shift); \
+            *bucket = (*bucket & ~(UINT64_C(0xffff) << shift)) | ((uint64_t) fingerprint << shift); \
+            fingerprint = kicked; \
+            index = _cuckoofilter_alt_index(index, fingerprint, mask); \
+            if (_cuckoofilter_bucket_insert(filter->_buckets + index, fingerprint)) \
+                return true; \
+        } \
+        /* the added key is in the filter, but the last moved fingerprint has no slot left */ \
+        filter->_has_victim = true; \
+        filter->_victim = fingerprint; \
+        filter->_victim_index = index; \
+        return true; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Adds a key, after which may_contain returns true for it
+     *
+     * @returns false if the filter is full, the key is then not added
+     *******************************************************************/ \
+    static bool CUCKOOFILTER_NAME##_add(CUCKOOFILTER_NAME* filter, const CUCKOOFILTER_KEY_TYPE* key) \
+    { \
+        assert(key); \
+        return CUCKOOFILTER_NAME##_add_hash(filter, CUCKOOFILTER_HASH_FUNC(key)); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Do not use this function
+     *
+     * Checks the victim and both buckets of a fingerprint
+     *******************************************************************/ \
+    static inline bool _##CUCKOOFILTER_NAME##_lookup(const CUCKOOFILTER_NAME* filter, uint16_t fingerprint, size_t index, size_t alt_index) \
+    { \
+        uint64_t found = _cuckoofilter_match(filter->_buckets[index], fingerprint) \
+                       | _cuckoofilter_match(filter->_buckets[alt_index], fingerprint); \
+        return found || (filter->_has_victim && filter->_victim == fingerprint \
+                         && (filter->_victim_index == index || filter->_victim_index == alt_index)); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Checks a key by its hash, as computed by CUCKOOFILTER_HASH_FUNC
+     *******************************************************************/ \
+    static bool CUCKOOFILTER_NAME##_may_contain_hash(const CUCKOOFILTER_NAME* filter, size_t hash) \
+    { \
+        assert(filter); \
+        size_t mask = filter->_n_buckets - 1; \
+        uint16_t fingerprint = _cuckoofilter_fingerprint(hash); \
+        size_t index = hash & mask; \
+        return _##CUCKOOFILTER_NAME##_lookup(filter, fingerprint, index, _cuckoofilter_alt_index(index, fingerprint, mask)); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * @returns false if the key is certainly not in the filter, true if
+     *    it is, or rarely, if it is not (a false positive)
+     *******************************************************************/ \
+    static bool CUCKOOFILTER_NAME##_may_contain(const CUCKOOFILTER_NAME* filter, const CUCKOOFILTER_KEY_TYPE* key) \
+    { \
+        assert(key); \
+        return CUCKOOFILTER_NAME##_may_contain_hash(filter, CUCKOOFILTER_HASH_FUNC(key)); \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Checks n keys, writing the result of may_contain for keys[i] to out[i].
+     * Keys are hashed and both their buckets prefetched _CUCKOOFILTER_BATCH at
+     * a time, so the cache misses of a batch overlap
+     *******************************************************************************/ \
+    static void CUCKOOFILTER_NAME##_may_contain_batch(const CUCKOOFILTER_NAME* filter, const CUCKOOFILTER_KEY_TYPE* keys, size_t n, bool out[]) \
+    { \
+        assert(filter); \
+        assert(keys || n == 0); \
+        assert(out || n == 0); \
+        size_t mask = filter->_n_buckets - 1; \
+        uint16_t fingerprints[_CUCKOOFILTER_BATCH]; \
+        size_t indices[_CUCKOOFILTER_BATCH]; \
+        size_t alt_indices[_CUCKOOFILTER_BATCH]; \
+        for (size_t start = 0; start < n; start += _CUCKOOFILTER_BATCH) { \
+            size_t batch = n - start < _CUCKOOFILTER_BATCH ? n - start : _CUCKOOFILTER_BATCH; \
+            for (size_t i = 0; i < batch; i++) { \
+                size_t hash = CUCKOOFILTER_HASH_FUNC((keys + start + i)); \
+                fingerprints[i] = _cuckoofilter_fingerprint(hash); \
+                indices[i] = hash & mask; \
+                alt_indices[i] = _cuckoofilter_alt_index(indices[i], fingerprints[i], mask); \
+                __builtin_prefetch(filter->_buckets + indices[i]); \
+                __builtin_prefetch(filter->_buckets + alt_indices[i]); \
+            } \
+            for (size_t i = 0; i < batch; i++) \
+                out[start + i] = _##CUCKOOFILTER_NAME##_lookup(filter, fingerprints[i], indices[i], alt_indices[i]); \
+        } \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Removes a key by its hash, as computed by CUCKOOFILTER_HASH_FUNC
+     *
+     * @returns false if the key was not found
+     *******************************************************************/ \
+    static bool CUCKOOFILTER_NAME##_remove_hash(CUCKOOFILTER_NAME* filter, size_t hash) \
+    { \
+        assert(filter); \
+        size_t mask = filter->_n_buckets - 1; \
+        uint16_t fingerprint = _cuckoofilter_fingerprint(hash); \
+        size_t index = hash & mask; \
+        size_t alt_index = _cuckoofilter_alt_index(index, fingerprint, mask); \
+        if (filter->_has_victim && filter->_victim == fingerprint \
+            && (filter->_victim_index == index || filter->_victim_index == alt_index)) { \
+            filter->_has_victim = false; \
+            filter->size--; \
+            return true; \
+        } \
+        if (!_cuckoofilter_bucket_remove(filter->_buckets + index, fingerprint) \
+         && !_cuckoofilter_bucket_remove(filter->_buckets + alt_index, fingerprint)) \
+            return false; \
+        filter->size--; \
+        /* a slot was freed, which may be one of the buckets of the victim */ \
+        if (filter->_has_victim) { \
+            size_t victim_alt = _cuckoofilter_alt_index(filter->_victim_index, filter->_victim, mask); \
+            if (_cuckoofilter_bucket_insert(filter->_buckets + filter->_victim_index, filter->_victim) \
+             || _cuckoofilter_bucket_insert(filter->_buckets + victim_alt, filter->_victim)) \
+                filter->_has_victim = false; \
+        } \
+        return true; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Removes a key, it must have been added before
+     *
+     * @returns false if the key was not found
+     *******************************************************************/ \
+    static bool CUCKOOFILTER_NAME##_remove(CUCKOOFILTER_NAME* filter, const CUCKOOFILTER_KEY_TYPE* key) \
+    { \
+        assert(key); \
+        return CUCKOOFILTER_NAME##_remove_hash(filter, CUCKOOFILTER_HASH_FUNC(key)); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Bytes allocated by the filter
+     *******************************************************************/ \
+    static size_t CUCKOOFILTER_NAME##_memory_usage(const CUCKOOFILTER_NAME* filter) \
+    { \
+        assert(filter); \
+        return sizeof(CUCKOOFILTER_NAME) + filter->_n_buckets * sizeof(uint64_t); \
+    } \
+    \
+    \
+    static void CUCKOOFILTER_NAME##_free(CUCKOOFILTER_NAME* filter) \
+    { \
+        assert(filter); \
+        free(filter->_buckets); \
+        filter->_buckets = NULL; \
+        filter->_n_buckets = 0; \
+        filter->size = 0; \
+    }
+
+#endif
@@ -0,0 +1,526 @@
+#ifndef FLATMAP_H
+#define FLATMAP_H
+
+/***************************************************************************************
+ * Sorted map stored in one flat array, for maps that are built once and mostly queried
+ *
+ * The entries are kept in a Vec, without any node pointers, and searched with a
+ * binary search without branches. The layout of the array is chosen at compile time:
+ * - FLATMAP_SORTED, entries in ascending order. Searches prefetch both entries
+ *   they may compare with next
+ * - FLATMAP_EYTZINGER, entries in the order of a breadth first walk of a complete
+ *   binary search tree, the children of position k (counting from 1) are at 2k
+ *   and 2k+1. The first levels of the tree share a few cache lines, and the 16
+ *   descendants of an entry 4 levels down are adjacent, so their cache lines are
+ *   prefetched while the 4 levels above them are searched. See Khuong and Morin, "Array
+ *   layouts for comparison-based searching", 2017
+ *
+ * Iterators are a position in the array, they walk the implicit tree for the
+ * Eytzinger layout. Entries can be inserted or removed one at a time, but this
+ * moves up to all entries, in batches they are merged in with insert_sorted.
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "vec.h"
+
+#define FLATMAP_SORTED 0
+#define FLATMAP_EYTZINGER 1
+
+// levels above the descendants prefetched by searches of the Eytzinger layout,
+// all 2^_FLATMAP_PREFETCH_DEPTH of them are fetched, lower it for large entries
+#ifndef _FLATMAP_PREFETCH_DEPTH
+#define _FLATMAP_PREFETCH_DEPTH 4
+#endif
+
+
+/***************************************************************************************
+ * Creates a new FlatMap type
+ *
+ * @param FLATMAP_NAME name of the map struct and prefix of every function
+ * @param FLATMAP_KEY_TYPE type of keys, stored in place
+ * @param FLATMAP_VAL_TYPE type of values, stored in place, pass TREEMAP_NO_VALUE
+ *    or HASHMAP_NO_VALUE for a set
+ * @param FLATMAP_KEY_CMP function or macro comparing two const FLATMAP_KEY_TYPE*,
+ *    as for TREEMAP_DEFINE
+ * @param FLATMAP_LAYOUT FLATMAP_SORTED or FLATMAP_EYTZINGER
+ ***************************************************************************************/
+#define FLATMAP_DEFINE(FLATMAP_NAME, FLATMAP_KEY_TYPE, FLATMAP_VAL_TYPE, FLATMAP_KEY_CMP, FLATMAP_LAYOUT) \
+    typedef struct \
+    { \
+        FLATMAP_KEY_TYPE key; \
+        FLATMAP_VAL_TYPE value; \
+    } FLATMAP_NAME##Entry; \
+    \
+    VEC_DEFINE(FLATMAP_NAME##Entries, FLATMAP_NAME##Entry) \
+    \
+    typedef struct \
+    { \
+        size_t size; \
+        FLATMAP_NAME##Entries entries;     /* in the order of FLATMAP_LAYOUT */ \
+    } FLATMAP_NAME; \
+    \
+    typedef struct \
+    { \
+        FLATMAP_NAME##Entry* current; \
+        FLATMAP_NAME##Entry* _arr; \
+        size_t _n; \
+        size_t _pos;                /* of current, counting from 1, 0 if there is none */ \
+    } FLATMAP_NAME##Iter; \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Position of the smallest entry among n, counting from 1,
+     * or 0 if there are no entries
+     *****************************************************************/ \
+    static inline size_t _##FLATMAP_NAME##_first(size_t n) \
+    { \
+        if (n == 0 || FLATMAP_LAYOUT == FLATMAP_SORTED) \
+            return n ? 1 : 0; \
+        size_t pos = 1; \
+        while (2 * pos <= n) \
+            pos = 2 * pos; \
+        return pos; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Position of the largest entry among n, or 0 if there are none
+     *****************************************************************/ \
+    static inline size_t _##FLATMAP_NAME##_last(size_t n) \
+    { \
+        if (n == 0 || FLATMAP_LAYOUT == FLATMAP_SORTED) \
+            return n; \
+        size_t pos = 1; \
+        while (2 * pos + 1 <= n) \
+            pos = 2 * pos + 1; \
+        return pos; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Position of the entry following pos, or 0 if it is the last.
+     * In the tree, this is the leftmost entry of the right subtree,
+     * or else the first ancestor pos is in the left subtree of
+     *****************************************************************/ \
+    static inline size_t _##FLATMAP_NAME##_next(size_t n, size_t pos) \
+    { \
+        if (FLATMAP_LAYOUT == FLATMAP_SORTED) \
+            return pos < n ? pos + 1 : 0; \
+        if (2 * pos + 1 <= n) { \
+            pos = 2 * pos + 1; \
+            while (2 * pos <= n) \
+                pos = 2 * pos; \
+            return pos; \
+        } \
+        while (pos & 1) \
+            pos >>= 1; \
+        return pos >> 1; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Position of the entry preceding pos, or 0 if it is the first
+     *****************************************************************/ \
+    static inline size_t _##FLATMAP_NAME##_prev(size_t n, size_t pos) \
+    { \
+        if (FLATMAP_LAYOUT == FLATMAP_SORTED) \
+            return pos - 1; \
+        if (2 * pos <= n) { \
+            pos = 2 * pos; \
+            while (2 * pos + 1 <= n) \
+                pos = 2 * pos + 1; \
+            return pos; \
+        } \
+        while (pos && !(pos & 1)) \
+            pos >>= 1; \
+        return pos >> 1; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Do not use this function
+     *
+     * Position of the smallest entry with a key greater than or equal
+     * to key, or 0 if every key is smaller
+     *******************************************************************/ \
+    static size_t _##FLATMAP_NAME##_lower_bound(const FLATMAP_NAME* map, const FLATMAP_KEY_TYPE* key) \
+    { \
+        const FLATMAP_NAME##Entry* arr = map->entries.arr; \
+        size_t n = map->size; \
+        if (FLATMAP_LAYOUT == FLATMAP_SORTED) { \
+            if (n == 0) \
+                return 0; \
+            const FLATMAP_NAME##Entry* base = arr; \
+            while (n > 1) { \
+                size_t half = n / 2; \
+                /* the next comparison is in the middle of either half */ \
+                __builtin_prefetch(base + (n - half) / 2); \
+                __builtin_prefetch(base + half + (n - half) / 2); \
+                base = FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &base[half].key, key) < 0 ? base + half : base; \
+                n -= half; \
+            } \
+            size_t pos = base - arr + (FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &base->key, key) < 0) + 1; \
+            return pos <= map->size ? pos : 0; \
+        } \
+        /* descend to a leaf, going right past smaller keys, then undo the right turns after the last left turn */ \
+        size_t pos = 1; \
+        while (pos <= n) { \
+            /* the descendants near the leaves lie partly or wholly past the end, only those in the array are fetched */ \
+            size_t first = (pos << _FLATMAP_PREFETCH_DEPTH) - 1; \
+            if (first < n) { \
+                size_t n_fetched = n - first < ((size_t) 1 << _FLATMAP_PREFETCH_DEPTH) ? n - first : (size_t) 1 << _FLATMAP_PREFETCH_DEPTH; \
+                const char* descendants = (const char*) (arr + first); \
+                for (size_t offset = 0; offset < n_fetched * sizeof(FLATMAP_NAME##Entry); offset += 64) \
+                    __builtin_prefetch(descendants + offset); \
+            } \
+            pos = 2 * pos + (FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &arr[pos - 1].key, key) < 0); \
+        } \
+        return pos >> __builtin_ffsll(~pos); \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Writes n entries in ascending order to the array of the map,
+     * in the order of FLATMAP_LAYOUT
+     *****************************************************************/ \
+    static void _##FLATMAP_NAME##_layout(FLATMAP_NAME* map, const FLATMAP_NAME##Entry* sorted, size_t n) \
+    { \
+        FLATMAP_NAME##Entries_resize_uninit(&map->entries, n); \
+        map->size = n; \
+        if (FLATMAP_LAYOUT == FLATMAP_SORTED) { \
+            memmove(map->entries.arr, sorted, n * sizeof(FLATMAP_NAME##Entry)); \
+            return; \
+        } \
+        size_t pos = _##FLATMAP_NAME##_first(n); \
+        for (size_t i = 0; i < n; i++, pos = _##FLATMAP_NAME##_next(n, pos)) \
+            map->entries.arr[pos - 1] = sorted[i]; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Copies the entries of the map to out in ascending order
+     *****************************************************************/ \
+    static void _##FLATMAP_NAME##_to_sorted(const FLATMAP_NAME* map, FLATMAP_NAME##Entry* out) \
+    { \
+        size_t i = 0; \
+        for (size_t pos = _##FLATMAP_NAME##_first(map->size); pos; pos = _##FLATMAP_NAME##_next(map->size, pos)) \
+            out[i++] = map->entries.arr[pos - 1]; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Initializes a new empty FlatMap
+     *****************************************************************/ \
+    static FLATMAP_NAME FLATMAP_NAME##_new() \
+    { \
+        FLATMAP_NAME ret; \
+        ret.size = 0; \
+        ret.entries = FLATMAP_NAME##Entries_with_capacity(1); \
+        return ret; \
+    } \
+    \
+    \
+    /*************************************************************************
+     * Creates a map holding n entries, which must be sorted by key without
+     * duplicates. Takes linear time
+     *************************************************************************/ \
+    static FLATMAP_NAME FLATMAP_NAME##_from_sorted(const FLATMAP_NAME##Entry* entries, size_t n) \
+    { \
+        assert(entries || n == 0); \
+        for (size_t i = 1; i < n; i++) \
+            assert(FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &entries[i-1].key, (const FLATMAP_KEY_TYPE*) &entries[i].key) < 0); \
+        FLATMAP_NAME ret; \
+        ret.entries = FLATMAP_NAME##Entries_with_capacity(n); \
+        _##FLATMAP_NAME##_layout(&ret, entries, n); \
+        return ret; \
+    } \
+    \
+    \
+    /*************************************************************************
+     * Creates a map holding n keys, which must be sorted without duplicates,
+     * with zeroed values. Takes linear time
+     *************************************************************************/ \
+    static FLATMAP_NAME FLATMAP_NAME##_from_sorted_keys(const FLATMAP_KEY_TYPE* keys, size_t n) \
+    { \
+        assert(keys || n == 0); \
+        FLATMAP_NAME##Entry* sorted = calloc(n ? n : 1, sizeof(FLATMAP_NAME##Entry)); \
+        assert(sorted); \
+        for (size_t i = 0; i < n; i++) \
+            sorted[i].key = keys[i]; \
+        FLATMAP_NAME ret = FLATMAP_NAME##_from_sorted(sorted, n); \
+        free(sorted); \
+        return ret; \
+    } \
+    \
+    \
+    /**************************************************************************************
+     * Merges n entries, sorted by key without duplicates, into the map. Values of keys
+     * already in the map are replaced. Takes time linear in the size of both.
+     *
+     * With the sorted layout, entries are merged in place from the back, otherwise
+     * the map is first copied out in ascending order and laid out again afterwards
+     *
+     * @returns the number of keys that were not already in the map
+     **************************************************************************************/ \
+    static size_t FLATMAP_NAME##_insert_sorted(FLATMAP_NAME* map, const FLATMAP_NAME##Entry* entries, size_t n) \
+    { \
+        assert(map); \
+        assert(entries || n == 0); \
+        for (size_t i = 1; i < n; i++) \
+            assert(FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &entries[i-1].key, (const FLATMAP_KEY_TYPE*) &entries[i].key) < 0); \
+        size_t old_n = map->size; \
+        FLATMAP_NAME##Entry* buf = map->entries.arr; \
+        if (FLATMAP_LAYOUT != FLATMAP_SORTED) { \
+            buf = malloc((old_n + n ? old_n + n : 1) * sizeof(FLATMAP_NAME##Entry)); \
+            assert(buf); \
+            _##FLATMAP_NAME##_to_sorted(map, buf); \
+        } \
+        size_t n_new = 0; \
+        for (size_t i = 0, j = 0; j < n;) { \
+            int cmp_res = i < old_n ? FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &buf[i].key, (const FLATMAP_KEY_TYPE*) &entries[j].key) : 1; \
+            i += cmp_res <= 0; \
+            j += cmp_res >= 0; \
+            n_new += cmp_res > 0; \
+        } \
+        if (FLATMAP_LAYOUT == FLATMAP_SORTED) { \
+            FLATMAP_NAME##Entries_reserve(&map->entries, old_n + n_new); \
+            buf = map->entries.arr; \
+        } \
+        /* from the back, so no entry is overwritten before it is moved */ \
+        size_t i = old_n, j = n, out = old_n + n_new; \
+        while (j > 0) { \
+            int cmp_res = i > 0 ? FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &buf[i-1].key, (const FLATMAP_KEY_TYPE*) &entries[j-1].key) : -1; \
+            if (cmp_res > 0) { \
+                buf[--out] = buf[--i]; \
+            } else { \
+                buf[--out] = entries[--j]; \
+                i -= cmp_res == 0; \
+            } \
+        } \
+        if (FLATMAP_LAYOUT == FLATMAP_SORTED) { \
+            map->entries.size = old_n + n_new; \
+            map->size = old_n + n_new; \
+        } else { \
+            _##FLATMAP_NAME##_layout(map, buf, old_n + n_new); \
+            free(buf); \
+        } \
+        return n_new; \
+    } \
+    \
+    \
+    /**************************************************************************
+     * Finds the entry of a key
+     *
+     * @param insert whether to insert the key if it is not found, its value
+     *    is then zeroed. This moves up to all entries, see insert_sorted
+     * @returns the entry, or NULL if it was not found and insert is false.
+     *    Pointers to entries are valid until the map is modified
+     **************************************************************************/ \
+    static FLATMAP_NAME##Entry* FLATMAP_NAME##_search(FLATMAP_NAME* map, const FLATMAP_KEY_TYPE* key, bool insert) \
+    { \
+        assert(map); \
+        assert(key); \
+        size_t pos = _##FLATMAP_NAME##_lower_bound(map, key); \
+        if (pos && FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &map->entries.arr[pos - 1].key, key) == 0) \
+            return map->entries.arr + pos - 1; \
+        if (!insert) \
+            return NULL; \
+        FLATMAP_NAME##Entry entry; \
+        memset(&entry, 0, sizeof(entry)); \
+        entry.key = *key; \
+        FLATMAP_NAME##_insert_sorted(map, &entry, 1); \
+        return FLATMAP_NAME##_search(map, key, false); \
+    } \
+    \
+    \
+    static bool FLATMAP_NAME##_contains(const FLATMAP_NAME* map, const FLATMAP_KEY_TYPE* key) \
+    { \
+        return FLATMAP_NAME##_search((FLATMAP_NAME*) map, key, false) != NULL; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Assigns a value to a key, moving up to all entries
+     *****************************************************************/ \
+    static void FLATMAP_NAME##_insert(FLATMAP_NAME* map, FLATMAP_KEY_TYPE key, FLATMAP_VAL_TYPE value) \
+    { \
+        FLATMAP_NAME##_search(map, (const FLATMAP_KEY_TYPE*) &key, true)->value = value; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Removes the entry of a key, if there is one.
+     * This moves up to all entries
+     *****************************************************************/ \
+    static void FLATMAP_NAME##_remove(FLATMAP_NAME* map, const FLATMAP_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        FLATMAP_NAME##Entry* entry = FLATMAP_NAME##_search(map, key, false); \
+        if (!entry) \
+            return; \
+        if (FLATMAP_LAYOUT == FLATMAP_SORTED) { \
+            memmove(entry, entry + 1, (map->entries.arr + map->size - entry - 1) * sizeof(FLATMAP_NAME##Entry)); \
+            map->entries.size--; \
+            map->size--; \
+            return; \
+        } \
+        FLATMAP_NAME##Entry* sorted = malloc(map->size * sizeof(FLATMAP_NAME##Entry)); \
+        assert(sorted); \
+        _##FLATMAP_NAME##_to_sorted(map, sorted); \
+        size_t n = 0; \
+        for (size_t i = 0; i < map->size; i++) \
+            if (FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &sorted[i].key, key) != 0) \
+                sorted[n++] = sorted[i]; \
+        _##FLATMAP_NAME##_layout(map, sorted, n); \
+        free(sorted); \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Bytes used by the map, including unused capacity of its array
+     *****************************************************************/ \
+    static size_t FLATMAP_NAME##_memory_usage(const FLATMAP_NAME* map) \
+    { \
+        assert(map); \
+        return sizeof(FLATMAP_NAME) + map->entries._arr_cap * sizeof(FLATMAP_NAME##Entry); \
+    } \
+    \
+    \
+    /**************************************************
+    * Deallocates all resources used by this FlatMap.
+    * It must not be used after this point
+    ***************************************************/ \
+    static void FLATMAP_NAME##_free(FLATMAP_NAME* map) \
+    { \
+        assert(map); \
+        FLATMAP_NAME##Entries_free(&map->entries); \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Iterator at a position, or an ended iterator if pos is 0
+     *****************************************************************/ \
+    static FLATMAP_NAME##Iter _##FLATMAP_NAME##_iter_at(const FLATMAP_NAME* map, size_t pos) \
+    { \
+        FLATMAP_NAME##Iter ret; \
+        ret._arr = map->entries.arr; \
+        ret._n = map->size; \
+        ret._pos = pos; \
+        ret.current = pos ? ret._arr + pos - 1 : NULL; \
+        return ret; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Returns an iterator starting at key, current is NULL if the
+     * key is not found
+     *****************************************************************/ \
+    static FLATMAP_NAME##Iter FLATMAP_NAME##_iter(const FLATMAP_NAME* map, const FLATMAP_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        size_t pos = _##FLATMAP_NAME##_lower_bound(map, key); \
+        if (pos && FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &map->entries.arr[pos - 1].key, key) != 0) \
+            pos = 0; \
+        return _##FLATMAP_NAME##_iter_at(map, pos); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns an iterator starting at the minimum element in the map
+     *******************************************************************/ \
+    static FLATMAP_NAME##Iter FLATMAP_NAME##_min_iter(const FLATMAP_NAME* map) \
+    { \
+        assert(map); \
+        return _##FLATMAP_NAME##_iter_at(map, _##FLATMAP_NAME##_first(map->size)); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns an iterator starting at the maximum element in the map
+     *******************************************************************/ \
+    static FLATMAP_NAME##Iter FLATMAP_NAME##_max_iter(const FLATMAP_NAME* map) \
+    { \
+        assert(map); \
+        return _##FLATMAP_NAME##_iter_at(map, _##FLATMAP_NAME##_last(map->size)); \
+    } \
+    \
+    \
+    /*********************************************
+     * Returns an iterator starting at the
+     * maximum element less than or equal to key
+     *********************************************/ \
+    static FLATMAP_NAME##Iter FLATMAP_NAME##_floor_iter(const FLATMAP_NAME* map, const FLATMAP_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        size_t pos = _##FLATMAP_NAME##_lower_bound(map, key); \
+        if (!pos) \
+            pos = _##FLATMAP_NAME##_last(map->size); \
+        else if (FLATMAP_KEY_CMP((const FLATMAP_KEY_TYPE*) &map->entries.arr[pos - 1].key, key) != 0) \
+            pos = _##FLATMAP_NAME##_prev(map->size, pos); \
+        return _##FLATMAP_NAME##_iter_at(map, pos); \
+    } \
+    \
+    \
+    /************************************************
+     * Returns an iterator starting at the
+     * minimum element greater than or equal to key
+     ************************************************/ \
+    static FLATMAP_NAME##Iter FLATMAP_NAME##_ceil_iter(const FLATMAP_NAME* map, const FLATMAP_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        return _##FLATMAP_NAME##_iter_at(map, _##FLATMAP_NAME##_lower_bound(map, key)); \
+    } \
+    \
+    \
+    /**************************************************************
+     * sets the field current to be the next element in the map,
+     * if there are no more elements, current is set to NULL
+     **************************************************************/ \
+    static void FLATMAP_NAME##Iter_inc(FLATMAP_NAME##Iter* iter) \
+    { \
+        assert(iter); \
+        if (!iter->current) \
+            return; \
+        iter->_pos = _##FLATMAP_NAME##_next(iter->_n, iter->_pos); \
+        iter->current = iter->_pos ? iter->_arr + iter->_pos - 1 : NULL; \
+    } \
+    \
+    \
+    /**************************************************************
+     * sets the field current to be the previous element in the map,
+     * if there are no more elements, current is set to NULL
+     **************************************************************/ \
+    static void FLATMAP_NAME##Iter_dec(FLATMAP_NAME##Iter* iter) \
+    { \
+        assert(iter); \
+        if (!iter->current) \
+            return; \
+        iter->_pos = _##FLATMAP_NAME##_prev(iter->_n, iter->_pos); \
+        iter->current = iter->_pos ? iter->_arr + iter->_pos - 1 : NULL; \
+    }
+
+#endif
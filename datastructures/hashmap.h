@@ -9,6 +9,21 @@
 #include <string.h>
 
 #include "siphash.h"
+#include "trace.h"
+
+/* 
+ * Allocation functions used by HashMap
+ * Define HASHMAP_USE_HUGEALLOC before including this header to back
+ * the bucket arrays with mmap and huge pages, see hugealloc.h
+ */
+#ifdef HASHMAP_USE_HUGEALLOC
+#include "hugealloc.h"
+#define _HASHMAP_CALLOC hugealloc_calloc
+#define _HASHMAP_FREE hugealloc_free
+#else
+#define _HASHMAP_CALLOC calloc
+#define _HASHMAP_FREE free
+#endif
 
 /**********************************************************************************
  * Utility function to hash byte arrays
@@ -22,6 +37,31 @@ static size_t byte_hasher(const char* byte_array, size_t n_bytes)
     return output;
 }
 
+/*************************************************************************************
+ * Hashes n byte arrays at once, giving the same hashes as calling byte_hasher on each
+ *
+ * The SipHash states of several keys are computed side by side in SIMD lanes
+ * (AVX2 when compiled with -mavx2), which is much faster than a loop over
+ * byte_hasher when hashing many short keys, for instance before bulk insertion
+ *************************************************************************************/
+static void siphash_batch(const char* const keys[], const size_t lens[], size_t n, size_t out[])
+{
+    uint64_t key[] = {0, 0};  // no key is used, same as byte_hasher
+    const void* lane_keys[_SIPHASH_BATCH_LANES];
+    size_t lane_lens[_SIPHASH_BATCH_LANES];
+    uint64_t lane_out[_SIPHASH_BATCH_LANES];
+    for (size_t i = 0; i < n; i += _SIPHASH_BATCH_LANES) {
+        for (size_t l = 0; l < _SIPHASH_BATCH_LANES; l++) {
+            /* unused lanes of the last batch hash an empty message */
+            lane_keys[l] = i + l < n ? keys[i+l] : "";
+            lane_lens[l] = i + l < n ? lens[i+l] : 0;
+        }
+        _siphash_batch_source_code(lane_keys, lane_lens, key, lane_out);
+        for (size_t l = 0; l < _SIPHASH_BATCH_LANES && i + l < n; l++)
+            out[i+l] = lane_out[l];
+    }
+}
+
 /*******************************
  * Empty value to use for sets
  *******************************/
@@ -39,6 +79,118 @@ typedef struct
 #define _HASHMAP_LOAD_FACTOR 0.6
 #endif
 
+// number of entries in the probe length histograms, the last one also counts all longer probes
+#ifndef _HASHMAP_STATS_HISTOGRAM_SIZE
+#define _HASHMAP_STATS_HISTOGRAM_SIZE 16
+#endif
+
+/*
+ * Define HASHMAP_INCREMENTAL_RESIZE before including this header to spread resizes
+ * over the following operations, instead of rehashing every entry at once.
+ * The old bucket array is kept alongside the new one, and every insert, search
+ * with insert set and remove moves at least _HASHMAP_REHASH_STEP old buckets over,
+ * so that no single operation has to wait for the whole map to be rehashed.
+ * Lookups only read both arrays, so they are safe while iterating.
+ * As lookups never move entries, a map that is mostly read after growing keeps
+ * both arrays alive, and every miss probes both. Call HASHMAP_NAME##_migrate
+ * when idle, or between batches of lookups, to finish the resize
+ */
+#ifdef HASHMAP_INCREMENTAL_RESIZE
+#define _HASHMAP_INCREMENTAL(...) __VA_ARGS__
+#else
+#define _HASHMAP_INCREMENTAL(...)
+#endif
+
+// number of old buckets moved over by each insert or remove during an incremental resize
+#ifndef _HASHMAP_REHASH_STEP
+#define _HASHMAP_REHASH_STEP 64
+#endif
+
+// number of keys hashed and prefetched ahead of probing by HASHMAP_NAME##_insert_keys
+#ifndef _HASHMAP_BULK_BATCH
+#define _HASHMAP_BULK_BATCH 16
+#endif
+
+// number of buckets walked by each task of HASHMAP_NAME##_parallel_for_each and _parallel_reduce
+#ifndef _HASHMAP_PARALLEL_CHUNK
+#define _HASHMAP_PARALLEL_CHUNK (1 << 16)
+#endif
+
+/*
+ * Define HASHMAP_INSTRUMENT before including this header to count every lookup,
+ * resize and rehash as it happens, see HashMapCounters.
+ * When it is not defined, the counters are not stored and nothing is counted
+ */
+#ifdef HASHMAP_INSTRUMENT
+#define _HASHMAP_INSTRUMENT(...) __VA_ARGS__
+#else
+#define _HASHMAP_INSTRUMENT(...)
+#endif
+
+/*********************************************************************************
+ * Live counters of a HashMap, only gathered when HASHMAP_INSTRUMENT is defined
+ *
+ * Lookups are counted for search, insert, contains and remove.
+ * Index i of a histogram counts lookups that inspected i+1 buckets
+ *********************************************************************************/
+typedef struct
+{
+    size_t n_hits;
+    size_t n_misses;
+    size_t hit_probes;          // total number of buckets inspected by hits
+    size_t miss_probes;         // total number of buckets inspected by misses
+    size_t hit_histogram[_HASHMAP_STATS_HISTOGRAM_SIZE];
+    size_t miss_histogram[_HASHMAP_STATS_HISTOGRAM_SIZE];
+    size_t n_resizes;
+    size_t n_rehashes;          // entries moved by resizes and by the cleanup after removals
+    size_t bytes_allocated;     // total bytes allocated for bucket arrays since the map was created
+    size_t _last_probes;
+} HashMapCounters;
+
+/************************************************************************************
+ * Statistics returned by HASHMAP_NAME##_stats
+ *
+ * The histograms are computed from the current contents of the bucket array:
+ * index i of hit_histogram counts the entries found after inspecting i+1 buckets,
+ * and index i of miss_histogram counts the buckets where a missing key hashing
+ * there would be rejected after inspecting i+1 buckets.
+ * An even spread of hashes gives short clusters and histograms falling off quickly,
+ * long tails point to a bad hash function or a too high load factor
+ ************************************************************************************/
+typedef struct
+{
+    size_t size;
+    size_t n_buckets;
+    double load_factor;
+    size_t bytes_allocated;     // bytes currently used by the bucket array
+    size_t n_clusters;          // runs of consecutive occupied buckets
+    size_t longest_cluster;
+    double mean_hit_probes;
+    double mean_miss_probes;
+    size_t hit_histogram[_HASHMAP_STATS_HISTOGRAM_SIZE];
+    size_t miss_histogram[_HASHMAP_STATS_HISTOGRAM_SIZE];
+    HashMapCounters counters;   // all zero unless HASHMAP_INSTRUMENT is defined
+} HashMapStats;
+
+static void _hashmap_histogram_add(size_t histogram[], size_t probes)
+{
+    histogram[probes <= _HASHMAP_STATS_HISTOGRAM_SIZE ? probes - 1 : _HASHMAP_STATS_HISTOGRAM_SIZE - 1]++;
+}
+
+/* counts the lookup that last called _locate_entry_holder */
+static void _hashmap_count_lookup(HashMapCounters* counters, bool hit)
+{
+    if (hit) {
+        counters->n_hits++;
+        counters->hit_probes += counters->_last_probes;
+        _hashmap_histogram_add(counters->hit_histogram, counters->_last_probes);
+    } else {
+        counters->n_misses++;
+        counters->miss_probes += counters->_last_probes;
+        _hashmap_histogram_add(counters->miss_histogram, counters->_last_probes);
+    }
+}
+
 /*******************************************************************************************************************
  * Generates functions for a HashMap                                                                               *
  *                                                                                                                 *
@@ -89,6 +241,12 @@ typedef struct
         size_t size; \
         _##HASHMAP_NAME##BucketEntry* _buckets; \
         size_t _n_buckets; \
+        _HASHMAP_INCREMENTAL( \
+            _##HASHMAP_NAME##BucketEntry* _old_buckets; /* NULL unless a resize is ongoing */ \
+            size_t _n_old_buckets; \
+            size_t _migrate_ind; /* old buckets before this index are empty */ \
+        ) \
+        _HASHMAP_INSTRUMENT(HashMapCounters _counters;) \
     } HASHMAP_NAME; \
     \
     \
@@ -103,52 +261,153 @@ typedef struct
         initial_capacity /= _HASHMAP_LOAD_FACTOR; \
         size_t capacity = _HASHMAP_MIN_BUCKET_ARRAY_SIZE; \
         for (; capacity < initial_capacity && capacity < _HASHMAP_MAX_BUCKET_ARRAY_SIZE; capacity <<= 1); \
-        HASHMAP_NAME ret = {0, NULL, capacity}; \
-        ret._buckets = calloc(capacity, sizeof(_##HASHMAP_NAME##BucketEntry)); \
+        HASHMAP_NAME ret = {.size = 0, ._buckets = NULL, ._n_buckets = capacity}; \
+        ret._buckets = _HASHMAP_CALLOC(capacity, sizeof(_##HASHMAP_NAME##BucketEntry)); \
         assert(ret._buckets); \
+        _HASHMAP_INSTRUMENT(ret._counters.bytes_allocated = capacity * sizeof(_##HASHMAP_NAME##BucketEntry);) \
         return ret; \
     } \
     \
     \
-    /****************************************************
+    /******************************************************
      * Do not use this function
      *
-     * Finds the place where an entry is/can be stored.
-     ****************************************************/ \
-    static _##HASHMAP_NAME##BucketEntry* _##HASHMAP_NAME##_locate_entry_holder(HASHMAP_NAME* map, const HASHMAP_KEY_TYPE* key) \
+     * Finds the place where an entry is/can be stored,
+     * given the hash of its key
+     ******************************************************/ \
+    static _##HASHMAP_NAME##BucketEntry* _##HASHMAP_NAME##_locate_hashed_entry_holder(HASHMAP_NAME* map, const HASHMAP_KEY_TYPE* key, size_t hash) \
     { \
         assert(map); \
         assert(key); \
-        size_t hash = (HASHMAP_HASH_FUNC(key)) % map->_n_buckets; \
-        size_t ind = hash; \
+        size_t ind = hash % map->_n_buckets; \
+        _HASHMAP_INSTRUMENT(map->_counters._last_probes = 1;) \
         for (int i = 0;;i++) { \
             if (!((map->_buckets+ind)->_is_valid) || (HASHMAP_KEY_EQ_FUNC((key), ((const HASHMAP_KEY_TYPE*) &((map->_buckets+ind)->entry.key))))) \
                 break; \
             ind = (ind + 1) % map->_n_buckets; \
+            _HASHMAP_INSTRUMENT(map->_counters._last_probes = i + 2;) \
         } \
         return map->_buckets + ind; \
     } \
     \
     \
+    /****************************************************
+     * Do not use this function
+     *
+     * Finds the place where an entry is/can be stored.
+     ****************************************************/ \
+    static _##HASHMAP_NAME##BucketEntry* _##HASHMAP_NAME##_locate_entry_holder(HASHMAP_NAME* map, const HASHMAP_KEY_TYPE* key) \
+    { \
+        return _##HASHMAP_NAME##_locate_hashed_entry_holder(map, key, HASHMAP_HASH_FUNC(key)); \
+    } \
+    \
+    \
+    _HASHMAP_INCREMENTAL( \
+    /**********************************************************
+     * Do not use this function
+     *
+     * Finds the place where an entry is stored in the old
+     * bucket array, while an incremental resize is ongoing
+     **********************************************************/ \
+    static _##HASHMAP_NAME##BucketEntry* _##HASHMAP_NAME##_locate_old_entry_holder(const HASHMAP_NAME* map, const HASHMAP_KEY_TYPE* key) \
+    { \
+        size_t ind = (HASHMAP_HASH_FUNC(key)) % map->_n_old_buckets; \
+        while ((map->_old_buckets+ind)->_is_valid && !(HASHMAP_KEY_EQ_FUNC((key), ((const HASHMAP_KEY_TYPE*) &((map->_old_buckets+ind)->entry.key))))) \
+            ind = (ind + 1) % map->_n_old_buckets; \
+        return map->_old_buckets + ind; \
+    } \
+    \
+    \
+    /***************************************************************************
+     * Do not use this function
+     *
+     * Moves the cluster of the old bucket array containing index ind into the
+     * new bucket array. Lookups never probe past an empty bucket, so removing
+     * a whole cluster keeps every other entry of the old array reachable.
+     * Returns the number of entries moved
+     ***************************************************************************/ \
+    static size_t _##HASHMAP_NAME##_migrate_cluster(HASHMAP_NAME* map, size_t ind) \
+    { \
+        size_t n = map->_n_old_buckets; \
+        /* the old array always has an empty bucket, as its load factor is below 1 */ \
+        while (map->_old_buckets[(ind + n - 1) % n]._is_valid) \
+            ind = (ind + n - 1) % n; \
+        size_t n_moved = 0; \
+        for (; map->_old_buckets[ind]._is_valid; ind = (ind + 1) % n) { \
+            _##HASHMAP_NAME##BucketEntry* entry = map->_old_buckets+ind; \
+            *(_##HASHMAP_NAME##_locate_entry_holder(map, (const HASHMAP_KEY_TYPE*) &(entry->entry.key))) = *entry; \
+            entry->_is_valid = 0; \
+            n_moved++; \
+        } \
+        _HASHMAP_INSTRUMENT(map->_counters.n_rehashes += n_moved;) \
+        return n_moved; \
+    } \
+    \
+    \
+    /*************************************************************************
+     * Do not use this function
+     *
+     * Moves the entries of at least n_buckets old buckets into the new
+     * bucket array, and frees the old array once it is empty.
+     * Clusters are always moved as a whole, so a step may go beyond n_buckets
+     *************************************************************************/ \
+    static void _##HASHMAP_NAME##_rehash_step(HASHMAP_NAME* map, size_t n_buckets) \
+    { \
+        if (!map->_old_buckets) \
+            return; \
+        for (size_t visited = 0; visited < n_buckets && map->_migrate_ind < map->_n_old_buckets; visited++) { \
+            if (map->_old_buckets[map->_migrate_ind]._is_valid) \
+                visited += _##HASHMAP_NAME##_migrate_cluster(map, map->_migrate_ind); \
+            map->_migrate_ind++; \
+        } \
+        if (map->_migrate_ind == map->_n_old_buckets) { \
+            _HASHMAP_FREE(map->_old_buckets); \
+            map->_old_buckets = NULL; \
+            map->_n_old_buckets = 0; \
+        } \
+    } \
+    ) \
+    \
+    \
     /*************************************************
      * Do not use this function
      *
      * resizes bucket array and rehashes all entries
+     *
+     * With HASHMAP_INCREMENTAL_RESIZE only the new
+     * array is allocated, the entries are moved over
+     * by later operations, see _rehash_step
      *************************************************/ \
     static void _##HASHMAP_NAME##_resize(HASHMAP_NAME* map, size_t new_size) \
     { \
+        _TRACE(uint64_t _trace_start = _trace_now_ns();) \
+        /* the previous resize must be finished, before the bucket arrays are swapped out again */ \
+        _HASHMAP_INCREMENTAL(_##HASHMAP_NAME##_rehash_step(map, SIZE_MAX);) \
         size_t old_n_buckets = map->_n_buckets; \
         _##HASHMAP_NAME##BucketEntry* old_buckets = map->_buckets; \
         map->_n_buckets = new_size; \
-        map->_buckets = calloc(map->_n_buckets, sizeof(_##HASHMAP_NAME##BucketEntry)); \
+        map->_buckets = _HASHMAP_CALLOC(map->_n_buckets, sizeof(_##HASHMAP_NAME##BucketEntry)); \
         assert(map->_buckets); \
+        _HASHMAP_INSTRUMENT( \
+            map->_counters.n_resizes++; \
+            map->_counters.bytes_allocated += new_size * sizeof(_##HASHMAP_NAME##BucketEntry); \
+        ) \
+        _HASHMAP_INCREMENTAL( \
+            map->_old_buckets = old_buckets; \
+            map->_n_old_buckets = old_n_buckets; \
+            map->_migrate_ind = 0; \
+            _TRACE(_TRACE_EMIT(TRACE_HASHMAP_RESIZE, hashmap_resize, #HASHMAP_NAME, map, old_n_buckets, new_size, _trace_start);) \
+            return; \
+        ) \
+        _HASHMAP_INSTRUMENT(map->_counters.n_rehashes += map->size;) \
         \
         for (size_t i = 0; i < old_n_buckets; i++) { \
             _##HASHMAP_NAME##BucketEntry* entry = old_buckets+i; \
             if (entry->_is_valid) \
                 *(_##HASHMAP_NAME##_locate_entry_holder(map, (const HASHMAP_KEY_TYPE*) &(entry->entry.key))) = *entry; \
         } \
-        free(old_buckets); \
+        _HASHMAP_FREE(old_buckets); \
+        _TRACE(_TRACE_EMIT(TRACE_HASHMAP_RESIZE, hashmap_resize, #HASHMAP_NAME, map, old_n_buckets, new_size, _trace_start);) \
     } \
     \
     \
@@ -164,10 +423,22 @@ typedef struct
         assert(map); \
         assert(key); \
         \
-        if ((map->size) / (double) map->_n_buckets >= _HASHMAP_LOAD_FACTOR) \
-            _##HASHMAP_NAME##_resize(map, map->_n_buckets * 2); \
+        /* lookups leave the bucket arrays alone, so they do not invalidate iterators */ \
+        if (insert) { \
+            _HASHMAP_INCREMENTAL(_##HASHMAP_NAME##_rehash_step(map, _HASHMAP_REHASH_STEP);) \
+            if ((map->size) / (double) map->_n_buckets >= _HASHMAP_LOAD_FACTOR) \
+                _##HASHMAP_NAME##_resize(map, map->_n_buckets * 2); \
+        } \
         \
         _##HASHMAP_NAME##BucketEntry* entry_holder = _##HASHMAP_NAME##_locate_entry_holder(map, key); \
+        _HASHMAP_INCREMENTAL( \
+            if (!(entry_holder->_is_valid) && map->_old_buckets) { \
+                _##HASHMAP_NAME##BucketEntry* old_holder = _##HASHMAP_NAME##_locate_old_entry_holder(map, key); \
+                if (old_holder->_is_valid) \
+                    entry_holder = old_holder; \
+            } \
+        ) \
+        _HASHMAP_INSTRUMENT(_hashmap_count_lookup(&map->_counters, entry_holder->_is_valid);) \
         if (insert && !(entry_holder->_is_valid)) { \
             entry_holder->_is_valid = 1; \
             entry_holder->entry.key = (HASHMAP_KEY_TYPE) *key; \
@@ -179,6 +450,86 @@ typedef struct
     } \
     \
     \
+    /***********************************************************************
+     * Grows the bucket array so that n_entries entries fit without
+     * another resize. An ongoing incremental resize is finished first
+     ***********************************************************************/ \
+    static void HASHMAP_NAME##_reserve(HASHMAP_NAME* map, size_t n_entries) \
+    { \
+        assert(map); \
+        _HASHMAP_INCREMENTAL(_##HASHMAP_NAME##_rehash_step(map, SIZE_MAX);) \
+        size_t n_buckets = map->_n_buckets; \
+        for (; n_entries / (double) n_buckets >= _HASHMAP_LOAD_FACTOR && n_buckets < _HASHMAP_MAX_BUCKET_ARRAY_SIZE; n_buckets <<= 1); \
+        if (n_buckets != map->_n_buckets) { \
+            _##HASHMAP_NAME##_resize(map, n_buckets); \
+            _HASHMAP_INCREMENTAL(_##HASHMAP_NAME##_rehash_step(map, SIZE_MAX);) \
+        } \
+    } \
+    \
+    \
+    /******************************************************************************
+     * Moves the entries of at least n_buckets buckets of an ongoing incremental
+     * resize into the new bucket array, SIZE_MAX finishes it. Lookups do not
+     * move entries, so read-mostly maps should call this to free the old array.
+     * Invalidates iterators if it moves entries. Without
+     * HASHMAP_INCREMENTAL_RESIZE resizes are never pending and this does nothing
+     *
+     * @returns true if the resize is still not finished
+     ******************************************************************************/ \
+    static bool HASHMAP_NAME##_migrate(HASHMAP_NAME* map, size_t n_buckets) \
+    { \
+        assert(map); \
+        (void) n_buckets; \
+        _HASHMAP_INCREMENTAL( \
+            _##HASHMAP_NAME##_rehash_step(map, n_buckets); \
+            return map->_old_buckets != NULL; \
+        ) \
+        return false; \
+    } \
+    \
+    \
+    /**************************************************************************************
+     * Inserts n keys, equivalent to calling search with insert set to true on each
+     *
+     * The map is resized once up front, and the keys are hashed in batches of
+     * _HASHMAP_BULK_BATCH, prefetching their buckets before any of them is probed,
+     * so the cache misses of one batch overlap. Values of new entries are zeroed.
+     *
+     * @returns the number of keys that were not already present
+     **************************************************************************************/ \
+    static size_t HASHMAP_NAME##_insert_keys(HASHMAP_NAME* map, const HASHMAP_KEY_TYPE* keys, size_t n) \
+    { \
+        assert(map); \
+        assert(keys || n == 0); \
+        size_t old_size = map->size; \
+        HASHMAP_NAME##_reserve(map, map->size + n); \
+        size_t hashes[_HASHMAP_BULK_BATCH]; \
+        for (size_t start = 0; start < n; start += _HASHMAP_BULK_BATCH) { \
+            size_t batch = n - start < _HASHMAP_BULK_BATCH ? n - start : _HASHMAP_BULK_BATCH; \
+            for (size_t i = 0; i < batch; i++) { \
+                hashes[i] = HASHMAP_HASH_FUNC((keys + start + i)); \
+                __builtin_prefetch(map->_buckets + hashes[i] % map->_n_buckets, 1); \
+            } \
+            for (size_t i = 0; i < batch; i++) { \
+                /* the map is only full if reserve hit _HASHMAP_MAX_BUCKET_ARRAY_SIZE */ \
+                if ((map->size) / (double) map->_n_buckets >= _HASHMAP_LOAD_FACTOR) { \
+                    _##HASHMAP_NAME##_resize(map, map->_n_buckets * 2); \
+                    _HASHMAP_INCREMENTAL(_##HASHMAP_NAME##_rehash_step(map, SIZE_MAX);) \
+                } \
+                _##HASHMAP_NAME##BucketEntry* entry_holder = _##HASHMAP_NAME##_locate_hashed_entry_holder(map, keys + start + i, hashes[i]); \
+                _HASHMAP_INSTRUMENT(_hashmap_count_lookup(&map->_counters, entry_holder->_is_valid);) \
+                if (!(entry_holder->_is_valid)) { \
+                    entry_holder->_is_valid = 1; \
+                    entry_holder->entry.key = (HASHMAP_KEY_TYPE) keys[start + i]; \
+                    memset(&(entry_holder->entry.value), '\0', sizeof(HASHMAP_VALUE_TYPE)); \
+                    map->size++; \
+                } \
+            } \
+        } \
+        return map->size - old_size; \
+    } \
+    \
+    \
     /**********************************
      * Assigns a value to a given key
     ***********************************/ \
@@ -203,7 +554,11 @@ typedef struct
     ***************************************************/ \
     static void HASHMAP_NAME##_free(HASHMAP_NAME* map) \
     { \
-        free(map->_buckets); \
+        _HASHMAP_FREE(map->_buckets); \
+        _HASHMAP_INCREMENTAL( \
+            if (map->_old_buckets) \
+                _HASHMAP_FREE(map->_old_buckets); \
+        ) \
     } \
     \
     \
@@ -217,7 +572,20 @@ typedef struct
     { \
         assert(map); \
         assert(key); \
+        _HASHMAP_INCREMENTAL(_##HASHMAP_NAME##_rehash_step(map, _HASHMAP_REHASH_STEP);) \
         _##HASHMAP_NAME##BucketEntry* entry_holder = _##HASHMAP_NAME##_locate_entry_holder(map, key); \
+        _HASHMAP_INCREMENTAL( \
+            /* removing from the old array could leave entries behind the migration index, \
+               so the cluster of the entry is moved over first, and it is removed from the new array */ \
+            if (!(entry_holder->_is_valid) && map->_old_buckets) { \
+                _##HASHMAP_NAME##BucketEntry* old_holder = _##HASHMAP_NAME##_locate_old_entry_holder(map, key); \
+                if (old_holder->_is_valid) { \
+                    _##HASHMAP_NAME##_migrate_cluster(map, old_holder - map->_old_buckets); \
+                    entry_holder = _##HASHMAP_NAME##_locate_entry_holder(map, key); \
+                } \
+            } \
+        ) \
+        _HASHMAP_INSTRUMENT(_hashmap_count_lookup(&map->_counters, entry_holder->_is_valid);) \
         if (!(entry_holder->_is_valid)) \
             return; \
         entry_holder->_is_valid = 0; \
@@ -229,6 +597,7 @@ typedef struct
             _##HASHMAP_NAME##BucketEntry entry = map->_buckets[ind]; \
             map->_buckets[ind]._is_valid = 0; \
             *(_##HASHMAP_NAME##_locate_entry_holder(map, (const HASHMAP_KEY_TYPE*) &(entry.entry.key))) = entry; \
+            _HASHMAP_INSTRUMENT(map->_counters.n_rehashes++;) \
         } \
         if (4 * map->size / (double) map->_n_buckets < _HASHMAP_LOAD_FACTOR && !(map->_n_buckets <= _HASHMAP_MIN_BUCKET_ARRAY_SIZE)) \
             _##HASHMAP_NAME##_resize(map, map->_n_buckets / 2); \
@@ -236,15 +605,159 @@ typedef struct
     } \
     \
     \
+    /*******************************************************************************
+     * Returns the number of bytes used by the HashMap, including the owner struct
+     *
+     * Every bucket stores an entry and a validity flag, which is padded to the
+     * alignment of the entry, so the bytes per entry depend on both the load
+     * factor and the key and value types.
+     * During an incremental resize, the old bucket array is counted as well
+     *******************************************************************************/ \
+    static size_t HASHMAP_NAME##_memory_usage(const HASHMAP_NAME* map) \
+    { \
+        assert(map); \
+        size_t n_buckets = map->_n_buckets; \
+        _HASHMAP_INCREMENTAL(n_buckets += map->_n_old_buckets;) \
+        return sizeof(HASHMAP_NAME) + n_buckets * sizeof(_##HASHMAP_NAME##BucketEntry); \
+    } \
+    \
+    \
+    /**********************************************************************************
+     * Computes probe length histograms, clustering and memory use of the map
+     *
+     * Every key is hashed once, so this takes time linear in the number of buckets.
+     * The live counters in out->counters are only filled when HASHMAP_INSTRUMENT
+     * is defined, see HashMapStats for a description of each statistic.
+     * During an incremental resize, the probe statistics only cover the entries
+     * already moved into the new bucket array
+     **********************************************************************************/ \
+    static void HASHMAP_NAME##_stats(const HASHMAP_NAME* map, HashMapStats* out) \
+    { \
+        assert(map); \
+        assert(out); \
+        memset(out, 0, sizeof(HashMapStats)); \
+        size_t n = map->_n_buckets; \
+        out->size = map->size; \
+        out->n_buckets = n; \
+        out->load_factor = map->size / (double) n; \
+        out->bytes_allocated = n * sizeof(_##HASHMAP_NAME##BucketEntry); \
+        _HASHMAP_INCREMENTAL(out->bytes_allocated += map->_n_old_buckets * sizeof(_##HASHMAP_NAME##BucketEntry);) \
+        _HASHMAP_INSTRUMENT(out->counters = map->_counters;) \
+        \
+        /* walk backwards from an empty bucket, so the distance to the end of each cluster is known */ \
+        size_t empty = 0; \
+        while (map->_buckets[empty]._is_valid) \
+            empty++; \
+        size_t run = 0, total_hit = 0, total_miss = 0, n_entries = 0; \
+        for (size_t k = 0; k < n; k++) { \
+            size_t ind = (empty + n - k) % n; \
+            const _##HASHMAP_NAME##BucketEntry* bucket = map->_buckets + ind; \
+            if (!bucket->_is_valid) { \
+                run = 0; \
+            } else { \
+                if (run++ == 0) \
+                    out->n_clusters++; \
+                if (run > out->longest_cluster) \
+                    out->longest_cluster = run; \
+                size_t home = (HASHMAP_HASH_FUNC(((const HASHMAP_KEY_TYPE*) &(bucket->entry.key)))) % n; \
+                size_t probes = (ind + n - home) % n + 1; \
+                total_hit += probes; \
+                n_entries++; \
+                _hashmap_histogram_add(out->hit_histogram, probes); \
+            } \
+            total_miss += run + 1; \
+            _hashmap_histogram_add(out->miss_histogram, run + 1); \
+        } \
+        out->mean_hit_probes = n_entries ? total_hit / (double) n_entries : 0; \
+        out->mean_miss_probes = total_miss / (double) n; \
+    } \
+    \
+    \
     typedef struct \
     { \
         HASHMAP_NAME##Entry* current; \
         _##HASHMAP_NAME##BucketEntry* _buckets; \
         size_t _n_buckets; \
         size_t _index; \
+        size_t _end; \
+        _HASHMAP_INCREMENTAL( \
+            _##HASHMAP_NAME##BucketEntry* _old_buckets; \
+        ) \
     } HASHMAP_NAME##Iter; \
     \
     \
+    /**************************************************************
+     * Do not use this function
+     *
+     * Moves the iterator to the first entry at or after index i
+     * and before _end. During incremental resizes, the indices
+     * past the new bucket array are those of the old one
+     **************************************************************/ \
+    static void _##HASHMAP_NAME##Iter_seek(HASHMAP_NAME##Iter* iter, size_t i) \
+    { \
+        for (; i < iter->_end && i < iter->_n_buckets; i++) { \
+            if ((iter->_buckets+i)->_is_valid) { \
+                iter->current = &(iter->_buckets[i].entry); \
+                iter->_index = i; \
+                return; \
+            } \
+        } \
+        _HASHMAP_INCREMENTAL( \
+            for (; i < iter->_end; i++) { \
+                _##HASHMAP_NAME##BucketEntry* old = iter->_old_buckets + (i - iter->_n_buckets); \
+                if (old->_is_valid) { \
+                    iter->current = &(old->entry); \
+                    iter->_index = i; \
+                    return; \
+                } \
+            } \
+        ) \
+        iter->current = NULL; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns the number of buckets to split iter_range calls over,
+     * the size of the bucket array, plus that of the old bucket array
+     * during an incremental resize
+     *******************************************************************/ \
+    static size_t HASHMAP_NAME##_bucket_count(const HASHMAP_NAME* map) \
+    { \
+        assert(map != NULL); \
+        return map->_n_buckets _HASHMAP_INCREMENTAL(+ map->_n_old_buckets); \
+    } \
+    \
+    \
+    /*********************************************************************
+     * Returns an iterator over the entries in the buckets with indices
+     * from begin_bucket up to, but not including, end_bucket
+     *
+     * Iterators over disjoint ranges visit disjoint entries, so threads
+     * may each walk their own range of 0..bucket_count(map) at once,
+     * as long as no thread inserts or removes entries. Lookups with
+     * search, insert set to false, and contains are allowed, as they
+     * never move entries, also during an incremental resize
+     *
+     * If the range holds no entries the field `current`
+     * in the returned iterator is NULL
+     *********************************************************************/ \
+    static HASHMAP_NAME##Iter HASHMAP_NAME##_iter_range(const HASHMAP_NAME* map, size_t begin_bucket, size_t end_bucket) \
+    { \
+        assert(map != NULL); \
+        assert(begin_bucket <= end_bucket && end_bucket <= HASHMAP_NAME##_bucket_count(map)); \
+        HASHMAP_NAME##Iter iter = { \
+            .current = NULL, \
+            ._buckets = map->_buckets, \
+            ._n_buckets = map->_n_buckets, \
+            ._index = begin_bucket, \
+            ._end = end_bucket, \
+            _HASHMAP_INCREMENTAL(._old_buckets = map->_old_buckets,) \
+        }; \
+        _##HASHMAP_NAME##Iter_seek(&iter, begin_bucket); \
+        return iter; \
+    } \
+    \
+    \
     /*********************************************************************
      * Returns an iterator to iterate over all elements of map
      * The order the elements are given is is completely arbitrary
@@ -267,12 +780,7 @@ typedef struct
      *********************************************************************/ \
     static HASHMAP_NAME##Iter HASHMAP_NAME##_iter(const HASHMAP_NAME* map) \
     { \
-        assert(map != NULL); \
-        for (size_t i = 0; i < map->_n_buckets; i++) { \
-            if ((map->_buckets+i)->_is_valid) \
-                return (HASHMAP_NAME##Iter) {&(map->_buckets[i].entry), map->_buckets, map->_n_buckets, i}; \
-        } \
-        return (HASHMAP_NAME##Iter) {NULL, NULL, 0}; \
+        return HASHMAP_NAME##_iter_range(map, 0, HASHMAP_NAME##_bucket_count(map)); \
     } \
     \
     \
@@ -289,14 +797,80 @@ typedef struct
         assert(iter); \
         if (!iter->current) \
             return; \
-        for (size_t i = iter->_index+1; i < iter->_n_buckets; i++) { \
-            if ((iter->_buckets+i)->_is_valid) { \
-                iter->current = &(iter->_buckets[i].entry); \
-                iter->_index = i; \
-                return; \
+        _##HASHMAP_NAME##Iter_seek(iter, iter->_index+1); \
+    } \
+    \
+    \
+    /************************************************************************************
+     * Calls fn on every entry of the map, together with ctx
+     *
+     * The bucket array is split into ranges of _HASHMAP_PARALLEL_CHUNK buckets,
+     * which are handed out to the threads of an OpenMP parallel region as they
+     * finish their previous one. Without -fopenmp it runs on the calling thread.
+     * fn is called from several threads at once, never twice for the same entry.
+     * It may look up keys with contains or search with insert set to false,
+     * but must not insert or remove entries. With HASHMAP_INSTRUMENT, lookups
+     * also update the counters of the map, so fn must not do any then.
+     * Must not be called from inside an OpenMP parallel region
+     ************************************************************************************/ \
+    static void HASHMAP_NAME##_parallel_for_each(HASHMAP_NAME* map, \
+        void (*fn)(HASHMAP_NAME##Entry* entry, void* ctx), void* ctx) \
+    { \
+        assert(map != NULL && fn != NULL); \
+        size_t n_buckets = HASHMAP_NAME##_bucket_count(map); \
+        size_t n_chunks = (n_buckets + _HASHMAP_PARALLEL_CHUNK - 1) / _HASHMAP_PARALLEL_CHUNK; \
+        _Pragma("omp parallel for schedule(dynamic)") \
+        for (size_t c = 0; c < n_chunks; c++) { \
+            size_t end = (c + 1) * _HASHMAP_PARALLEL_CHUNK < n_buckets ? (c + 1) * _HASHMAP_PARALLEL_CHUNK : n_buckets; \
+            for (HASHMAP_NAME##Iter it = HASHMAP_NAME##_iter_range(map, c * _HASHMAP_PARALLEL_CHUNK, end); it.current; HASHMAP_NAME##Iter_inc(&it)) \
+                fn(it.current, ctx); \
+        } \
+    } \
+    \
+    \
+    /*******************************************************************************************
+     * Folds every entry of the map into acc, an accumulator of acc_size bytes
+     *
+     * acc must hold the identity of the reduction when called. Every thread starts
+     * from a copy of it, calls add for the entries of its ranges of buckets, as in
+     * parallel_for_each, and finally calls merge to combine its copy into acc, one
+     * thread at a time. Threads merge in no particular order, so merge should be
+     * commutative and associative. Must not be called from inside an OpenMP parallel region
+     *
+     * EXAMPLE USAGE:
+     * ```
+     * static void add(void* acc, const MapEntry* entry) { *(double*) acc += entry->value; }
+     * static void merge(void* acc, const void* other) { *(double*) acc += *(const double*) other; }
+     * ...
+     * double sum = 0;
+     * Map_parallel_reduce(&map, &sum, sizeof(sum), add, merge);
+     * ```
+     *******************************************************************************************/ \
+    static void HASHMAP_NAME##_parallel_reduce(const HASHMAP_NAME* map, void* acc, size_t acc_size, \
+        void (*add)(void* acc, const HASHMAP_NAME##Entry* entry), void (*merge)(void* acc, const void* other)) \
+    { \
+        assert(map != NULL && acc != NULL && add != NULL && merge != NULL); \
+        size_t n_buckets = HASHMAP_NAME##_bucket_count(map); \
+        size_t n_chunks = (n_buckets + _HASHMAP_PARALLEL_CHUNK - 1) / _HASHMAP_PARALLEL_CHUNK; \
+        void* identity = malloc(acc_size); \
+        assert(identity); \
+        memcpy(identity, acc, acc_size); \
+        _Pragma("omp parallel") \
+        { \
+            void* local = malloc(acc_size); \
+            assert(local); \
+            memcpy(local, identity, acc_size); \
+            _Pragma("omp for schedule(dynamic) nowait") \
+            for (size_t c = 0; c < n_chunks; c++) { \
+                size_t end = (c + 1) * _HASHMAP_PARALLEL_CHUNK < n_buckets ? (c + 1) * _HASHMAP_PARALLEL_CHUNK : n_buckets; \
+                for (HASHMAP_NAME##Iter it = HASHMAP_NAME##_iter_range(map, c * _HASHMAP_PARALLEL_CHUNK, end); it.current; HASHMAP_NAME##Iter_inc(&it)) \
+                    add(local, it.current); \
             } \
+            _Pragma("omp critical") \
+            merge(acc, local); \
+            free(local); \
         } \
-        iter->current = NULL; \
+        free(identity); \
     }
       
 
@@ -0,0 +1,256 @@
+#ifndef HASHMAP_MMAP_H
+#define HASHMAP_MMAP_H
+
+/***************************************************************************************
+ * On-disk format for HashMaps, opened with mmap without copying or rehashing
+ *
+ * The bucket array of a HashMap is written to disk as is, after a header of
+ * _HASHMAP_MMAP_HEADER_SIZE bytes. Opening the file maps it read-only, and the
+ * returned HashMap points straight into the mapping, so lookups and iteration
+ * only fault in the pages they touch. Opening takes the same time for any size.
+ *
+ * The header records the sizes of keys, values and buckets, and a fingerprint
+ * of the hash function: the combined hashes of the first stored keys.
+ * These are checked when opening, so a file written with a different hash
+ * function or seed, or different types, is rejected instead of silently
+ * returning wrong results. The checksum of the bucket array is only checked
+ * by HASHMAP_NAME##_verify_mmap, as it needs to read the whole file.
+ *
+ * Keys and values are stored in place, so they must not contain pointers.
+ * Files are only portable between machines with the same byte order and ABI.
+ * Requires POSIX (mmap).
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hashmap.h"
+
+// the bucket array starts at this offset, so it is page aligned in the mapping
+#define _HASHMAP_MMAP_HEADER_SIZE 4096
+
+#define _HASHMAP_MMAP_MAGIC "HASHMAP"
+#define _HASHMAP_MMAP_VERSION 1
+
+// number of stored keys hashed into the fingerprint of the hash function
+#define _HASHMAP_MMAP_FINGERPRINT_KEYS 16
+
+/***************************************************
+ * Header at the start of every HashMap file
+ ***************************************************/
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // 0x01020304 written in native byte order
+    uint64_t header_size;
+    uint64_t key_size;
+    uint64_t value_size;
+    uint64_t bucket_size;
+    uint64_t size;
+    uint64_t n_buckets;
+    uint64_t hash_fingerprint;  // see _hashmap_mmap_fingerprint_add
+    uint64_t checksum;          // of the bucket array
+} HashMapFileHeader;
+
+/*********************************************
+ * Do not use this function
+ *
+ * Mixes one more hash into a fingerprint
+ *********************************************/
+static uint64_t _hashmap_mmap_fingerprint_add(uint64_t fingerprint, uint64_t hash)
+{
+    fingerprint = (fingerprint ^ hash) * UINT64_C(0xff51afd7ed558ccd);
+    return fingerprint ^ (fingerprint >> 33);
+}
+
+/****************************************************
+ * Do not use this function
+ *
+ * 64 bit checksum of n bytes, reading 8 at a time
+ ****************************************************/
+static uint64_t _hashmap_mmap_checksum(const unsigned char* data, size_t n)
+{
+    uint64_t h = UINT64_C(0x9e3779b97f4a7c15) ^ n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h ^= word * UINT64_C(0xc4ceb9fe1a85ec53);
+        h = ((h << 31) | (h >> 33)) * UINT64_C(0xff51afd7ed558ccd);
+    }
+    for (; i < n; i++)
+        h = (h ^ data[i]) * UINT64_C(0x100000001b3);
+    h ^= h >> 33;
+    h *= UINT64_C(0xc4ceb9fe1a85ec53);
+    return h ^ (h >> 33);
+}
+
+
+/*****************************************************************************
+ * Generates functions to save a HashMap to a file, and to open it with mmap
+ *
+ * @param HASHMAP_NAME a HashMap type defined with HASHMAP_DEFINE
+ * @param HASHMAP_HASH_FUNC the hash function passed to HASHMAP_DEFINE
+ *****************************************************************************/
+#define HASHMAP_MMAP_DEFINE(HASHMAP_NAME, HASHMAP_HASH_FUNC) \
+    \
+    /****************************************************************
+     * Do not use this function
+     *
+     * Fingerprint of the hash function, from the first stored keys
+     ****************************************************************/ \
+    static uint64_t _##HASHMAP_NAME##_mmap_fingerprint(const HASHMAP_NAME* map) \
+    { \
+        uint64_t fingerprint = 0; \
+        size_t n_keys = 0; \
+        for (size_t i = 0; i < map->_n_buckets && n_keys < _HASHMAP_MMAP_FINGERPRINT_KEYS; i++) { \
+            if (map->_buckets[i]._is_valid) { \
+                fingerprint = _hashmap_mmap_fingerprint_add(fingerprint, HASHMAP_HASH_FUNC((&map->_buckets[i].entry.key))); \
+                n_keys++; \
+            } \
+        } \
+        return fingerprint; \
+    } \
+    \
+    \
+    /*************************************************************************
+     * Writes the map to a file, which can be opened with
+     * HASHMAP_NAME##_open_mmap
+     *
+     * The map may be resized first, so that lookups on the opened map never
+     * need to resize it. An ongoing incremental resize is finished as well
+     *
+     * @returns false if the file could not be written
+     *************************************************************************/ \
+    static bool HASHMAP_NAME##_save(HASHMAP_NAME* map, const char* path) \
+    { \
+        assert(map); \
+        assert(path); \
+        if ((map->size) / (double) map->_n_buckets >= _HASHMAP_LOAD_FACTOR) \
+            _##HASHMAP_NAME##_resize(map, map->_n_buckets * 2); \
+        _HASHMAP_INCREMENTAL(_##HASHMAP_NAME##_rehash_step(map, SIZE_MAX);) \
+        \
+        size_t bucket_bytes = map->_n_buckets * sizeof(_##HASHMAP_NAME##BucketEntry); \
+        union \
+        { \
+            HashMapFileHeader header; \
+            unsigned char bytes[_HASHMAP_MMAP_HEADER_SIZE]; \
+        } header; \
+        memset(&header, 0, sizeof(header)); \
+        memcpy(header.header.magic, _HASHMAP_MMAP_MAGIC, sizeof(_HASHMAP_MMAP_MAGIC)); \
+        header.header.version = _HASHMAP_MMAP_VERSION; \
+        header.header.byte_order = 0x01020304; \
+        header.header.header_size = _HASHMAP_MMAP_HEADER_SIZE; \
+        header.header.key_size = sizeof(map->_buckets->entry.key); \
+        header.header.value_size = sizeof(map->_buckets->entry.value); \
+        header.header.bucket_size = sizeof(_##HASHMAP_NAME##BucketEntry); \
+        header.header.size = map->size; \
+        header.header.n_buckets = map->_n_buckets; \
+        header.header.hash_fingerprint = _##HASHMAP_NAME##_mmap_fingerprint(map); \
+        header.header.checksum = _hashmap_mmap_checksum((const unsigned char*) map->_buckets, bucket_bytes); \
+        \
+        FILE* file = fopen(path, "wb"); \
+        if (!file) \
+            return false; \
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 \
+               && fwrite(map->_buckets, 1, bucket_bytes, file) == bucket_bytes; \
+        return fclose(file) == 0 && ok; \
+    } \
+    \
+    \
+    /*****************************************************************************
+     * Opens a file written by HASHMAP_NAME##_save, without reading it
+     *
+     * The returned map points into a read-only mapping of the file, it can be
+     * used with search (with insert set to false), contains, iter and stats.
+     * Any modification crashes the program. It must be released with
+     * HASHMAP_NAME##_close_mmap, not with HASHMAP_NAME##_free
+     *
+     * @returns false if the file could not be opened, or was not written
+     *    by a map with the same key, value and bucket sizes and hash function,
+     *    or holds more entries than the load factor allows, which could make
+     *    lookups of absent keys probe without end
+     *****************************************************************************/ \
+    static bool HASHMAP_NAME##_open_mmap(HASHMAP_NAME* map, const char* path) \
+    { \
+        assert(map); \
+        assert(path); \
+        int fd = open(path, O_RDONLY); \
+        if (fd < 0) \
+            return false; \
+        struct stat st; \
+        if (fstat(fd, &st) != 0 || (size_t) st.st_size < _HASHMAP_MMAP_HEADER_SIZE) { \
+            close(fd); \
+            return false; \
+        } \
+        void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0); \
+        close(fd); \
+        if (mapping == MAP_FAILED) \
+            return false; \
+        \
+        const HashMapFileHeader* header = mapping; \
+        bool ok = memcmp(header->magic, _HASHMAP_MMAP_MAGIC, sizeof(_HASHMAP_MMAP_MAGIC)) == 0 \
+               && header->version == _HASHMAP_MMAP_VERSION \
+               && header->byte_order == 0x01020304 \
+               && header->header_size == _HASHMAP_MMAP_HEADER_SIZE \
+               && header->key_size == sizeof(map->_buckets->entry.key) \
+               && header->value_size == sizeof(map->_buckets->entry.value) \
+               && header->bucket_size == sizeof(_##HASHMAP_NAME##BucketEntry) \
+               && header->n_buckets > 0 \
+               && header->size / (double) header->n_buckets < _HASHMAP_LOAD_FACTOR \
+               /* a huge bucket count could wrap the file size around to the real one */ \
+               && header->n_buckets <= (SIZE_MAX - _HASHMAP_MMAP_HEADER_SIZE) / header->bucket_size \
+               && (size_t) st.st_size == _HASHMAP_MMAP_HEADER_SIZE + header->n_buckets * header->bucket_size; \
+        if (ok) { \
+            memset(map, 0, sizeof(HASHMAP_NAME)); \
+            map->size = header->size; \
+            map->_n_buckets = header->n_buckets; \
+            map->_buckets = (_##HASHMAP_NAME##BucketEntry*) ((char*) mapping + _HASHMAP_MMAP_HEADER_SIZE); \
+            ok = _##HASHMAP_NAME##_mmap_fingerprint(map) == header->hash_fingerprint; \
+        } \
+        if (!ok) { \
+            munmap(mapping, st.st_size); \
+            return false; \
+        } \
+        /* lookups jump around the file, so reading ahead would mostly load unused pages */ \
+        madvise(mapping, st.st_size, MADV_RANDOM); \
+        return true; \
+    } \
+    \
+    \
+    /*************************************************************************
+     * Checks the bucket array of a map opened with HASHMAP_NAME##_open_mmap
+     * against the checksum written by HASHMAP_NAME##_save
+     *
+     * This reads the whole file
+     *************************************************************************/ \
+    static bool HASHMAP_NAME##_verify_mmap(const HASHMAP_NAME* map) \
+    { \
+        assert(map); \
+        const HashMapFileHeader* header = (const HashMapFileHeader*) ((const char*) map->_buckets - _HASHMAP_MMAP_HEADER_SIZE); \
+        size_t bucket_bytes = map->_n_buckets * sizeof(_##HASHMAP_NAME##BucketEntry); \
+        return _hashmap_mmap_checksum((const unsigned char*) map->_buckets, bucket_bytes) == header->checksum; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Unmaps a map opened with HASHMAP_NAME##_open_mmap.
+     * It must not be used after this point
+     *****************************************************************/ \
+    static void HASHMAP_NAME##_close_mmap(HASHMAP_NAME* map) \
+    { \
+        assert(map); \
+        munmap((char*) map->_buckets - _HASHMAP_MMAP_HEADER_SIZE, \
+               _HASHMAP_MMAP_HEADER_SIZE + map->_n_buckets * sizeof(_##HASHMAP_NAME##BucketEntry)); \
+    }
+
+#endif
@@ -71,6 +71,8 @@
     static void HEAP_NAME##_heapify(void* vector) \
     { \
         _##HEAP_NAME##_VECTOR_TYPE* cast_vec = (_##HEAP_NAME##_VECTOR_TYPE*) vector; \
+        if (cast_vec->size < 2) \
+            return; \
         size_t i = _HEAP_PARENT((cast_vec->size - 1)); \
         do { \
             _##HEAP_NAME##_sift_down(cast_vec, i); \
@@ -78,6 +80,40 @@
     } \
     \
     \
+    /****************************************************************
+    * Constructs a min-heap from the given vector, in parallel
+    *
+    * The tree is processed bottom up, one level at a time. 
+    * The subtrees rooted at one level are disjoint, so they are 
+    * sifted down at the same time by OpenMP threads.
+    * Without OpenMP, this is equivalent to HEAP_NAME##_heapify
+    *
+    * @param vector Can have any vector type with 
+    *   identical <VALUE_TYPE> as the heap
+    *****************************************************************/ \
+    static void HEAP_NAME##_parallel_heapify(void* vector) \
+    { \
+        _##HEAP_NAME##_VECTOR_TYPE* cast_vec = (_##HEAP_NAME##_VECTOR_TYPE*) vector; \
+        if (cast_vec->size < 2) \
+            return; \
+        size_t last_parent = _HEAP_PARENT((cast_vec->size - 1)); \
+        size_t level_start = 0; \
+        for (; _HEAP_LEFT(level_start) <= last_parent; level_start = _HEAP_LEFT(level_start)); \
+        for (;;) { \
+            size_t level_end = _HEAP_LEFT(level_start); \
+            if (level_end > last_parent + 1) \
+                level_end = last_parent + 1; \
+            long long n_level = level_end - level_start; \
+            _Pragma("omp parallel for schedule(dynamic, 64) if(n_level >= 1024)") \
+            for (long long j = 0; j < n_level; j++) \
+                _##HEAP_NAME##_sift_down(cast_vec, level_start + j); \
+            if (level_start == 0) \
+                break; \
+            level_start = _HEAP_PARENT(level_start); \
+        } \
+    } \
+    \
+    \
     /************************************
      * Inserts an element into the Heap
      ************************************/ \
@@ -104,8 +140,12 @@
     { \
         assert(vector); \
         HEAP_VAL_TYPE ret = vector->arr[0]; \
-        vector->arr[0] = _##HEAP_NAME##_VECTOR_TYPE##_pop(vector); \
-        _##HEAP_NAME##_sift_down(vector, 0); \
+        /* the pop may reallocate arr, so it must happen before indexing into it */ \
+        HEAP_VAL_TYPE last = _##HEAP_NAME##_VECTOR_TYPE##_pop(vector); \
+        if (vector->size) { \
+            vector->arr[0] = last; \
+            _##HEAP_NAME##_sift_down(vector, 0); \
+        } \
         return ret; \
     } \
     \
@@ -114,7 +154,16 @@
      **************************************/ \
     static void HEAP_NAME##_free(HEAP_NAME* heap) \
     { \
-        _##HEAP_NAME##_VECTOR_TYPE_free(heap); \
+        _##HEAP_NAME##_VECTOR_TYPE##_free(heap); \
+    } \
+    \
+    /**********************************************
+     * Returns the number of bytes used by the heap
+     * see VEC_NAME##_memory_usage
+     **********************************************/ \
+    static size_t HEAP_NAME##_memory_usage(const HEAP_NAME* heap) \
+    { \
+        return _##HEAP_NAME##_VECTOR_TYPE##_memory_usage(heap); \
     }
 
 #endif
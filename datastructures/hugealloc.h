@@ -0,0 +1,278 @@
+#ifndef HUGEALLOC_H
+#define HUGEALLOC_H
+
+/***************************************************************************************
+ * Allocator for very large arrays, backed by mmap and huge pages
+ *
+ * Allocations of at least _HUGEALLOC_THRESHOLD bytes are mapped directly with mmap,
+ * rounded up to whole 2 MB pages and advised with MADV_HUGEPAGE, so that the kernel
+ * backs them with transparent huge pages. This greatly reduces TLB misses when
+ * doing random accesses into multi-GB arrays.
+ * Smaller allocations are passed on to malloc.
+ *
+ * Mapped allocations are grown and shrunk in place using mremap on Linux,
+ * instead of allocating new memory and copying. mremap is only declared by glibc
+ * when _GNU_SOURCE is defined before any system header is included,
+ * otherwise the allocator falls back to mapping new memory and copying.
+ *
+ * Vec and HashMap can be made to use this allocator by defining
+ * VEC_USE_HUGEALLOC or HASHMAP_USE_HUGEALLOC before including their headers.
+ * Memory returned from these functions must only be freed with hugealloc_free.
+ *
+ * The statistics are kept per translation unit, and are not thread safe.
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+// allocations smaller than this (in bytes) are served by malloc
+#ifndef _HUGEALLOC_THRESHOLD
+#define _HUGEALLOC_THRESHOLD (1 << 21)
+#endif
+
+// mappings are rounded up to a multiple of this size
+#define _HUGEALLOC_PAGE_SIZE (1 << 21)
+
+// set to 1 to first try explicit 2 MB pages (MAP_HUGETLB), these must be reserved
+// in /proc/sys/vm/nr_hugepages beforehand, otherwise transparent huge pages are used
+#ifndef _HUGEALLOC_USE_HUGETLB
+#define _HUGEALLOC_USE_HUGETLB 0
+#endif
+
+/*************************************************
+ * Statistics returned from hugealloc_stats
+ *************************************************/
+typedef struct
+{
+    size_t n_mappings;          // live allocations backed by mmap
+    size_t mapped_bytes;        // bytes currently mapped
+    size_t peak_mapped_bytes;   // maximum of mapped_bytes so far
+    size_t n_remaps;            // number of times a mapping was resized with mremap
+    size_t n_copies;            // number of times a mapping was resized by copying
+    size_t n_hugetlb_mappings;  // live mappings backed by explicit huge pages
+    size_t n_malloc_fallbacks;  // allocations smaller than the threshold, served by malloc
+    size_t huge_page_bytes;     // bytes of the whole process backed by transparent huge pages
+} HugeAllocStats;
+
+static HugeAllocStats _hugealloc_stats;
+
+/* stored in front of every allocation, mapped_size is 0 for allocations from malloc */
+typedef union
+{
+    struct
+    {
+        size_t mapped_size;
+        size_t malloc_size;
+        bool hugetlb;
+    } info;
+    max_align_t _align;
+} _HugeAllocHeader;
+
+
+/*****************************************************
+ * Do not use this function
+ *
+ * Maps a new region of at least n_bytes,
+ * returns NULL if no memory could be mapped
+ *****************************************************/
+static _HugeAllocHeader* _hugealloc_map(size_t n_bytes)
+{
+    size_t mapped_size = (n_bytes + _HUGEALLOC_PAGE_SIZE - 1) / _HUGEALLOC_PAGE_SIZE * _HUGEALLOC_PAGE_SIZE;
+    void* mem = MAP_FAILED;
+    bool hugetlb = false;
+#if _HUGEALLOC_USE_HUGETLB && defined(MAP_HUGETLB)
+    mem = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    hugetlb = mem != MAP_FAILED;
+#endif
+    if (mem == MAP_FAILED)
+        mem = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    if (!hugetlb)
+        madvise(mem, mapped_size, MADV_HUGEPAGE);
+#endif
+
+    _HugeAllocHeader* header = mem;
+    header->info.mapped_size = mapped_size;
+    header->info.hugetlb = hugetlb;
+    _hugealloc_stats.n_mappings++;
+    _hugealloc_stats.n_hugetlb_mappings += hugetlb;
+    _hugealloc_stats.mapped_bytes += mapped_size;
+    if (_hugealloc_stats.mapped_bytes > _hugealloc_stats.peak_mapped_bytes)
+        _hugealloc_stats.peak_mapped_bytes = _hugealloc_stats.mapped_bytes;
+    return header;
+}
+
+
+/*******************************************************
+ * Do not use this function
+ *
+ * Unmaps a region created by _hugealloc_map
+ *******************************************************/
+static void _hugealloc_unmap(_HugeAllocHeader* header)
+{
+    _hugealloc_stats.n_mappings--;
+    _hugealloc_stats.n_hugetlb_mappings -= header->info.hugetlb;
+    _hugealloc_stats.mapped_bytes -= header->info.mapped_size;
+    munmap(header, header->info.mapped_size);
+}
+
+
+/*****************************************************************
+ * Allocates n_bytes of uninitialized memory, like malloc
+ *****************************************************************/
+static void* hugealloc_malloc(size_t n_bytes)
+{
+    _HugeAllocHeader* header;
+    size_t total = n_bytes + sizeof(_HugeAllocHeader);
+    if (total < _HUGEALLOC_THRESHOLD) {
+        header = malloc(total);
+        if (!header)
+            return NULL;
+        header->info.mapped_size = 0;
+        header->info.malloc_size = n_bytes;
+        _hugealloc_stats.n_malloc_fallbacks++;
+    } else {
+        header = _hugealloc_map(total);
+        if (!header)
+            return NULL;
+    }
+    return header + 1;
+}
+
+
+/***************************************************************
+ * Allocates an array of zeroed memory, like calloc
+ *
+ * Mapped memory is already zeroed by the kernel, so pages are
+ * not touched until they are used
+ ***************************************************************/
+static void* hugealloc_calloc(size_t n_members, size_t member_size)
+{
+    size_t n_bytes = n_members * member_size;
+    assert(member_size == 0 || n_bytes / member_size == n_members);
+    if (n_bytes + sizeof(_HugeAllocHeader) < _HUGEALLOC_THRESHOLD) {
+        _HugeAllocHeader* header = calloc(1, n_bytes + sizeof(_HugeAllocHeader));
+        if (!header)
+            return NULL;
+        header->info.malloc_size = n_bytes;
+        _hugealloc_stats.n_malloc_fallbacks++;
+        return header + 1;
+    }
+    return hugealloc_malloc(n_bytes);
+}
+
+
+/**********************************************
+ * Frees memory allocated by this allocator
+ **********************************************/
+static void hugealloc_free(void* ptr)
+{
+    if (!ptr)
+        return;
+    _HugeAllocHeader* header = (_HugeAllocHeader*) ptr - 1;
+    if (header->info.mapped_size)
+        _hugealloc_unmap(header);
+    else
+        free(header);
+}
+
+
+/*****************************************************************************
+ * Resizes memory allocated by this allocator, like realloc
+ *
+ * Mapped memory is resized in place with mremap when it is available,
+ * the kernel then moves the page table entries instead of copying the data
+ *****************************************************************************/
+static void* hugealloc_realloc(void* ptr, size_t n_bytes)
+{
+    if (!ptr)
+        return hugealloc_malloc(n_bytes);
+    _HugeAllocHeader* header = (_HugeAllocHeader*) ptr - 1;
+    size_t total = n_bytes + sizeof(_HugeAllocHeader);
+    size_t old_mapped = header->info.mapped_size;
+
+    if (!old_mapped) {
+        if (total < _HUGEALLOC_THRESHOLD) {
+            header = realloc(header, total);
+            if (!header)
+                return NULL;
+            header->info.malloc_size = n_bytes;
+            return header + 1;
+        }
+        /* moving from malloc to a mapping */
+        _HugeAllocHeader* new_header = _hugealloc_map(total);
+        if (!new_header)
+            return NULL;
+        memcpy(new_header + 1, ptr, header->info.malloc_size);
+        free(header);
+        return new_header + 1;
+    }
+
+    size_t new_mapped = (total + _HUGEALLOC_PAGE_SIZE - 1) / _HUGEALLOC_PAGE_SIZE * _HUGEALLOC_PAGE_SIZE;
+    if (new_mapped == old_mapped)
+        return ptr;
+
+#ifdef MREMAP_MAYMOVE
+    if (!header->info.hugetlb) {
+        void* mem = mremap(header, old_mapped, new_mapped, MREMAP_MAYMOVE);
+        if (mem == MAP_FAILED)
+            return NULL;
+        header = mem;
+        header->info.mapped_size = new_mapped;
+        _hugealloc_stats.n_remaps++;
+        _hugealloc_stats.mapped_bytes += new_mapped - old_mapped;
+        if (_hugealloc_stats.mapped_bytes > _hugealloc_stats.peak_mapped_bytes)
+            _hugealloc_stats.peak_mapped_bytes = _hugealloc_stats.mapped_bytes;
+#ifdef MADV_HUGEPAGE
+        if (new_mapped > old_mapped)
+            madvise((char*) mem + old_mapped, new_mapped - old_mapped, MADV_HUGEPAGE);
+#endif
+        return header + 1;
+    }
+#endif
+
+    _HugeAllocHeader* new_header = _hugealloc_map(total);
+    if (!new_header)
+        return NULL;
+    size_t keep = (old_mapped < new_mapped ? old_mapped : new_mapped) - sizeof(_HugeAllocHeader);
+    memcpy(new_header + 1, ptr, keep);
+    _hugealloc_unmap(header);
+    _hugealloc_stats.n_copies++;
+    return new_header + 1;
+}
+
+
+/*****************************************************************************
+ * Returns the allocation statistics of this translation unit
+ *
+ * huge_page_bytes is read from /proc/self/smaps_rollup, and is 0
+ * when it is not available
+ *****************************************************************************/
+static HugeAllocStats hugealloc_stats()
+{
+    HugeAllocStats ret = _hugealloc_stats;
+    ret.huge_page_bytes = 0;
+    FILE* smaps = fopen("/proc/self/smaps_rollup", "r");
+    if (!smaps)
+        return ret;
+    char line[256];
+    size_t kb;
+    while (fgets(line, sizeof(line), smaps)) {
+        if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+            ret.huge_page_bytes = kb * 1024;
+            break;
+        }
+    }
+    fclose(smaps);
+    return ret;
+}
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+/***************************************************************************************
+ * Fast reading of whitespace separated integers from files, pipes or stdin
+ *
+ * The input is read with read() in blocks of _INGEST_BUFFER_SIZE bytes, and parsed
+ * in place, eight digits at a time with SWAR arithmetic on 64 bit words.
+ * Any character other than a digit or a minus sign directly followed by a digit
+ * separates two numbers, so a lone minus sign is skipped.
+ * Numbers must fit into an int64_t, overflow is not detected.
+ *
+ * Parsed numbers are appended straight into the array of a Vec, see INGEST_DEFINE,
+ * from which HashMaps and TreeMaps can be built in bulk with
+ * HASHMAP_NAME##_insert_keys and TREEMAP_NAME##_from_sorted_keys.
+ *
+ * LineReader splits the same kind of input into lines, found with memchr, and
+ * returns each line in place in its buffer, without copying.
+ *
+ * Requires POSIX (read).
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// bytes read from the input at a time
+#ifndef _INGEST_BUFFER_SIZE
+#define _INGEST_BUFFER_SIZE (1 << 20)
+#endif
+
+// the buffer is refilled once fewer bytes than this are left, so every number is parsed from one buffer
+#define _INGEST_MAX_TOKEN 64
+
+// numbers appended to a Vec between checks of its capacity
+#define _INGEST_VEC_BATCH 4096
+
+/*****************************************************************
+ * Reader of integers, opened with int_reader_open and released
+ * with int_reader_close
+ *****************************************************************/
+typedef struct
+{
+    int _fd;
+    bool _owns_fd;
+    bool _eof;
+    char* _buf;   // followed by 8 zero bytes, so words can be loaded past the end
+    size_t _pos;
+    size_t _end;
+} IntReader;
+
+/***************************************************************
+ * Opens a file for reading, or stdin if path is NULL
+ *
+ * @returns false if the file could not be opened
+ ***************************************************************/
+static bool int_reader_open(IntReader* reader, const char* path)
+{
+    assert(reader);
+    int fd = path ? open(path, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0)
+        return false;
+    reader->_fd = fd;
+    reader->_owns_fd = path != NULL;
+    reader->_eof = false;
+    reader->_buf = malloc(_INGEST_BUFFER_SIZE + 8);
+    assert(reader->_buf);
+    reader->_pos = 0;
+    reader->_end = 0;
+    memset(reader->_buf, 0, 8);
+    return true;
+}
+
+/**************************************************************
+ * Frees the buffer of a reader, and closes its file.
+ * stdin is left open
+ **************************************************************/
+static void int_reader_close(IntReader* reader)
+{
+    assert(reader);
+    if (reader->_owns_fd)
+        close(reader->_fd);
+    free(reader->_buf);
+}
+
+/**************************************************************
+ * Do not use this function
+ *
+ * Moves the unparsed bytes to the front of the buffer,
+ * and fills the rest from the file
+ **************************************************************/
+static void _int_reader_fill(IntReader* reader)
+{
+    size_t left = reader->_end - reader->_pos;
+    memmove(reader->_buf, reader->_buf + reader->_pos, left);
+    reader->_pos = 0;
+    reader->_end = left;
+    while (!reader->_eof && reader->_end < _INGEST_BUFFER_SIZE) {
+        ssize_t n_read = read(reader->_fd, reader->_buf + reader->_end, _INGEST_BUFFER_SIZE - reader->_end);
+        if (n_read <= 0)
+            reader->_eof = true;
+        else
+            reader->_end += n_read;
+        /* a pipe may return less than asked for, only wait for more if a number could be cut off */
+        if (reader->_end >= _INGEST_MAX_TOKEN)
+            break;
+    }
+    memset(reader->_buf + reader->_end, 0, 8);
+}
+
+/*********************************************************************
+ * Do not use this function
+ *
+ * Returns the number of leading decimal digits in 8 bytes, loaded
+ * little endian. A byte c is a digit if c ^ '0' is below 10, adding
+ * 0x76 sets the top bit of exactly the bytes at or above 10, the
+ * top bit of bytes at or above 0x80 is kept by or-ing them back in.
+ * Carries only go into later bytes, so the first non digit is exact
+ *********************************************************************/
+static inline size_t _ingest_count_digits(uint64_t word)
+{
+    uint64_t x = word ^ UINT64_C(0x3030303030303030);
+    uint64_t non_digits = ((x + UINT64_C(0x7676767676767676)) | x) & UINT64_C(0x8080808080808080);
+    return non_digits ? __builtin_ctzll(non_digits) / 8 : 8;
+}
+
+/**********************************************************************
+ * Do not use this function
+ *
+ * Parses the first n_digits (1 to 8) digits of 8 bytes, loaded little
+ * endian. The digits are shifted to the top, leaving zeroes in front,
+ * then pairs, quads and octets are combined with three multiplies
+ **********************************************************************/
+static inline uint64_t _ingest_parse_digits(uint64_t word, size_t n_digits)
+{
+    uint64_t x = (word ^ UINT64_C(0x3030303030303030)) << (8 * (8 - n_digits));
+    x = (x * 10 + (x >> 8)) & UINT64_C(0x00ff00ff00ff00ff);
+    x = (x * 100 + (x >> 16)) & UINT64_C(0x0000ffff0000ffff);
+    return (x * 10000 + (x >> 32)) & UINT64_C(0xffffffff);
+}
+
+static const uint64_t _ingest_powers_of_10[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+/**************************************************************************
+ * Parses the next integer
+ *
+ * @returns false once the input has no more numbers
+ **************************************************************************/
+static bool int_reader_next(IntReader* reader, int64_t* out)
+{
+    assert(reader);
+    assert(out);
+    for (;;) {
+        if (reader->_end - reader->_pos < _INGEST_MAX_TOKEN && !reader->_eof)
+            _int_reader_fill(reader);
+        if (reader->_pos == reader->_end)
+            return false;
+        char c = reader->_buf[reader->_pos];
+        if ((unsigned char) (c - '0') < 10)
+            break;
+        /* a minus sign only starts a number if a digit follows, the buffer holds a whole token */
+        if (c == '-' && reader->_pos + 1 < reader->_end && (unsigned char) (reader->_buf[reader->_pos + 1] - '0') < 10)
+            break;
+        reader->_pos++;
+    }
+    const char* p = reader->_buf + reader->_pos;
+    bool negative = *p == '-';
+    p += negative;
+    uint64_t value = 0;
+    for (;;) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        size_t n_digits = _ingest_count_digits(word);
+        if (n_digits == 0)
+            break;
+        value = value * _ingest_powers_of_10[n_digits] + _ingest_parse_digits(word, n_digits);
+        p += n_digits;
+        if (n_digits < 8)
+            break;
+    }
+    reader->_pos = p - reader->_buf;
+    *out = negative ? (int64_t) (0 - value) : (int64_t) value;
+    return true;
+}
+
+
+/*****************************************************************
+ * Reader of lines, opened with line_reader_open and released
+ * with line_reader_close
+ *****************************************************************/
+typedef struct
+{
+    int _fd;
+    bool _owns_fd;
+    bool _eof;
+    char* _buf;   // followed by 1 byte, for the '\0' after a last line without newline
+    size_t _cap;
+    size_t _pos;
+    size_t _end;
+} LineReader;
+
+/***************************************************************
+ * Opens a file for reading, or stdin if path is NULL
+ *
+ * @returns false if the file could not be opened
+ ***************************************************************/
+static bool line_reader_open(LineReader* reader, const char* path)
+{
+    assert(reader);
+    int fd = path ? open(path, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0)
+        return false;
+    reader->_fd = fd;
+    reader->_owns_fd = path != NULL;
+    reader->_eof = false;
+    reader->_cap = _INGEST_BUFFER_SIZE;
+    reader->_buf = malloc(reader->_cap + 1);
+    assert(reader->_buf);
+    reader->_pos = 0;
+    reader->_end = 0;
+    return true;
+}
+
+/**************************************************************
+ * Frees the buffer of a reader, and closes its file.
+ * stdin is left open
+ **************************************************************/
+static void line_reader_close(LineReader* reader)
+{
+    assert(reader);
+    if (reader->_owns_fd)
+        close(reader->_fd);
+    free(reader->_buf);
+}
+
+/**************************************************************
+ * Do not use this function
+ *
+ * Moves the unsplit bytes to the front of the buffer, doubles
+ * the buffer if a single line fills it, and reads once more
+ **************************************************************/
+static void _line_reader_fill(LineReader* reader)
+{
+    size_t left = reader->_end - reader->_pos;
+    memmove(reader->_buf, reader->_buf + reader->_pos, left);
+    reader->_pos = 0;
+    reader->_end = left;
+    if (left == reader->_cap) {
+        reader->_cap *= 2;
+        reader->_buf = realloc(reader->_buf, reader->_cap + 1);
+        assert(reader->_buf);
+    }
+    ssize_t n_read = read(reader->_fd, reader->_buf + reader->_end, reader->_cap - reader->_end);
+    if (n_read <= 0)
+        reader->_eof = true;
+    else
+        reader->_end += n_read;
+}
+
+/**************************************************************************
+ * Returns the next line, without its newline and terminated by '\0'.
+ * The line lives in the buffer of the reader, and is only valid until
+ * the next call. A last line without a newline is returned as well
+ *
+ * @param line set to the first character of the line
+ * @param len set to the length of the line
+ * @returns false once the input has no more lines
+ **************************************************************************/
+static bool line_reader_next(LineReader* reader, char** line, size_t* len)
+{
+    assert(reader);
+    assert(line);
+    assert(len);
+    size_t searched = 0;   // bytes after _pos known to hold no newline
+    for (;;) {
+        char* start = reader->_buf + reader->_pos;
+        size_t left = reader->_end - reader->_pos;
+        char* newline = memchr(start + searched, '\n', left - searched);
+        if (newline || (reader->_eof && left > 0)) {
+            *len = newline ? (size_t) (newline - start) : left;
+            start[*len] = '\0';
+            reader->_pos += newline ? *len + 1 : left;
+            *line = start;
+            return true;
+        }
+        if (reader->_eof)
+            return false;
+        searched = left;
+        _line_reader_fill(reader);
+    }
+}
+
+
+/*************************************************************************************
+ * Generates a function to read integers straight into a Vec
+ *
+ * @param VEC_NAME a Vec type defined with VEC_DEFINE
+ * @param VEC_VAL_TYPE an integer type, the value type of the Vec
+ *************************************************************************************/
+#define INGEST_DEFINE(VEC_NAME, VEC_VAL_TYPE) \
+    \
+    /******************************************************************************
+     * Appends up to max_n integers from reader to the back of the Vec,
+     * converting them to VEC_VAL_TYPE. The Vec is grown in batches,
+     * instead of checking its capacity for every number
+     *
+     * @returns the number of integers appended, less than max_n only if
+     *    the input ended
+     ******************************************************************************/ \
+    static size_t VEC_NAME##_read_ints(VEC_NAME* vec, IntReader* reader, size_t max_n) \
+    { \
+        assert(vec); \
+        assert(reader); \
+        size_t n_read = 0; \
+        while (n_read < max_n) { \
+            size_t batch = max_n - n_read < _INGEST_VEC_BATCH ? max_n - n_read : _INGEST_VEC_BATCH; \
+            VEC_NAME##_reserve(vec, vec->size + batch); \
+            size_t i = 0; \
+            int64_t value; \
+            for (; i < batch && int_reader_next(reader, &value); i++) \
+                vec->arr[vec->size + i] = (VEC_VAL_TYPE) value; \
+            vec->size += i; \
+            n_read += i; \
+            if (i < batch) \
+                break; \
+        } \
+        return n_read; \
+    }
+
+#endif
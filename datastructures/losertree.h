@@ -0,0 +1,267 @@
+#ifndef LOSERTREE_H
+#define LOSERTREE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdio.h>
+
+/*************************************************************************************
+ * Generates functions for a tournament (loser) tree, merging k sorted runs
+ *
+ * Every internal node of the tree stores the loser of the match played there,
+ * and the overall winner is stored separately. When the winner is replaced by the
+ * next element of its run, only the path from its leaf to the root is replayed,
+ * so each output element costs exactly ceil(log2 k) comparisons,
+ * without moving any elements around.
+ *
+ * Runs are read through sources, which hand out one element at a time.
+ * Sources for arrays (and thereby Vecs) and for binary files are predefined,
+ * but any function with the signature of `next` in LOSER_TREE_NAME##Source can be used
+ *
+ * The merge is stable, if two elements are equal, the one from the source
+ * with the lowest index is output first
+ *
+ * @param LOSER_TREE_NAME name of owner struct and prefix of generated functions
+ * @param LOSER_TREE_VAL_TYPE type of elements being merged
+ * @param LOSER_TREE_CMP_FUNC int (*)(const <LOSER_TREE_VAL_TYPE>* a, const <LOSER_TREE_VAL_TYPE>* b)
+ *   function or macro to compare two entries.
+ *   Given two entries a and b, should return less than 0 if a < b,
+ *   more than 0 if a > b and 0 if a == b
+ *
+ * EXAMPLE USAGE:
+ * ```
+ * LOSER_TREE_DEFINE(Merger, int, CMP)
+ * MergerArrayRun runs[2] = {{vec_a.arr, vec_a.size}, {vec_b.arr, vec_b.size}};
+ * MergerSource sources[2] = {Merger_array_source(runs), Merger_array_source(runs+1)};
+ * Merger merger = Merger_new(sources, 2);
+ * int value;
+ * while (Merger_pop(&merger, &value))
+ *     printf("%d\n", value);
+ * Merger_free(&merger);
+ * ```
+ *************************************************************************************/
+#define LOSER_TREE_DEFINE(LOSER_TREE_NAME, LOSER_TREE_VAL_TYPE, LOSER_TREE_CMP_FUNC) \
+    /*********************************************************************
+     * A sorted run
+     *
+     * `next` must write the next element of the run to out and return
+     * true, or return false if the run is exhausted
+     *********************************************************************/ \
+    typedef struct \
+    { \
+        bool (*next)(void* ctx, LOSER_TREE_VAL_TYPE* out); \
+        void* ctx; \
+    } LOSER_TREE_NAME##Source; \
+    \
+    typedef struct \
+    { \
+        size_t k; \
+        size_t* _losers; \
+        LOSER_TREE_VAL_TYPE* _heads; \
+        bool* _active; \
+        LOSER_TREE_NAME##Source* _sources; \
+    } LOSER_TREE_NAME; \
+    \
+    \
+    /***********************************************
+     * A run stored in an array, for instance a Vec
+     ***********************************************/ \
+    typedef struct \
+    { \
+        const LOSER_TREE_VAL_TYPE* arr; \
+        size_t size; \
+        size_t _index; \
+    } LOSER_TREE_NAME##ArrayRun; \
+    \
+    \
+    static bool _##LOSER_TREE_NAME##ArrayRun_next(void* ctx, LOSER_TREE_VAL_TYPE* out) \
+    { \
+        LOSER_TREE_NAME##ArrayRun* run = ctx; \
+        if (run->_index == run->size) \
+            return false; \
+        *out = run->arr[(run->_index)++]; \
+        return true; \
+    } \
+    \
+    \
+    /***************************************************************
+     * Returns a source reading the given array run from the start
+     *
+     * The run must stay alive for as long as the source is used
+     ***************************************************************/ \
+    static LOSER_TREE_NAME##Source LOSER_TREE_NAME##_array_source(LOSER_TREE_NAME##ArrayRun* run) \
+    { \
+        assert(run); \
+        run->_index = 0; \
+        return (LOSER_TREE_NAME##Source) {_##LOSER_TREE_NAME##ArrayRun_next, run}; \
+    } \
+    \
+    \
+    static bool _##LOSER_TREE_NAME##_file_next(void* ctx, LOSER_TREE_VAL_TYPE* out) \
+    { \
+        return fread(out, sizeof(LOSER_TREE_VAL_TYPE), 1, (FILE*) ctx) == 1; \
+    } \
+    \
+    \
+    /******************************************************************************
+     * Returns a source reading a run of raw binary elements from an open file,
+     * as written by LOSER_TREE_NAME##_file_sink. Reads are buffered by stdio,
+     * so the buffer size can be tuned with setvbuf
+     ******************************************************************************/ \
+    static LOSER_TREE_NAME##Source LOSER_TREE_NAME##_file_source(FILE* file) \
+    { \
+        assert(file); \
+        return (LOSER_TREE_NAME##Source) {_##LOSER_TREE_NAME##_file_next, file}; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Sink writing the raw binary element to an open file (ctx),
+     * for use with LOSER_TREE_NAME##_merge
+     *****************************************************************/ \
+    static void LOSER_TREE_NAME##_file_sink(void* ctx, const LOSER_TREE_VAL_TYPE* value) \
+    { \
+        size_t written = fwrite(value, sizeof(LOSER_TREE_VAL_TYPE), 1, (FILE*) ctx); \
+        assert(written == 1); \
+        (void) written; \
+    } \
+    \
+    \
+    /*************************************************
+     * Do not use this function
+     *
+     * Checks if source a wins a match against b,
+     * exhausted sources lose every match
+     *************************************************/ \
+    static bool _##LOSER_TREE_NAME##_beats(const LOSER_TREE_NAME* tree, size_t a, size_t b) \
+    { \
+        if (!tree->_active[a]) \
+            return false; \
+        if (!tree->_active[b]) \
+            return true; \
+        int cmp_res = LOSER_TREE_CMP_FUNC( \
+            ((const LOSER_TREE_VAL_TYPE*)(tree->_heads+a)), \
+            ((const LOSER_TREE_VAL_TYPE*)(tree->_heads+b)) \
+        ); \
+        return cmp_res < 0 || (cmp_res == 0 && a < b); \
+    } \
+    \
+    \
+    /*****************************************************************************
+     * Creates a new loser tree merging the given sources
+     *
+     * The first element of every source is read immediately
+     *
+     * @param sources array of k sources, it is copied so it can be freed after
+     * @param k number of sources, at least 1
+     *****************************************************************************/ \
+    static LOSER_TREE_NAME LOSER_TREE_NAME##_new(const LOSER_TREE_NAME##Source* sources, size_t k) \
+    { \
+        assert(sources); \
+        assert(k > 0); \
+        LOSER_TREE_NAME ret = {k, NULL, NULL, NULL, NULL}; \
+        ret._losers = malloc(sizeof(size_t) * k); \
+        ret._heads = malloc(sizeof(LOSER_TREE_VAL_TYPE) * k); \
+        ret._active = malloc(sizeof(bool) * k); \
+        ret._sources = malloc(sizeof(LOSER_TREE_NAME##Source) * k); \
+        assert(ret._losers && ret._heads && ret._active && ret._sources); \
+        \
+        for (size_t i = 0; i < k; i++) { \
+            ret._sources[i] = sources[i]; \
+            ret._active[i] = sources[i].next(sources[i].ctx, ret._heads+i); \
+        } \
+        \
+        /* node i has children 2i and 2i+1, leaves are at k..2k-1 */ \
+        size_t* winners = malloc(sizeof(size_t) * 2 * k); \
+        assert(winners); \
+        for (size_t i = 0; i < k; i++) \
+            winners[k+i] = i; \
+        for (size_t node = k-1; node > 0; node--) { \
+            size_t left = winners[2*node], right = winners[2*node+1]; \
+            bool left_wins = !_##LOSER_TREE_NAME##_beats(&ret, right, left); \
+            winners[node] = left_wins ? left : right; \
+            ret._losers[node] = left_wins ? right : left; \
+        } \
+        ret._losers[0] = k == 1 ? 0 : winners[1]; \
+        free(winners); \
+        return ret; \
+    } \
+    \
+    \
+    /*********************************************************************
+     * Removes the smallest element of all the runs, and writes it to out
+     *
+     * @returns false if all runs are exhausted, then out is not written
+     *********************************************************************/ \
+    static bool LOSER_TREE_NAME##_pop(LOSER_TREE_NAME* tree, LOSER_TREE_VAL_TYPE* out) \
+    { \
+        assert(tree); \
+        assert(out); \
+        size_t winner = tree->_losers[0]; \
+        if (!tree->_active[winner]) \
+            return false; \
+        *out = tree->_heads[winner]; \
+        LOSER_TREE_NAME##Source* source = tree->_sources + winner; \
+        tree->_active[winner] = source->next(source->ctx, tree->_heads+winner); \
+        \
+        for (size_t node = (winner + tree->k) / 2; node > 0; node /= 2) { \
+            size_t loser = tree->_losers[node]; \
+            if (_##LOSER_TREE_NAME##_beats(tree, loser, winner)) { \
+                tree->_losers[node] = winner; \
+                winner = loser; \
+            } \
+        } \
+        tree->_losers[0] = winner; \
+        return true; \
+    } \
+    \
+    \
+    /******************************************************************
+     * Merges all remaining elements into a sink, in ascending order
+     *
+     * @param sink called once per element, with ctx as first argument
+     * @returns number of elements written to the sink
+     ******************************************************************/ \
+    static size_t LOSER_TREE_NAME##_merge( \
+        LOSER_TREE_NAME* tree, void (*sink)(void* ctx, const LOSER_TREE_VAL_TYPE* value), void* ctx) \
+    { \
+        assert(tree); \
+        assert(sink); \
+        size_t n = 0; \
+        LOSER_TREE_VAL_TYPE value; \
+        while (LOSER_TREE_NAME##_pop(tree, &value)) { \
+            sink(ctx, (const LOSER_TREE_VAL_TYPE*) &value); \
+            n++; \
+        } \
+        return n; \
+    } \
+    \
+    \
+    /*****************************************************
+     * Deallocates resources used by the tree
+     * The sources themselves are not closed or freed
+     *****************************************************/ \
+    static void LOSER_TREE_NAME##_free(LOSER_TREE_NAME* tree) \
+    { \
+        assert(tree); \
+        free(tree->_losers); \
+        free(tree->_heads); \
+        free(tree->_active); \
+        free(tree->_sources); \
+    } \
+    \
+    \
+    /*******************************************************
+     * Returns the number of bytes used by the tree,
+     * not counting memory owned by the sources themselves
+     *******************************************************/ \
+    static size_t LOSER_TREE_NAME##_memory_usage(const LOSER_TREE_NAME* tree) \
+    { \
+        assert(tree); \
+        size_t per_source = sizeof(size_t) + sizeof(LOSER_TREE_VAL_TYPE) + sizeof(bool) + sizeof(LOSER_TREE_NAME##Source); \
+        return sizeof(LOSER_TREE_NAME) + tree->k * per_source; \
+    }
+
+#endif
@@ -6,6 +6,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "trace.h"
+
 /*****************************************************************************
 * Generates functions for a new Queue datastructure
 *
@@ -44,6 +46,7 @@
      **************************************/ \
     static void _##QUEUE_NAME##_resize(QUEUE_NAME* q, size_t new_capacity) \
     { \
+        _TRACE(uint64_t _trace_start = _trace_now_ns();) \
         QUEUE_VAL_TYPE* old_arr = q->_arr; \
         size_t old_cap = q->_capacity; \
         q->_capacity = new_capacity; \
@@ -62,6 +65,7 @@
         q->_tail = q->size; \
         \
         free(old_arr); \
+        _TRACE(_TRACE_EMIT(TRACE_QUEUE_RESIZE, queue_resize, #QUEUE_NAME, q, old_cap, new_capacity, _trace_start);) \
     } \
     \
     \
@@ -91,6 +95,17 @@
         if (q->size < q->_capacity / 4. && q->size > 16) \
             _##QUEUE_NAME##_resize(q, q->_capacity / 2); \
         return ret; \
+    } \
+    \
+    \
+    /*******************************************************************
+    * Returns the number of bytes used by the queue, including the
+    * owner struct and unused capacity of the underlying ring buffer
+    ********************************************************************/ \
+    static size_t QUEUE_NAME##_memory_usage(const QUEUE_NAME* q) \
+    { \
+        assert(q); \
+        return sizeof(QUEUE_NAME) + q->_capacity * sizeof(QUEUE_VAL_TYPE); \
     }
 
 #endif
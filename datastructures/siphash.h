@@ -176,4 +176,174 @@ static int _siphash_source_code(const void *in, const size_t inlen, const void *
     return 0;
 }
 
+
+/***********************************************************************************************
+ * Batched SipHash, not part of the reference implementation
+ *
+ * Hashes _SIPHASH_BATCH_LANES messages at once, giving the same 8 byte outputs as
+ * _siphash_source_code. The compression rounds of the messages are independent, so they
+ * are run side by side in the lanes of AVX2 registers when compiled with -mavx2.
+ * Otherwise the lanes are interleaved in scalar code, which still lets the CPU
+ * execute the serial add-rotate-xor chains of several messages in parallel.
+ *
+ * Every lane runs as many blocks as the longest message, lanes that are done keep their
+ * state through masking, so the batches are most efficient for messages of similar length
+ ***********************************************************************************************/
+
+#define _SIPHASH_BATCH_LANES 4
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+#ifdef __AVX512VL__
+#define _SIPHASH_ROTL_AVX2(x, b) _mm256_rol_epi64((x), (b))
+#else
+#define _SIPHASH_ROTL_AVX2(x, b) _mm256_or_si256(_mm256_slli_epi64((x), (b)), _mm256_srli_epi64((x), 64 - (b)))
+#endif
+#define _SIPHASH_ROTL32_AVX2(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+
+#define _SIPHASH_SIPROUND_AVX2                                                  \
+    do {                                                                       \
+        v0 = _mm256_add_epi64(v0, v1);                                         \
+        v1 = _SIPHASH_ROTL_AVX2(v1, 13);                                       \
+        v1 = _mm256_xor_si256(v1, v0);                                         \
+        v0 = _SIPHASH_ROTL32_AVX2(v0);                                         \
+        v2 = _mm256_add_epi64(v2, v3);                                         \
+        v3 = _SIPHASH_ROTL_AVX2(v3, 16);                                       \
+        v3 = _mm256_xor_si256(v3, v2);                                         \
+        v0 = _mm256_add_epi64(v0, v3);                                         \
+        v3 = _SIPHASH_ROTL_AVX2(v3, 21);                                       \
+        v3 = _mm256_xor_si256(v3, v0);                                         \
+        v2 = _mm256_add_epi64(v2, v1);                                         \
+        v1 = _SIPHASH_ROTL_AVX2(v1, 17);                                       \
+        v1 = _mm256_xor_si256(v1, v2);                                         \
+        v2 = _SIPHASH_ROTL32_AVX2(v2);                                         \
+    } while (0)
+#endif
+
+/* 
+    Returns the last message word of a message with inlen bytes,
+    holding the remaining bytes and the length
+*/
+static inline uint64_t _siphash_last_word(const unsigned char *in, size_t inlen) {
+    const unsigned char *ni = in + (inlen - (inlen & 7));
+    uint64_t b = ((uint64_t)inlen) << 56;
+    switch (inlen & 7) {
+    case 7:
+        b |= ((uint64_t)ni[6]) << 48;
+        /* FALLTHRU */
+    case 6:
+        b |= ((uint64_t)ni[5]) << 40;
+        /* FALLTHRU */
+    case 5:
+        b |= ((uint64_t)ni[4]) << 32;
+        /* FALLTHRU */
+    case 4:
+        b |= ((uint64_t)ni[3]) << 24;
+        /* FALLTHRU */
+    case 3:
+        b |= ((uint64_t)ni[2]) << 16;
+        /* FALLTHRU */
+    case 2:
+        b |= ((uint64_t)ni[1]) << 8;
+        /* FALLTHRU */
+    case 1:
+        b |= ((uint64_t)ni[0]);
+        break;
+    case 0:
+        break;
+    }
+    return b;
+}
+
+/*
+    Computes _SIPHASH_BATCH_LANES 8 byte SipHash values
+    in[]: pointers to the input messages
+    inlen[]: lengths of the messages in bytes
+    *k: pointer to the key data (read-only), must be 16 bytes
+    out[]: the hashes, as returned by _SIPHASH_U8TO64_LE on the output of _siphash_source_code
+*/
+static void _siphash_batch_source_code(const void *const in[_SIPHASH_BATCH_LANES],
+            const size_t inlen[_SIPHASH_BATCH_LANES], const void *k, uint64_t out[_SIPHASH_BATCH_LANES]) {
+
+    const unsigned char *kk = (const unsigned char *)k;
+    uint64_t k0 = _SIPHASH_U8TO64_LE(kk);
+    uint64_t k1 = _SIPHASH_U8TO64_LE(kk + 8);
+    const unsigned char *const *ni = (const unsigned char *const *)in;
+    size_t n_blocks[_SIPHASH_BATCH_LANES];
+    uint64_t last[_SIPHASH_BATCH_LANES];
+    size_t max_blocks = 0;
+    for (int l = 0; l < _SIPHASH_BATCH_LANES; l++) {
+        n_blocks[l] = inlen[l] / 8;
+        last[l] = _siphash_last_word(ni[l], inlen[l]);
+        max_blocks = n_blocks[l] > max_blocks ? n_blocks[l] : max_blocks;
+    }
+
+#ifdef __AVX2__
+    __m256i v0 = _mm256_set1_epi64x((long long)(UINT64_C(0x736f6d6570736575) ^ k0));
+    __m256i v1 = _mm256_set1_epi64x((long long)(UINT64_C(0x646f72616e646f6d) ^ k1));
+    __m256i v2 = _mm256_set1_epi64x((long long)(UINT64_C(0x6c7967656e657261) ^ k0));
+    __m256i v3 = _mm256_set1_epi64x((long long)(UINT64_C(0x7465646279746573) ^ k1));
+
+    __m256i blocks_end = _mm256_set_epi64x((long long)n_blocks[3] + 1, (long long)n_blocks[2] + 1,
+                                           (long long)n_blocks[1] + 1, (long long)n_blocks[0] + 1);
+    for (size_t blk = 0; blk <= max_blocks; blk++) {
+#define _SIPHASH_BATCH_WORD(l) \
+        (long long)(blk < n_blocks[l] ? _SIPHASH_U8TO64_LE(ni[l] + 8 * blk) : blk == n_blocks[l] ? last[l] : 0)
+        __m256i m = _mm256_set_epi64x(_SIPHASH_BATCH_WORD(3), _SIPHASH_BATCH_WORD(2), _SIPHASH_BATCH_WORD(1), _SIPHASH_BATCH_WORD(0));
+#undef _SIPHASH_BATCH_WORD
+        /* lanes where blk <= n_blocks are still compressing */
+        __m256i active = _mm256_cmpgt_epi64(blocks_end, _mm256_set1_epi64x((long long)blk));
+        __m256i o0 = v0, o1 = v1, o2 = v2, o3 = v3;
+
+        v3 = _mm256_xor_si256(v3, m);
+        for (int i = 0; i < _SIPHASH_cROUNDS; ++i)
+            _SIPHASH_SIPROUND_AVX2;
+        v0 = _mm256_xor_si256(v0, m);
+
+        v0 = _mm256_blendv_epi8(o0, v0, active);
+        v1 = _mm256_blendv_epi8(o1, v1, active);
+        v2 = _mm256_blendv_epi8(o2, v2, active);
+        v3 = _mm256_blendv_epi8(o3, v3, active);
+    }
+
+    v2 = _mm256_xor_si256(v2, _mm256_set1_epi64x(0xff));
+    for (int i = 0; i < _SIPHASH_dROUNDS; ++i)
+        _SIPHASH_SIPROUND_AVX2;
+
+    __m256i b = _mm256_xor_si256(_mm256_xor_si256(v0, v1), _mm256_xor_si256(v2, v3));
+    _mm256_storeu_si256((__m256i *)out, b);
+#else
+    uint64_t s0[_SIPHASH_BATCH_LANES], s1[_SIPHASH_BATCH_LANES], s2[_SIPHASH_BATCH_LANES], s3[_SIPHASH_BATCH_LANES];
+    for (int l = 0; l < _SIPHASH_BATCH_LANES; l++) {
+        s0[l] = UINT64_C(0x736f6d6570736575) ^ k0;
+        s1[l] = UINT64_C(0x646f72616e646f6d) ^ k1;
+        s2[l] = UINT64_C(0x6c7967656e657261) ^ k0;
+        s3[l] = UINT64_C(0x7465646279746573) ^ k1;
+    }
+
+    for (size_t blk = 0; blk <= max_blocks; blk++) {
+        for (int l = 0; l < _SIPHASH_BATCH_LANES; l++) {
+            if (blk > n_blocks[l])
+                continue;
+            uint64_t m = blk < n_blocks[l] ? _SIPHASH_U8TO64_LE(ni[l] + 8 * blk) : last[l];
+            uint64_t v0 = s0[l], v1 = s1[l], v2 = s2[l], v3 = s3[l] ^ m;
+            for (int i = 0; i < _SIPHASH_cROUNDS; ++i)
+                _SIPHASH_SIPROUND;
+            s0[l] = v0 ^ m;
+            s1[l] = v1;
+            s2[l] = v2;
+            s3[l] = v3;
+        }
+    }
+
+    for (int l = 0; l < _SIPHASH_BATCH_LANES; l++) {
+        uint64_t v0 = s0[l], v1 = s1[l], v2 = s2[l] ^ 0xff, v3 = s3[l];
+        for (int i = 0; i < _SIPHASH_dROUNDS; ++i)
+            _SIPHASH_SIPROUND;
+        out[l] = v0 ^ v1 ^ v2 ^ v3;
+    }
+#endif
+}
+
 #endif
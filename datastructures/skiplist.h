@@ -0,0 +1,829 @@
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+/***************************************************************************************
+ * Concurrent ordered map, a lazy skiplist, see Herlihy et al., "A simple optimistic
+ * skiplist algorithm", 2007
+ *
+ * Any number of threads may search, insert, remove and iterate at the same time.
+ * Searches and iterators take no locks. Insertions and removals lock only the nodes
+ * next to the key they change, so writers to different parts of the map do not wait
+ * for each other, unlike a TreeMap behind a single mutex. Every node is locked with a
+ * spinlock, which yields the thread after a while, so the map stays usable when there
+ * are more threads than cores.
+ *
+ * Removed nodes may still be read by concurrent searches, so they are freed with
+ * epoch-based reclamation, see Fraser, "Practical lock-freedom", 2004. Every thread
+ * publishes the global epoch while it uses a map, and a removed node is freed by a
+ * later removal once the epoch has advanced twice since, as no thread can still
+ * read it then. A thread holds pointers to entries and iterators safely only while
+ * it is pinned, between skiplist_pin and skiplist_unpin, which every function
+ * does by itself for its own duration. A value that is written by one thread
+ * while another reads it must be written atomically, or read with get, which
+ * holds the lock of the node.
+ *
+ * Iterators see every entry that is in the map during the whole iteration, and any
+ * subset of the entries that are inserted or removed meanwhile.
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "treemap.h"
+
+// levels of the skiplist, every level holds a quarter of the nodes of the level below
+#ifndef _SKIPLIST_MAX_LEVEL
+#define _SKIPLIST_MAX_LEVEL 20
+#endif
+
+// attempts to take a lock before the thread yields
+#define _SKIPLIST_SPINS 64
+
+// threads that can use SkipLists at the same time, must be the same in every translation unit
+#ifndef _SKIPLIST_MAX_THREADS
+#define _SKIPLIST_MAX_THREADS 256
+#endif
+
+// removed nodes of a map after which a removal tries to free them, and again after as many more
+#ifndef _SKIPLIST_RECLAIM_THRESHOLD
+#define _SKIPLIST_RECLAIM_THRESHOLD 128
+#endif
+
+/*****************************************************************
+ * Epoch of a thread, on its own cache line
+ *****************************************************************/
+typedef struct
+{
+    _Alignas(64) atomic_uint_fast64_t epoch;   // global epoch when the thread pinned, 0 if it is not pinned
+    atomic_bool in_use;
+} _SkipListThread;
+
+/*
+ * Shared by all SkipLists of the program. A map used from several translation units
+ * must see the same epochs in all of them, or one could free nodes another still
+ * reads, so these are weak definitions, which the linker merges into one
+ */
+__attribute__((weak)) atomic_uint_fast64_t _skiplist_epoch = 1;
+__attribute__((weak)) _SkipListThread _skiplist_threads[_SKIPLIST_MAX_THREADS];
+__attribute__((weak)) atomic_size_t _skiplist_n_threads;      // slots ever claimed
+__attribute__((weak)) pthread_key_t _skiplist_thread_key;
+__attribute__((weak)) pthread_once_t _skiplist_thread_key_once = PTHREAD_ONCE_INIT;
+__attribute__((weak)) _Thread_local _SkipListThread* _skiplist_self;
+__attribute__((weak)) _Thread_local unsigned _skiplist_pin_depth;
+
+/*****************************************************************
+ * Do not use this function
+ *****************************************************************/
+static inline void _skiplist_lock(atomic_flag* lock)
+{
+    for (unsigned spins = 0; atomic_flag_test_and_set_explicit(lock, memory_order_acquire); spins++)
+        if (spins >= _SKIPLIST_SPINS)
+            sched_yield();
+}
+
+/*****************************************************************
+ * Do not use this function
+ *****************************************************************/
+static inline void _skiplist_unlock(atomic_flag* lock)
+{
+    atomic_flag_clear_explicit(lock, memory_order_release);
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Frees the slot of an exiting thread
+ *****************************************************************/
+static void _skiplist_release_thread(void* slot)
+{
+    atomic_store(&((_SkipListThread*) slot)->epoch, 0);
+    atomic_store(&((_SkipListThread*) slot)->in_use, false);
+}
+
+/*****************************************************************
+ * Do not use this function
+ *****************************************************************/
+static void _skiplist_create_thread_key()
+{
+    if (pthread_key_create(&_skiplist_thread_key, _skiplist_release_thread) != 0) {
+        fprintf(stderr, "skiplist: could not create a thread key\n");
+        abort();
+    }
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Claims a slot for the calling thread, given back when it exits.
+ * Aborts if more than _SKIPLIST_MAX_THREADS threads hold one
+ *****************************************************************/
+static void _skiplist_register_thread()
+{
+    pthread_once(&_skiplist_thread_key_once, _skiplist_create_thread_key);
+    size_t i = 0;
+    while (i < _SKIPLIST_MAX_THREADS && atomic_exchange(&_skiplist_threads[i].in_use, true))
+        i++;
+    if (i == _SKIPLIST_MAX_THREADS) {
+        fprintf(stderr, "skiplist: more than _SKIPLIST_MAX_THREADS (%d) threads use SkipLists\n", _SKIPLIST_MAX_THREADS);
+        abort();
+    }
+    _skiplist_self = _skiplist_threads + i;
+    size_t n = atomic_load(&_skiplist_n_threads);
+    while (n <= i && !atomic_compare_exchange_weak(&_skiplist_n_threads, &n, i + 1));
+    pthread_setspecific(_skiplist_thread_key, _skiplist_self);
+}
+
+/*****************************************************************
+ * Pins the calling thread, so that no entry it can reach is freed
+ * until it calls skiplist_unpin. Calls may be nested, only the
+ * outermost pair matters. Threads should not stay pinned for long,
+ * no removed node of any SkipList is freed meanwhile
+ *****************************************************************/
+static inline void skiplist_pin()
+{
+    if (_skiplist_pin_depth++ > 0)
+        return;
+    if (!_skiplist_self)
+        _skiplist_register_thread();
+    atomic_store(&_skiplist_self->epoch, atomic_load(&_skiplist_epoch));
+}
+
+static inline void skiplist_unpin()
+{
+    assert(_skiplist_pin_depth > 0);
+    if (--_skiplist_pin_depth == 0)
+        atomic_store_explicit(&_skiplist_self->epoch, 0, memory_order_release);
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Advances the global epoch, unless a thread is pinned in an
+ * older one. Nodes removed in epoch e are freed from epoch e + 2
+ *
+ * @returns the global epoch
+ *****************************************************************/
+static uint_fast64_t _skiplist_try_advance()
+{
+    uint_fast64_t epoch = atomic_load(&_skiplist_epoch);
+    size_t n = atomic_load(&_skiplist_n_threads);
+    for (size_t i = 0; i < n; i++) {
+        uint_fast64_t pinned = atomic_load(&_skiplist_threads[i].epoch);
+        if (pinned != 0 && pinned != epoch)
+            return epoch;
+    }
+    if (atomic_compare_exchange_strong(&_skiplist_epoch, &epoch, epoch + 1))
+        return epoch + 1;
+    return epoch;
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Number of levels of a new node, 1 with probability 3/4, 2 with
+ * probability 3/16, and so on
+ *****************************************************************/
+static inline int _skiplist_random_level()
+{
+    static _Thread_local uint64_t state = 0;
+    if (state == 0)
+        state = (uint64_t) (uintptr_t) &state | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    uint64_t bits = state | (UINT64_C(1) << (2 * (_SKIPLIST_MAX_LEVEL - 1)));
+    return 1 + __builtin_ctzll(bits) / 2;
+}
+
+
+/***************************************************************************************
+ * Creates a new SkipList type
+ *
+ * @param SKIPLIST_NAME name of the map struct and prefix of every function
+ * @param SKIPLIST_KEY_TYPE type of keys, stored in place
+ * @param SKIPLIST_VAL_TYPE type of values, stored in place, pass TREEMAP_NO_VALUE for a set
+ * @param SKIPLIST_KEY_CMP function or macro comparing two const SKIPLIST_KEY_TYPE*,
+ *    as for TREEMAP_DEFINE
+ ***************************************************************************************/
+#define SKIPLIST_DEFINE(SKIPLIST_NAME, SKIPLIST_KEY_TYPE, SKIPLIST_VAL_TYPE, SKIPLIST_KEY_CMP) \
+    typedef struct \
+    { \
+        SKIPLIST_KEY_TYPE key; \
+        SKIPLIST_VAL_TYPE value; \
+    } SKIPLIST_NAME##Entry; \
+    \
+    typedef struct _##SKIPLIST_NAME##Node _##SKIPLIST_NAME##Node; \
+    \
+    struct _##SKIPLIST_NAME##Node \
+    { \
+        SKIPLIST_NAME##Entry entry; \
+        atomic_flag lock; \
+        atomic_bool marked;                 /* removed, or being removed */ \
+        atomic_bool fully_linked;           /* linked in on all its levels */ \
+        int n_levels; \
+        uint_fast64_t retired_epoch; \
+        _##SKIPLIST_NAME##Node* retired_next; \
+        _Atomic(_##SKIPLIST_NAME##Node*) next[]; \
+    }; \
+    \
+    typedef struct \
+    { \
+        _##SKIPLIST_NAME##Node* _head;      /* sentinel before every key, on all levels */ \
+        _Atomic(_##SKIPLIST_NAME##Node*) _retired; \
+        atomic_size_t _n_retired; \
+        atomic_flag _reclaiming; \
+        atomic_size_t size; \
+    } SKIPLIST_NAME; \
+    \
+    typedef struct \
+    { \
+        SKIPLIST_NAME##Entry* current; \
+        _##SKIPLIST_NAME##Node* _node; \
+        SKIPLIST_NAME* _map; \
+    } SKIPLIST_NAME##Iter; \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *****************************************************************/ \
+    static _##SKIPLIST_NAME##Node* _##SKIPLIST_NAME##_new_node(int n_levels) \
+    { \
+        _##SKIPLIST_NAME##Node* node = calloc(1, sizeof(_##SKIPLIST_NAME##Node) + n_levels * sizeof(node->next[0])); \
+        assert(node); \
+        atomic_flag_clear(&node->lock); \
+        atomic_init(&node->marked, false); \
+        atomic_init(&node->fully_linked, false); \
+        node->n_levels = n_levels; \
+        for (int level = 0; level < n_levels; level++) \
+            atomic_init(&node->next[level], NULL); \
+        return node; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Initializes a new empty SkipList. This is not thread safe
+     *****************************************************************/ \
+    static SKIPLIST_NAME SKIPLIST_NAME##_new() \
+    { \
+        SKIPLIST_NAME ret; \
+        ret._head = _##SKIPLIST_NAME##_new_node(_SKIPLIST_MAX_LEVEL); \
+        atomic_init(&ret._head->fully_linked, true); \
+        atomic_init(&ret._retired, NULL); \
+        atomic_init(&ret._n_retired, 0); \
+        atomic_flag_clear(&ret._reclaiming); \
+        atomic_init(&ret.size, 0); \
+        return ret; \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Do not use this function
+     *
+     * Finds the last node with a smaller key, and the node after it, on every
+     * level. The first node after is NULL if every key is smaller
+     *
+     * @returns the highest level on which the key was found, or -1
+     *******************************************************************************/ \
+    static int _##SKIPLIST_NAME##_find(const SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key, \
+                                       _##SKIPLIST_NAME##Node** preds, _##SKIPLIST_NAME##Node** succs) \
+    { \
+        int found = -1; \
+        _##SKIPLIST_NAME##Node* pred = map->_head; \
+        for (int level = _SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) { \
+            _##SKIPLIST_NAME##Node* curr = atomic_load_explicit(&pred->next[level], memory_order_acquire); \
+            int cmp_res = 1; \
+            while (curr && (cmp_res = SKIPLIST_KEY_CMP((const SKIPLIST_KEY_TYPE*) &curr->entry.key, key)) < 0) { \
+                pred = curr; \
+                curr = atomic_load_explicit(&pred->next[level], memory_order_acquire); \
+            } \
+            if (found == -1 && curr && cmp_res == 0) \
+                found = level; \
+            preds[level] = pred; \
+            succs[level] = curr; \
+        } \
+        return found; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Unlocks the distinct predecessors locked on levels 0 to highest
+     *****************************************************************/ \
+    static void _##SKIPLIST_NAME##_unlock_preds(_##SKIPLIST_NAME##Node** preds, int highest) \
+    { \
+        _##SKIPLIST_NAME##Node* prev = NULL; \
+        for (int level = 0; level <= highest; level++) { \
+            if (preds[level] != prev) \
+                _skiplist_unlock(&preds[level]->lock); \
+            prev = preds[level]; \
+        } \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Do not use this function
+     *
+     * Inserts a key unless it is in the map, with value, or a zeroed value
+     * if it is NULL, set before the node is linked in
+     *
+     * @returns the node of the key, and whether it was inserted in is_new
+     *******************************************************************************/ \
+    static _##SKIPLIST_NAME##Node* _##SKIPLIST_NAME##_add(SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key, \
+                                                         const SKIPLIST_VAL_TYPE* value, bool* is_new) \
+    { \
+        _##SKIPLIST_NAME##Node* preds[_SKIPLIST_MAX_LEVEL]; \
+        _##SKIPLIST_NAME##Node* succs[_SKIPLIST_MAX_LEVEL]; \
+        int n_levels = _skiplist_random_level(); \
+        for (;;) { \
+            int found = _##SKIPLIST_NAME##_find(map, key, preds, succs); \
+            if (found != -1) { \
+                _##SKIPLIST_NAME##Node* node = succs[found]; \
+                if (!atomic_load_explicit(&node->marked, memory_order_acquire)) { \
+                    /* another thread may still be linking it in */ \
+                    while (!atomic_load_explicit(&node->fully_linked, memory_order_acquire)) \
+                        sched_yield(); \
+                    *is_new = false; \
+                    return node; \
+                } \
+                continue; \
+            } \
+            /* lock the predecessors from the bottom up, and check that nothing changed since find */ \
+            int highest = -1; \
+            bool valid = true; \
+            _##SKIPLIST_NAME##Node* prev = NULL; \
+            for (int level = 0; valid && level < n_levels; level++) { \
+                _##SKIPLIST_NAME##Node* pred = preds[level]; \
+                _##SKIPLIST_NAME##Node* succ = succs[level]; \
+                if (pred != prev) \
+                    _skiplist_lock(&pred->lock); \
+                highest = level; \
+                prev = pred; \
+                valid = !atomic_load_explicit(&pred->marked, memory_order_acquire) \
+                     && (!succ || !atomic_load_explicit(&succ->marked, memory_order_acquire)) \
+                     && atomic_load_explicit(&pred->next[level], memory_order_acquire) == succ; \
+            } \
+            if (!valid) { \
+                _##SKIPLIST_NAME##_unlock_preds(preds, highest); \
+                continue; \
+            } \
+            _##SKIPLIST_NAME##Node* node = _##SKIPLIST_NAME##_new_node(n_levels); \
+            node->entry.key = *key; \
+            if (value) \
+                node->entry.value = *value; \
+            for (int level = 0; level < n_levels; level++) \
+                atomic_store_explicit(&node->next[level], succs[level], memory_order_relaxed); \
+            for (int level = 0; level < n_levels; level++) \
+                atomic_store_explicit(&preds[level]->next[level], node, memory_order_release); \
+            atomic_store_explicit(&node->fully_linked, true, memory_order_release); \
+            _##SKIPLIST_NAME##_unlock_preds(preds, highest); \
+            atomic_fetch_add_explicit(&map->size, 1, memory_order_relaxed); \
+            *is_new = true; \
+            return node; \
+        } \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Finds the entry of a key
+     *
+     * @param insert whether to insert the key if it is not found, its value
+     *    is then zeroed. If several threads insert the same key at once, they
+     *    all get the same entry
+     * @returns the entry, or NULL if it was not found and insert is false.
+     *    If other threads may remove it, it may only be used while the
+     *    calling thread is pinned, see skiplist_pin
+     *******************************************************************************/ \
+    static SKIPLIST_NAME##Entry* SKIPLIST_NAME##_search(SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key, bool insert) \
+    { \
+        assert(map); \
+        assert(key); \
+        skiplist_pin(); \
+        SKIPLIST_NAME##Entry* entry = NULL; \
+        if (insert) { \
+            bool is_new; \
+            entry = &_##SKIPLIST_NAME##_add(map, key, NULL, &is_new)->entry; \
+        } else { \
+            _##SKIPLIST_NAME##Node* preds[_SKIPLIST_MAX_LEVEL]; \
+            _##SKIPLIST_NAME##Node* succs[_SKIPLIST_MAX_LEVEL]; \
+            int found = _##SKIPLIST_NAME##_find(map, key, preds, succs); \
+            if (found != -1 && atomic_load_explicit(&succs[found]->fully_linked, memory_order_acquire) \
+                            && !atomic_load_explicit(&succs[found]->marked, memory_order_acquire)) \
+                entry = &succs[found]->entry; \
+        } \
+        skiplist_unpin(); \
+        return entry; \
+    } \
+    \
+    \
+    static bool SKIPLIST_NAME##_contains(const SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key) \
+    { \
+        return SKIPLIST_NAME##_search((SKIPLIST_NAME*) map, key, false) != NULL; \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Assigns a value to a key, under the lock of its node
+     *
+     * @returns true if the key was not in the map before
+     *******************************************************************************/ \
+    static bool SKIPLIST_NAME##_insert(SKIPLIST_NAME* map, SKIPLIST_KEY_TYPE key, SKIPLIST_VAL_TYPE value) \
+    { \
+        assert(map); \
+        skiplist_pin(); \
+        bool is_new; \
+        _##SKIPLIST_NAME##Node* node = _##SKIPLIST_NAME##_add(map, (const SKIPLIST_KEY_TYPE*) &key, \
+                                                              (const SKIPLIST_VAL_TYPE*) &value, &is_new); \
+        if (!is_new) { \
+            _skiplist_lock(&node->lock); \
+            node->entry.value = value; \
+            _skiplist_unlock(&node->lock); \
+        } \
+        skiplist_unpin(); \
+        return is_new; \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Copies the value of a key to out, under the lock of its node, so it is
+     * not torn by a concurrent insert
+     *
+     * @returns false if the key is not in the map
+     *******************************************************************************/ \
+    static bool SKIPLIST_NAME##_get(const SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key, SKIPLIST_VAL_TYPE* out) \
+    { \
+        assert(out); \
+        skiplist_pin(); \
+        SKIPLIST_NAME##Entry* entry = SKIPLIST_NAME##_search((SKIPLIST_NAME*) map, key, false); \
+        if (entry) { \
+            _##SKIPLIST_NAME##Node* node = (_##SKIPLIST_NAME##Node*) entry; \
+            _skiplist_lock(&node->lock); \
+            *out = entry->value; \
+            _skiplist_unlock(&node->lock); \
+        } \
+        skiplist_unpin(); \
+        return entry != NULL; \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Do not use this function
+     *
+     * Frees the removed nodes that no thread can read anymore, unless another
+     * thread is already doing so. Nodes that are still needed are kept
+     *
+     * @returns the number of nodes freed
+     *******************************************************************************/ \
+    static size_t _##SKIPLIST_NAME##_collect(SKIPLIST_NAME* map) \
+    { \
+        if (atomic_flag_test_and_set_explicit(&map->_reclaiming, memory_order_acquire)) \
+            return 0; \
+        uint_fast64_t epoch = _skiplist_try_advance(); \
+        _##SKIPLIST_NAME##Node* node = atomic_exchange(&map->_retired, NULL); \
+        _##SKIPLIST_NAME##Node* kept = NULL; \
+        _##SKIPLIST_NAME##Node* kept_last = NULL; \
+        size_t n = 0; \
+        while (node) { \
+            _##SKIPLIST_NAME##Node* next = node->retired_next; \
+            if (node->retired_epoch + 2 <= epoch) { \
+                free(node); \
+                n++; \
+            } else { \
+                node->retired_next = kept; \
+                kept = node; \
+                kept_last = kept_last ? kept_last : node; \
+            } \
+            node = next; \
+        } \
+        if (kept) { \
+            kept_last->retired_next = atomic_load_explicit(&map->_retired, memory_order_relaxed); \
+            while (!atomic_compare_exchange_weak_explicit(&map->_retired, &kept_last->retired_next, kept, \
+                                                          memory_order_release, memory_order_relaxed)); \
+        } \
+        atomic_fetch_sub_explicit(&map->_n_retired, n, memory_order_relaxed); \
+        atomic_flag_clear_explicit(&map->_reclaiming, memory_order_release); \
+        return n; \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Do not use this function
+     *
+     * Unlinks the node of a key, if there is one, the calling thread must be pinned
+     *
+     * @returns the node, or NULL if the key was not removed by this call
+     *******************************************************************************/ \
+    static _##SKIPLIST_NAME##Node* _##SKIPLIST_NAME##_unlink(SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key) \
+    { \
+        _##SKIPLIST_NAME##Node* preds[_SKIPLIST_MAX_LEVEL]; \
+        _##SKIPLIST_NAME##Node* succs[_SKIPLIST_MAX_LEVEL]; \
+        _##SKIPLIST_NAME##Node* victim = NULL; \
+        for (;;) { \
+            int found = _##SKIPLIST_NAME##_find(map, key, preds, succs); \
+            if (!victim) { \
+                /* only a node linked in on all its levels, not removed by another thread, can be removed */ \
+                if (found == -1) \
+                    return NULL; \
+                _##SKIPLIST_NAME##Node* node = succs[found]; \
+                if (!atomic_load_explicit(&node->fully_linked, memory_order_acquire) || node->n_levels - 1 != found \
+                    || atomic_load_explicit(&node->marked, memory_order_acquire)) \
+                    return NULL; \
+                _skiplist_lock(&node->lock); \
+                if (atomic_load_explicit(&node->marked, memory_order_acquire)) { \
+                    _skiplist_unlock(&node->lock); \
+                    return NULL; \
+                } \
+                atomic_store_explicit(&node->marked, true, memory_order_release); \
+                victim = node; \
+            } \
+            int highest = -1; \
+            bool valid = true; \
+            _##SKIPLIST_NAME##Node* prev = NULL; \
+            for (int level = 0; valid && level < victim->n_levels; level++) { \
+                _##SKIPLIST_NAME##Node* pred = preds[level]; \
+                if (pred != prev) \
+                    _skiplist_lock(&pred->lock); \
+                highest = level; \
+                prev = pred; \
+                valid = !atomic_load_explicit(&pred->marked, memory_order_acquire) \
+                     && atomic_load_explicit(&pred->next[level], memory_order_acquire) == victim; \
+            } \
+            if (!valid) { \
+                _##SKIPLIST_NAME##_unlock_preds(preds, highest); \
+                continue; \
+            } \
+            for (int level = victim->n_levels - 1; level >= 0; level--) \
+                atomic_store_explicit(&preds[level]->next[level], \
+                                      atomic_load_explicit(&victim->next[level], memory_order_acquire), memory_order_release); \
+            _skiplist_unlock(&victim->lock); \
+            _##SKIPLIST_NAME##_unlock_preds(preds, highest); \
+            atomic_fetch_sub_explicit(&map->size, 1, memory_order_relaxed); \
+            return victim; \
+        } \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Removes the entry of a key, if there is one. Its node is freed by a later
+     * removal, once no thread can still be reading it
+     *
+     * @returns true if the key was removed by this call
+     *******************************************************************************/ \
+    static bool SKIPLIST_NAME##_remove(SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        skiplist_pin(); \
+        _##SKIPLIST_NAME##Node* victim = _##SKIPLIST_NAME##_unlink(map, key); \
+        if (victim) { \
+            victim->retired_epoch = atomic_load(&_skiplist_epoch); \
+            victim->retired_next = atomic_load_explicit(&map->_retired, memory_order_relaxed); \
+            while (!atomic_compare_exchange_weak_explicit(&map->_retired, &victim->retired_next, victim, \
+                                                          memory_order_release, memory_order_relaxed)); \
+            size_t n_retired = atomic_fetch_add_explicit(&map->_n_retired, 1, memory_order_relaxed) + 1; \
+            if (n_retired % _SKIPLIST_RECLAIM_THRESHOLD == 0) \
+                _##SKIPLIST_NAME##_collect(map); \
+        } \
+        skiplist_unpin(); \
+        return victim != NULL; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * First node from node on that is in the map, or NULL
+     *****************************************************************/ \
+    static _##SKIPLIST_NAME##Node* _##SKIPLIST_NAME##_skip_removed(_##SKIPLIST_NAME##Node* node) \
+    { \
+        while (node && (atomic_load_explicit(&node->marked, memory_order_acquire) \
+                        || !atomic_load_explicit(&node->fully_linked, memory_order_acquire))) \
+            node = atomic_load_explicit(&node->next[0], memory_order_acquire); \
+        return node; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Last node in the map with a key smaller than key, or with
+     * any key if key is NULL, or NULL if there is none
+     *****************************************************************/ \
+    static _##SKIPLIST_NAME##Node* _##SKIPLIST_NAME##_last_below(const SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key) \
+    { \
+        for (;;) { \
+            _##SKIPLIST_NAME##Node* pred = map->_head; \
+            for (int level = _SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) { \
+                _##SKIPLIST_NAME##Node* curr = atomic_load_explicit(&pred->next[level], memory_order_acquire); \
+                while (curr && (!key || SKIPLIST_KEY_CMP((const SKIPLIST_KEY_TYPE*) &curr->entry.key, key) < 0)) { \
+                    pred = curr; \
+                    curr = atomic_load_explicit(&pred->next[level], memory_order_acquire); \
+                } \
+            } \
+            if (pred == map->_head) \
+                return NULL; \
+            if (!atomic_load_explicit(&pred->marked, memory_order_acquire) \
+                && atomic_load_explicit(&pred->fully_linked, memory_order_acquire)) \
+                return pred; \
+            /* removed meanwhile, or not linked in yet, search below its key */ \
+            key = (const SKIPLIST_KEY_TYPE*) &pred->entry.key; \
+        } \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *****************************************************************/ \
+    static SKIPLIST_NAME##Iter _##SKIPLIST_NAME##_iter_at(const SKIPLIST_NAME* map, _##SKIPLIST_NAME##Node* node) \
+    { \
+        SKIPLIST_NAME##Iter ret; \
+        ret._node = node; \
+        ret.current = node ? &node->entry : NULL; \
+        ret._map = (SKIPLIST_NAME*) map; \
+        return ret; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Returns an iterator starting at key, current is NULL if the
+     * key is not found
+     *****************************************************************/ \
+    static SKIPLIST_NAME##Iter SKIPLIST_NAME##_iter(const SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key) \
+    { \
+        return _##SKIPLIST_NAME##_iter_at(map, (_##SKIPLIST_NAME##Node*) SKIPLIST_NAME##_search((SKIPLIST_NAME*) map, key, false)); \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns an iterator starting at the minimum element in the map
+     *******************************************************************/ \
+    static SKIPLIST_NAME##Iter SKIPLIST_NAME##_min_iter(const SKIPLIST_NAME* map) \
+    { \
+        assert(map); \
+        skiplist_pin(); \
+        SKIPLIST_NAME##Iter ret = _##SKIPLIST_NAME##_iter_at(map, \
+            _##SKIPLIST_NAME##_skip_removed(atomic_load_explicit(&map->_head->next[0], memory_order_acquire))); \
+        skiplist_unpin(); \
+        return ret; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns an iterator starting at the maximum element in the map
+     *******************************************************************/ \
+    static SKIPLIST_NAME##Iter SKIPLIST_NAME##_max_iter(const SKIPLIST_NAME* map) \
+    { \
+        assert(map); \
+        skiplist_pin(); \
+        SKIPLIST_NAME##Iter ret = _##SKIPLIST_NAME##_iter_at(map, _##SKIPLIST_NAME##_last_below(map, NULL)); \
+        skiplist_unpin(); \
+        return ret; \
+    } \
+    \
+    \
+    /*********************************************
+     * Returns an iterator starting at the
+     * maximum element less than or equal to key
+     *********************************************/ \
+    static SKIPLIST_NAME##Iter SKIPLIST_NAME##_floor_iter(const SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        skiplist_pin(); \
+        SKIPLIST_NAME##Entry* entry = SKIPLIST_NAME##_search((SKIPLIST_NAME*) map, key, false); \
+        SKIPLIST_NAME##Iter ret = _##SKIPLIST_NAME##_iter_at(map, entry ? (_##SKIPLIST_NAME##Node*) entry \
+                                                                        : _##SKIPLIST_NAME##_last_below(map, key)); \
+        skiplist_unpin(); \
+        return ret; \
+    } \
+    \
+    \
+    /************************************************
+     * Returns an iterator starting at the
+     * minimum element greater than or equal to key
+     ************************************************/ \
+    static SKIPLIST_NAME##Iter SKIPLIST_NAME##_ceil_iter(const SKIPLIST_NAME* map, const SKIPLIST_KEY_TYPE* key) \
+    { \
+        assert(map); \
+        assert(key); \
+        _##SKIPLIST_NAME##Node* preds[_SKIPLIST_MAX_LEVEL]; \
+        _##SKIPLIST_NAME##Node* succs[_SKIPLIST_MAX_LEVEL]; \
+        skiplist_pin(); \
+        _##SKIPLIST_NAME##_find(map, key, preds, succs); \
+        SKIPLIST_NAME##Iter ret = _##SKIPLIST_NAME##_iter_at(map, _##SKIPLIST_NAME##_skip_removed(succs[0])); \
+        skiplist_unpin(); \
+        return ret; \
+    } \
+    \
+    \
+    /**************************************************************
+     * sets the field current to be the next element in the map,
+     * if there are no more elements, current is set to NULL
+     **************************************************************/ \
+    static void SKIPLIST_NAME##Iter_inc(SKIPLIST_NAME##Iter* iter) \
+    { \
+        assert(iter); \
+        if (!iter->current) \
+            return; \
+        skiplist_pin(); \
+        *iter = _##SKIPLIST_NAME##_iter_at(iter->_map, \
+            _##SKIPLIST_NAME##_skip_removed(atomic_load_explicit(&iter->_node->next[0], memory_order_acquire))); \
+        skiplist_unpin(); \
+    } \
+    \
+    \
+    /**************************************************************
+     * sets the field current to be the previous element in the map,
+     * if there are no more elements, current is set to NULL.
+     * Nodes only link forward, so this searches from the top
+     **************************************************************/ \
+    static void SKIPLIST_NAME##Iter_dec(SKIPLIST_NAME##Iter* iter) \
+    { \
+        assert(iter); \
+        if (!iter->current) \
+            return; \
+        skiplist_pin(); \
+        *iter = _##SKIPLIST_NAME##_iter_at(iter->_map, \
+            _##SKIPLIST_NAME##_last_below(iter->_map, (const SKIPLIST_KEY_TYPE*) &iter->_node->entry.key)); \
+        skiplist_unpin(); \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Frees the nodes of all removed entries at once, without waiting
+     * for the epoch to advance. This is not thread safe, no other
+     * thread may use the map or its entries meanwhile
+     *
+     * @returns the number of nodes freed
+     *****************************************************************/ \
+    static size_t SKIPLIST_NAME##_reclaim(SKIPLIST_NAME* map) \
+    { \
+        assert(map); \
+        size_t n = 0; \
+        _##SKIPLIST_NAME##Node* node = atomic_exchange(&map->_retired, NULL); \
+        while (node) { \
+            _##SKIPLIST_NAME##Node* next = node->retired_next; \
+            free(node); \
+            node = next; \
+            n++; \
+        } \
+        atomic_fetch_sub(&map->_n_retired, n); \
+        return n; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Number of removed nodes not freed yet. While no thread stays
+     * pinned, it stays below about 2 * _SKIPLIST_RECLAIM_THRESHOLD
+     *****************************************************************/ \
+    static size_t SKIPLIST_NAME##_retired_count(const SKIPLIST_NAME* map) \
+    { \
+        assert(map); \
+        return atomic_load_explicit(&map->_n_retired, memory_order_relaxed); \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Bytes used by the map, including removed nodes not yet
+     * reclaimed. This is not thread safe
+     *****************************************************************/ \
+    static size_t SKIPLIST_NAME##_memory_usage(const SKIPLIST_NAME* map) \
+    { \
+        assert(map); \
+        size_t bytes = sizeof(SKIPLIST_NAME) + sizeof(_##SKIPLIST_NAME##Node) + _SKIPLIST_MAX_LEVEL * sizeof(map->_head->next[0]); \
+        for (_##SKIPLIST_NAME##Node* node = atomic_load(&map->_head->next[0]); node; node = atomic_load(&node->next[0])) \
+            bytes += sizeof(_##SKIPLIST_NAME##Node) + node->n_levels * sizeof(node->next[0]); \
+        for (_##SKIPLIST_NAME##Node* node = atomic_load(&map->_retired); node; node = node->retired_next) \
+            bytes += sizeof(_##SKIPLIST_NAME##Node) + node->n_levels * sizeof(node->next[0]); \
+        return bytes; \
+    } \
+    \
+    \
+    /**************************************************
+    * Deallocates all resources used by this SkipList.
+    * It must not be used after this point, and no
+    * other thread may use it meanwhile
+    ***************************************************/ \
+    static void SKIPLIST_NAME##_free(SKIPLIST_NAME* map) \
+    { \
+        assert(map); \
+        SKIPLIST_NAME##_reclaim(map); \
+        _##SKIPLIST_NAME##Node* node = map->_head; \
+        while (node) { \
+            _##SKIPLIST_NAME##Node* next = atomic_load(&node->next[0]); \
+            free(node); \
+            node = next; \
+        } \
+        map->_head = NULL; \
+        atomic_store(&map->size, 0); \
+    }
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef SMALLVEC_H
+#define SMALLVEC_H
+
+#include <stdlib.h>
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/*****************************************************************************************
+* Generates functions for a Vec with small buffer optimization
+*
+* The first SMALLVEC_N elements are stored inline in the owner struct itself,
+* so no heap allocation is done until the Vec grows past that size.
+* When the heap is used, the Vec behaves exactly like a Vec from vec.h
+*
+* Since the elements may live inside the struct, there is no `arr` field,
+* elements must instead be accessed through the pointer returned by `SMALLVEC_NAME##_data`
+* This pointer is invalidated by push, pop, insert, remove, clear and by moving the struct itself
+*
+* Unlike Vec, it can insert and remove elements in the middle, which takes linear
+* time, but is cheap for the few elements a SmallVec usually holds
+*
+* @param SMALLVEC_NAME name of owner struct and prefix of each function defined
+* @param SMALLVEC_VAL_TYPE type stored in the Vec
+* @param SMALLVEC_N number of elements stored inline, must be at least 1
+*
+* EXAMPLE USAGE:
+* ```
+* SMALLVEC_DEFINE(Args, int, 8)
+* Args args = Args_new();
+* Args_push(&args, 4); // no allocation
+* ...
+* int* data = Args_data(&args);
+* for (size_t i = 0; i < args.size; i++)
+*     printf("%d\n", data[i]);
+* Args_free(&args);
+* ```
+******************************************************************************************/
+#define SMALLVEC_DEFINE(SMALLVEC_NAME, SMALLVEC_VAL_TYPE, SMALLVEC_N) \
+    typedef struct \
+    { \
+        size_t size; \
+        size_t _arr_cap; \
+        union \
+        { \
+            SMALLVEC_VAL_TYPE* _heap; \
+            SMALLVEC_VAL_TYPE _inline[SMALLVEC_N]; \
+        }; \
+    } SMALLVEC_NAME; \
+    \
+    \
+    /**************************************************
+    * Makes a new empty Vec, using only inline storage
+    ***************************************************/ \
+    static SMALLVEC_NAME SMALLVEC_NAME##_new() \
+    { \
+        SMALLVEC_NAME ret; \
+        ret.size = 0; \
+        ret._arr_cap = SMALLVEC_N; \
+        return ret; \
+    } \
+    \
+    \
+    /*******************************************************
+    * Returns a pointer to the first element of the Vec
+    *
+    * Index into this to access elements
+    ********************************************************/ \
+    static SMALLVEC_VAL_TYPE* SMALLVEC_NAME##_data(SMALLVEC_NAME* vec) \
+    { \
+        assert(vec); \
+        return vec->_arr_cap > SMALLVEC_N ? vec->_heap : vec->_inline; \
+    } \
+    \
+    \
+    /**************************************************
+     * Creates a new Vector that is a copy of another
+     *
+     * @param copy_from valid initialized vector
+     **************************************************/ \
+    static SMALLVEC_NAME SMALLVEC_NAME##_copy(const SMALLVEC_NAME* copy_from) \
+    { \
+        assert(copy_from); \
+        SMALLVEC_NAME ret = *copy_from; \
+        if (copy_from->_arr_cap > SMALLVEC_N) { \
+            ret._heap = malloc(copy_from->_arr_cap * sizeof(SMALLVEC_VAL_TYPE)); \
+            assert(ret._heap); \
+            memcpy(ret._heap, copy_from->_heap, copy_from->size * sizeof(SMALLVEC_VAL_TYPE)); \
+        } \
+        return ret; \
+    } \
+    \
+    \
+    /*********************************************************************************
+    * Pushes a value to the back of the Vec, the value is copied and stored in place
+    *
+    * When the inline storage is full, the elements are moved to the heap.
+    * After that the underlying array is doubled in size using realloc.
+    **********************************************************************************/ \
+    static void SMALLVEC_NAME##_push(SMALLVEC_NAME* vec, SMALLVEC_VAL_TYPE value) \
+    { \
+        assert(vec); \
+        if (vec->size == vec->_arr_cap) { \
+            if (vec->_arr_cap == SMALLVEC_N) { \
+                SMALLVEC_VAL_TYPE* mem = malloc(2 * SMALLVEC_N * sizeof(SMALLVEC_VAL_TYPE)); \
+                assert(mem); \
+                memcpy(mem, vec->_inline, SMALLVEC_N * sizeof(SMALLVEC_VAL_TYPE)); \
+                vec->_heap = mem; \
+            } else { \
+                vec->_heap = realloc(vec->_heap, 2 * vec->_arr_cap * sizeof(SMALLVEC_VAL_TYPE)); \
+                assert(vec->_heap); \
+            } \
+            vec->_arr_cap *= 2; \
+        } \
+        SMALLVEC_NAME##_data(vec)[(vec->size)++] = value; \
+    } \
+    \
+    \
+    /*****************************************************************************************
+    * Removes the last element of the Vec and returns the value that was stored there
+    *
+    * A heap allocated array is shrunk if it is more than four times the size of the stored
+    * elements, and the elements are moved back inline when they fit there again
+    ******************************************************************************************/ \
+    static SMALLVEC_VAL_TYPE SMALLVEC_NAME##_pop(SMALLVEC_NAME* vec) \
+    { \
+        assert(vec); \
+        assert(vec->size); \
+        SMALLVEC_VAL_TYPE ret = SMALLVEC_NAME##_data(vec)[--(vec->size)]; \
+        if (vec->_arr_cap > SMALLVEC_N && vec->size < vec->_arr_cap / 4) { \
+            if (vec->_arr_cap / 2 <= SMALLVEC_N) { \
+                SMALLVEC_VAL_TYPE* mem = vec->_heap; \
+                memcpy(vec->_inline, mem, vec->size * sizeof(SMALLVEC_VAL_TYPE)); \
+                free(mem); \
+                vec->_arr_cap = SMALLVEC_N; \
+            } else { \
+                vec->_arr_cap /= 2; \
+                vec->_heap = realloc(vec->_heap, vec->_arr_cap * sizeof(SMALLVEC_VAL_TYPE)); \
+                assert(vec->_heap); \
+            } \
+        } \
+        return ret; \
+    } \
+    \
+    \
+    /*****************************************************************************
+    * Inserts a value before the element at index, moving the later elements up
+    *
+    * @param index at most the size, the size appends the value as push does
+    *****************************************************************************/ \
+    static void SMALLVEC_NAME##_insert(SMALLVEC_NAME* vec, size_t index, SMALLVEC_VAL_TYPE value) \
+    { \
+        assert(vec); \
+        assert(index <= vec->size); \
+        SMALLVEC_NAME##_push(vec, value); \
+        SMALLVEC_VAL_TYPE* data = SMALLVEC_NAME##_data(vec); \
+        memmove(data + index + 1, data + index, (vec->size - 1 - index) * sizeof(SMALLVEC_VAL_TYPE)); \
+        data[index] = value; \
+    } \
+    \
+    \
+    /*****************************************************************************
+    * Removes the element at index and returns it, moving the later elements down
+    *
+    * The storage shrinks, and moves back inline, as with pop
+    *****************************************************************************/ \
+    static SMALLVEC_VAL_TYPE SMALLVEC_NAME##_remove(SMALLVEC_NAME* vec, size_t index) \
+    { \
+        assert(vec); \
+        assert(index < vec->size); \
+        SMALLVEC_VAL_TYPE* data = SMALLVEC_NAME##_data(vec); \
+        SMALLVEC_VAL_TYPE ret = data[index]; \
+        memmove(data + index, data + index + 1, (vec->size - 1 - index) * sizeof(SMALLVEC_VAL_TYPE)); \
+        SMALLVEC_NAME##_pop(vec); \
+        return ret; \
+    } \
+    \
+    \
+    /************************************
+    * Deallocates memory used by vector
+    *
+    * Do not use after this point
+    *************************************/ \
+    static void SMALLVEC_NAME##_free(SMALLVEC_NAME* vec) \
+    { \
+        assert(vec); \
+        if (vec->_arr_cap > SMALLVEC_N) \
+            free(vec->_heap); \
+    } \
+    \
+    \
+    /*********************************
+    * Removes all elements in vector
+    *
+    * Safe to use after this
+    **********************************/ \
+    static void SMALLVEC_NAME##_clear(SMALLVEC_NAME* vec) \
+    { \
+        assert(vec); \
+        SMALLVEC_NAME##_free(vec); \
+        vec->size = 0; \
+        vec->_arr_cap = SMALLVEC_N; \
+    } \
+    \
+    \
+    /*****************************************************************
+    * Returns the number of bytes used by the Vec, including the
+    * owner struct with its inline storage, and any heap array
+    ******************************************************************/ \
+    static size_t SMALLVEC_NAME##_memory_usage(const SMALLVEC_NAME* vec) \
+    { \
+        assert(vec); \
+        size_t heap_bytes = vec->_arr_cap > SMALLVEC_N ? vec->_arr_cap * sizeof(SMALLVEC_VAL_TYPE) : 0; \
+        return sizeof(SMALLVEC_NAME) + heap_bytes; \
+    }
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdbool.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#define _SORT_NUM_THREADS() omp_get_num_threads()
+#define _SORT_THREAD_NUM() omp_get_thread_num()
+#else
+#define _SORT_NUM_THREADS() 1
+#define _SORT_THREAD_NUM() 0
+#endif
+
+/******************************************************************************
+ * Sorting routines for Vecs
+ *
+ * The sorts are parallelized with OpenMP when compiled with -fopenmp,
+ * otherwise they run on a single thread. They must not be called from inside
+ * an OpenMP parallel region, as each sort starts its own.
+ ******************************************************************************/
+
+// subarrays smaller than this are sorted with insertion sort
+#ifndef _SORT_INSERTION_CUTOFF
+#define _SORT_INSERTION_CUTOFF 24
+#endif
+
+// subarrays smaller than this are not split into parallel tasks
+#ifndef _SORT_PARALLEL_CUTOFF
+#define _SORT_PARALLEL_CUTOFF (1 << 14)
+#endif
+
+/******************************************************************************
+ * Key functions for RADIX_SORT_DEFINE
+ *
+ * Maps values to unsigned integers with the same ordering,
+ * signed integers get their sign bit flipped, and floats are ordered
+ * as by the IEEE 754 total order (-0.0 < 0.0, NaNs are sorted to the ends)
+ ******************************************************************************/
+static inline uint64_t sort_key_u32(const uint32_t* x) { return *x; }
+static inline uint64_t sort_key_u64(const uint64_t* x) { return *x; }
+static inline uint64_t sort_key_i32(const int32_t* x) { return (uint32_t) *x ^ UINT32_C(0x80000000); }
+static inline uint64_t sort_key_i64(const int64_t* x) { return (uint64_t) *x ^ UINT64_C(0x8000000000000000); }
+
+static inline uint64_t sort_key_f32(const float* x)
+{
+    uint32_t bits;
+    memcpy(&bits, x, sizeof(bits));
+    return bits & UINT32_C(0x80000000) ? ~bits : bits | UINT32_C(0x80000000);
+}
+
+static inline uint64_t sort_key_f64(const double* x)
+{
+    uint64_t bits;
+    memcpy(&bits, x, sizeof(bits));
+    return bits & UINT64_C(0x8000000000000000) ? ~bits : bits | UINT64_C(0x8000000000000000);
+}
+
+
+/*********************************************************************************
+ * Generates a parallel, stable merge sort for a Vec type
+ *
+ * The halves of each subarray are sorted as independent OpenMP tasks,
+ * and large merges are split into independent parts by binary searching
+ * for the median of the left half in the right half
+ *
+ * @param SORT_NAME prefix of generated functions
+ * @param SORT_VEC_TYPE Vec type to sort, defined with VEC_DEFINE
+ * @param SORT_VAL_TYPE type of elements in the Vec
+ * @param SORT_CMP_FUNC int (*)(const <SORT_VAL_TYPE>* a, const <SORT_VAL_TYPE>* b)
+ *   function or macro to compare two entries.
+ *   Should return less than 0 if a < b, more than 0 if a > b and 0 if a == b
+ *
+ * EXAMPLE USAGE:
+ * ```
+ * VEC_DEFINE(Vec, int)
+ * SORT_DEFINE(IntSort, Vec, int, CMP)
+ * ...
+ * IntSort_sort(&vec);
+ * ```
+ *********************************************************************************/
+#define SORT_DEFINE(SORT_NAME, SORT_VEC_TYPE, SORT_VAL_TYPE, SORT_CMP_FUNC) \
+    /**********************************
+     * Do not use this function
+     *
+     * Sorts a small array in place
+     **********************************/ \
+    static void _##SORT_NAME##_insertion_sort(SORT_VAL_TYPE* arr, size_t n) \
+    { \
+        for (size_t i = 1; i < n; i++) { \
+            SORT_VAL_TYPE tmp = arr[i]; \
+            size_t j = i; \
+            for (; j > 0 && (SORT_CMP_FUNC(((const SORT_VAL_TYPE*)&tmp), ((const SORT_VAL_TYPE*)(arr+j-1)))) < 0; j--) \
+                arr[j] = arr[j-1]; \
+            arr[j] = tmp; \
+        } \
+    } \
+    \
+    \
+    /********************************************************************
+     * Do not use this function
+     *
+     * Returns the number of elements in arr that are less than value
+     ********************************************************************/ \
+    static size_t _##SORT_NAME##_lower_bound(const SORT_VAL_TYPE* arr, size_t n, const SORT_VAL_TYPE* value) \
+    { \
+        size_t lo = 0, hi = n; \
+        while (lo < hi) { \
+            size_t mid = lo + (hi - lo) / 2; \
+            if ((SORT_CMP_FUNC(((const SORT_VAL_TYPE*)(arr+mid)), value)) < 0) \
+                lo = mid + 1; \
+            else \
+                hi = mid; \
+        } \
+        return lo; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Merges the sorted arrays a and b into dst, stable in favor of a
+     *****************************************************************/ \
+    static void _##SORT_NAME##_merge( \
+        const SORT_VAL_TYPE* a, size_t n_a, const SORT_VAL_TYPE* b, size_t n_b, SORT_VAL_TYPE* dst) \
+    { \
+        if (n_a + n_b >= _SORT_PARALLEL_CUTOFF && n_a > 0) { \
+            size_t mid_a = n_a / 2; \
+            /* elements of b equal to the pivot are placed after it, to keep the merge stable */ \
+            size_t mid_b = _##SORT_NAME##_lower_bound(b, n_b, a+mid_a); \
+            dst[mid_a + mid_b] = a[mid_a]; \
+            _Pragma("omp task untied") \
+            _##SORT_NAME##_merge(a, mid_a, b, mid_b, dst); \
+            _##SORT_NAME##_merge(a+mid_a+1, n_a-mid_a-1, b+mid_b, n_b-mid_b, dst+mid_a+mid_b+1); \
+            _Pragma("omp taskwait") \
+            return; \
+        } \
+        size_t i = 0, j = 0, k = 0; \
+        while (i < n_a && j < n_b) { \
+            if ((SORT_CMP_FUNC(((const SORT_VAL_TYPE*)(b+j)), ((const SORT_VAL_TYPE*)(a+i)))) < 0) \
+                dst[k++] = b[j++]; \
+            else \
+                dst[k++] = a[i++]; \
+        } \
+        memcpy(dst+k, a+i, (n_a-i) * sizeof(SORT_VAL_TYPE)); \
+        memcpy(dst+k+(n_a-i), b+j, (n_b-j) * sizeof(SORT_VAL_TYPE)); \
+    } \
+    \
+    \
+    /********************************************************************************
+     * Do not use this function
+     *
+     * Sorts the n elements of arr, using tmp as scratch space of the same size.
+     * The sorted result is stored in tmp if result_in_tmp is set, otherwise in arr
+     ********************************************************************************/ \
+    static void _##SORT_NAME##_merge_sort(SORT_VAL_TYPE* arr, SORT_VAL_TYPE* tmp, size_t n, bool result_in_tmp) \
+    { \
+        if (n <= _SORT_INSERTION_CUTOFF) { \
+            _##SORT_NAME##_insertion_sort(arr, n); \
+            if (result_in_tmp) \
+                memcpy(tmp, arr, n * sizeof(SORT_VAL_TYPE)); \
+            return; \
+        } \
+        size_t half = n / 2; \
+        if (n >= _SORT_PARALLEL_CUTOFF) { \
+            _Pragma("omp task untied") \
+            _##SORT_NAME##_merge_sort(arr, tmp, half, !result_in_tmp); \
+            _##SORT_NAME##_merge_sort(arr+half, tmp+half, n-half, !result_in_tmp); \
+            _Pragma("omp taskwait") \
+        } else { \
+            _##SORT_NAME##_merge_sort(arr, tmp, half, !result_in_tmp); \
+            _##SORT_NAME##_merge_sort(arr+half, tmp+half, n-half, !result_in_tmp); \
+        } \
+        SORT_VAL_TYPE* src = result_in_tmp ? arr : tmp; \
+        SORT_VAL_TYPE* dst = result_in_tmp ? tmp : arr; \
+        _##SORT_NAME##_merge(src, half, src+half, n-half, dst); \
+    } \
+    \
+    \
+    /*****************************************************
+     * Sorts the elements of the Vec in ascending order
+     *
+     * The sort is stable, and uses O(n) extra memory
+     *****************************************************/ \
+    static void SORT_NAME##_sort(SORT_VEC_TYPE* vec) \
+    { \
+        assert(vec); \
+        if (vec->size <= _SORT_INSERTION_CUTOFF) { \
+            _##SORT_NAME##_insertion_sort(vec->arr, vec->size); \
+            return; \
+        } \
+        SORT_VAL_TYPE* tmp = malloc(vec->size * sizeof(SORT_VAL_TYPE)); \
+        assert(tmp); \
+        _Pragma("omp parallel") \
+        _Pragma("omp single nowait") \
+        _##SORT_NAME##_merge_sort(vec->arr, tmp, vec->size, false); \
+        free(tmp); \
+    }
+
+
+/*********************************************************************************
+ * Generates a parallel, stable LSD radix sort for a Vec type
+ *
+ * Each pass sorts on one byte of the key, and passes where every key
+ * has the same byte are skipped. With OpenMP each thread counts and
+ * scatters its own contiguous chunk of the array.
+ *
+ * @param SORT_NAME prefix of generated functions
+ * @param SORT_VEC_TYPE Vec type to sort, defined with VEC_DEFINE
+ * @param SORT_VAL_TYPE type of elements in the Vec
+ * @param SORT_KEY_FUNC uint64_t (*)(const <SORT_VAL_TYPE>*)
+ *   function or macro mapping a value to an unsigned key with the same ordering,
+ *   see the sort_key_* functions for integer and floating point keys
+ * @param SORT_KEY_BYTES number of low bytes of the key to sort on, at most 8
+ *
+ * EXAMPLE USAGE:
+ * ```
+ * VEC_DEFINE(Vec, int32_t)
+ * RADIX_SORT_DEFINE(IntSort, Vec, int32_t, sort_key_i32, 4)
+ * ...
+ * IntSort_radix_sort(&vec);
+ * ```
+ *********************************************************************************/
+#define RADIX_SORT_DEFINE(SORT_NAME, SORT_VEC_TYPE, SORT_VAL_TYPE, SORT_KEY_FUNC, SORT_KEY_BYTES) \
+    /*****************************************************
+     * Sorts the elements of the Vec in ascending order
+     * of their keys
+     *
+     * The sort is stable, and uses O(n) extra memory
+     *****************************************************/ \
+    static void SORT_NAME##_radix_sort(SORT_VEC_TYPE* vec) \
+    { \
+        assert(vec); \
+        assert((SORT_KEY_BYTES) <= 8); \
+        size_t n = vec->size; \
+        if (n < 2) \
+            return; \
+        SORT_VAL_TYPE* src = vec->arr; \
+        SORT_VAL_TYPE* dst = malloc(n * sizeof(SORT_VAL_TYPE)); \
+        assert(dst); \
+        /* one slice per thread, but the slices are handed out by omp for, \
+           so all of them are sorted even if a region gets fewer threads */ \
+        int n_slices = 1; \
+        _Pragma("omp parallel") \
+        _Pragma("omp single") \
+        n_slices = _SORT_NUM_THREADS(); \
+        size_t* counts = malloc(sizeof(size_t) * 256 * n_slices); \
+        assert(counts); \
+        \
+        for (int byte = 0; byte < (SORT_KEY_BYTES); byte++) { \
+            int shift = 8 * byte; \
+            bool skip_pass = false; \
+            _Pragma("omp parallel num_threads(n_slices)") \
+            { \
+                _Pragma("omp for schedule(static)") \
+                for (int t = 0; t < n_slices; t++) { \
+                    size_t begin = n * t / n_slices, end = n * (t+1) / n_slices; \
+                    size_t* local = counts + 256 * t; \
+                    memset(local, 0, 256 * sizeof(size_t)); \
+                    for (size_t i = begin; i < end; i++) \
+                        local[(SORT_KEY_FUNC(((const SORT_VAL_TYPE*)(src+i))) >> shift) & 0xff]++; \
+                } \
+                \
+                _Pragma("omp single") \
+                { \
+                    /* exclusive prefix sum, ordered by digit and then by slice */ \
+                    size_t sum = 0; \
+                    for (int d = 0; d < 256; d++) { \
+                        size_t digit_total = 0; \
+                        for (int th = 0; th < n_slices; th++) { \
+                            size_t c = counts[256 * th + d]; \
+                            counts[256 * th + d] = sum; \
+                            sum += c; \
+                            digit_total += c; \
+                        } \
+                        if (digit_total == n) \
+                            skip_pass = true; \
+                    } \
+                } \
+                \
+                if (!skip_pass) { \
+                    _Pragma("omp for schedule(static)") \
+                    for (int t = 0; t < n_slices; t++) { \
+                        size_t begin = n * t / n_slices, end = n * (t+1) / n_slices; \
+                        size_t* local = counts + 256 * t; \
+                        for (size_t i = begin; i < end; i++) \
+                            dst[local[(SORT_KEY_FUNC(((const SORT_VAL_TYPE*)(src+i))) >> shift) & 0xff]++] = src[i]; \
+                    } \
+                } \
+            } \
+            if (!skip_pass) { \
+                SORT_VAL_TYPE* tmp = src; \
+                src = dst; \
+                dst = tmp; \
+            } \
+        } \
+        \
+        if (src != vec->arr) { \
+            memcpy(vec->arr, src, n * sizeof(SORT_VAL_TYPE)); \
+            dst = src; \
+        } \
+        free(dst); \
+        free(counts); \
+    }
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef STRMAP_H
+#define STRMAP_H
+
+/***************************************************************************************
+ * HashMap with variable length string keys, and interning of strings to 32 bit ids
+ *
+ * Entries are stored in one array in insertion order, and the position of an entry
+ * in it is the id of its key. Ids are dense and never change, so they can be stored
+ * instead of the strings themselves. Keys are found through an open addressing index
+ * of (id, hash) pairs, which is the only part that is rehashed on resize, using the
+ * hashes cached in the index, without reading any key.
+ *
+ * A key is 16 bytes: its length, 32 bits of its hash, and either the string itself
+ * if it is at most _STRMAP_INLINE_LEN bytes, or the offset of its bytes in an
+ * append-only arena shared by all keys. Strings are compared by length, so they
+ * may contain null bytes, and are not null terminated.
+ *
+ * Keys are hashed with byte_hasher, entries can not be removed, as ids must stay valid.
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "hashmap.h"
+
+// strings of at most this many bytes are stored in the key instead of the arena
+#define _STRMAP_INLINE_LEN 8
+
+// returned by STRMAP_NAME##_id for strings that are not in the map, also marks empty index buckets
+#define STRMAP_NO_ID UINT32_MAX
+
+#ifndef _STRMAP_MIN_ARENA_SIZE
+#define _STRMAP_MIN_ARENA_SIZE 4096
+#endif
+
+// strings hashed, and their index buckets prefetched, before any of them is inserted by intern_batch
+#ifndef _STRMAP_BULK_BATCH
+#define _STRMAP_BULK_BATCH 16
+#endif
+
+/******************************************************************
+ * Key of a StrMap, see strmap_key_chars to get the string back
+ ******************************************************************/
+typedef struct
+{
+    uint32_t len;
+    uint32_t hash;
+    union
+    {
+        char chars[_STRMAP_INLINE_LEN];     // if len <= _STRMAP_INLINE_LEN
+        uint64_t offset;                    // into the arena otherwise
+    };
+} StrMapKey;
+
+/*******************************************************************
+ * Bucket of the index of a StrMap. The hash is kept next to the id,
+ * so probing and resizing only read the entries of equal hashes
+ *******************************************************************/
+typedef struct
+{
+    uint32_t id;    // STRMAP_NO_ID if empty
+    uint32_t hash;
+} _StrMapBucket;
+
+/*******************************************************************
+ * Bytes of a key, valid until the next insertion into its map
+ *
+ * @param arena the _arena of the map holding the key
+ *******************************************************************/
+static inline const char* strmap_key_chars(const StrMapKey* key, const char* arena)
+{
+    return key->len <= _STRMAP_INLINE_LEN ? key->chars : arena + key->offset;
+}
+
+
+/***************************************************************************************
+ * Creates a new StrMap type
+ *
+ * @param STRMAP_NAME name of the map struct and prefix of every function
+ * @param STRMAP_VALUE_TYPE type of values, stored in place. Pass HASHMAP_NO_VALUE
+ *    to only intern strings
+ ***************************************************************************************/
+#define STRMAP_DEFINE(STRMAP_NAME, STRMAP_VALUE_TYPE) \
+    typedef struct \
+    { \
+        StrMapKey key; \
+        STRMAP_VALUE_TYPE value; \
+    } STRMAP_NAME##Entry; \
+    \
+    typedef struct \
+    { \
+        size_t size; \
+        STRMAP_NAME##Entry* _entries;   /* indexed by id */ \
+        size_t _capacity; \
+        _StrMapBucket* _buckets; \
+        size_t _n_buckets;              /* power of two */ \
+        char* _arena; \
+        size_t _arena_size; \
+        size_t _arena_capacity; \
+    } STRMAP_NAME; \
+    \
+    \
+    /***********************************************************************
+     * Creates a new StrMap
+     *
+     * @param initial_capacity expected number of strings, the map is
+     *    resized automatically as needed
+     ***********************************************************************/ \
+    static STRMAP_NAME STRMAP_NAME##_new(size_t initial_capacity) \
+    { \
+        STRMAP_NAME map; \
+        map.size = 0; \
+        map._capacity = initial_capacity > 0 ? initial_capacity : 1; \
+        map._entries = malloc(map._capacity * sizeof(STRMAP_NAME##Entry)); \
+        assert(map._entries); \
+        map._n_buckets = _HASHMAP_MIN_BUCKET_ARRAY_SIZE; \
+        while (map._n_buckets * _HASHMAP_LOAD_FACTOR < initial_capacity) \
+            map._n_buckets *= 2; \
+        map._buckets = malloc(map._n_buckets * sizeof(_StrMapBucket)); \
+        assert(map._buckets); \
+        memset(map._buckets, 0xff, map._n_buckets * sizeof(_StrMapBucket)); \
+        map._arena = NULL; \
+        map._arena_size = 0; \
+        map._arena_capacity = 0; \
+        return map; \
+    } \
+    \
+    \
+    /*********************************************************
+     * Do not use this function
+     *
+     * Doubles the index, moving ids by their cached hashes
+     *********************************************************/ \
+    static void _##STRMAP_NAME##_grow_index(STRMAP_NAME* map) \
+    { \
+        _TRACE(uint64_t _trace_start = _trace_now_ns();) \
+        size_t n_buckets = map->_n_buckets * 2; \
+        _StrMapBucket* buckets = malloc(n_buckets * sizeof(_StrMapBucket)); \
+        assert(buckets); \
+        memset(buckets, 0xff, n_buckets * sizeof(_StrMapBucket)); \
+        for (size_t i = 0; i < map->_n_buckets; i++) { \
+            if (map->_buckets[i].id == STRMAP_NO_ID) \
+                continue; \
+            size_t ind = map->_buckets[i].hash & (n_buckets - 1); \
+            while (buckets[ind].id != STRMAP_NO_ID) \
+                ind = (ind + 1) & (n_buckets - 1); \
+            buckets[ind] = map->_buckets[i]; \
+        } \
+        free(map->_buckets); \
+        map->_buckets = buckets; \
+        map->_n_buckets = n_buckets; \
+        _TRACE(_TRACE_EMIT(TRACE_HASHMAP_RESIZE, hashmap_resize, #STRMAP_NAME, map, n_buckets / 2, n_buckets, _trace_start);) \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Do not use this function
+     *
+     * Finds the index bucket holding a string, or the empty bucket
+     * where it can be inserted
+     *******************************************************************/ \
+    static _StrMapBucket* _##STRMAP_NAME##_locate(const STRMAP_NAME* map, const char* str, size_t len, uint32_t hash) \
+    { \
+        size_t mask = map->_n_buckets - 1; \
+        for (size_t ind = hash & mask;; ind = (ind + 1) & mask) { \
+            _StrMapBucket* bucket = map->_buckets + ind; \
+            if (bucket->id == STRMAP_NO_ID) \
+                return bucket; \
+            if (bucket->hash != hash) \
+                continue; \
+            const StrMapKey* key = &map->_entries[bucket->id].key; \
+            if (key->len == len && memcmp(strmap_key_chars(key, map->_arena), str, len) == 0) \
+                return bucket; \
+        } \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Do not use this function
+     *
+     * Appends a new entry for a string, which is not in the map,
+     * to an empty bucket found by _locate. The value is zeroed
+     *******************************************************************/ \
+    static STRMAP_NAME##Entry* _##STRMAP_NAME##_append(STRMAP_NAME* map, _StrMapBucket* bucket, const char* str, size_t len, uint32_t hash) \
+    { \
+        assert(map->size < STRMAP_NO_ID); \
+        assert(len <= UINT32_MAX); \
+        /* str may point into the arena or an inline key, so it is copied before either is reallocated */ \
+        StrMapKey key; \
+        memset(&key, 0, sizeof(key)); \
+        key.len = (uint32_t) len; \
+        key.hash = hash; \
+        if (len <= _STRMAP_INLINE_LEN) { \
+            memcpy(key.chars, str, len); \
+        } else { \
+            if (map->_arena_size + len > map->_arena_capacity) { \
+                size_t capacity = map->_arena_capacity ? map->_arena_capacity : _STRMAP_MIN_ARENA_SIZE; \
+                while (capacity < map->_arena_size + len) \
+                    capacity *= 2; \
+                char* arena = malloc(capacity); \
+                assert(arena); \
+                if (map->_arena_size) \
+                    memcpy(arena, map->_arena, map->_arena_size); \
+                memcpy(arena + map->_arena_size, str, len); \
+                free(map->_arena); \
+                map->_arena = arena; \
+                map->_arena_capacity = capacity; \
+            } else { \
+                memcpy(map->_arena + map->_arena_size, str, len); \
+            } \
+            key.offset = map->_arena_size; \
+            map->_arena_size += len; \
+        } \
+        if (map->size == map->_capacity) { \
+            map->_capacity *= 2; \
+            map->_entries = realloc(map->_entries, map->_capacity * sizeof(STRMAP_NAME##Entry)); \
+            assert(map->_entries); \
+        } \
+        STRMAP_NAME##Entry* entry = map->_entries + map->size; \
+        memset(entry, 0, sizeof(STRMAP_NAME##Entry)); \
+        entry->key = key; \
+        bucket->id = (uint32_t) map->size; \
+        bucket->hash = hash; \
+        map->size++; \
+        return entry; \
+    } \
+    \
+    \
+    /**************************************************************************
+     * Finds the entry of a string
+     *
+     * @param insert whether to insert the string if it is not found,
+     *    its value is then zeroed
+     * @returns the entry, or NULL if it was not found and insert is false.
+     *    The pointer is valid until the next insertion
+     **************************************************************************/ \
+    static STRMAP_NAME##Entry* STRMAP_NAME##_search(STRMAP_NAME* map, const char* str, size_t len, bool insert) \
+    { \
+        assert(map); \
+        assert(str || len == 0); \
+        if (insert && map->size + 1 > map->_n_buckets * _HASHMAP_LOAD_FACTOR) \
+            _##STRMAP_NAME##_grow_index(map); \
+        uint32_t hash = (uint32_t) byte_hasher(str, len); \
+        _StrMapBucket* bucket = _##STRMAP_NAME##_locate(map, str, len, hash); \
+        if (bucket->id != STRMAP_NO_ID) \
+            return map->_entries + bucket->id; \
+        return insert ? _##STRMAP_NAME##_append(map, bucket, str, len, hash) : NULL; \
+    } \
+    \
+    \
+    /*********************************************************************
+     * Returns the id of a string, inserting it if it is not in the map.
+     * Ids are given out in insertion order, starting at 0
+     *********************************************************************/ \
+    static uint32_t STRMAP_NAME##_intern(STRMAP_NAME* map, const char* str, size_t len) \
+    { \
+        return (uint32_t) (STRMAP_NAME##_search(map, str, len, true) - map->_entries); \
+    } \
+    \
+    \
+    /**************************************************************************************
+     * Interns n strings, writing the id of strs[i] to ids_out[i]. Same as calling
+     * intern on each, but the strings are hashed with siphash_batch, and their
+     * index buckets prefetched, _STRMAP_BULK_BATCH at a time
+     **************************************************************************************/ \
+    static void STRMAP_NAME##_intern_batch(STRMAP_NAME* map, const char* const strs[], const size_t lens[], size_t n, uint32_t ids_out[]) \
+    { \
+        assert(map); \
+        assert((strs && lens && ids_out) || n == 0); \
+        size_t hashes[_STRMAP_BULK_BATCH]; \
+        for (size_t start = 0; start < n; start += _STRMAP_BULK_BATCH) { \
+            size_t batch = n - start < _STRMAP_BULK_BATCH ? n - start : _STRMAP_BULK_BATCH; \
+            while (map->size + batch > map->_n_buckets * _HASHMAP_LOAD_FACTOR) \
+                _##STRMAP_NAME##_grow_index(map); \
+            siphash_batch(strs + start, lens + start, batch, hashes); \
+            for (size_t i = 0; i < batch; i++) \
+                __builtin_prefetch(map->_buckets + ((uint32_t) hashes[i] & (map->_n_buckets - 1)), 1); \
+            for (size_t i = 0; i < batch; i++) { \
+                uint32_t hash = (uint32_t) hashes[i]; \
+                _StrMapBucket* bucket = _##STRMAP_NAME##_locate(map, strs[start + i], lens[start + i], hash); \
+                if (bucket->id == STRMAP_NO_ID) \
+                    _##STRMAP_NAME##_append(map, bucket, strs[start + i], lens[start + i], hash); \
+                ids_out[start + i] = bucket->id; \
+            } \
+        } \
+    } \
+    \
+    \
+    /*******************************************************************
+     * @returns the id of a string, or STRMAP_NO_ID if it is not found
+     *******************************************************************/ \
+    static uint32_t STRMAP_NAME##_id(const STRMAP_NAME* map, const char* str, size_t len) \
+    { \
+        assert(map); \
+        assert(str || len == 0); \
+        return _##STRMAP_NAME##_locate(map, str, len, (uint32_t) byte_hasher(str, len))->id; \
+    } \
+    \
+    \
+    static bool STRMAP_NAME##_contains(const STRMAP_NAME* map, const char* str, size_t len) \
+    { \
+        return STRMAP_NAME##_id(map, str, len) != STRMAP_NO_ID; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Entry of an id returned by intern, the pointer is valid until
+     * the next insertion
+     *******************************************************************/ \
+    static STRMAP_NAME##Entry* STRMAP_NAME##_entry(STRMAP_NAME* map, uint32_t id) \
+    { \
+        assert(map); \
+        assert(id < map->size); \
+        return map->_entries + id; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * String of an id returned by intern, not null terminated.
+     * The pointer is valid until the next insertion
+     *
+     * @param len_out set to the length of the string
+     *******************************************************************/ \
+    static const char* STRMAP_NAME##_str(const STRMAP_NAME* map, uint32_t id, size_t* len_out) \
+    { \
+        assert(map); \
+        assert(id < map->size); \
+        assert(len_out); \
+        const StrMapKey* key = &map->_entries[id].key; \
+        *len_out = key->len; \
+        return strmap_key_chars(key, map->_arena); \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Returns the number of bytes used by the map, including the unused
+     * capacity of the entry array, the index and the arena
+     *******************************************************************************/ \
+    static size_t STRMAP_NAME##_memory_usage(const STRMAP_NAME* map) \
+    { \
+        assert(map); \
+        return sizeof(STRMAP_NAME) + map->_capacity * sizeof(STRMAP_NAME##Entry) \
+             + map->_n_buckets * sizeof(_StrMapBucket) + map->_arena_capacity; \
+    } \
+    \
+    \
+    /**************************************************
+    * Deallocates all resources used by this StrMap.
+    * It must not be used after this point
+    ***************************************************/ \
+    static void STRMAP_NAME##_free(STRMAP_NAME* map) \
+    { \
+        assert(map); \
+        free(map->_entries); \
+        free(map->_buckets); \
+        free(map->_arena); \
+    }
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/***************************************************************************************
+ * Tracepoints around rare, expensive events of the datastructures
+ *
+ * - hashmap_resize, the bucket array is reallocated and every entry is rehashed
+ * - queue_resize, the ring buffer is reallocated and copied
+ * - treemap_split, a full node is split in two by an insertion
+ * - treemap_merge, a node is merged with a sibling by a remove
+ * - vec_grow and vec_shrink, the array of a Vec (or Heap) is reallocated by push or pop
+ *
+ * Tracing is disabled by default, and then compiles to nothing.
+ * Define DATASTRUCTURES_TRACE before including any datastructure header to enable it.
+ * Every event is then timed, and reported to the callback set with trace_set_callback.
+ *
+ * When DATASTRUCTURES_TRACE_USDT is defined as well, every event also fires a USDT probe
+ * of the provider "datastructures", named as listed above, with the arguments
+ * (container name, container address, old size, new size, nanoseconds).
+ * This needs <sys/sdt.h>, from systemtap-sdt-dev or systemtap-sdt-devel.
+ * The probes are a single nop while no tracer is attached, and can be used with
+ * perf (perf probe -x ./prog sdt_datastructures:hashmap_resize) or bpftrace, e.g.
+ *
+ *   bpftrace -e 'usdt:./prog:datastructures:hashmap_resize
+ *       { printf("%s %d -> %d buckets, %d ns\n", str(arg0), arg2, arg3, arg4); }'
+ *
+ * The callback is kept per translation unit, and is not thread safe.
+ ***************************************************************************************/
+
+#ifdef DATASTRUCTURES_TRACE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef DATASTRUCTURES_TRACE_USDT
+#include <sys/sdt.h>
+#endif
+
+/* wraps code that should only be compiled when tracing is enabled */
+#define _TRACE(...) __VA_ARGS__
+
+typedef enum
+{
+    TRACE_HASHMAP_RESIZE,
+    TRACE_QUEUE_RESIZE,
+    TRACE_TREEMAP_SPLIT,
+    TRACE_TREEMAP_MERGE,
+    TRACE_VEC_GROW,
+    TRACE_VEC_SHRINK,
+    TRACE_N_EVENTS
+} TraceEventType;
+
+static const char* const trace_event_names[TRACE_N_EVENTS] = {
+    "hashmap_resize", "queue_resize", "treemap_split", "treemap_merge", "vec_grow", "vec_shrink"
+};
+
+/***************************************************************************
+ * An event passed to the trace callback
+ *
+ * Sizes are bucket counts for hashmap_resize, and capacities for
+ * queue_resize, vec_grow and vec_shrink.
+ * For treemap_split they are the entries in the full node, and the entries
+ * it keeps after moving the rest into a new node. For treemap_merge they
+ * are the entries in the underfull node, and in the node after merging
+ ***************************************************************************/
+typedef struct
+{
+    TraceEventType type;
+    const char* container;  // name passed to the DEFINE macro
+    const void* object;     // address of the container
+    size_t old_size;
+    size_t new_size;
+    uint64_t ns;            // time taken by the event
+} TraceEvent;
+
+typedef void (*TraceCallback)(const TraceEvent* event, void* ctx);
+
+static TraceCallback _trace_callback;
+static void* _trace_ctx;
+
+/*****************************************************************
+ * Sets the function called after every event, NULL disables it
+ *
+ * @param ctx passed on to every call of callback
+ *****************************************************************/
+static void trace_set_callback(TraceCallback callback, void* ctx)
+{
+    _trace_callback = callback;
+    _trace_ctx = ctx;
+}
+
+/**************************************
+ * Do not use this function
+ *
+ * Monotonic clock, in nanoseconds
+ **************************************/
+static inline uint64_t _trace_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*****************************************************************
+ * Do not use this function
+ *
+ * Reports an event that started at start_ns (see _trace_now_ns)
+ *****************************************************************/
+static inline void _trace_emit(TraceEventType type, const char* container, const void* object,
+                               size_t old_size, size_t new_size, uint64_t start_ns)
+{
+    TraceEvent event = {type, container, object, old_size, new_size, _trace_now_ns() - start_ns};
+    if (_trace_callback)
+        _trace_callback(&event, _trace_ctx);
+}
+
+#ifdef DATASTRUCTURES_TRACE_USDT
+#define _TRACE_EMIT(TYPE, PROBE, CONTAINER, OBJECT, OLD_SIZE, NEW_SIZE, START_NS) \
+    do { \
+        uint64_t _trace_ns = _trace_now_ns() - (START_NS); \
+        DTRACE_PROBE5(datastructures, PROBE, CONTAINER, OBJECT, OLD_SIZE, NEW_SIZE, _trace_ns); \
+        _trace_emit(TYPE, CONTAINER, OBJECT, OLD_SIZE, NEW_SIZE, START_NS); \
+    } while (0)
+#else
+#define _TRACE_EMIT(TYPE, PROBE, CONTAINER, OBJECT, OLD_SIZE, NEW_SIZE, START_NS) \
+    _trace_emit(TYPE, CONTAINER, OBJECT, OLD_SIZE, NEW_SIZE, START_NS)
+#endif
+
+#else
+
+#define _TRACE(...)
+
+#endif
+
+#endif
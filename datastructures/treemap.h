@@ -9,6 +9,15 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "trace.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#define _TREEMAP_MAX_THREADS() omp_get_max_threads()
+#else
+#define _TREEMAP_MAX_THREADS() 1
+#endif
+
 typedef struct
 {} TREEMAP_NO_VALUE;
 
@@ -17,6 +26,67 @@ typedef struct
 #define _TREEMAP_M 32
 #endif
 
+// maximum height reported by TREEMAP_NAME##_stats, deeper levels are counted in the last one
+#define _TREEMAP_STATS_MAX_HEIGHT 64
+
+// number of entries in the node fill histogram, each covering an equal range of fill factors
+#define _TREEMAP_STATS_FILL_BUCKETS 10
+
+// number of ranges per thread the tree is split into by TREEMAP_NAME##_parallel_for_each and _parallel_reduce
+#ifndef _TREEMAP_PARALLEL_RANGES_PER_THREAD
+#define _TREEMAP_PARALLEL_RANGES_PER_THREAD 8
+#endif
+
+/*
+ * Define TREEMAP_INSTRUMENT before including this header to count splits, merges,
+ * borrows, comparisons and moved bytes as they happen, see TreeMapCounters.
+ * When it is not defined, the counters are not stored and nothing is counted
+ */
+#ifdef TREEMAP_INSTRUMENT
+#define _TREEMAP_INSTRUMENT(...) __VA_ARGS__
+#else
+#define _TREEMAP_INSTRUMENT(...)
+#endif
+
+/******************************************************************************
+ * Live counters of a TreeMap, only gathered when TREEMAP_INSTRUMENT is defined
+ *
+ * Searches include insertions and contains. Dividing n_comparisons or
+ * bytes_moved by the number of operations gives the average cost of each
+ ******************************************************************************/
+typedef struct
+{
+    size_t n_searches;
+    size_t n_removes;
+    size_t n_comparisons;   // key comparisons done by searches and removes
+    size_t n_splits;        // full nodes split in two by insertions
+    size_t n_merges;        // nodes merged with a sibling by removes
+    size_t n_borrows;       // entries rotated in from a sibling by removes
+    size_t bytes_moved;     // bytes of node entries moved by memmove and memcpy
+} TreeMapCounters;
+
+/****************************************************************************
+ * Statistics returned by TREEMAP_NAME##_stats
+ *
+ * Index i of fill_histogram counts the nodes storing between i/10 and
+ * (i+1)/10 of the maximum of _TREEMAP_M - 1 entries, so a tree built from
+ * random insertions has most of its nodes in the upper half
+ ****************************************************************************/
+typedef struct
+{
+    size_t size;
+    size_t height;                  // number of levels, 1 for a tree of only a root
+    size_t n_nodes;
+    size_t n_leaves;
+    size_t nodes_per_level[_TREEMAP_STATS_MAX_HEIGHT];
+    size_t fill_histogram[_TREEMAP_STATS_FILL_BUCKETS];
+    double mean_fill;               // average fraction of entries used per node
+    size_t node_size;               // bytes per node
+    size_t bytes_allocated;         // bytes used by all nodes
+    double bytes_per_entry;
+    TreeMapCounters counters;       // all zero unless TREEMAP_INSTRUMENT is defined
+} TreeMapStats;
+
 #define TREEMAP_DEFINE(TREEMAP_NAME, TREEMAP_KEY_TYPE, TREEMAP_VAL_TYPE, TREEMAP_KEY_CMP) \
     typedef struct \
     { \
@@ -43,6 +113,7 @@ typedef struct
     { \
         _##TREEMAP_NAME##Node* _root; \
         size_t size; \
+        _TREEMAP_INSTRUMENT(TreeMapCounters _counters;) \
     } TREEMAP_NAME; \
     \
     typedef struct \
@@ -74,6 +145,106 @@ typedef struct
     } \
     \
     \
+    /******************************************************************************
+     * Do not use this function
+     *
+     * Builds a subtree of exactly the given height from n sorted entries,
+     * taken from entries if it is not NULL, and otherwise from keys.
+     * capacities[h-1] is the most entries a subtree of height h can hold.
+     * Children get an equal share of the entries, as few children as possible
+     * are used, but never fewer than a node must have after a remove
+     ******************************************************************************/ \
+    static _##TREEMAP_NAME##Node* _##TREEMAP_NAME##_build_sorted( \
+        const TREEMAP_NAME##Entry* entries, const TREEMAP_KEY_TYPE* keys, size_t n, \
+        size_t height, const size_t* capacities, bool is_root) \
+    { \
+        _##TREEMAP_NAME##Node* node = calloc(1, sizeof(_##TREEMAP_NAME##Node)); \
+        assert(node != NULL); \
+        if (height == 1) { \
+            node->is_leaf = 1; \
+            for (size_t i = 0; i < n; i++) { \
+                if (entries) \
+                    node->entries[i].entry = entries[i]; \
+                else \
+                    node->entries[i].entry.key = keys[i]; \
+            } \
+            node->n_entries = n; \
+            return node; \
+        } \
+        size_t child_capacity = capacities[height-2]; \
+        size_t n_children = (n + 1 + child_capacity) / (child_capacity + 1); \
+        if (!is_root && n_children < (_TREEMAP_M - 1) / 2 + 1) \
+            n_children = (_TREEMAP_M - 1) / 2 + 1; \
+        assert(n_children >= 2 && n_children <= _TREEMAP_M); \
+        size_t child_size = (n - (n_children - 1)) / n_children; \
+        size_t n_larger = (n - (n_children - 1)) % n_children; \
+        size_t pos = 0; \
+        for (size_t c = 0; c < n_children; c++) { \
+            size_t size = child_size + (c < n_larger); \
+            node->entries[c].lt_child = _##TREEMAP_NAME##_build_sorted( \
+                entries ? entries + pos : NULL, entries ? NULL : keys + pos, size, height - 1, capacities, false \
+            ); \
+            pos += size; \
+            if (c + 1 < n_children) { \
+                if (entries) \
+                    node->entries[c].entry = entries[pos]; \
+                else \
+                    node->entries[c].entry.key = keys[pos]; \
+                pos++; \
+            } \
+        } \
+        node->n_entries = n_children - 1; \
+        return node; \
+    } \
+    \
+    \
+    /******************************************************************************
+     * Do not use this function
+     *
+     * Builds a tree of the smallest possible height, see TREEMAP_NAME##_from_sorted
+     ******************************************************************************/ \
+    static TREEMAP_NAME _##TREEMAP_NAME##_from_sorted_helper(const TREEMAP_NAME##Entry* entries, const TREEMAP_KEY_TYPE* keys, size_t n) \
+    { \
+        for (size_t i = 1; i < n; i++) \
+            assert(TREEMAP_KEY_CMP((entries ? &entries[i-1].key : keys+i-1), (entries ? &entries[i].key : keys+i)) < 0); \
+        size_t capacities[_TREEMAP_STATS_MAX_HEIGHT]; \
+        size_t height = 1; \
+        capacities[0] = _TREEMAP_M - 1; \
+        for (; capacities[height-1] < n; height++) \
+            capacities[height] = _TREEMAP_M - 1 + _TREEMAP_M * capacities[height-1]; \
+        TREEMAP_NAME ret = {0}; \
+        ret._root = _##TREEMAP_NAME##_build_sorted(entries, keys, n, height, capacities, true); \
+        ret.size = n; \
+        return ret; \
+    } \
+    \
+    \
+    /*********************************************************************************
+     * Builds a treemap from n entries sorted by strictly increasing keys
+     *
+     * The nodes are allocated and filled directly, without searching or splitting,
+     * so this takes linear time. Nodes are filled as far as possible, so the tree
+     * is shallower and uses less memory than one built by insertions, while
+     * insertions into the full nodes right after building split them
+     *********************************************************************************/ \
+    static TREEMAP_NAME TREEMAP_NAME##_from_sorted(const TREEMAP_NAME##Entry* entries, size_t n) \
+    { \
+        assert(entries != NULL || n == 0); \
+        return _##TREEMAP_NAME##_from_sorted_helper(entries, NULL, n); \
+    } \
+    \
+    \
+    /*********************************************************************************
+     * Builds a treemap from n strictly increasing keys, with values set to zeroes,
+     * see TREEMAP_NAME##_from_sorted
+     *********************************************************************************/ \
+    static TREEMAP_NAME TREEMAP_NAME##_from_sorted_keys(const TREEMAP_KEY_TYPE* keys, size_t n) \
+    { \
+        assert(keys != NULL || n == 0); \
+        return _##TREEMAP_NAME##_from_sorted_helper(NULL, keys, n); \
+    } \
+    \
+    \
     /*******************************************************************************
      * Do not use this function
      *
@@ -86,6 +257,7 @@ typedef struct
         int n = node->n_entries; \
         for (int i = 0; i < n+1; i++) { \
             _##TREEMAP_NAME##NodeEntry* entry = node->entries+i; \
+            _TREEMAP_INSTRUMENT(map->_counters.n_comparisons += i < n;) \
             int cmp_res = i == n \
                     ? -1 \
                     : TREEMAP_KEY_CMP((const TREEMAP_KEY_TYPE*)(key), (const TREEMAP_KEY_TYPE*)(&(entry->entry.key))); \
@@ -126,6 +298,7 @@ typedef struct
                         ? n - i \
                         : n - i + 1; \
                 memmove(node->entries+i+1, node->entries+i, n_move*sizeof(_##TREEMAP_NAME##NodeEntry)); \
+                _TREEMAP_INSTRUMENT(map->_counters.bytes_moved += n_move*sizeof(_##TREEMAP_NAME##NodeEntry);) \
                 node->entries[i] = new_entry; \
                 \
                 if (!is_full) { \
@@ -134,6 +307,7 @@ typedef struct
                     (node->n_entries)++; \
                     return NULL; \
                 } \
+                _TRACE(uint64_t _trace_start = _trace_now_ns();) \
                 int median_ind = n / 2; \
                 _##TREEMAP_NAME##NodeEntry median = node->entries[median_ind]; \
                 _##TREEMAP_NAME##Node* new_node = calloc(1, sizeof(_##TREEMAP_NAME##Node)); \
@@ -143,8 +317,13 @@ typedef struct
                 memcpy(new_node->entries, node->entries, sizeof(_##TREEMAP_NAME##NodeEntry)*median_ind); \
                 memmove(node->entries, node->entries+median_ind+1, sizeof(_##TREEMAP_NAME##NodeEntry)*(_TREEMAP_M/2)); \
                 (node->entries+_TREEMAP_M/2)->lt_child = gt_child; \
+                _TREEMAP_INSTRUMENT( \
+                    map->_counters.n_splits++; \
+                    map->_counters.bytes_moved += sizeof(_##TREEMAP_NAME##NodeEntry)*(median_ind + _TREEMAP_M/2); \
+                ) \
                 node->n_entries = _TREEMAP_M/2; \
                 new_node->n_entries = median_ind; \
+                _TRACE(_TRACE_EMIT(TRACE_TREEMAP_SPLIT, treemap_split, #TREEMAP_NAME, map, (size_t) _TREEMAP_M, (size_t) _TREEMAP_M/2, _trace_start);) \
                 \
                 if (set_res) { \
                     if (i < median_ind) \
@@ -181,6 +360,7 @@ typedef struct
     { \
         assert(map != NULL); \
         assert(key != NULL); \
+        _TREEMAP_INSTRUMENT(map->_counters.n_searches++;) \
         TREEMAP_NAME##Entry* res; \
         _##TREEMAP_NAME##NodeEntry* floater = _##TREEMAP_NAME##_search_helper( \
                 map, map->_root, key, insert, &res \
@@ -258,9 +438,11 @@ typedef struct
         int stack_size = 0; \
         bool unbalanced = false; \
         _##TREEMAP_NAME##Node* current_node = map->_root; \
+        _TREEMAP_INSTRUMENT(map->_counters.n_removes++;) \
         for (;;) { \
             int n = current_node->n_entries; \
             for (int i = 0; i <= n; i++) { \
+                _TREEMAP_INSTRUMENT(map->_counters.n_comparisons += i < n;) \
                 int cmp_res = i == n \
                     ? -1 \
                     : TREEMAP_KEY_CMP(key, (const TREEMAP_KEY_TYPE*)&((current_node->entries+i)->entry.key)); \
@@ -276,6 +458,7 @@ typedef struct
                 if (current_node->is_leaf) { \
                     size_t bytes_move = (n-i) * sizeof(_##TREEMAP_NAME##NodeEntry); \
                     memmove(current_node->entries+i, current_node->entries+i+1, bytes_move); \
+                    _TREEMAP_INSTRUMENT(map->_counters.bytes_moved += bytes_move;) \
                     if (--(current_node->n_entries) < min_entries) \
                         unbalanced = true; \
                     (map->size)--; \
@@ -315,6 +498,7 @@ typedef struct
                 _##TREEMAP_NAME##Node* left_child = current_node->entries[ind-1].lt_child; \
                 size_t move_bytes = (current_child->n_entries+1) * sizeof(_##TREEMAP_NAME##NodeEntry); \
                 memmove(current_child->entries+1, current_child->entries, move_bytes); \
+                _TREEMAP_INSTRUMENT(map->_counters.n_borrows++; map->_counters.bytes_moved += move_bytes;) \
                 current_child->entries[0].entry = current_node->entries[ind-1].entry; \
                 current_child->n_entries++; \
                 \
@@ -328,43 +512,115 @@ typedef struct
                 current_child->entries[current_child->n_entries].lt_child = right_child->entries[0].lt_child; \
                 size_t move_bytes = right_child->n_entries-- * sizeof(_##TREEMAP_NAME##NodeEntry); \
                 memmove(right_child->entries, right_child->entries+1, move_bytes); \
+                _TREEMAP_INSTRUMENT(map->_counters.n_borrows++; map->_counters.bytes_moved += move_bytes;) \
             } else if (ind > 0) { /* merge with left sibling */ \
+                _TRACE(uint64_t _trace_start = _trace_now_ns();) \
                 _##TREEMAP_NAME##Node* left_child = current_node->entries[ind-1].lt_child; \
                 int left_n = left_child->n_entries; \
                 size_t move_bytes = (current_child->n_entries+1) * sizeof(_##TREEMAP_NAME##NodeEntry); \
                 memmove(current_child->entries+(left_n+1), current_child->entries, move_bytes); \
+                _TREEMAP_INSTRUMENT(map->_counters.n_merges++; map->_counters.bytes_moved += move_bytes;) \
                 move_bytes = (left_n+1) * sizeof(_##TREEMAP_NAME##NodeEntry); \
                 memmove(current_child->entries, left_child->entries, move_bytes); \
+                _TREEMAP_INSTRUMENT(map->_counters.bytes_moved += move_bytes;) \
                 current_child->entries[left_n].entry = current_node->entries[ind-1].entry; \
                 free(left_child); \
                 move_bytes = (current_node->n_entries-- - ind + 1) * sizeof(_##TREEMAP_NAME##NodeEntry); \
                 memmove(current_node->entries + (ind - 1), current_node->entries + ind, move_bytes); \
+                _TREEMAP_INSTRUMENT(map->_counters.bytes_moved += move_bytes;) \
                 current_child->n_entries += left_n + 1; \
+                _TRACE(_TRACE_EMIT(TRACE_TREEMAP_MERGE, treemap_merge, #TREEMAP_NAME, map, (size_t) current_child->n_entries - left_n - 1, (size_t) current_child->n_entries, _trace_start);) \
             } else { /* merge with right sibling */ \
+                _TRACE(uint64_t _trace_start = _trace_now_ns();) \
                 _##TREEMAP_NAME##Node* right_child = current_node->entries[ind+1].lt_child; \
                 int right_n = right_child->n_entries; \
                 int child_n = current_child->n_entries; \
                 size_t move_bytes = (right_n+1) * sizeof(_##TREEMAP_NAME##NodeEntry); \
                 memmove(right_child->entries+(child_n+1), right_child->entries, move_bytes); \
+                _TREEMAP_INSTRUMENT(map->_counters.n_merges++; map->_counters.bytes_moved += move_bytes;) \
                 move_bytes = (child_n+1) * sizeof(_##TREEMAP_NAME##NodeEntry); \
                 memmove(right_child->entries, current_child->entries, move_bytes); \
+                _TREEMAP_INSTRUMENT(map->_counters.bytes_moved += move_bytes;) \
                 right_child->entries[child_n].entry = current_node->entries[ind].entry; \
                 free(current_child); \
                 move_bytes = (current_node->n_entries-- - ind) * sizeof(_##TREEMAP_NAME##NodeEntry); \
                 memmove(current_node->entries + ind, current_node->entries + ind+1, move_bytes); \
+                _TREEMAP_INSTRUMENT(map->_counters.bytes_moved += move_bytes;) \
                 right_child->n_entries += child_n + 1; \
+                _TRACE(_TRACE_EMIT(TRACE_TREEMAP_MERGE, treemap_merge, #TREEMAP_NAME, map, (size_t) child_n, (size_t) right_child->n_entries, _trace_start);) \
             } \
             \
             unbalanced = current_node->n_entries < min_entries; \
             --stack_size; \
         } \
         \
-        if (map->_root->n_entries == 0) { \
+        if (map->_root->n_entries == 0 && !map->_root->is_leaf) { \
             _##TREEMAP_NAME##Node* old_root = map->_root; \
             map->_root = old_root->entries[0].lt_child; \
             free(old_root); \
         } \
     } \
+    \
+    \
+    /***************************************************
+     * Do not use this function
+     *
+     * Adds a subtree to the statistics, recursively
+     ***************************************************/ \
+    static void _##TREEMAP_NAME##_stats_helper(const _##TREEMAP_NAME##Node* node, size_t level, TreeMapStats* out) \
+    { \
+        out->n_nodes++; \
+        out->n_leaves += node->is_leaf; \
+        if (level + 1 > out->height) \
+            out->height = level + 1; \
+        out->nodes_per_level[level < _TREEMAP_STATS_MAX_HEIGHT ? level : _TREEMAP_STATS_MAX_HEIGHT - 1]++; \
+        double fill = node->n_entries / (double) (_TREEMAP_M - 1); \
+        int bucket = (int) (fill * _TREEMAP_STATS_FILL_BUCKETS); \
+        out->fill_histogram[bucket < _TREEMAP_STATS_FILL_BUCKETS ? bucket : _TREEMAP_STATS_FILL_BUCKETS - 1]++; \
+        out->mean_fill += fill; \
+        if (!node->is_leaf) { \
+            for (int i = 0; i < node->n_entries+1; i++) \
+                _##TREEMAP_NAME##_stats_helper(node->entries[i].lt_child, level + 1, out); \
+        } \
+    } \
+    \
+    \
+    /*****************************************************************************
+     * Computes the shape, node fill and memory footprint of the tree
+     *
+     * Visits every node, so this takes time linear in the number of nodes.
+     * The live counters in out->counters are only filled when TREEMAP_INSTRUMENT
+     * is defined, see TreeMapStats for a description of each statistic
+     *****************************************************************************/ \
+    static void TREEMAP_NAME##_stats(const TREEMAP_NAME* map, TreeMapStats* out) \
+    { \
+        assert(map); \
+        assert(out); \
+        memset(out, 0, sizeof(TreeMapStats)); \
+        out->size = map->size; \
+        _##TREEMAP_NAME##_stats_helper(map->_root, 0, out); \
+        out->mean_fill /= out->n_nodes; \
+        out->node_size = sizeof(_##TREEMAP_NAME##Node); \
+        out->bytes_allocated = out->n_nodes * sizeof(_##TREEMAP_NAME##Node); \
+        out->bytes_per_entry = map->size ? out->bytes_allocated / (double) map->size : 0; \
+        _TREEMAP_INSTRUMENT(out->counters = map->_counters;) \
+    } \
+    \
+    \
+    /**************************************************************************
+     * Returns the number of bytes used by the tree, including the owner struct
+     *
+     * Every node has room for _TREEMAP_M entries and child pointers,
+     * leaves included, so this visits every node to count them
+     **************************************************************************/ \
+    static size_t TREEMAP_NAME##_memory_usage(const TREEMAP_NAME* map) \
+    { \
+        TreeMapStats stats; \
+        TREEMAP_NAME##_stats(map, &stats); \
+        return sizeof(TREEMAP_NAME) + stats.bytes_allocated; \
+    } \
+    \
+    \
     /*******************************************************
      * Do not use this function
      *
@@ -559,10 +815,9 @@ typedef struct
                 break; \
             else { \
                 if (current_node->is_leaf) { \
-                    while (ret._stack_size && ret._callstack[ret._stack_size-1].node_ind == current_node->n_entries) { \
+                    while (ret._stack_size && ret._callstack[ret._stack_size-1].node_ind \
+                                == ret._callstack[ret._stack_size-1].node->n_entries) \
                         ret._stack_size--; \
-                        current_node = ret._callstack[ret._stack_size-1].node; \
-                    } \
                     break; \
                 } \
                 current_node = current_node->entries[i].lt_child; \
@@ -631,5 +886,153 @@ typedef struct
         _##TREEMAP_NAME##IterStackEntry se = iter->_callstack[iter->_stack_size-1]; \
         iter->current = &(se.node->entries[se.node_ind].entry); \
     } \
+    \
+    \
+    /**************************************************************************************
+     * Splits the map into at most k ranges of consecutive entries, and stores
+     * an iterator to the first entry of each range in begins, in key order
+     *
+     * Range i runs from begins[i].current up to, but not including,
+     * begins[i+1].current, and the last range runs to the end of the map.
+     * The ranges are cut at entries of the highest level of the tree that has
+     * at least k-1 entries, so each holds about as many subtrees of the level below.
+     * Returns the number of ranges, which are never empty, fewer than k only
+     * for small maps, and 0 for an empty map
+     *
+     * EXAMPLE USAGE:
+     * ```
+     * MapIter begins[8];
+     * size_t n_ranges = Map_split(&map, begins, 8);
+     * #pragma omp parallel for
+     * for (size_t r = 0; r < n_ranges; r++) {
+     *     const MapEntry* end = r + 1 < n_ranges ? begins[r+1].current : NULL;
+     *     for (MapIter it = begins[r]; it.current != end; MapIter_inc(&it))
+     *         ...
+     * }
+     * ```
+     **************************************************************************************/ \
+    static size_t TREEMAP_NAME##_split(const TREEMAP_NAME* map, TREEMAP_NAME##Iter* begins, size_t k) \
+    { \
+        assert(map != NULL); \
+        assert(begins != NULL || k == 0); \
+        if (map->size == 0 || k == 0) \
+            return 0; \
+        size_t n_level = 1; \
+        size_t n_entries = map->_root->n_entries; \
+        _##TREEMAP_NAME##Node** level = malloc(sizeof(_##TREEMAP_NAME##Node*)); \
+        assert(level); \
+        level[0] = map->_root; \
+        while (n_entries + 1 < k && !level[0]->is_leaf) { \
+            size_t n_children = n_entries + n_level; \
+            _##TREEMAP_NAME##Node** children = malloc(n_children * sizeof(_##TREEMAP_NAME##Node*)); \
+            assert(children); \
+            n_entries = 0; \
+            size_t c = 0; \
+            for (size_t i = 0; i < n_level; i++) { \
+                for (int j = 0; j < level[i]->n_entries+1; j++) { \
+                    children[c] = level[i]->entries[j].lt_child; \
+                    n_entries += children[c++]->n_entries; \
+                } \
+            } \
+            free(level); \
+            level = children; \
+            n_level = n_children; \
+        } \
+        \
+        /* entries of inner nodes have a subtree before them, so the first range starts at the minimum */ \
+        bool is_leaf = level[0]->is_leaf; \
+        size_t n_cuts = is_leaf ? n_entries : n_entries + 1; \
+        size_t n_ranges = n_cuts < k ? n_cuts : k; \
+        size_t r = 0; \
+        if (!is_leaf) \
+            begins[r++] = TREEMAP_NAME##_min_iter(map); \
+        size_t pos = 0; \
+        for (size_t i = 0; i < n_level && r < n_ranges; i++) { \
+            for (int j = 0; j < level[i]->n_entries && r < n_ranges; j++, pos++) { \
+                size_t cut = is_leaf ? r * n_entries / n_ranges : r * (n_entries + 1) / n_ranges - 1; \
+                if (pos == cut) \
+                    begins[r++] = TREEMAP_NAME##_iter(map, (const TREEMAP_KEY_TYPE*) &level[i]->entries[j].entry.key); \
+            } \
+        } \
+        free(level); \
+        assert(r == n_ranges); \
+        return n_ranges; \
+    } \
+    \
+    \
+    /************************************************************************************
+     * Calls fn on every entry of the map, together with ctx
+     *
+     * The map is split into _TREEMAP_PARALLEL_RANGES_PER_THREAD ranges per thread,
+     * see TREEMAP_NAME##_split, which are handed out to the threads of an OpenMP
+     * parallel region as they finish their previous one. Without -fopenmp it runs
+     * on the calling thread. fn is called from several threads at once, in no
+     * particular order between ranges, and must not insert or remove entries,
+     * or change keys. Must not be called from inside an OpenMP parallel region
+     ************************************************************************************/ \
+    static void TREEMAP_NAME##_parallel_for_each(TREEMAP_NAME* map, \
+        void (*fn)(TREEMAP_NAME##Entry* entry, void* ctx), void* ctx) \
+    { \
+        assert(map != NULL && fn != NULL); \
+        size_t k = _TREEMAP_MAX_THREADS() * _TREEMAP_PARALLEL_RANGES_PER_THREAD; \
+        TREEMAP_NAME##Iter* begins = malloc(k * sizeof(TREEMAP_NAME##Iter)); \
+        assert(begins); \
+        size_t n_ranges = TREEMAP_NAME##_split(map, begins, k); \
+        _Pragma("omp parallel for schedule(dynamic)") \
+        for (size_t r = 0; r < n_ranges; r++) { \
+            const TREEMAP_NAME##Entry* end = r + 1 < n_ranges ? begins[r+1].current : NULL; \
+            for (TREEMAP_NAME##Iter it = begins[r]; it.current != end; TREEMAP_NAME##Iter_inc(&it)) \
+                fn(it.current, ctx); \
+        } \
+        free(begins); \
+    } \
+    \
+    \
+    /*******************************************************************************************
+     * Folds every entry of the map into acc, an accumulator of acc_size bytes
+     *
+     * acc must hold the identity of the reduction when called. Every thread starts
+     * from a copy of it, calls add for the entries of its ranges in key order, as in
+     * parallel_for_each, and finally calls merge to combine its copy into acc, one
+     * thread at a time. Threads merge in no particular order, so merge should be
+     * commutative and associative. Must not be called from inside an OpenMP parallel region
+     *
+     * EXAMPLE USAGE:
+     * ```
+     * static void add(void* acc, const MapEntry* entry) { *(double*) acc += entry->value; }
+     * static void merge(void* acc, const void* other) { *(double*) acc += *(const double*) other; }
+     * ...
+     * double sum = 0;
+     * Map_parallel_reduce(&map, &sum, sizeof(sum), add, merge);
+     * ```
+     *******************************************************************************************/ \
+    static void TREEMAP_NAME##_parallel_reduce(const TREEMAP_NAME* map, void* acc, size_t acc_size, \
+        void (*add)(void* acc, const TREEMAP_NAME##Entry* entry), void (*merge)(void* acc, const void* other)) \
+    { \
+        assert(map != NULL && acc != NULL && add != NULL && merge != NULL); \
+        size_t k = _TREEMAP_MAX_THREADS() * _TREEMAP_PARALLEL_RANGES_PER_THREAD; \
+        TREEMAP_NAME##Iter* begins = malloc(k * sizeof(TREEMAP_NAME##Iter)); \
+        void* identity = malloc(acc_size); \
+        assert(begins && identity); \
+        memcpy(identity, acc, acc_size); \
+        size_t n_ranges = TREEMAP_NAME##_split(map, begins, k); \
+        _Pragma("omp parallel") \
+        { \
+            void* local = malloc(acc_size); \
+            assert(local); \
+            memcpy(local, identity, acc_size); \
+            _Pragma("omp for schedule(dynamic) nowait") \
+            for (size_t r = 0; r < n_ranges; r++) { \
+                const TREEMAP_NAME##Entry* end = r + 1 < n_ranges ? begins[r+1].current : NULL; \
+                for (TREEMAP_NAME##Iter it = begins[r]; it.current != end; TREEMAP_NAME##Iter_inc(&it)) \
+                    add(local, it.current); \
+            } \
+            _Pragma("omp critical") \
+            merge(acc, local); \
+            free(local); \
+        } \
+        free(identity); \
+        free(begins); \
+    }
 
 #endif
@@ -0,0 +1,592 @@
+#ifndef TREEMAP_MMAP_H
+#define TREEMAP_MMAP_H
+
+/***************************************************************************************
+ * Read-only on-disk snapshots of TreeMaps, opened with mmap
+ *
+ * A snapshot is a B-tree packed into fixed size nodes of _TREEMAP_MMAP_PAGE_SIZE
+ * bytes (or a multiple of it, for very large entries), following a header of one
+ * page, so every node starts on a page boundary. Children are referenced by their
+ * offset in the file instead of by pointers.
+ *
+ * Snapshots are written from a TreeMap in sorted order, filling every node
+ * completely, bottom up. Leaves store no child offsets, so they fit more entries
+ * than inner nodes. Only the last leaf and the inner nodes on the right edge of
+ * the tree may be less than full, and the last leaf may be empty.
+ *
+ * The reader maps the file, and follows offsets into the mapping as it goes, so
+ * only the pages that are touched are ever read from disk. Searches, range scans
+ * and floor and ceil queries work on snapshots larger than memory, backed only
+ * by the page cache.
+ *
+ * Keys and values are stored in place, so they must not contain pointers.
+ * Files are only portable between machines with the same byte order and ABI.
+ * Requires POSIX (mmap).
+ ***************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "treemap.h"
+
+// size of the file header, node sizes are a multiple of this
+#ifndef _TREEMAP_MMAP_PAGE_SIZE
+#define _TREEMAP_MMAP_PAGE_SIZE 4096
+#endif
+
+// nodes are made larger than a page if fewer entries than this would fit in an inner node
+#define _TREEMAP_MMAP_MIN_FANOUT 4
+
+// deepest snapshot that can be written and iterated
+#define _TREEMAP_MMAP_MAX_HEIGHT 32
+
+#define _TREEMAP_MMAP_MAGIC "TREEMAP"
+#define _TREEMAP_MMAP_VERSION 1
+
+/******************************************************************************
+ * Layout of a node in the file
+ *
+ * The header is followed by the entries in leaves, and by n_entries+1
+ * child offsets and then the entries in inner nodes.
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t n_entries;
+    uint32_t is_leaf;
+    uint64_t _padding;
+} _TreeMapMmapNode;
+
+/*************************************************
+ * Sizes and capacities of the nodes of a file
+ *************************************************/
+typedef struct
+{
+    uint64_t node_size;
+    uint64_t leaf_capacity;
+    uint64_t inner_capacity;
+    uint64_t inner_entries_offset;  // offset of the entries within inner nodes
+} _TreeMapMmapLayout;
+
+/***************************************************
+ * Header at the start of every TreeMap snapshot
+ ***************************************************/
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // 0x01020304 written in native byte order
+    uint64_t header_size;
+    uint64_t key_size;
+    uint64_t value_size;
+    uint64_t entry_size;
+    _TreeMapMmapLayout layout;
+    uint64_t size;              // number of entries
+    uint64_t n_nodes;
+    uint64_t height;
+    uint64_t root;              // offset of the root node
+} TreeMapFileHeader;
+
+/******************************************************
+ * Do not use this function
+ *
+ * Computes the layout of nodes holding entries of
+ * entry_size bytes
+ ******************************************************/
+static _TreeMapMmapLayout _treemap_mmap_layout(size_t entry_size)
+{
+    _TreeMapMmapLayout layout;
+    size_t header = sizeof(_TreeMapMmapNode);
+    for (layout.node_size = _TREEMAP_MMAP_PAGE_SIZE;; layout.node_size += _TREEMAP_MMAP_PAGE_SIZE) {
+        /* one more child offset than entries, and up to 15 bytes to align the entries */
+        layout.inner_capacity = (layout.node_size - header - sizeof(uint64_t) - 15) / (sizeof(uint64_t) + entry_size);
+        if (layout.inner_capacity >= _TREEMAP_MMAP_MIN_FANOUT)
+            break;
+    }
+    layout.leaf_capacity = (layout.node_size - header) / entry_size;
+    layout.inner_entries_offset = (header + sizeof(uint64_t) * (layout.inner_capacity + 1) + 15) / 16 * 16;
+    return layout;
+}
+
+
+/*******************************************************************************
+ * Generates functions to write snapshots of a TreeMap, and to read them
+ *
+ * @param TREEMAP_NAME a TreeMap type defined with TREEMAP_DEFINE
+ * @param TREEMAP_KEY_TYPE the key type passed to TREEMAP_DEFINE
+ * @param TREEMAP_KEY_CMP the comparison function passed to TREEMAP_DEFINE
+ *******************************************************************************/
+#define TREEMAP_MMAP_DEFINE(TREEMAP_NAME, TREEMAP_KEY_TYPE, TREEMAP_KEY_CMP) \
+    typedef struct \
+    { \
+        size_t size; \
+        size_t height; \
+        const char* _mapping; \
+        size_t _mapping_size; \
+        const _TreeMapMmapNode* _root; \
+        _TreeMapMmapLayout _layout; \
+    } TREEMAP_NAME##Snapshot; \
+    \
+    typedef struct \
+    { \
+        const _TreeMapMmapNode* node; \
+        size_t ind; \
+    } _##TREEMAP_NAME##SnapshotStackEntry; \
+    \
+    typedef struct \
+    { \
+        const TREEMAP_NAME##Entry* current; \
+        const TREEMAP_NAME##Snapshot* _snapshot; \
+        size_t _stack_size; \
+        _##TREEMAP_NAME##SnapshotStackEntry _stack[_TREEMAP_MMAP_MAX_HEIGHT]; \
+    } TREEMAP_NAME##SnapshotIter; \
+    \
+    \
+    /***********************************************
+     * Do not use this function
+     *
+     * Returns the entries of a node in a buffer or
+     * mapping with the given layout
+     ***********************************************/ \
+    static TREEMAP_NAME##Entry* _##TREEMAP_NAME##_mmap_entries(const _TreeMapMmapLayout* layout, const _TreeMapMmapNode* node) \
+    { \
+        size_t offset = node->is_leaf ? sizeof(_TreeMapMmapNode) : layout->inner_entries_offset; \
+        return (TREEMAP_NAME##Entry*) ((char*) node + offset); \
+    } \
+    \
+    /*************************************************
+     * Do not use this function
+     *
+     * Returns the child offsets of an inner node
+     *************************************************/ \
+    static uint64_t* _##TREEMAP_NAME##_mmap_children(const _TreeMapMmapNode* node) \
+    { \
+        return (uint64_t*) ((char*) node + sizeof(_TreeMapMmapNode)); \
+    } \
+    \
+    \
+    /*******************************************************
+     * Do not use this function
+     *
+     * Appends a node to the file, and empties the buffer
+     *******************************************************/ \
+    static uint64_t _##TREEMAP_NAME##_mmap_write_node(FILE* file, TreeMapFileHeader* header, _TreeMapMmapNode* node, bool* ok) \
+    { \
+        uint64_t offset = header->header_size + header->n_nodes * header->layout.node_size; \
+        *ok = *ok && fwrite(node, header->layout.node_size, 1, file) == 1; \
+        header->n_nodes++; \
+        uint32_t is_leaf = node->is_leaf; \
+        memset(node, 0, header->layout.node_size); \
+        node->is_leaf = is_leaf; \
+        return offset; \
+    } \
+    \
+    \
+    /*******************************************************************************
+     * Writes a snapshot of the map to a file, to be opened with
+     * TREEMAP_NAME##Snapshot_open
+     *
+     * The entries are visited in order, and packed into full nodes bottom up,
+     * so the snapshot is smaller and shallower than the map itself.
+     * Memory use is one node buffer per level
+     *
+     * @returns false if the file could not be written
+     *******************************************************************************/ \
+    static bool TREEMAP_NAME##_save(const TREEMAP_NAME* map, const char* path) \
+    { \
+        assert(map); \
+        assert(path); \
+        static_assert(_Alignof(TREEMAP_NAME##Entry) <= 16, "entries must be at most 16 byte aligned"); \
+        union \
+        { \
+            TreeMapFileHeader header; \
+            unsigned char bytes[_TREEMAP_MMAP_PAGE_SIZE]; \
+        } header; \
+        memset(&header, 0, sizeof(header)); \
+        memcpy(header.header.magic, _TREEMAP_MMAP_MAGIC, sizeof(_TREEMAP_MMAP_MAGIC)); \
+        header.header.version = _TREEMAP_MMAP_VERSION; \
+        header.header.byte_order = 0x01020304; \
+        header.header.header_size = _TREEMAP_MMAP_PAGE_SIZE; \
+        header.header.key_size = sizeof(((TREEMAP_NAME##Entry*) NULL)->key); \
+        header.header.value_size = sizeof(((TREEMAP_NAME##Entry*) NULL)->value); \
+        header.header.entry_size = sizeof(TREEMAP_NAME##Entry); \
+        header.header.layout = _treemap_mmap_layout(sizeof(TREEMAP_NAME##Entry)); \
+        header.header.size = map->size; \
+        const _TreeMapMmapLayout* layout = &header.header.layout; \
+        \
+        FILE* file = fopen(path, "wb"); \
+        if (!file) \
+            return false; \
+        /* the header is written again at the end, once the root is known */ \
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1; \
+        \
+        /* levels[0] is the leaf being filled, levels[i] the inner node being filled at height i */ \
+        _TreeMapMmapNode* levels[_TREEMAP_MMAP_MAX_HEIGHT]; \
+        size_t n_levels = 1; \
+        levels[0] = calloc(1, layout->node_size); \
+        assert(levels[0]); \
+        levels[0]->is_leaf = 1; \
+        \
+        for (TREEMAP_NAME##Iter it = TREEMAP_NAME##_min_iter(map); it.current; TREEMAP_NAME##Iter_inc(&it)) { \
+            _TreeMapMmapNode* leaf = levels[0]; \
+            if (leaf->n_entries < layout->leaf_capacity) { \
+                _##TREEMAP_NAME##_mmap_entries(layout, leaf)[leaf->n_entries++] = *it.current; \
+                continue; \
+            } \
+            /* the leaf is full, so this entry separates it from the next leaf in the parent */ \
+            uint64_t child = _##TREEMAP_NAME##_mmap_write_node(file, &header.header, leaf, &ok); \
+            for (size_t level = 1;; level++) { \
+                if (level == n_levels) { \
+                    assert(n_levels < _TREEMAP_MMAP_MAX_HEIGHT); \
+                    levels[n_levels++] = calloc(1, layout->node_size); \
+                    assert(levels[level]); \
+                } \
+                _TreeMapMmapNode* node = levels[level]; \
+                _##TREEMAP_NAME##_mmap_children(node)[node->n_entries] = child; \
+                if (node->n_entries < layout->inner_capacity) { \
+                    _##TREEMAP_NAME##_mmap_entries(layout, node)[node->n_entries++] = *it.current; \
+                    break; \
+                } \
+                child = _##TREEMAP_NAME##_mmap_write_node(file, &header.header, node, &ok); \
+            } \
+        } \
+        \
+        /* close the nodes on the right edge, empty inner nodes are left out */ \
+        uint64_t child = _##TREEMAP_NAME##_mmap_write_node(file, &header.header, levels[0], &ok); \
+        for (size_t level = 1; level < n_levels; level++) { \
+            _TreeMapMmapNode* node = levels[level]; \
+            if (node->n_entries > 0) { \
+                _##TREEMAP_NAME##_mmap_children(node)[node->n_entries] = child; \
+                child = _##TREEMAP_NAME##_mmap_write_node(file, &header.header, node, &ok); \
+            } \
+        } \
+        for (size_t level = 0; level < n_levels; level++) \
+            free(levels[level]); \
+        header.header.root = child; \
+        header.header.height = n_levels; \
+        \
+        ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1; \
+        return fclose(file) == 0 && ok; \
+    } \
+    \
+    \
+    /*****************************************************************************
+     * Opens a snapshot written by TREEMAP_NAME##_save, without reading it
+     *
+     * Must be released with TREEMAP_NAME##Snapshot_close
+     *
+     * @returns false if the file could not be opened, or was not written
+     *    by a map with the same key and value sizes
+     *****************************************************************************/ \
+    static bool TREEMAP_NAME##Snapshot_open(TREEMAP_NAME##Snapshot* snapshot, const char* path) \
+    { \
+        assert(snapshot); \
+        assert(path); \
+        int fd = open(path, O_RDONLY); \
+        if (fd < 0) \
+            return false; \
+        struct stat st; \
+        if (fstat(fd, &st) != 0 || (size_t) st.st_size < _TREEMAP_MMAP_PAGE_SIZE) { \
+            close(fd); \
+            return false; \
+        } \
+        void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0); \
+        close(fd); \
+        if (mapping == MAP_FAILED) \
+            return false; \
+        \
+        const TreeMapFileHeader* header = mapping; \
+        _TreeMapMmapLayout layout = _treemap_mmap_layout(sizeof(TREEMAP_NAME##Entry)); \
+        bool ok = memcmp(header->magic, _TREEMAP_MMAP_MAGIC, sizeof(_TREEMAP_MMAP_MAGIC)) == 0 \
+               && header->version == _TREEMAP_MMAP_VERSION \
+               && header->byte_order == 0x01020304 \
+               && header->header_size == _TREEMAP_MMAP_PAGE_SIZE \
+               && header->key_size == sizeof(((TREEMAP_NAME##Entry*) NULL)->key) \
+               && header->value_size == sizeof(((TREEMAP_NAME##Entry*) NULL)->value) \
+               && header->entry_size == sizeof(TREEMAP_NAME##Entry) \
+               && memcmp(&header->layout, &layout, sizeof(layout)) == 0 \
+               && header->height <= _TREEMAP_MMAP_MAX_HEIGHT \
+               && (size_t) st.st_size == header->header_size + header->n_nodes * layout.node_size \
+               && header->root >= header->header_size && header->root < (size_t) st.st_size; \
+        if (!ok) { \
+            munmap(mapping, st.st_size); \
+            return false; \
+        } \
+        snapshot->size = header->size; \
+        snapshot->height = header->height; \
+        snapshot->_mapping = mapping; \
+        snapshot->_mapping_size = st.st_size; \
+        snapshot->_root = (const _TreeMapMmapNode*) ((const char*) mapping + header->root); \
+        snapshot->_layout = layout; \
+        return true; \
+    } \
+    \
+    \
+    /*****************************************************
+     * Unmaps a snapshot, it must not be used after this
+     *****************************************************/ \
+    static void TREEMAP_NAME##Snapshot_close(TREEMAP_NAME##Snapshot* snapshot) \
+    { \
+        assert(snapshot); \
+        munmap((void*) snapshot->_mapping, snapshot->_mapping_size); \
+    } \
+    \
+    \
+    /*********************************************************
+     * Do not use this function
+     *
+     * Returns the child at index i of an inner node
+     *********************************************************/ \
+    static const _TreeMapMmapNode* _##TREEMAP_NAME##Snapshot_child(const TREEMAP_NAME##Snapshot* snapshot, const _TreeMapMmapNode* node, size_t i) \
+    { \
+        return (const _TreeMapMmapNode*) (snapshot->_mapping + _##TREEMAP_NAME##_mmap_children(node)[i]); \
+    } \
+    \
+    \
+    /********************************************************************
+     * Do not use this function
+     *
+     * Binary search for the first entry of a node not less than key.
+     * Sets *found if that entry is equal to key
+     ********************************************************************/ \
+    static size_t _##TREEMAP_NAME##Snapshot_lower_bound(const TREEMAP_NAME##Snapshot* snapshot, const _TreeMapMmapNode* node, \
+                                                        const TREEMAP_KEY_TYPE* key, bool* found) \
+    { \
+        const TREEMAP_NAME##Entry* entries = _##TREEMAP_NAME##_mmap_entries(&snapshot->_layout, node); \
+        size_t lo = 0, hi = node->n_entries; \
+        while (lo < hi) { \
+            size_t mid = lo + (hi - lo) / 2; \
+            if (TREEMAP_KEY_CMP((&entries[mid].key), (key)) < 0) \
+                lo = mid + 1; \
+            else \
+                hi = mid; \
+        } \
+        *found = lo < node->n_entries && TREEMAP_KEY_CMP((key), (&entries[lo].key)) == 0; \
+        return lo; \
+    } \
+    \
+    \
+    /********************************************************************
+     * Returns the entry with the given key, or NULL if it is not found.
+     * The entry points into the read-only mapping
+     ********************************************************************/ \
+    static const TREEMAP_NAME##Entry* TREEMAP_NAME##Snapshot_search(const TREEMAP_NAME##Snapshot* snapshot, \
+                                                                    const TREEMAP_KEY_TYPE* key) \
+    { \
+        assert(snapshot); \
+        assert(key); \
+        const _TreeMapMmapNode* node = snapshot->_root; \
+        for (;;) { \
+            bool found; \
+            size_t i = _##TREEMAP_NAME##Snapshot_lower_bound(snapshot, node, key, &found); \
+            if (found) \
+                return _##TREEMAP_NAME##_mmap_entries(&snapshot->_layout, node) + i; \
+            if (node->is_leaf) \
+                return NULL; \
+            node = _##TREEMAP_NAME##Snapshot_child(snapshot, node, i); \
+        } \
+    } \
+    \
+    \
+    /*******************************************
+     * Checks if a key is present in the snapshot
+     *******************************************/ \
+    static bool TREEMAP_NAME##Snapshot_contains(const TREEMAP_NAME##Snapshot* snapshot, const TREEMAP_KEY_TYPE* key) \
+    { \
+        return TREEMAP_NAME##Snapshot_search(snapshot, key) != NULL; \
+    } \
+    \
+    \
+    /************************************************************************
+     * Do not use this function
+     *
+     * Iterator positions are a stack of (node, index). The top holds the
+     * current entry, the entries below hold the child that was descended
+     * into. Descends from node to its minimum or maximum leaf
+     ************************************************************************/ \
+    static void _##TREEMAP_NAME##SnapshotIter_descend(TREEMAP_NAME##SnapshotIter* iter, const _TreeMapMmapNode* node, bool to_min) \
+    { \
+        for (;;) { \
+            size_t ind = to_min ? 0 : node->n_entries; \
+            assert(iter->_stack_size < _TREEMAP_MMAP_MAX_HEIGHT); \
+            iter->_stack[iter->_stack_size++] = (_##TREEMAP_NAME##SnapshotStackEntry) {node, ind}; \
+            if (node->is_leaf) \
+                return; \
+            node = _##TREEMAP_NAME##Snapshot_child(iter->_snapshot, node, ind); \
+        } \
+    } \
+    \
+    /***********************************************************************
+     * Do not use this function
+     *
+     * Moves up from an index past the end of a node, to the next entry
+     ***********************************************************************/ \
+    static void _##TREEMAP_NAME##SnapshotIter_settle_forward(TREEMAP_NAME##SnapshotIter* iter) \
+    { \
+        while (iter->_stack_size && iter->_stack[iter->_stack_size-1].ind >= iter->_stack[iter->_stack_size-1].node->n_entries) \
+            iter->_stack_size--; \
+        if (!iter->_stack_size) { \
+            iter->current = NULL; \
+            return; \
+        } \
+        _##TREEMAP_NAME##SnapshotStackEntry* top = iter->_stack + (iter->_stack_size-1); \
+        iter->current = _##TREEMAP_NAME##_mmap_entries(&iter->_snapshot->_layout, top->node) + top->ind; \
+    } \
+    \
+    /***********************************************************************
+     * Do not use this function
+     *
+     * Moves to the entry before the index at the top of the stack
+     ***********************************************************************/ \
+    static void _##TREEMAP_NAME##SnapshotIter_settle_back(TREEMAP_NAME##SnapshotIter* iter) \
+    { \
+        while (iter->_stack_size && iter->_stack[iter->_stack_size-1].ind == 0) \
+            iter->_stack_size--; \
+        if (!iter->_stack_size) { \
+            iter->current = NULL; \
+            return; \
+        } \
+        _##TREEMAP_NAME##SnapshotStackEntry* top = iter->_stack + (iter->_stack_size-1); \
+        top->ind--; \
+        iter->current = _##TREEMAP_NAME##_mmap_entries(&iter->_snapshot->_layout, top->node) + top->ind; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns an iterator starting at the minimum element
+     *
+     * Does not own any memory, so no deallocation is needed afterwards
+     *******************************************************************/ \
+    static TREEMAP_NAME##SnapshotIter TREEMAP_NAME##Snapshot_min_iter(const TREEMAP_NAME##Snapshot* snapshot) \
+    { \
+        assert(snapshot); \
+        TREEMAP_NAME##SnapshotIter ret; \
+        ret.current = NULL; \
+        ret._snapshot = snapshot; \
+        ret._stack_size = 0; \
+        _##TREEMAP_NAME##SnapshotIter_descend(&ret, snapshot->_root, true); \
+        _##TREEMAP_NAME##SnapshotIter_settle_forward(&ret); \
+        return ret; \
+    } \
+    \
+    \
+    /*******************************************************************
+     * Returns an iterator starting at the maximum element
+     *******************************************************************/ \
+    static TREEMAP_NAME##SnapshotIter TREEMAP_NAME##Snapshot_max_iter(const TREEMAP_NAME##Snapshot* snapshot) \
+    { \
+        assert(snapshot); \
+        TREEMAP_NAME##SnapshotIter ret; \
+        ret.current = NULL; \
+        ret._snapshot = snapshot; \
+        ret._stack_size = 0; \
+        _##TREEMAP_NAME##SnapshotIter_descend(&ret, snapshot->_root, false); \
+        _##TREEMAP_NAME##SnapshotIter_settle_back(&ret); \
+        return ret; \
+    } \
+    \
+    \
+    /*****************************************************************
+     * Do not use this function
+     *
+     * Descends to key, and stops at the entry equal to key, or at
+     * the position in a leaf where key would be inserted
+     *****************************************************************/ \
+    static bool _##TREEMAP_NAME##SnapshotIter_seek(TREEMAP_NAME##SnapshotIter* iter, const TREEMAP_KEY_TYPE* key) \
+    { \
+        const _TreeMapMmapNode* node = iter->_snapshot->_root; \
+        for (;;) { \
+            bool found; \
+            size_t i = _##TREEMAP_NAME##Snapshot_lower_bound(iter->_snapshot, node, key, &found); \
+            assert(iter->_stack_size < _TREEMAP_MMAP_MAX_HEIGHT); \
+            iter->_stack[iter->_stack_size++] = (_##TREEMAP_NAME##SnapshotStackEntry) {node, i}; \
+            if (found) { \
+                iter->current = _##TREEMAP_NAME##_mmap_entries(&iter->_snapshot->_layout, node) + i; \
+                return true; \
+            } \
+            if (node->is_leaf) \
+                return false; \
+            node = _##TREEMAP_NAME##Snapshot_child(iter->_snapshot, node, i); \
+        } \
+    } \
+    \
+    \
+    /*********************************************
+     * Returns an iterator starting at the
+     * maximum element less than or equal to key
+     *********************************************/ \
+    static TREEMAP_NAME##SnapshotIter TREEMAP_NAME##Snapshot_floor_iter(const TREEMAP_NAME##Snapshot* snapshot, \
+                                                                        const TREEMAP_KEY_TYPE* key) \
+    { \
+        assert(snapshot); \
+        assert(key); \
+        TREEMAP_NAME##SnapshotIter ret; \
+        ret.current = NULL; \
+        ret._snapshot = snapshot; \
+        ret._stack_size = 0; \
+        if (!_##TREEMAP_NAME##SnapshotIter_seek(&ret, key)) \
+            _##TREEMAP_NAME##SnapshotIter_settle_back(&ret); \
+        return ret; \
+    } \
+    \
+    \
+    /************************************************
+     * Returns an iterator starting at the
+     * minimum element greater than or equal to key
+     ************************************************/ \
+    static TREEMAP_NAME##SnapshotIter TREEMAP_NAME##Snapshot_ceil_iter(const TREEMAP_NAME##Snapshot* snapshot, \
+                                                                       const TREEMAP_KEY_TYPE* key) \
+    { \
+        assert(snapshot); \
+        assert(key); \
+        TREEMAP_NAME##SnapshotIter ret; \
+        ret.current = NULL; \
+        ret._snapshot = snapshot; \
+        ret._stack_size = 0; \
+        if (!_##TREEMAP_NAME##SnapshotIter_seek(&ret, key)) \
+            _##TREEMAP_NAME##SnapshotIter_settle_forward(&ret); \
+        return ret; \
+    } \
+    \
+    \
+    /**************************************************************
+     * sets the field current to be the next element,
+     * if there are no more elements, current is set to NULL
+     **************************************************************/ \
+    static void TREEMAP_NAME##SnapshotIter_inc(TREEMAP_NAME##SnapshotIter* iter) \
+    { \
+        assert(iter); \
+        if (!iter->current) \
+            return; \
+        _##TREEMAP_NAME##SnapshotStackEntry* top = iter->_stack + (iter->_stack_size-1); \
+        top->ind++; \
+        if (!top->node->is_leaf) \
+            _##TREEMAP_NAME##SnapshotIter_descend(iter, _##TREEMAP_NAME##Snapshot_child(iter->_snapshot, top->node, top->ind), true); \
+        _##TREEMAP_NAME##SnapshotIter_settle_forward(iter); \
+    } \
+    \
+    \
+    /**************************************************************
+     * sets the field current to be the previous element,
+     * if there are no more elements, current is set to NULL
+     **************************************************************/ \
+    static void TREEMAP_NAME##SnapshotIter_dec(TREEMAP_NAME##SnapshotIter* iter) \
+    { \
+        assert(iter); \
+        if (!iter->current) \
+            return; \
+        _##TREEMAP_NAME##SnapshotStackEntry* top = iter->_stack + (iter->_stack_size-1); \
+        if (!top->node->is_leaf) \
+            _##TREEMAP_NAME##SnapshotIter_descend(iter, _##TREEMAP_NAME##Snapshot_child(iter->_snapshot, top->node, top->ind), false); \
+        _##TREEMAP_NAME##SnapshotIter_settle_back(iter); \
+    }
+
+#endif
@@ -6,6 +6,26 @@
 #include <stddef.h>
 #include <string.h>
 
+#include "trace.h"
+
+/* 
+ * Allocation functions used by Vec
+ * Define VEC_USE_HUGEALLOC before including this header to back
+ * all Vecs with mmap and huge pages, see hugealloc.h
+ */
+#ifdef VEC_USE_HUGEALLOC
+#include "hugealloc.h"
+#define _VEC_MALLOC hugealloc_malloc
+#define _VEC_CALLOC hugealloc_calloc
+#define _VEC_REALLOC hugealloc_realloc
+#define _VEC_FREE hugealloc_free
+#else
+#define _VEC_MALLOC malloc
+#define _VEC_CALLOC calloc
+#define _VEC_REALLOC realloc
+#define _VEC_FREE free
+#endif
+
 /*****************************************************************************
 * Generates declarations for a new Vec datastructure
 *
@@ -33,13 +53,55 @@
     ***********************************************/ \
     VEC_NAME VEC_NAME##_new(size_t initial_size); \
     \
+    /***************************************************************
+    * Makes a new Vec filled with zeroes, identical to VEC_NAME##_new
+    *
+    * Only the first initial_size elements are guaranteed to be zero
+    *
+    * @param initial_size initial size of the Vec 
+    ****************************************************************/ \
+    VEC_NAME VEC_NAME##_new_zeroed(size_t initial_size); \
+    \
+    /*********************************************************************
+    * Makes a new empty Vec, with room for at least `capacity` elements
+    *
+    * The memory is not initialized, so no pages are touched until 
+    * elements are pushed
+    **********************************************************************/ \
+    VEC_NAME VEC_NAME##_with_capacity(size_t capacity); \
+    \
     /**************************************************
      * Creates a new Vector that is a copy of another
      *
+     * Only the stored elements are copied, the capacity
+     * of the copy is exactly its size, or 1 if it is empty
+     *
      * @param copy_from valid initialized vector
      **************************************************/ \
     VEC_NAME VEC_NAME##_copy(const VEC_NAME* copy_from); \
     \
+    /*******************************************************************************
+    * Sets the size of the Vec, growing the underlying array if needed
+    *
+    * Any new elements are left uninitialized, and must be written by the caller
+    * before they are read. If new_size is smaller than the current size, 
+    * the Vec is truncated, but the underlying array is not shrunk
+    ********************************************************************************/ \
+    void VEC_NAME##_resize_uninit(VEC_NAME* vec, size_t new_size); \
+    \
+    /*******************************************************************************
+    * Grows the underlying array to hold at least capacity elements,
+    * so that pushes up to that size do not reallocate. Never shrinks it
+    ********************************************************************************/ \
+    void VEC_NAME##_reserve(VEC_NAME* vec, size_t capacity); \
+    \
+    /*******************************************************************************
+    * Appends n values to the back of the Vec, copied with a single memcpy
+    *
+    * The underlying array is grown at most once
+    ********************************************************************************/ \
+    void VEC_NAME##_extend(VEC_NAME* vec, const VEC_VAL_TYPE* values, size_t n); \
+    \
     /*********************************************************************************
     * Pushes a value to the back of the Vec, the value is copied and stored in place
     *
@@ -67,36 +129,90 @@
     * Safe to use after this
     **********************************/ \
     void VEC_NAME##_clear(VEC_NAME* vec); \
+    \
+    /*****************************************************************
+    * Returns the number of bytes used by the Vec, including the
+    * owner struct and unused capacity of the underlying array
+    *
+    * Bookkeeping done by the allocator itself is not included
+    ******************************************************************/ \
+    size_t VEC_NAME##_memory_usage(const VEC_NAME* vec); \
 
 
 /* Implementation code for the Vec */
 #define VEC_IMPL(VEC_NAME, VEC_VAL_TYPE) \
     VEC_NAME VEC_NAME##_new(size_t initial_size) \
     { \
-        assert(initial_size >= 0); \
+        return VEC_NAME##_new_zeroed(initial_size); \
+    } \
+    \
+    VEC_NAME VEC_NAME##_new_zeroed(size_t initial_size) \
+    { \
+        if (initial_size == 0) \
+            return VEC_NAME##_with_capacity(1); \
         size_t initial_capacity = 1; \
         for (; initial_capacity < initial_size; initial_capacity <<= 1); \
-        VEC_VAL_TYPE* mem = calloc(initial_capacity, sizeof(VEC_VAL_TYPE)); \
+        VEC_VAL_TYPE* mem = _VEC_CALLOC(initial_capacity, sizeof(VEC_VAL_TYPE)); \
         assert(mem); \
         return (VEC_NAME) {mem, initial_capacity, initial_size}; \
     } \
     \
+    VEC_NAME VEC_NAME##_with_capacity(size_t capacity) \
+    { \
+        size_t initial_capacity = 1; \
+        for (; initial_capacity < capacity; initial_capacity <<= 1); \
+        VEC_VAL_TYPE* mem = _VEC_MALLOC(initial_capacity * sizeof(VEC_VAL_TYPE)); \
+        assert(mem); \
+        return (VEC_NAME) {mem, initial_capacity, 0}; \
+    } \
+    \
     VEC_NAME VEC_NAME##_copy(const VEC_NAME* copy_from) \
     { \
         assert(copy_from); \
-        VEC_VAL_TYPE* mem = calloc(copy_from->_arr_cap, sizeof(VEC_VAL_TYPE)); \
+        size_t capacity = copy_from->size ? copy_from->size : 1; \
+        VEC_VAL_TYPE* mem = _VEC_MALLOC(capacity * sizeof(VEC_VAL_TYPE)); \
         assert(mem); \
         memcpy(mem, copy_from->arr, copy_from->size * sizeof(VEC_VAL_TYPE)); \
-        return (VEC_NAME) {mem, copy_from->_arr_cap, copy_from->size}; \
+        return (VEC_NAME) {mem, capacity, copy_from->size}; \
+    } \
+    \
+    void VEC_NAME##_resize_uninit(VEC_NAME* vec, size_t new_size) \
+    { \
+        assert(vec); \
+        VEC_NAME##_reserve(vec, new_size); \
+        vec->size = new_size; \
+    } \
+    \
+    void VEC_NAME##_reserve(VEC_NAME* vec, size_t capacity) \
+    { \
+        assert(vec); \
+        if (capacity > vec->_arr_cap) { \
+            _TRACE(uint64_t _trace_start = _trace_now_ns(); size_t _trace_old_cap = vec->_arr_cap;) \
+            for (; vec->_arr_cap < capacity; vec->_arr_cap <<= 1); \
+            vec->arr = _VEC_REALLOC(vec->arr, vec->_arr_cap * sizeof(VEC_VAL_TYPE)); \
+            assert(vec->arr); \
+            _TRACE(_TRACE_EMIT(TRACE_VEC_GROW, vec_grow, #VEC_NAME, vec, _trace_old_cap, vec->_arr_cap, _trace_start);) \
+        } \
+    } \
+    \
+    void VEC_NAME##_extend(VEC_NAME* vec, const VEC_VAL_TYPE* values, size_t n) \
+    { \
+        assert(vec); \
+        assert(values || n == 0); \
+        VEC_NAME##_reserve(vec, vec->size + n); \
+        memcpy(vec->arr + vec->size, values, n * sizeof(VEC_VAL_TYPE)); \
+        vec->size += n; \
     } \
     \
     void VEC_NAME##_push(VEC_NAME* vec, VEC_VAL_TYPE value) \
     { \
         assert(vec); \
         if (vec->size == vec->_arr_cap) { \
+            _TRACE(uint64_t _trace_start = _trace_now_ns();) \
             vec->_arr_cap *= 2; \
-            vec->arr = realloc(vec->arr, vec->_arr_cap * sizeof(VEC_VAL_TYPE)); \
+            vec->arr = _VEC_REALLOC(vec->arr, vec->_arr_cap * sizeof(VEC_VAL_TYPE)); \
             assert(vec->arr); \
+            _TRACE(_TRACE_EMIT(TRACE_VEC_GROW, vec_grow, #VEC_NAME, vec, vec->_arr_cap / 2, vec->_arr_cap, _trace_start);) \
         } \
         vec->arr[(vec->size)++] = value; \
     } \
@@ -107,9 +223,11 @@
         assert(vec->size); \
         VEC_VAL_TYPE ret = vec->arr[--(vec->size)]; \
         if (vec->size < vec->_arr_cap / 4) { \
+            _TRACE(uint64_t _trace_start = _trace_now_ns();) \
             vec->_arr_cap /= 2; \
-            vec->arr = realloc(vec->arr, vec->_arr_cap * sizeof(VEC_VAL_TYPE)); \
+            vec->arr = _VEC_REALLOC(vec->arr, vec->_arr_cap * sizeof(VEC_VAL_TYPE)); \
             assert(vec->arr); \
+            _TRACE(_TRACE_EMIT(TRACE_VEC_SHRINK, vec_shrink, #VEC_NAME, vec, vec->_arr_cap * 2, vec->_arr_cap, _trace_start);) \
         } \
         return ret; \
     } \
@@ -117,7 +235,7 @@
     void VEC_NAME##_free(VEC_NAME* vec) \
     { \
         assert(vec); \
-        free(vec->arr); \
+        _VEC_FREE(vec->arr); \
     } \
     \
     void VEC_NAME##_clear(VEC_NAME* vec) \
@@ -125,8 +243,22 @@
         assert(vec); \
         vec->size = 0; \
         vec->_arr_cap = 1; \
-        vec->arr = realloc(vec->arr, sizeof(VEC_VAL_TYPE)); \
+        vec->arr = _VEC_REALLOC(vec->arr, sizeof(VEC_VAL_TYPE)); \
         assert(vec->arr); \
+    } \
+    \
+    size_t VEC_NAME##_memory_usage(const VEC_NAME* vec) \
+    { \
+        assert(vec); \
+        return sizeof(VEC_NAME) + vec->_arr_cap * sizeof(VEC_VAL_TYPE); \
     }
 
+/*****************************************************
+* Generates both declarations and implementation 
+* of a new Vec datastructure, see VEC_DECL for usage
+******************************************************/
+#define VEC_DEFINE(VEC_NAME, VEC_VAL_TYPE) \
+    VEC_DECL(VEC_NAME, VEC_VAL_TYPE) \
+    VEC_IMPL(VEC_NAME, VEC_VAL_TYPE)
+
 #endif
@@ -0,0 +1,309 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <omp.h>
+
+#include "../../datastructures/treemap.h"
+#include "../../datastructures/artmap.h"
+#include "../../datastructures/vec.h"
+#include "../../datastructures/ingest.h"
+
+/******************************************************************************
+ * Checks an ArtMap against a TreeMap for integer and string keys, then
+ * compares their insertion, query and iteration times and memory use on the
+ * datasets of tests/tree_insertion and tests/hashmap_words
+ *
+ * Without input files, n random 32 bit integers are used, and n generated
+ * URLs, which share long prefixes. The integer file is in the format of
+ * tests/nums_generator.py, the words file has one word per line
+ *
+ * usage: ./test [n] [ints_file] [words_file], default 10^6
+ ******************************************************************************/
+
+#define MAX_STR_LEN 200
+
+typedef char* CString;
+
+#define CMP(a, b) (*(a) < *(b) ? -1 : (*(a) == *(b) ? 0 : 1))
+#define STR_CMP(a, b) (strcmp(*(a), *(b)))
+
+TREEMAP_DEFINE(U64Tree, uint64_t, uint64_t, CMP)
+ARTMAP_DEFINE(U64Art, uint64_t, uint64_t, artmap_u64_bytes)
+TREEMAP_DEFINE(IntTree, int32_t, TREEMAP_NO_VALUE, CMP)
+ARTMAP_DEFINE(IntArt, int32_t, TREEMAP_NO_VALUE, artmap_i32_bytes)
+TREEMAP_DEFINE(StrTree, CString, size_t, STR_CMP)
+ARTMAP_DEFINE(StrArt, CString, size_t, artmap_str_bytes)
+VEC_DEFINE(IntVec, int32_t)
+INGEST_DEFINE(IntVec, int32_t)
+VEC_DEFINE(StrVec, CString)
+
+static uint64_t rng_state = 42;
+
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+#define CHECK_AGAINST_TREE(ART, TREE_NAME, ART_NAME, TREE, KEYS, N_KEYS, KEY_EQ) \
+    do { \
+        assert((ART)->size == (TREE)->size); \
+        ART_NAME##Iter it = ART_NAME##_min_iter(ART); \
+        for (TREE_NAME##Iter tit = TREE_NAME##_min_iter(TREE); tit.current; TREE_NAME##Iter_inc(&tit), ART_NAME##Iter_inc(&it)) \
+            assert(it.current && KEY_EQ(&it.current->key, &tit.current->key)); \
+        assert(!it.current); \
+        it = ART_NAME##_max_iter(ART); \
+        for (TREE_NAME##Iter tit = TREE_NAME##_max_iter(TREE); tit.current; TREE_NAME##Iter_dec(&tit), ART_NAME##Iter_dec(&it)) \
+            assert(it.current && KEY_EQ(&it.current->key, &tit.current->key)); \
+        assert(!it.current); \
+        for (size_t i = 0; i < (N_KEYS); i++) { \
+            TREE_NAME##Entry* tree_entry = TREE_NAME##_search(TREE, (KEYS) + i, false); \
+            ART_NAME##Entry* entry = ART_NAME##_search(ART, (KEYS) + i, false); \
+            assert(!tree_entry == !entry && (!entry || entry->value == tree_entry->value)); \
+            assert(ART_NAME##_contains(ART, (KEYS) + i) == !!entry && ART_NAME##_iter(ART, (KEYS) + i).current == entry); \
+            TREE_NAME##Iter tfloor = TREE_NAME##_floor_iter(TREE, (KEYS) + i); \
+            ART_NAME##Iter floor = ART_NAME##_floor_iter(ART, (KEYS) + i); \
+            assert(!tfloor.current == !floor.current && (!floor.current || KEY_EQ(&floor.current->key, &tfloor.current->key))); \
+            TREE_NAME##Iter tceil = TREE_NAME##_ceil_iter(TREE, (KEYS) + i); \
+            ART_NAME##Iter ceil = ART_NAME##_ceil_iter(ART, (KEYS) + i); \
+            assert(!tceil.current == !ceil.current && (!ceil.current || KEY_EQ(&ceil.current->key, &tceil.current->key))); \
+        } \
+    } while (0)
+
+#define NUM_EQ(a, b) (*(a) == *(b))
+#define STR_EQ(a, b) (strcmp(*(a), *(b)) == 0)
+
+// URL of about 50 characters, mostly made of shared parts
+static size_t gen_url(char* out)
+{
+    static const char* hosts[] = {"www.example.com", "docs.example.com", "blog.example.org", "shop.example.net"};
+    static const char* dirs[] = {"articles", "archive", "assets", "api", "users", "products", "static", "search"};
+    uint64_t r = rng_next();
+    int len = sprintf(out, "https://%s/%s/%s/%llu", hosts[r % 4], dirs[(r >> 8) % 8], dirs[(r >> 16) % 8],
+                      (unsigned long long) (rng_next() % 100000000));
+    if ((r >> 24) % 2)
+        len += sprintf(out + len, "/index.html");
+    return (size_t) len;
+}
+
+static void check_integers()
+{
+    for (uint64_t range = 50; range <= (UINT64_C(1) << 40); range <<= 10) {
+        U64Tree tree = U64Tree_new();
+        U64Art art = U64Art_new();
+        uint64_t keys[2000];
+        for (size_t i = 0; i < 2000; i++)
+            keys[i] = (rng_next() % range) << ((i % 3) * 8);
+        for (size_t round = 0; round < 3; round++) {
+            for (size_t i = 0; i < 2000; i++) {
+                uint64_t key = keys[rng_next() % 2000];
+                if (rng_next() % 3 == 0) {
+                    U64Tree_remove(&tree, &key);
+                    U64Art_remove(&art, &key);
+                } else {
+                    U64Tree_insert(&tree, key, i);
+                    U64Art_insert(&art, key, i);
+                }
+            }
+            CHECK_AGAINST_TREE(&art, U64Tree, U64Art, &tree, keys, 2000, NUM_EQ);
+        }
+        for (size_t i = 0; i < 2000; i++) {
+            U64Tree_remove(&tree, keys + i);
+            U64Art_remove(&art, keys + i);
+        }
+        CHECK_AGAINST_TREE(&art, U64Tree, U64Art, &tree, keys, 2000, NUM_EQ);
+        assert(art.size == 0 && U64Art_memory_usage(&art) == sizeof(U64Art));
+        U64Tree_free(&tree);
+        U64Art_free(&art);
+    }
+
+    /* negative keys come first */
+    IntArt art = IntArt_new();
+    int32_t keys[] = {5, -1, INT32_MIN, 0, INT32_MAX, -300, 300};
+    for (size_t i = 0; i < 7; i++)
+        IntArt_search(&art, keys + i, true);
+    int32_t prev = INT32_MIN;
+    size_t n = 0;
+    for (IntArtIter it = IntArt_min_iter(&art); it.current; IntArtIter_inc(&it), n++) {
+        assert(n == 0 || it.current->key > prev);
+        prev = it.current->key;
+    }
+    assert(n == 7);
+    IntArt_free(&art);
+}
+
+static void check_strings()
+{
+    size_t n = 3000;
+    char* buf = malloc(n * 128);
+    CString* keys = malloc(n * sizeof(CString));
+    assert(buf && keys);
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = buf + i * 128;
+        if (i < 100) {
+            /* "", "a", "aa", ... a tree as deep as the longest key */
+            memset(keys[i], 'a', i);
+            keys[i][i] = '\0';
+        } else if (i < 200) {
+            /* prefixes longer than the stored part, differing after it */
+            sprintf(keys[i], "%.*s%zu", (int) (i % 40), "0123456789012345678901234567890123456789", i % 7);
+        } else {
+            gen_url(keys[i]);
+        }
+    }
+
+    StrTree tree = StrTree_new();
+    StrArt art = StrArt_new();
+    for (size_t round = 0; round < 4; round++) {
+        for (size_t i = 0; i < n; i++) {
+            CString key = keys[rng_next() % n];
+            if (round == 3 || rng_next() % 3 == 0) {
+                StrTree_remove(&tree, &key);
+                StrArt_remove(&art, &key);
+            } else {
+                StrTree_insert(&tree, key, i);
+                StrArt_insert(&art, key, i);
+            }
+        }
+        CHECK_AGAINST_TREE(&art, StrTree, StrArt, &tree, keys, n, STR_EQ);
+
+        /* prefix scans give the same keys as scanning the tree from the prefix on */
+        for (size_t i = 0; i < 300; i++) {
+            CString key = keys[rng_next() % n];
+            size_t len = strlen(key) ? rng_next() % (strlen(key) + 1) : 0;
+            char prefix[128];
+            memcpy(prefix, key, len);
+            prefix[len] = '\0';
+            CString prefix_key = prefix;
+            StrTreeIter tit = StrTree_ceil_iter(&tree, &prefix_key);
+            size_t n_matches = 0;
+            for (StrArtIter it = StrArt_prefix_iter(&art, prefix, len); it.current; StrArtIter_inc(&it), StrTreeIter_inc(&tit), n_matches++)
+                assert(tit.current && strcmp(it.current->key, tit.current->key) == 0 && strncmp(it.current->key, prefix, len) == 0);
+            assert(!tit.current || strncmp(tit.current->key, prefix, len) != 0);
+            StrArtIter it = StrArt_prefix_iter(&art, prefix, len);
+            if (it.current) {
+                StrArtIter_dec(&it);
+                assert(!it.current);
+            }
+            if (len == 0)
+                assert(n_matches == art.size);
+        }
+    }
+    StrTree_free(&tree);
+    StrArt_free(&art);
+    free(keys);
+    free(buf);
+}
+
+#define BENCH(TREE_NAME, ART_NAME, KEYS, N, TITLE) \
+    do { \
+        double times[2][3]; \
+        size_t bytes[2], sum = 0; \
+        TREE_NAME tree = TREE_NAME##_new(); \
+        double start = omp_get_wtime(); \
+        for (size_t i = 0; i < (N); i++) \
+            TREE_NAME##_search(&tree, (KEYS) + i, true); \
+        times[0][0] = omp_get_wtime() - start; \
+        start = omp_get_wtime(); \
+        for (size_t i = 0; i < (N); i++) \
+            sum += TREE_NAME##_search(&tree, (KEYS) + i, false) != NULL; \
+        times[0][1] = omp_get_wtime() - start; \
+        start = omp_get_wtime(); \
+        for (TREE_NAME##Iter it = TREE_NAME##_min_iter(&tree); it.current; TREE_NAME##Iter_inc(&it)) \
+            sum++; \
+        times[0][2] = omp_get_wtime() - start; \
+        bytes[0] = TREE_NAME##_memory_usage(&tree); \
+        \
+        ART_NAME art = ART_NAME##_new(); \
+        start = omp_get_wtime(); \
+        for (size_t i = 0; i < (N); i++) \
+            ART_NAME##_search(&art, (KEYS) + i, true); \
+        times[1][0] = omp_get_wtime() - start; \
+        start = omp_get_wtime(); \
+        for (size_t i = 0; i < (N); i++) \
+            sum += ART_NAME##_search(&art, (KEYS) + i, false) != NULL; \
+        times[1][1] = omp_get_wtime() - start; \
+        start = omp_get_wtime(); \
+        for (ART_NAME##Iter it = ART_NAME##_min_iter(&art); it.current; ART_NAME##Iter_inc(&it)) \
+            sum++; \
+        times[1][2] = omp_get_wtime() - start; \
+        bytes[1] = ART_NAME##_memory_usage(&art); \
+        assert(art.size == tree.size && sum == 2 * ((N) + art.size)); \
+        \
+        printf("%s, %zu keys, %zu distinct:\n", TITLE, (size_t) (N), art.size); \
+        printf("  %-8s %9s %9s %9s %16s\n", "", "insertion", "queries", "iteration", "bytes per entry"); \
+        const char* names[2] = {"TreeMap", "ArtMap"}; \
+        for (size_t m = 0; m < 2; m++) \
+            printf("  %-8s %8.3lfs %8.3lfs %8.3lfs %16.1lf\n", names[m], times[m][0], times[m][1], times[m][2], \
+                   bytes[m] / (double) (art.size ? art.size : 1)); \
+        TREE_NAME##_free(&tree); \
+        ART_NAME##_free(&art); \
+    } while (0)
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    const char* ints_path = argc > 2 ? argv[2] : NULL;
+    const char* words_path = argc > 3 ? argv[3] : NULL;
+
+    check_integers();
+    check_strings();
+
+    IntVec ints = IntVec_new(0);
+    if (ints_path) {
+        IntReader reader;
+        if (!int_reader_open(&reader, ints_path)) {
+            fprintf(stderr, "could not open %s\n", ints_path);
+            return 1;
+        }
+        int64_t n_ints;
+        bool ok = int_reader_next(&reader, &n_ints) && n_ints >= 0
+                  && IntVec_read_ints(&ints, &reader, n_ints) == (size_t) n_ints;
+        int_reader_close(&reader);
+        if (!ok) {
+            fprintf(stderr, "%s should hold the number of integers followed by them\n", ints_path);
+            return 1;
+        }
+    } else {
+        for (size_t i = 0; i < n; i++)
+            IntVec_push(&ints, (int32_t) rng_next());
+    }
+    BENCH(IntTree, IntArt, ints.arr, ints.size, ints_path ? ints_path : "random 32 bit integers");
+
+    /* all words in one buffer, the keys point into it */
+    StrVec words = StrVec_new(0);
+    char* chars = NULL;
+    size_t n_chars = 0, chars_cap = 0;
+    char line[MAX_STR_LEN];
+    FILE* file = words_path ? fopen(words_path, "r") : NULL;
+    if (words_path && !file) {
+        fprintf(stderr, "could not open %s\n", words_path);
+        return 1;
+    }
+    for (size_t i = 0; file ? fgets(line, MAX_STR_LEN, file) != NULL : i < n; i++) {
+        size_t len = file ? strcspn(line, "\r\n") : gen_url(line);
+        line[len] = '\0';
+        if (n_chars + len + 1 > chars_cap) {
+            chars_cap = 2 * chars_cap + MAX_STR_LEN;
+            chars = realloc(chars, chars_cap);
+            assert(chars);
+        }
+        memcpy(chars + n_chars, line, len + 1);
+        StrVec_push(&words, (CString) n_chars);
+        n_chars += len + 1;
+    }
+    if (file)
+        fclose(file);
+    for (size_t i = 0; i < words.size; i++)
+        words.arr[i] = chars + (size_t) words.arr[i];
+    BENCH(StrTree, StrArt, words.arr, words.size, words_path ? words_path : "generated URLs");
+
+    IntVec_free(&ints);
+    StrVec_free(&words);
+    free(chars);
+    return 0;
+}
@@ -0,0 +1,411 @@
+/******************************************************************************
+ * Benchmark runner for all datastructures
+ *
+ * Every benchmark works on the same deterministic input, generated from the
+ * seed, so results from different runs and commits can be compared directly.
+ * Run `make bench` from the repository root, or see `./bench --help`
+ *
+ * Compile with -fopenmp
+ ******************************************************************************/
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../../datastructures/vec.h"
+#include "../../datastructures/heap.h"
+#include "../../datastructures/sort.h"
+#include "../../datastructures/queue.h"
+#include "../../datastructures/hashmap.h"
+#include "../../datastructures/treemap.h"
+
+#define WORD_STRIDE 16
+
+#define EQ(a, b) (*(a) == *(b))
+#define HASH(key) (*(key))
+#define SIPHASH(key) (byte_hasher((const char*)(key), sizeof(int)))
+#define CMP(a, b) (*(a) < *(b) ? -1 : (*(a) > *(b) ? 1 : 0))
+#define WORD_EQ(a, b) (strcmp((a)->s, (b)->s) == 0)
+#define WORD_HASH(a) (byte_hasher((a)->s, strlen((a)->s)))
+
+typedef struct { char s[WORD_STRIDE]; } Word;
+
+VEC_DEFINE(Vector, int)
+HEAP_DEFINE(Heap, int, CMP)
+SORT_DEFINE(IntSort, Vector, int, CMP)
+RADIX_SORT_DEFINE(IntSort, Vector, int32_t, sort_key_i32, 4)
+QUEUE_DEFINE(Queue, int)
+HASHMAP_DEFINE(IntSet, int, HASHMAP_NO_VALUE, HASH, EQ)
+HASHMAP_DEFINE(SipSet, int, HASHMAP_NO_VALUE, SIPHASH, EQ)
+HASHMAP_DEFINE(WordCount, Word, int, WORD_HASH, WORD_EQ)
+TREEMAP_DEFINE(TreeSet, int, TREEMAP_NO_VALUE, CMP)
+
+
+static int cmp(const void* a, const void* b)
+{
+    return CMP((const int*) a, (const int*) b);
+}
+
+static Vector input_vec(const Bench* b)
+{
+    Vector vec = Vector_new(b->n);
+    int* input = bench_gen_ints(b->seed, b->n);
+    memcpy(vec.arr, input, b->n * sizeof(int));
+    free(input);
+    return vec;
+}
+
+
+static void bench_vec_push(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    bench_begin(b);
+    Vector vec = Vector_new(0);
+    for (size_t i = 0; i < b->n; i++)
+        Vector_push(&vec, input[i]);
+    bench_end(b);
+    bench_sink += vec.arr[vec.size - 1];
+    Vector_free(&vec);
+    free(input);
+}
+
+static void bench_qsort(Bench* b)
+{
+    Vector vec = input_vec(b);
+    bench_begin(b);
+    qsort(vec.arr, vec.size, sizeof(int), cmp);
+    bench_end(b);
+    bench_sink += vec.arr[0];
+    Vector_free(&vec);
+}
+
+static void bench_heap_sort(Bench* b)
+{
+    Vector vec = input_vec(b);
+    bench_begin(b);
+    Heap_heapify(&vec);
+    while (vec.size)
+        bench_sink += Heap_pop((Heap*) &vec);
+    bench_end(b);
+    Vector_free(&vec);
+}
+
+static void bench_merge_sort(Bench* b)
+{
+    Vector vec = input_vec(b);
+    bench_begin(b);
+    IntSort_sort(&vec);
+    bench_end(b);
+    bench_sink += vec.arr[0];
+    Vector_free(&vec);
+}
+
+static void bench_radix_sort(Bench* b)
+{
+    Vector vec = input_vec(b);
+    bench_begin(b);
+    IntSort_radix_sort(&vec);
+    bench_end(b);
+    bench_sink += vec.arr[0];
+    Vector_free(&vec);
+}
+
+static void bench_heap_push_pop(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    bench_begin(b);
+    Heap heap = Heap_new();
+    for (size_t i = 0; i < b->n; i++)
+        Heap_push(&heap, input[i]);
+    while (heap.size)
+        bench_sink += Heap_pop(&heap);
+    bench_end(b);
+    Heap_free(&heap);
+    free(input);
+}
+
+static void bench_queue_push_pop(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    bench_begin(b);
+    Queue q = Queue_new(0);
+    for (size_t i = 0; i < b->n; i++) {
+        Queue_push(&q, input[i]);
+        if (i % 3 == 2)
+            bench_sink += Queue_pop(&q);
+    }
+    while (q.size)
+        bench_sink += Queue_pop(&q);
+    bench_end(b);
+    free(q._arr);
+    free(input);
+}
+
+static void bench_hashmap_insert(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    bench_begin(b);
+    IntSet set = IntSet_new(0);
+    for (size_t i = 0; i < b->n; i++)
+        IntSet_search(&set, input+i, true);
+    bench_end(b);
+    bench_sink += set.size;
+    IntSet_free(&set);
+    free(input);
+}
+
+static void bench_hashmap_query(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    IntSet set = IntSet_new(0);
+    for (size_t i = 0; i < b->n; i++)
+        IntSet_search(&set, input+i, true);
+    uint64_t sum = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < b->n; i++)
+        sum += IntSet_search(&set, input+i, false)->key;
+    bench_end(b);
+    bench_sink += sum;
+    IntSet_free(&set);
+    free(input);
+}
+
+/* half of the queried keys are not in the set */
+static void bench_hashmap_query_miss(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    int* queries = bench_gen_ints(b->seed + 1, b->n);
+    IntSet set = IntSet_new(0);
+    for (size_t i = 0; i < b->n; i++)
+        IntSet_search(&set, input+i, true);
+    for (size_t i = 0; i < b->n; i += 2)
+        queries[i] = input[i];
+    uint64_t found = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < b->n; i++)
+        found += IntSet_contains(&set, queries+i);
+    bench_end(b);
+    bench_sink += found;
+    IntSet_free(&set);
+    free(input);
+    free(queries);
+}
+
+static void bench_hashmap_iter(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    IntSet set = IntSet_new(0);
+    for (size_t i = 0; i < b->n; i++)
+        IntSet_search(&set, input+i, true);
+    uint64_t sum = 0;
+    bench_begin(b);
+    for (IntSetIter it = IntSet_iter(&set); it.current; IntSetIter_inc(&it))
+        sum += it.current->key;
+    bench_end(b);
+    bench_sink += sum;
+    IntSet_free(&set);
+    free(input);
+}
+
+static void bench_hashmap_remove(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    IntSet set = IntSet_new(0);
+    for (size_t i = 0; i < b->n; i++)
+        IntSet_search(&set, input+i, true);
+    bench_begin(b);
+    for (size_t i = 0; i < b->n; i++)
+        IntSet_remove(&set, input+i);
+    bench_end(b);
+    bench_sink += set.size;
+    IntSet_free(&set);
+    free(input);
+}
+
+static void bench_hashmap_siphash_insert(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    bench_begin(b);
+    SipSet set = SipSet_new(0);
+    for (size_t i = 0; i < b->n; i++)
+        SipSet_search(&set, input+i, true);
+    bench_end(b);
+    bench_sink += set.size;
+    SipSet_free(&set);
+    free(input);
+}
+
+static void bench_hashmap_words(Bench* b)
+{
+    Word* words = (Word*) bench_gen_words(b->seed, b->n, WORD_STRIDE);
+    bench_begin(b);
+    WordCount counts = WordCount_new(0);
+    for (size_t i = 0; i < b->n; i++)
+        WordCount_search(&counts, words+i, true)->value++;
+    bench_end(b);
+    bench_sink += counts.size;
+    WordCount_free(&counts);
+    free(words);
+}
+
+static void bench_treemap_insert(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    bench_begin(b);
+    TreeSet tree = TreeSet_new();
+    for (size_t i = 0; i < b->n; i++)
+        TreeSet_search(&tree, input+i, true);
+    bench_end(b);
+    bench_sink += tree.size;
+    TreeSet_free(&tree);
+    free(input);
+}
+
+static void bench_treemap_query(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    TreeSet tree = TreeSet_new();
+    for (size_t i = 0; i < b->n; i++)
+        TreeSet_search(&tree, input+i, true);
+    uint64_t sum = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < b->n; i++)
+        sum += TreeSet_search(&tree, input+i, false)->key;
+    bench_end(b);
+    bench_sink += sum;
+    TreeSet_free(&tree);
+    free(input);
+}
+
+static void bench_treemap_iter(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    TreeSet tree = TreeSet_new();
+    for (size_t i = 0; i < b->n; i++)
+        TreeSet_search(&tree, input+i, true);
+    uint64_t sum = 0;
+    bench_begin(b);
+    for (TreeSetIter it = TreeSet_min_iter(&tree); it.current; TreeSetIter_inc(&it))
+        sum += it.current->key;
+    bench_end(b);
+    bench_sink += sum;
+    TreeSet_free(&tree);
+    free(input);
+}
+
+static void bench_treemap_remove(Bench* b)
+{
+    int* input = bench_gen_ints(b->seed, b->n);
+    TreeSet tree = TreeSet_new();
+    for (size_t i = 0; i < b->n; i++)
+        TreeSet_search(&tree, input+i, true);
+    bench_begin(b);
+    for (size_t i = 0; i < b->n; i++)
+        TreeSet_remove(&tree, input+i);
+    bench_end(b);
+    bench_sink += tree.size;
+    TreeSet_free(&tree);
+    free(input);
+}
+
+
+static const BenchCase cases[] = {
+    {"vec/push", bench_vec_push},
+    {"sort/qsort", bench_qsort},
+    {"sort/heap_sort", bench_heap_sort},
+    {"sort/merge_sort", bench_merge_sort},
+    {"sort/radix_sort", bench_radix_sort},
+    {"heap/push_pop", bench_heap_push_pop},
+    {"queue/push_pop", bench_queue_push_pop},
+    {"hashmap/insert", bench_hashmap_insert},
+    {"hashmap/query", bench_hashmap_query},
+    {"hashmap/query_miss", bench_hashmap_query_miss},
+    {"hashmap/iter", bench_hashmap_iter},
+    {"hashmap/remove", bench_hashmap_remove},
+    {"hashmap/siphash_insert", bench_hashmap_siphash_insert},
+    {"hashmap/words", bench_hashmap_words},
+    {"treemap/insert", bench_treemap_insert},
+    {"treemap/query", bench_treemap_query},
+    {"treemap/iter", bench_treemap_iter},
+    {"treemap/remove", bench_treemap_remove},
+};
+
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -n N          elements per trial (default 1000000)\n"
+            "  -t TRIALS     measured trials (default 10)\n"
+            "  -w WARMUP     warm-up trials (default 2)\n"
+            "  -s SEED       seed of the input generator (default 42)\n"
+            "  -f FILTER     only run benchmarks whose name contains FILTER\n"
+            "  -o FILE       write results as JSON to FILE\n"
+            "  -l            list benchmarks and exit\n", prog);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = 1000000;
+    int n_trials = 10, n_warmup = 2;
+    uint64_t seed = 42;
+    const char* filter = NULL;
+    const char* json_path = NULL;
+    size_t n_cases = sizeof(cases) / sizeof(cases[0]);
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i+1] : NULL;
+        if (!strcmp(arg, "-l")) {
+            for (size_t j = 0; j < n_cases; j++)
+                printf("%s\n", cases[j].name);
+            return 0;
+        }
+        if (arg[0] != '-' || !value || strchr("ntwsfo", arg[1]) == NULL || arg[1] == '\0') {
+            usage(argv[0]);
+            return 1;
+        }
+        switch (arg[1]) {
+            case 'n': n = strtoull(value, NULL, 10); break;
+            case 't': n_trials = atoi(value); break;
+            case 'w': n_warmup = atoi(value); break;
+            case 's': seed = strtoull(value, NULL, 10); break;
+            case 'f': filter = value; break;
+            case 'o': json_path = value; break;
+        }
+        i++;
+    }
+    if (n == 0 || n_trials < 1 || n_warmup < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE* json_out = NULL;
+    if (json_path) {
+        json_out = fopen(json_path, "w");
+        if (!json_out) {
+            perror(json_path);
+            return 1;
+        }
+        fprintf(json_out, "{\n  \"n\": %zu,\n  \"seed\": %llu,\n  \"results\": [\n",
+                n, (unsigned long long) seed);
+    }
+
+    bool first = true;
+    for (size_t i = 0; i < n_cases; i++) {
+        if (filter && !strstr(cases[i].name, filter))
+            continue;
+        bench_run(cases+i, n, seed, n_warmup, n_trials, json_out, first);
+        first = false;
+    }
+
+    if (json_out) {
+        fprintf(json_out, "\n  ]\n}\n");
+        fclose(json_out);
+    }
+}
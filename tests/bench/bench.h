@@ -0,0 +1,276 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/******************************************************************************
+ * Minimal benchmark harness
+ *
+ * A benchmark is a function taking a Bench*, which sets up its input and then
+ * wraps the measured code in bench_begin / bench_end. The harness runs it a
+ * number of warm-up trials followed by the measured trials, and reports the
+ * median and percentiles of the trial times, together with hardware counters
+ * read through perf_event_open when the kernel allows it.
+ *
+ * Input data is generated with a seeded splitmix64 generator,
+ * so every run and every commit measures the exact same input.
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define BENCH_MAX_TRIALS 1000
+#define BENCH_N_COUNTERS 4
+
+static const char* const bench_counter_names[BENCH_N_COUNTERS] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"
+};
+
+typedef struct
+{
+    const char* name;
+    size_t n;               // number of elements each trial works on
+    uint64_t seed;
+    int n_trials;
+    int n_warmup;
+
+    /* filled in by the harness */
+    int _trial;
+    bool _measuring;
+    uint64_t _start_ns;
+    uint64_t _trial_ns[BENCH_MAX_TRIALS];
+    uint64_t _trial_counters[BENCH_N_COUNTERS][BENCH_MAX_TRIALS];
+    int _counter_fds[BENCH_N_COUNTERS];
+    bool _has_counters;
+} Bench;
+
+typedef struct
+{
+    const char* name;
+    void (*func)(Bench* b);
+} BenchCase;
+
+
+/*****************************************************
+ * Deterministic random number generator, splitmix64
+ *****************************************************/
+static uint64_t bench_rand(uint64_t* state)
+{
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+/* uniformly distributed 32 bit integers, like nums_generator.py */
+static int* bench_gen_ints(uint64_t seed, size_t n)
+{
+    int* ret = malloc(n * sizeof(int));
+    for (size_t i = 0; i < n; i++)
+        ret[i] = (int)(uint32_t) bench_rand(&seed);
+    return ret;
+}
+
+/* lowercase words of 3 to 12 letters, stored in fixed size slots of `stride` bytes */
+static char* bench_gen_words(uint64_t seed, size_t n, size_t stride)
+{
+    char* ret = calloc(n, stride);
+    for (size_t i = 0; i < n; i++) {
+        size_t len = 3 + bench_rand(&seed) % 10;
+        for (size_t j = 0; j < len && j < stride - 1; j++)
+            ret[i*stride + j] = 'a' + bench_rand(&seed) % 26;
+    }
+    return ret;
+}
+
+static uint64_t bench_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+/*************************************************************
+ * Opens hardware counters for this thread, if permitted
+ *************************************************************/
+static void _bench_open_counters(Bench* b)
+{
+    b->_has_counters = false;
+    for (int i = 0; i < BENCH_N_COUNTERS; i++)
+        b->_counter_fds[i] = -1;
+#ifdef __linux__
+    static const uint64_t configs[BENCH_N_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        b->_counter_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (b->_counter_fds[i] < 0) {
+            for (int j = 0; j < i; j++)
+                close(b->_counter_fds[j]);
+            for (int j = 0; j < BENCH_N_COUNTERS; j++)
+                b->_counter_fds[j] = -1;
+            return;
+        }
+    }
+    b->_has_counters = true;
+#endif
+}
+
+static void _bench_close_counters(Bench* b)
+{
+#ifdef __linux__
+    for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+        if (b->_counter_fds[i] >= 0)
+            close(b->_counter_fds[i]);
+    }
+#endif
+}
+
+
+/********************************************
+ * Starts the measured part of a trial
+ ********************************************/
+static void bench_begin(Bench* b)
+{
+#ifdef __linux__
+    if (b->_has_counters) {
+        for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+            ioctl(b->_counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(b->_counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+    b->_start_ns = bench_now_ns();
+}
+
+
+/********************************************
+ * Ends the measured part of a trial
+ ********************************************/
+static void bench_end(Bench* b)
+{
+    uint64_t elapsed = bench_now_ns() - b->_start_ns;
+    if (!b->_measuring)
+        return;
+    b->_trial_ns[b->_trial] = elapsed;
+#ifdef __linux__
+    if (b->_has_counters) {
+        for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+            uint64_t count = 0;
+            ioctl(b->_counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(b->_counter_fds[i], &count, sizeof(count)) != sizeof(count))
+                count = 0;
+            b->_trial_counters[i][b->_trial] = count;
+        }
+    }
+#endif
+}
+
+/* keeps the compiler from optimizing away results */
+static volatile uint64_t bench_sink;
+
+
+static int _bench_cmp_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+/* nearest rank percentile of a sorted array */
+static uint64_t _bench_percentile(const uint64_t* sorted, int n, double p)
+{
+    int rank = (int)(p / 100.0 * n + 0.999999);
+    rank = rank < 1 ? 1 : rank > n ? n : rank;
+    return sorted[rank - 1];
+}
+
+
+/******************************************************************************
+ * Runs a benchmark, and writes its results as a JSON object to json_out
+ * (if it is not NULL) and as a line of human readable text to stdout
+ ******************************************************************************/
+static void bench_run(const BenchCase* bench_case, size_t n, uint64_t seed,
+                      int n_warmup, int n_trials, FILE* json_out, bool first)
+{
+    static Bench b;
+    memset(&b, 0, sizeof(b));
+    b.name = bench_case->name;
+    b.n = n;
+    b.seed = seed;
+    b.n_trials = n_trials > BENCH_MAX_TRIALS ? BENCH_MAX_TRIALS : n_trials;
+    b.n_warmup = n_warmup;
+    _bench_open_counters(&b);
+
+    b._measuring = false;
+    for (int i = 0; i < b.n_warmup; i++)
+        bench_case->func(&b);
+    b._measuring = true;
+    for (b._trial = 0; b._trial < b.n_trials; b._trial++)
+        bench_case->func(&b);
+    _bench_close_counters(&b);
+
+    uint64_t sorted[BENCH_MAX_TRIALS];
+    memcpy(sorted, b._trial_ns, sizeof(uint64_t) * b.n_trials);
+    qsort(sorted, b.n_trials, sizeof(uint64_t), _bench_cmp_u64);
+    uint64_t median = _bench_percentile(sorted, b.n_trials, 50);
+    uint64_t p90 = _bench_percentile(sorted, b.n_trials, 90);
+    uint64_t p99 = _bench_percentile(sorted, b.n_trials, 99);
+    uint64_t min = sorted[0], max = sorted[b.n_trials - 1];
+    double mean = 0;
+    for (int i = 0; i < b.n_trials; i++)
+        mean += b._trial_ns[i] / (double) b.n_trials;
+
+    printf("%-28s median %10.3f ms  p90 %10.3f ms  p99 %10.3f ms  %8.2f ns/op",
+           b.name, median / 1e6, p90 / 1e6, p99 / 1e6, median / (double) n);
+
+    uint64_t counter_medians[BENCH_N_COUNTERS];
+    if (b._has_counters) {
+        for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+            memcpy(sorted, b._trial_counters[i], sizeof(uint64_t) * b.n_trials);
+            qsort(sorted, b.n_trials, sizeof(uint64_t), _bench_cmp_u64);
+            counter_medians[i] = _bench_percentile(sorted, b.n_trials, 50);
+        }
+        printf("  %6.2f IPC", counter_medians[0] ? counter_medians[1] / (double) counter_medians[0] : 0.0);
+    }
+    printf("\n");
+
+    if (!json_out)
+        return;
+    fprintf(json_out, "%s    {\"name\": \"%s\", \"n\": %zu, \"trials\": %d, \"warmup\": %d, "
+            "\"median_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"min_ns\": %llu, \"max_ns\": %llu, "
+            "\"mean_ns\": %.1f, \"ns_per_op\": %.3f, \"counters\": ",
+            first ? "" : ",\n", b.name, n, b.n_trials, b.n_warmup,
+            (unsigned long long) median, (unsigned long long) p90, (unsigned long long) p99,
+            (unsigned long long) min, (unsigned long long) max, mean, median / (double) n);
+    if (b._has_counters) {
+        fprintf(json_out, "{");
+        for (int i = 0; i < BENCH_N_COUNTERS; i++)
+            fprintf(json_out, "%s\"%s\": %llu", i ? ", " : "", bench_counter_names[i],
+                    (unsigned long long) counter_medians[i]);
+        fprintf(json_out, "}}");
+    } else {
+        fprintf(json_out, "null}");
+    }
+}
+
+#endif
@@ -0,0 +1,56 @@
+"""
+Compares two JSON result files written by the benchmark runner
+
+usage: python3 compare.py BASE.json NEW.json [--threshold PERCENT]
+
+Prints the change in median time of every benchmark present in both files,
+and exits with status 1 if any benchmark got slower by more than the threshold
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {r["name"]: r for r in json.load(f)["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percent slowdown counted as a regression (default 5)")
+    args = parser.parse_args()
+
+    base, new = load(args.base), load(args.new)
+    regressions = []
+    print(f"{'benchmark':28} {'base ms':>10} {'new ms':>10} {'change':>9} {'base p90':>10} {'new p90':>10}")
+    for name, b in base.items():
+        if name not in new:
+            continue
+        n = new[name]
+        change = (n["median_ns"] - b["median_ns"]) / b["median_ns"] * 100
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        elif change < -args.threshold:
+            flag = "  improved"
+        print(f"{name:28} {b['median_ns'] / 1e6:10.3f} {n['median_ns'] / 1e6:10.3f} {change:+8.1f}% "
+              f"{b['p90_ns'] / 1e6:10.3f} {n['p90_ns'] / 1e6:10.3f}{flag}")
+
+    for name in new.keys() - base.keys():
+        print(f"{name:28} only in {args.new}")
+    for name in base.keys() - new.keys():
+        print(f"{name:28} only in {args.base}")
+
+    if regressions:
+        print(f"\n{len(regressions)} benchmark(s) slower by more than {args.threshold}%")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,467 @@
+/******************************************************************************
+ * Runs YCSB-like mixed workloads against the datastructures
+ *
+ * All containers are driven through the same interface, WorkloadTarget.
+ * Each run first loads the records, then executes the operations twice:
+ * once without per-operation timing to measure throughput,
+ * and once timing every operation to measure tail latency.
+ * Run `make workload` from the repository root, or see `./workload --help`
+ *
+ * HEAP and QUEUE have no keyed lookups, for them reads look at the first
+ * element, inserts and updates push and deletes pop. Scans are only
+ * supported by TREEMAP, other containers run them as reads. Read-modify-writes
+ * read the value and then update it, looking the key up twice as a client would
+ *
+ * Compile with -fopenmp -lm
+ *
+ * When compiled with -DDATASTRUCTURES_TRACE (make workload-trace), the resizes,
+ * splits and merges during the latency pass are collected, see trace.h,
+ * together with how many of the slowest 1% of operations ran into one of them
+ ******************************************************************************/
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "bench.h"
+#include "workload.h"
+#include "../../datastructures/vec.h"
+#include "../../datastructures/heap.h"
+#include "../../datastructures/queue.h"
+#include "../../datastructures/hashmap.h"
+#include "../../datastructures/treemap.h"
+
+#define EQ(a, b) (*(a) == *(b))
+#define HASH(key) (workload_mix(*(key)))
+#define CMP(a, b) (*(a) < *(b) ? -1 : (*(a) > *(b) ? 1 : 0))
+
+HASHMAP_DEFINE(HashTable, uint64_t, uint64_t, HASH, EQ)
+TREEMAP_DEFINE(Tree, uint64_t, uint64_t, CMP)
+HEAP_DEFINE(Heap, uint64_t, CMP)
+QUEUE_DEFINE(Queue, uint64_t)
+
+/**************************************************************
+ * A container driven by the workload
+ *
+ * scan may be NULL if the container has no ordered iteration
+ **************************************************************/
+typedef struct
+{
+    const char* name;
+    void* (*create)(size_t n_records);
+    void (*destroy)(void* c);
+    uint64_t (*read)(void* c, uint64_t key);
+    void (*insert)(void* c, uint64_t key);
+    void (*update)(void* c, uint64_t key);
+    void (*remove)(void* c, uint64_t key);
+    uint64_t (*scan)(void* c, uint64_t key, size_t length);
+} WorkloadTarget;
+
+
+static void* hashmap_create(size_t n_records)
+{
+    HashTable* map = malloc(sizeof(HashTable));
+    *map = HashTable_new(n_records);
+    return map;
+}
+
+static void hashmap_destroy(void* c)
+{
+    HashTable_free(c);
+    free(c);
+}
+
+static uint64_t hashmap_read(void* c, uint64_t key)
+{
+    HashTableEntry* entry = HashTable_search(c, &key, false);
+    return entry ? entry->value : 0;
+}
+
+static void hashmap_insert(void* c, uint64_t key)
+{
+    HashTable_insert(c, key, key);
+}
+
+static void hashmap_update(void* c, uint64_t key)
+{
+    HashTableEntry* entry = HashTable_search(c, &key, false);
+    if (entry)
+        entry->value++;
+}
+
+static void hashmap_remove(void* c, uint64_t key)
+{
+    HashTable_remove(c, &key);
+}
+
+
+static void* treemap_create(size_t n_records)
+{
+    (void) n_records;
+    Tree* map = malloc(sizeof(Tree));
+    *map = Tree_new();
+    return map;
+}
+
+static void treemap_destroy(void* c)
+{
+    Tree_free(c);
+    free(c);
+}
+
+static uint64_t treemap_read(void* c, uint64_t key)
+{
+    TreeEntry* entry = Tree_search(c, &key, false);
+    return entry ? entry->value : 0;
+}
+
+static void treemap_insert(void* c, uint64_t key)
+{
+    Tree_insert(c, key, key);
+}
+
+static void treemap_update(void* c, uint64_t key)
+{
+    TreeEntry* entry = Tree_search(c, &key, false);
+    if (entry)
+        entry->value++;
+}
+
+static void treemap_remove(void* c, uint64_t key)
+{
+    Tree_remove(c, &key);
+}
+
+static uint64_t treemap_scan(void* c, uint64_t key, size_t length)
+{
+    uint64_t sum = 0;
+    size_t i = 0;
+    for (TreeIter it = Tree_ceil_iter(c, &key); it.current && i < length; TreeIter_inc(&it), i++)
+        sum += it.current->value;
+    return sum;
+}
+
+
+static void* heap_create(size_t n_records)
+{
+    (void) n_records;
+    Heap* heap = malloc(sizeof(Heap));
+    *heap = Heap_new();
+    return heap;
+}
+
+static void heap_destroy(void* c)
+{
+    Heap_free(c);
+    free(c);
+}
+
+static uint64_t heap_read(void* c, uint64_t key)
+{
+    (void) key;
+    Heap* heap = c;
+    return heap->size ? heap->arr[0] : 0;
+}
+
+static void heap_insert(void* c, uint64_t key)
+{
+    Heap_push(c, key);
+}
+
+static void heap_remove(void* c, uint64_t key)
+{
+    (void) key;
+    if (((Heap*) c)->size)
+        Heap_pop(c);
+}
+
+
+static void* queue_create(size_t n_records)
+{
+    Queue* q = malloc(sizeof(Queue));
+    *q = Queue_new(n_records);
+    return q;
+}
+
+static void queue_destroy(void* c)
+{
+    free(((Queue*) c)->_arr);
+    free(c);
+}
+
+static uint64_t queue_read(void* c, uint64_t key)
+{
+    (void) key;
+    Queue* q = c;
+    return q->size ? q->_arr[q->_head] : 0;
+}
+
+static void queue_insert(void* c, uint64_t key)
+{
+    Queue_push(c, key);
+}
+
+static void queue_remove(void* c, uint64_t key)
+{
+    (void) key;
+    if (((Queue*) c)->size)
+        Queue_pop(c);
+}
+
+
+static const WorkloadTarget targets[] = {
+    {"hashmap", hashmap_create, hashmap_destroy, hashmap_read, hashmap_insert, hashmap_update, hashmap_remove, NULL},
+    {"treemap", treemap_create, treemap_destroy, treemap_read, treemap_insert, treemap_update, treemap_remove, treemap_scan},
+    {"heap", heap_create, heap_destroy, heap_read, heap_insert, heap_insert, heap_remove, NULL},
+    {"queue", queue_create, queue_destroy, queue_read, queue_insert, queue_insert, queue_remove, NULL},
+};
+
+
+static inline uint64_t run_op(const WorkloadTarget* t, void* c, const WorkloadOp* op)
+{
+    switch (op->type) {
+        case WORKLOAD_READ:
+            return t->read(c, op->key);
+        case WORKLOAD_INSERT:
+            t->insert(c, op->key);
+            return 0;
+        case WORKLOAD_UPDATE:
+            t->update(c, op->key);
+            return 0;
+        case WORKLOAD_DELETE:
+            t->remove(c, op->key);
+            return 0;
+        case WORKLOAD_READ_MODIFY_WRITE: {
+            uint64_t value = t->read(c, op->key);
+            t->update(c, op->key);
+            return value;
+        }
+        default:
+            return t->scan ? t->scan(c, op->key, op->scan_length) : t->read(c, op->key);
+    }
+}
+
+static void* load(const WorkloadTarget* t, const WorkloadConfig* config)
+{
+    void* c = t->create(config->n_records);
+    for (size_t i = 0; i < config->n_records; i++)
+        t->insert(c, workload_key(config, i));
+    return c;
+}
+
+#ifdef DATASTRUCTURES_TRACE
+/* events seen during the latency pass of one container */
+typedef struct
+{
+    size_t count[TRACE_N_EVENTS];
+    uint64_t total_ns[TRACE_N_EVENTS];
+    uint64_t max_ns[TRACE_N_EVENTS];
+    size_t in_op;   // events during the current operation
+} TraceSummary;
+
+static void trace_collect(const TraceEvent* event, void* ctx)
+{
+    TraceSummary* summary = ctx;
+    summary->count[event->type]++;
+    summary->total_ns[event->type] += event->ns;
+    if (event->ns > summary->max_ns[event->type])
+        summary->max_ns[event->type] = event->ns;
+    summary->in_op++;
+}
+
+/* prints the events, and how many operations of at least p99 latency had one */
+static void trace_report(const TraceSummary* summary, const uint32_t* latencies,
+                         const bool* had_event, size_t n, uint32_t p99)
+{
+    for (int i = 0; i < TRACE_N_EVENTS; i++) {
+        if (summary->count[i])
+            printf("  %-16s %8zu events, total %10.1f us, max %8.1f us\n", trace_event_names[i],
+                   summary->count[i], summary->total_ns[i] / 1e3, summary->max_ns[i] / 1e3);
+    }
+    size_t n_slow = 0, n_slow_with_event = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (latencies[i] >= p99) {
+            n_slow++;
+            n_slow_with_event += had_event[i];
+        }
+    }
+    printf("  %zu of %zu operations at or above p99 ran into an event\n", n_slow_with_event, n_slow);
+}
+#endif
+
+static int cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+static void run_target(const WorkloadTarget* t, const WorkloadConfig* config, const WorkloadOp* ops)
+{
+    uint64_t sum = 0;
+    void* c = load(t, config);
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < config->n_ops; i++)
+        sum += run_op(t, c, ops+i);
+    uint64_t elapsed = bench_now_ns() - start;
+    t->destroy(c);
+
+    uint32_t* latencies = malloc(config->n_ops * sizeof(uint32_t));
+    assert(latencies);
+    c = load(t, config);
+#ifdef DATASTRUCTURES_TRACE
+    TraceSummary summary = {0};
+    bool* had_event = malloc(config->n_ops * sizeof(bool));
+    assert(had_event);
+    trace_set_callback(trace_collect, &summary);
+#endif
+    for (size_t i = 0; i < config->n_ops; i++) {
+#ifdef DATASTRUCTURES_TRACE
+        summary.in_op = 0;
+#endif
+        uint64_t op_start = bench_now_ns();
+        sum += run_op(t, c, ops+i);
+        uint64_t op_ns = bench_now_ns() - op_start;
+        latencies[i] = op_ns > UINT32_MAX ? UINT32_MAX : op_ns;
+#ifdef DATASTRUCTURES_TRACE
+        had_event[i] = summary.in_op > 0;
+#endif
+    }
+#ifdef DATASTRUCTURES_TRACE
+    trace_set_callback(NULL, NULL);
+    uint32_t* unsorted = malloc(config->n_ops * sizeof(uint32_t));
+    assert(unsorted);
+    memcpy(unsorted, latencies, config->n_ops * sizeof(uint32_t));
+#endif
+    t->destroy(c);
+    bench_sink += sum;
+
+    qsort(latencies, config->n_ops, sizeof(uint32_t), cmp_u32);
+    size_t n = config->n_ops;
+    printf("%-10s %10.3f %9u %9u %9u %9u %9u\n", t->name, n / (elapsed / 1e3),
+           latencies[n / 2], latencies[n * 90 / 100], latencies[n * 99 / 100],
+           latencies[n * 999 / 1000], latencies[n - 1]);
+#ifdef DATASTRUCTURES_TRACE
+    trace_report(&summary, unsorted, had_event, n, latencies[n * 99 / 100]);
+    free(unsorted);
+    free(had_event);
+#endif
+    free(latencies);
+}
+
+
+static void set_preset(WorkloadConfig* config, char preset)
+{
+    static const struct { char name; double ratios[WORKLOAD_N_OPS]; WorkloadDistribution dist; } presets[] = {
+        /*             read insert update delete scan rmw */
+        {'a', {50, 0, 50, 0, 0, 0}, WORKLOAD_ZIPF},      // update heavy
+        {'b', {95, 0, 5, 0, 0, 0}, WORKLOAD_ZIPF},       // read mostly
+        {'c', {100, 0, 0, 0, 0, 0}, WORKLOAD_ZIPF},      // read only
+        {'d', {95, 5, 0, 0, 0, 0}, WORKLOAD_LATEST},     // read latest
+        {'e', {0, 5, 0, 0, 95, 0}, WORKLOAD_ZIPF},       // short ranges
+        {'f', {50, 0, 0, 0, 0, 50}, WORKLOAD_ZIPF},      // read-modify-write
+        {'m', {40, 15, 20, 15, 10, 0}, WORKLOAD_UNIFORM}, // mixed, with deletes
+    };
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+        if (presets[i].name == preset) {
+            memcpy(config->ratios, presets[i].ratios, sizeof(config->ratios));
+            config->distribution = presets[i].dist;
+            return;
+        }
+    }
+    fprintf(stderr, "unknown workload '%c'\n", preset);
+    exit(1);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -w PRESET     YCSB core workload a, b, c, d, e or f, or m for a mix with deletes (default a)\n"
+            "  -d DIST       request distribution: uniform, zipf, sequential or latest (default from preset)\n"
+            "  -m MIX        relative frequency of reads, inserts, updates, deletes, scans and\n"
+            "                read-modify-writes, as R,I,U,D,S[,M] (default from preset)\n"
+            "  -x MISS       fraction of reads looking up missing keys (default 0)\n"
+            "  -n RECORDS    records loaded before the run (default 1000000)\n"
+            "  -N OPS        operations in the run (default 1000000)\n"
+            "  -l LENGTH     maximum scan length (default 100)\n"
+            "  -k            use record numbers as keys in order, instead of scrambling them\n"
+            "  -s SEED       seed of the generator (default 42)\n"
+            "  -f FILTER     only run containers whose name contains FILTER\n", prog);
+}
+
+int main(int argc, char** argv)
+{
+    WorkloadConfig config = {1000000, 1000000, {0}, 0, 100, WORKLOAD_ZIPF, false, 42};
+    set_preset(&config, 'a');
+    const char* filter = NULL;
+    const char* dist = NULL;
+    const char* mix = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "-k")) {
+            config.ordered_keys = true;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[i+1] : NULL;
+        if (arg[0] != '-' || arg[1] == '\0' || !value || strchr("wdmxnNlsf", arg[1]) == NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+        switch (arg[1]) {
+            case 'w': set_preset(&config, value[0]); break;
+            case 'd': dist = value; break;
+            case 'm': mix = value; break;
+            case 'x': config.miss_ratio = atof(value); break;
+            case 'n': config.n_records = strtoull(value, NULL, 10); break;
+            case 'N': config.n_ops = strtoull(value, NULL, 10); break;
+            case 'l': config.max_scan_length = strtoull(value, NULL, 10); break;
+            case 's': config.seed = strtoull(value, NULL, 10); break;
+            case 'f': filter = value; break;
+        }
+        i++;
+    }
+    if (dist) {
+        if (!strcmp(dist, "uniform")) config.distribution = WORKLOAD_UNIFORM;
+        else if (!strcmp(dist, "zipf")) config.distribution = WORKLOAD_ZIPF;
+        else if (!strcmp(dist, "sequential")) config.distribution = WORKLOAD_SEQUENTIAL;
+        else if (!strcmp(dist, "latest")) config.distribution = WORKLOAD_LATEST;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (mix) {
+        config.ratios[WORKLOAD_READ_MODIFY_WRITE] = 0;
+        int n_read = sscanf(mix, "%lf,%lf,%lf,%lf,%lf,%lf", config.ratios, config.ratios+1,
+                            config.ratios+2, config.ratios+3, config.ratios+4, config.ratios+5);
+        if (n_read != WORKLOAD_N_OPS && n_read != WORKLOAD_N_OPS - 1) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.n_ops == 0 || config.max_scan_length == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    WorkloadOp* ops = workload_generate(&config);
+    size_t counts[WORKLOAD_N_OPS] = {0};
+    for (size_t i = 0; i < config.n_ops; i++)
+        counts[ops[i].type]++;
+    printf("%zu records, %zu operations:", config.n_records, config.n_ops);
+    for (int i = 0; i < WORKLOAD_N_OPS; i++)
+        printf(" %s %.1f%%", workload_op_names[i], 100.0 * counts[i] / config.n_ops);
+    printf("\n%-10s %10s %9s %9s %9s %9s %9s\n", "container", "Mops/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+
+    for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+        if (filter && !strstr(targets[i].name, filter))
+            continue;
+        run_target(targets+i, &config, ops);
+    }
+    free(ops);
+}
@@ -0,0 +1,208 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+/******************************************************************************
+ * YCSB-like workload generator
+ *
+ * A workload is a sequence of operations on numbered records, generated up
+ * front from a seed, so that generation is not part of the measurement and
+ * every container sees the exact same sequence.
+ *
+ * Record numbers are chosen by one of the request distributions
+ * - uniform, every existing record is equally likely
+ * - zipf, a few records are very popular (theta = 0.99, as in YCSB),
+ *   popular records are scattered over the whole key space
+ * - sequential, records are visited in order, wrapping around at the end
+ * - latest, like zipf, but the most recently inserted records are the most popular
+ *
+ * Inserts always add the next unused record number. A fraction of reads can
+ * be made negative lookups, using record numbers that are never inserted
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "bench.h"
+
+#define WORKLOAD_ZIPF_THETA 0.99
+
+// record numbers of negative lookups start here, inserted records never reach it
+#define WORKLOAD_MISSING_BASE (UINT64_C(1) << 62)
+
+typedef enum
+{
+    WORKLOAD_READ,
+    WORKLOAD_INSERT,
+    WORKLOAD_UPDATE,
+    WORKLOAD_DELETE,
+    WORKLOAD_SCAN,
+    WORKLOAD_READ_MODIFY_WRITE, // a read followed by an update of the same key
+    WORKLOAD_N_OPS
+} WorkloadOpType;
+
+static const char* const workload_op_names[WORKLOAD_N_OPS] = {
+    "read", "insert", "update", "delete", "scan", "rmw"
+};
+
+typedef enum
+{
+    WORKLOAD_UNIFORM,
+    WORKLOAD_ZIPF,
+    WORKLOAD_SEQUENTIAL,
+    WORKLOAD_LATEST
+} WorkloadDistribution;
+
+typedef struct
+{
+    uint64_t key;
+    uint32_t type;
+    uint32_t scan_length;
+} WorkloadOp;
+
+typedef struct
+{
+    size_t n_records;           // records inserted before the measured operations
+    size_t n_ops;
+    double ratios[WORKLOAD_N_OPS];  // relative frequency of each operation
+    double miss_ratio;          // fraction of reads looking up missing records
+    size_t max_scan_length;     // scan lengths are uniform in 1..max_scan_length
+    WorkloadDistribution distribution;
+    bool ordered_keys;          // use record numbers as keys, instead of scrambling them
+    uint64_t seed;
+} WorkloadConfig;
+
+
+/***********************************************************
+ * Zipf generator from Gray et al., "Quickly generating
+ * billion-record synthetic databases", as used by YCSB
+ ***********************************************************/
+typedef struct
+{
+    size_t n;
+    double theta, alpha, zetan, zeta2, eta;
+} WorkloadZipf;
+
+static void _workload_zipf_update_eta(WorkloadZipf* z)
+{
+    z->eta = (1 - pow(2.0 / z->n, 1 - z->theta)) / (1 - z->zeta2 / z->zetan);
+}
+
+static WorkloadZipf workload_zipf_new(size_t n, double theta)
+{
+    WorkloadZipf z = {n, theta, 1 / (1 - theta), 0, 1 + pow(0.5, theta), 0};
+    for (size_t i = 1; i <= n; i++)
+        z.zetan += 1 / pow((double) i, theta);
+    _workload_zipf_update_eta(&z);
+    return z;
+}
+
+/* grows the number of items by one, in constant time */
+static void workload_zipf_grow(WorkloadZipf* z)
+{
+    z->n++;
+    z->zetan += 1 / pow((double) z->n, z->theta);
+    _workload_zipf_update_eta(z);
+}
+
+/* returns a rank in 0..n-1, where 0 is the most popular */
+static size_t workload_zipf_next(const WorkloadZipf* z, uint64_t* rng)
+{
+    double u = (bench_rand(rng) >> 11) * 0x1.0p-53;
+    double uz = u * z->zetan;
+    if (uz < 1)
+        return 0;
+    if (uz < z->zeta2)
+        return 1;
+    size_t ret = (size_t) (z->n * pow(z->eta * u - z->eta + 1, z->alpha));
+    return ret < z->n ? ret : z->n - 1;
+}
+
+/* bijective mixer (the murmur3 finalizer), used to scramble record numbers */
+static uint64_t workload_mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33;
+    x *= UINT64_C(0xc4ceb9fe1a85ec53);
+    x ^= x >> 33;
+    return x;
+}
+
+/* key of a record number */
+static uint64_t workload_key(const WorkloadConfig* config, uint64_t record)
+{
+    return config->ordered_keys ? record : workload_mix(record);
+}
+
+
+/*****************************************************************************
+ * Generates the measured operations of a workload
+ *
+ * Records 0..n_records-1 are assumed to be loaded beforehand,
+ * see workload_key. Returns an array of config->n_ops operations
+ *****************************************************************************/
+static WorkloadOp* workload_generate(const WorkloadConfig* config)
+{
+    WorkloadOp* ops = malloc(config->n_ops * sizeof(WorkloadOp));
+    assert(ops);
+    uint64_t rng = config->seed;
+    size_t n_items = config->n_records > 0 ? config->n_records : 1;
+    size_t next_insert = config->n_records;
+    size_t sequential = 0;
+    WorkloadZipf zipf = {0};
+    if (config->distribution == WORKLOAD_ZIPF || config->distribution == WORKLOAD_LATEST)
+        zipf = workload_zipf_new(n_items, WORKLOAD_ZIPF_THETA);
+
+    double total = 0;
+    for (int i = 0; i < WORKLOAD_N_OPS; i++)
+        total += config->ratios[i];
+    assert(total > 0);
+
+    for (size_t i = 0; i < config->n_ops; i++) {
+        double u = (bench_rand(&rng) >> 11) * 0x1.0p-53 * total;
+        int type = 0;
+        while (type < WORKLOAD_N_OPS - 1 && u >= config->ratios[type]) {
+            u -= config->ratios[type];
+            type++;
+        }
+        ops[i].type = type;
+        ops[i].scan_length = type == WORKLOAD_SCAN ? 1 + bench_rand(&rng) % config->max_scan_length : 0;
+
+        uint64_t record;
+        if (type == WORKLOAD_INSERT) {
+            record = next_insert++;
+            if (config->distribution == WORKLOAD_LATEST)
+                workload_zipf_grow(&zipf);
+        } else if (type == WORKLOAD_READ && (bench_rand(&rng) >> 11) * 0x1.0p-53 < config->miss_ratio) {
+            record = WORKLOAD_MISSING_BASE + bench_rand(&rng) % WORKLOAD_MISSING_BASE;
+        } else {
+            switch (config->distribution) {
+                case WORKLOAD_UNIFORM:
+                    record = next_insert ? bench_rand(&rng) % next_insert : 0;
+                    break;
+                case WORKLOAD_ZIPF:
+                    /* hot records are scattered, by hashing their rank */
+                    record = workload_mix(workload_zipf_next(&zipf, &rng)) % n_items;
+                    break;
+                case WORKLOAD_SEQUENTIAL:
+                    record = next_insert ? sequential++ % next_insert : 0;
+                    break;
+                case WORKLOAD_LATEST:
+                default: {
+                    size_t rank = workload_zipf_next(&zipf, &rng);
+                    record = rank < next_insert ? next_insert - 1 - rank : 0;
+                    break;
+                }
+            }
+        }
+        ops[i].key = workload_key(config, record);
+    }
+    return ops;
+}
+
+#endif
@@ -0,0 +1,264 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+
+#include "../../datastructures/hashmap.h"
+#include "../../datastructures/cache.h"
+#include "../bench/workload.h"
+
+/******************************************************************************
+ * Compares the hit ratio and speed of the eviction policies of cache.h, and of
+ * an LRU cache built by hand from a HashMap and a malloc'ed linked list, on
+ * a zipf distributed trace, with and without scans of cold keys mixed in.
+ * Every lookup that misses inserts its key.
+ *
+ * Also checks that the caches agree with a HashMap tracking the cached keys,
+ * also when entries are evicted explicitly, that explicit evictions follow
+ * the policy, and that the hand built LRU cache has exactly the same hits as CACHE_LRU
+ *
+ * usage: ./test [n_keys] [n_ops], default 10^6 keys and 10^7 operations,
+ * the caches hold 10% of the keys
+ ******************************************************************************/
+
+#define EQ(a, b) (*(a) == *(b))
+#define HASH(key) (workload_mix(*(key)))
+
+CACHE_DEFINE(Lru, uint64_t, uint64_t, HASH, EQ, CACHE_LRU)
+CACHE_DEFINE(Clock, uint64_t, uint64_t, HASH, EQ, CACHE_CLOCK)
+CACHE_DEFINE(S3Fifo, uint64_t, uint64_t, HASH, EQ, CACHE_S3FIFO)
+HASHMAP_DEFINE(Set, uint64_t, HASHMAP_NO_VALUE, HASH, EQ)
+
+/* the cache built by hand: a map from key to a list node, and the list */
+typedef struct HandNode
+{
+    uint64_t key;
+    uint64_t value;
+    struct HandNode* prev;
+    struct HandNode* next;
+} HandNode;
+
+HASHMAP_DEFINE(HandMap, uint64_t, HandNode*, HASH, EQ)
+
+typedef struct
+{
+    HandMap map;
+    HandNode head;  // sentinel, head.next is the most recently used
+    size_t capacity;
+    size_t hits;
+} HandLru;
+
+static void hand_unlink(HandNode* node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+}
+
+static void hand_push_front(HandLru* cache, HandNode* node)
+{
+    node->next = cache->head.next;
+    node->prev = &cache->head;
+    cache->head.next->prev = node;
+    cache->head.next = node;
+}
+
+static void hand_access(HandLru* cache, uint64_t key)
+{
+    HandMapEntry* entry = HandMap_search(&cache->map, &key, false);
+    if (entry) {
+        cache->hits++;
+        hand_unlink(entry->value);
+        hand_push_front(cache, entry->value);
+        return;
+    }
+    if (cache->map.size == cache->capacity) {
+        HandNode* lru = cache->head.prev;
+        hand_unlink(lru);
+        HandMap_remove(&cache->map, &lru->key);
+        free(lru);
+    }
+    HandNode* node = malloc(sizeof(HandNode));
+    node->key = key;
+    node->value = key;
+    hand_push_front(cache, node);
+    HandMap_search(&cache->map, &key, true)->value = node;
+}
+
+static void track_eviction(const uint64_t* key, uint64_t* value, void* ctx)
+{
+    assert(*key == *value);
+    Set_remove((Set*) ctx, key);
+}
+
+#define RUN_POLICY(NAME, TRACE, N_OPS, CAPACITY, TITLE) \
+    do { \
+        NAME cache = NAME##_new(CAPACITY); \
+        double start = omp_get_wtime(); \
+        for (size_t i = 0; i < (N_OPS); i++) { \
+            if (!NAME##_get(&cache, (TRACE)+i)) \
+                NAME##_put(&cache, (TRACE)[i], (TRACE)[i]); \
+        } \
+        double time = omp_get_wtime() - start; \
+        CacheStats stats; \
+        NAME##_stats(&cache, &stats); \
+        printf("  %-10s hit ratio: %.4lf, %.1lf Mops/s\n", TITLE, stats.hits / (double) (N_OPS), (N_OPS) / time / 1e6); \
+        NAME##_free(&cache); \
+    } while (0)
+
+#define CHECK_POLICY(NAME, TRACE, N_OPS, CAPACITY) \
+    do { \
+        NAME cache = NAME##_new(CAPACITY); \
+        Set cached = Set_new(0); \
+        NAME##_set_evict_callback(&cache, track_eviction, &cached); \
+        for (size_t i = 0; i < (N_OPS); i++) { \
+            uint64_t key = (TRACE)[i]; \
+            uint64_t* value = NAME##_get(&cache, &key); \
+            assert(!value == !Set_contains(&cached, &key)); \
+            if (value) { \
+                assert(*value == key); \
+                if (i % 7 == 0) { \
+                    bool removed = NAME##_remove(&cache, &key); \
+                    assert(removed); \
+                    Set_remove(&cached, &key); \
+                } \
+            } else { \
+                NAME##_put(&cache, key, key); \
+                Set_search(&cached, &key, true); \
+            } \
+            /* the evict callback removes the entry from cached */ \
+            if (i % 13 == 0) { \
+                size_t size = cache.size; \
+                bool evicted = NAME##_evict(&cache); \
+                assert(evicted == (size > 0) && cache.size == size - evicted); \
+            } \
+            assert(cache.size == cached.size && cache.size <= (CAPACITY)); \
+        } \
+        for (SetIter it = Set_iter(&cached); it.current; SetIter_inc(&it)) \
+            assert(NAME##_contains(&cache, &it.current->key)); \
+        Set_free(&cached); \
+        NAME##_free(&cache); \
+    } while (0)
+
+static void count_eviction(const uint64_t* key, uint64_t* value, void* ctx)
+{
+    (void) value;
+    ((uint64_t*) ctx)[*key]++;
+}
+
+/* evict picks the entry put would have evicted, skipping slots freed by remove */
+static void check_evict()
+{
+    uint64_t counts[8] = {0};
+    uint64_t key;
+
+    Lru lru = Lru_new(4);
+    Lru_set_evict_callback(&lru, count_eviction, counts);
+    bool evicted = Lru_evict(&lru);
+    assert(!evicted);
+    for (key = 1; key <= 3; key++)
+        Lru_put(&lru, key, key);
+    key = 1;
+    Lru_get(&lru, &key);
+    evicted = Lru_evict(&lru);
+    assert(evicted && counts[2] == 1 && lru.size == 2 && !Lru_contains(&lru, &(uint64_t) {2}));
+    Lru_free(&lru);
+
+    memset(counts, 0, sizeof(counts));
+    Clock clock = Clock_new(4);
+    Clock_set_evict_callback(&clock, count_eviction, counts);
+    for (key = 1; key <= 3; key++)
+        Clock_put(&clock, key, key);
+    key = 1;
+    Clock_remove(&clock, &key);
+    key = 2;
+    Clock_get(&clock, &key);
+    /* slot 0 is free, 2 has its reference bit set, so 3 goes first, then 2 */
+    evicted = Clock_evict(&clock);
+    assert(evicted && counts[3] == 1 && counts[1] == 0);
+    evicted = Clock_evict(&clock);
+    assert(evicted && counts[2] == 1 && clock.size == 0);
+    evicted = Clock_evict(&clock);
+    assert(!evicted);
+    /* freed slots are handed out again and evicted as before */
+    for (key = 4; key <= 7; key++)
+        Clock_put(&clock, key, key);
+    Clock_put(&clock, 1, 1);
+    assert(clock.size == 4 && counts[4] + counts[5] + counts[6] + counts[7] == 1);
+    Clock_free(&clock);
+
+    memset(counts, 0, sizeof(counts));
+    S3Fifo s3fifo = S3Fifo_new(4);
+    S3Fifo_set_evict_callback(&s3fifo, count_eviction, counts);
+    for (key = 1; key <= 3; key++)
+        S3Fifo_put(&s3fifo, key, key);
+    /* the small queue is evicted in FIFO order, its keys become ghosts */
+    evicted = S3Fifo_evict(&s3fifo);
+    assert(evicted && counts[1] == 1);
+    CacheStats stats;
+    S3Fifo_put(&s3fifo, 1, 1);
+    S3Fifo_stats(&s3fifo, &stats);
+    assert(stats.ghost_hits == 1 && stats.evictions == 1);
+    S3Fifo_free(&s3fifo);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    size_t n_ops = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000000;
+    size_t capacity = n_keys / 10 ? n_keys / 10 : 1;
+
+    uint64_t rng = 42;
+    WorkloadZipf zipf = workload_zipf_new(n_keys, WORKLOAD_ZIPF_THETA);
+    uint64_t* zipf_trace = malloc(n_ops * sizeof(uint64_t));
+    uint64_t* scan_trace = malloc(n_ops * sizeof(uint64_t));
+    assert(zipf_trace && scan_trace);
+    /* every 100000 operations, 20% of them scan over keys that are never used again */
+    uint64_t next_cold = n_keys;
+    for (size_t i = 0; i < n_ops; i++) {
+        zipf_trace[i] = workload_zipf_next(&zipf, &rng);
+        scan_trace[i] = i % 100000 < 20000 ? next_cold++ : zipf_trace[i];
+    }
+
+    check_evict();
+    size_t n_checked = n_ops < 200000 ? n_ops : 200000;
+    CHECK_POLICY(Lru, zipf_trace, n_checked, capacity);
+    CHECK_POLICY(Clock, zipf_trace, n_checked, capacity);
+    CHECK_POLICY(S3Fifo, zipf_trace, n_checked, capacity);
+    CHECK_POLICY(S3Fifo, scan_trace, n_checked, capacity / 100 ? capacity / 100 : 1);
+
+    const char* trace_names[2] = {"zipf", "zipf with scans"};
+    uint64_t* traces[2] = {zipf_trace, scan_trace};
+    for (int t = 0; t < 2; t++) {
+        printf("%s, %zu keys, %zu operations, capacity %zu:\n", trace_names[t], n_keys, n_ops, capacity);
+        HandLru hand = {HandMap_new(capacity), {0}, capacity, 0};
+        hand.head.next = hand.head.prev = &hand.head;
+        double start = omp_get_wtime();
+        for (size_t i = 0; i < n_ops; i++)
+            hand_access(&hand, traces[t][i]);
+        double time = omp_get_wtime() - start;
+        printf("  %-10s hit ratio: %.4lf, %.1lf Mops/s\n", "by hand", hand.hits / (double) n_ops, n_ops / time / 1e6);
+        for (HandNode* node = hand.head.next; node != &hand.head;) {
+            HandNode* next = node->next;
+            free(node);
+            node = next;
+        }
+        HandMap_free(&hand.map);
+
+        Lru lru = Lru_new(capacity);
+        for (size_t i = 0; i < n_ops; i++)
+            if (!Lru_get(&lru, traces[t]+i))
+                Lru_put(&lru, traces[t][i], traces[t][i]);
+        CacheStats stats;
+        Lru_stats(&lru, &stats);
+        assert(stats.hits == hand.hits);
+        Lru_free(&lru);
+
+        RUN_POLICY(Lru, traces[t], n_ops, capacity, "LRU");
+        RUN_POLICY(Clock, traces[t], n_ops, capacity, "CLOCK");
+        RUN_POLICY(S3Fifo, traces[t], n_ops, capacity, "S3-FIFO");
+    }
+
+    free(zipf_trace);
+    free(scan_trace);
+}
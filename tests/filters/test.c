@@ -0,0 +1,210 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+
+#include "../../datastructures/hashmap.h"
+#include "../../datastructures/treemap.h"
+#include "../../datastructures/bloomfilter.h"
+#include "../../datastructures/cuckoofilter.h"
+#include "../bench/workload.h"
+
+/******************************************************************************
+ * Measures the false positive rate of the Bloom and cuckoo filters, and the
+ * time of n_queries lookups in a HashMap and a TreeMap of n keys, 90% of them
+ * for absent keys, with and without a filter queried first
+ *
+ * Also checks that no added key is ever reported as absent, including after
+ * removals from the cuckoo filter and after filling it up
+ *
+ * usage: ./test [n] [n_queries], default 10^6 keys and 10^7 queries
+ ******************************************************************************/
+
+#define CMP(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+#define EQ(a, b) (*(a) == *(b))
+#define HASH(key) (byte_hasher((const char*)(key), sizeof(*(key))))
+
+HASHMAP_DEFINE(Set, uint64_t, HASHMAP_NO_VALUE, HASH, EQ)
+TREEMAP_DEFINE(Tree, uint64_t, TREEMAP_NO_VALUE, CMP)
+BLOOMFILTER_DEFINE(Bloom10, uint64_t, HASH)
+BLOOMFILTER_DEFINE(Bloom16, uint64_t, HASH)
+CUCKOOFILTER_DEFINE(Cuckoo, uint64_t, HASH)
+
+// queries checked by one call to may_contain_batch
+#define QUERY_BATCH 1024
+
+// added keys are the mixed even numbers, absent keys the mixed odd numbers
+static uint64_t present_key(size_t i) { return workload_mix(2 * i); }
+static uint64_t absent_key(size_t i) { return workload_mix(2 * i + 1); }
+
+#define FALSE_POSITIVES(NAME, FILTER, N) \
+    do { \
+        size_t false_positives = 0; \
+        for (size_t i = 0; i < (N); i++) { \
+            uint64_t key = absent_key(i); \
+            false_positives += NAME##_may_contain(FILTER, &key); \
+        } \
+        printf("  %-12s false positives: %.4lf%%, %.1lf bits per key\n", #NAME, \
+               100.0 * false_positives / (N), 8.0 * NAME##_memory_usage(FILTER) / (FILTER)->size); \
+    } while (0)
+
+#define TIME_LOOKUPS(TITLE, QUERIES, N_QUERIES, EXPECTED, FOUND_EXPR) \
+    do { \
+        size_t found = 0; \
+        double start = omp_get_wtime(); \
+        for (size_t i = 0; i < (N_QUERIES); i++) { \
+            const uint64_t* key = (QUERIES) + i; \
+            found += (FOUND_EXPR); \
+        } \
+        double time = omp_get_wtime() - start; \
+        assert(found == (EXPECTED)); \
+        printf("  %-28s %.1lf ns per lookup\n", TITLE, time / (N_QUERIES) * 1e9); \
+    } while (0)
+
+#define TIME_BATCH_LOOKUPS(TITLE, FILTER_NAME, FILTER, QUERIES, N_QUERIES, EXPECTED, CONTAINS_EXPR) \
+    do { \
+        bool maybe[QUERY_BATCH]; \
+        size_t found = 0; \
+        double start = omp_get_wtime(); \
+        for (size_t b = 0; b < (N_QUERIES); b += QUERY_BATCH) { \
+            size_t batch = (N_QUERIES) - b < QUERY_BATCH ? (N_QUERIES) - b : QUERY_BATCH; \
+            FILTER_NAME##_may_contain_batch(FILTER, (QUERIES) + b, batch, maybe); \
+            for (size_t i = 0; i < batch; i++) { \
+                const uint64_t* key = (QUERIES) + b + i; \
+                found += maybe[i] && (CONTAINS_EXPR); \
+            } \
+        } \
+        double time = omp_get_wtime() - start; \
+        assert(found == (EXPECTED)); \
+        printf("  %-28s %.1lf ns per lookup\n", TITLE, time / (N_QUERIES) * 1e9); \
+    } while (0)
+
+static void check_cuckoo_removal(size_t n)
+{
+    Cuckoo filter = Cuckoo_new(n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = present_key(i);
+        bool added = Cuckoo_add(&filter, &key);
+        assert(added);
+    }
+    for (size_t i = 0; i < n; i += 2) {
+        uint64_t key = present_key(i);
+        bool removed = Cuckoo_remove(&filter, &key);
+        assert(removed);
+    }
+    assert(filter.size == n / 2);
+    size_t removed_positives = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = present_key(i);
+        if (i % 2)
+            assert(Cuckoo_may_contain(&filter, &key));
+        else
+            removed_positives += Cuckoo_may_contain(&filter, &key);
+    }
+    printf("  %-12s removed keys still reported: %.4lf%%\n", "Cuckoo", 100.0 * removed_positives / ((n + 1) / 2));
+    Cuckoo_free(&filter);
+
+    /* a filter filled up until add fails still has every key that was added */
+    filter = Cuckoo_new(1000);
+    size_t n_added = 0;
+    for (;; n_added++) {
+        uint64_t key = present_key(n_added);
+        if (!Cuckoo_add(&filter, &key))
+            break;
+    }
+    assert(n_added == filter.size && n_added >= filter._n_buckets * _CUCKOOFILTER_SLOTS * 9 / 10);
+    for (size_t i = 0; i < n_added; i++) {
+        uint64_t key = present_key(i);
+        assert(Cuckoo_may_contain(&filter, &key));
+    }
+    /* removing frees slots for new keys again */
+    for (size_t i = 0; i < n_added; i += 3) {
+        uint64_t key = present_key(i);
+        bool removed = Cuckoo_remove(&filter, &key);
+        assert(removed);
+    }
+    uint64_t key = absent_key(0);
+    bool added = Cuckoo_add(&filter, &key);
+    assert(added && Cuckoo_may_contain(&filter, &key));
+    for (size_t i = 0; i < n_added; i++) {
+        key = present_key(i);
+        assert(i % 3 == 0 || Cuckoo_may_contain(&filter, &key));
+    }
+    printf("  %-12s filled up at %.1lf%% of its slots\n", "Cuckoo", 100.0 * n_added / (filter._n_buckets * _CUCKOOFILTER_SLOTS));
+    Cuckoo_free(&filter);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    size_t n_queries = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000000;
+
+    Set set = Set_new(0);
+    Tree tree = Tree_new();
+    Bloom10 bloom10 = Bloom10_new(n, 10);
+    Bloom16 bloom16 = Bloom16_new(n, 16);
+    Cuckoo cuckoo = Cuckoo_new(n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = present_key(i);
+        Set_search(&set, &key, true);
+        Tree_search(&tree, &key, true);
+        Bloom10_add(&bloom10, &key);
+        Bloom16_add(&bloom16, &key);
+        bool added = Cuckoo_add(&cuckoo, &key);
+        assert(added);
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = present_key(i);
+        assert(Bloom10_may_contain(&bloom10, &key));
+        assert(Bloom16_may_contain(&bloom16, &key));
+        assert(Cuckoo_may_contain(&cuckoo, &key));
+    }
+    printf("%zu keys:\n", n);
+    FALSE_POSITIVES(Bloom10, &bloom10, n);
+    FALSE_POSITIVES(Bloom16, &bloom16, n);
+    FALSE_POSITIVES(Cuckoo, &cuckoo, n);
+    check_cuckoo_removal(n);
+
+    /* 10% of the queries are for added keys */
+    uint64_t* queries = malloc(n_queries * sizeof(uint64_t));
+    assert(queries);
+    size_t n_present = 0;
+    srand(42);
+    for (size_t i = 0; i < n_queries; i++) {
+        bool present = rand() % 10 == 0;
+        queries[i] = present ? present_key(rand() % n) : absent_key(rand() % n);
+        n_present += present;
+    }
+
+    /* the batch queries must agree with the single ones */
+    bool maybe[QUERY_BATCH];
+    size_t n_checked = n_queries < QUERY_BATCH ? n_queries : QUERY_BATCH;
+    Bloom10_may_contain_batch(&bloom10, queries, n_checked, maybe);
+    for (size_t i = 0; i < n_checked; i++)
+        assert(maybe[i] == Bloom10_may_contain(&bloom10, queries + i));
+    Cuckoo_may_contain_batch(&cuckoo, queries, n_checked, maybe);
+    for (size_t i = 0; i < n_checked; i++)
+        assert(maybe[i] == Cuckoo_may_contain(&cuckoo, queries + i));
+
+    printf("%zu lookups, %zu of added keys:\n", n_queries, n_present);
+    TIME_LOOKUPS("HashMap", queries, n_queries, n_present, Set_contains(&set, key));
+    TIME_LOOKUPS("Bloom10 + HashMap", queries, n_queries, n_present,
+                 Bloom10_may_contain(&bloom10, key) && Set_contains(&set, key));
+    TIME_BATCH_LOOKUPS("Bloom10 batch + HashMap", Bloom10, &bloom10, queries, n_queries, n_present, Set_contains(&set, key));
+    TIME_LOOKUPS("Cuckoo + HashMap", queries, n_queries, n_present,
+                 Cuckoo_may_contain(&cuckoo, key) && Set_contains(&set, key));
+    TIME_BATCH_LOOKUPS("Cuckoo batch + HashMap", Cuckoo, &cuckoo, queries, n_queries, n_present, Set_contains(&set, key));
+    TIME_LOOKUPS("TreeMap", queries, n_queries, n_present, Tree_contains(&tree, key));
+    TIME_LOOKUPS("Bloom10 + TreeMap", queries, n_queries, n_present,
+                 Bloom10_may_contain(&bloom10, key) && Tree_contains(&tree, key));
+    TIME_BATCH_LOOKUPS("Bloom10 batch + TreeMap", Bloom10, &bloom10, queries, n_queries, n_present, Tree_contains(&tree, key));
+
+    free(queries);
+    Cuckoo_free(&cuckoo);
+    Bloom16_free(&bloom16);
+    Bloom10_free(&bloom10);
+    Tree_free(&tree);
+    Set_free(&set);
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+
+#include "../../datastructures/treemap.h"
+#include "../../datastructures/flatmap.h"
+
+/******************************************************************************
+ * Compares lookups, floor queries and full scans of a TreeMap built in bulk
+ * against FlatMaps with the sorted and the Eytzinger layout, for n keys and
+ * n_queries random queries, about two thirds of them for absent keys
+ *
+ * Also checks search, iteration, floor, ceil, insert_sorted and remove of
+ * both layouts against the TreeMap, for every size up to 200 and for n keys
+ *
+ * usage: ./test [n] [n_queries], default 10^7 keys and 10^7 queries
+ ******************************************************************************/
+
+#define CMP(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+
+TREEMAP_DEFINE(Tree, uint64_t, uint64_t, CMP)
+FLATMAP_DEFINE(Sorted, uint64_t, uint64_t, CMP, FLATMAP_SORTED)
+FLATMAP_DEFINE(Eytz, uint64_t, uint64_t, CMP, FLATMAP_EYTZINGER)
+
+static uint64_t rng_state = 42;
+
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// strictly increasing keys, spaced 3 apart on average, so about 2 of 3 numbers are absent
+static void gen_keys(TreeEntry* entries, size_t n)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < n; i++) {
+        key += 1 + rng_next() % 5;
+        entries[i].key = key;
+        entries[i].value = key * 7;
+    }
+}
+
+#define CHECK_AGAINST_TREE(NAME, MAP, TREE, QUERIES, N_QUERIES) \
+    do { \
+        assert((MAP)->size == (TREE)->size); \
+        NAME##Iter it = NAME##_min_iter(MAP); \
+        for (TreeIter tit = Tree_min_iter(TREE); tit.current; TreeIter_inc(&tit), NAME##Iter_inc(&it)) \
+            assert(it.current && it.current->key == tit.current->key && it.current->value == tit.current->value); \
+        assert(!it.current); \
+        it = NAME##_max_iter(MAP); \
+        for (TreeIter tit = Tree_max_iter(TREE); tit.current; TreeIter_dec(&tit), NAME##Iter_dec(&it)) \
+            assert(it.current && it.current->key == tit.current->key); \
+        assert(!it.current); \
+        for (size_t q = 0; q < (N_QUERIES); q++) { \
+            const uint64_t* key = (QUERIES) + q; \
+            TreeEntry* tree_entry = Tree_search(TREE, key, false); \
+            NAME##Entry* entry = NAME##_search(MAP, key, false); \
+            assert(!tree_entry == !entry && (!entry || entry->value == tree_entry->value)); \
+            assert(!NAME##_iter(MAP, key).current == !entry && NAME##_contains(MAP, key) == !!entry); \
+            TreeIter tfloor = Tree_floor_iter(TREE, key); \
+            NAME##Iter floor = NAME##_floor_iter(MAP, key); \
+            assert(!tfloor.current == !floor.current && (!floor.current || floor.current->key == tfloor.current->key)); \
+            if (floor.current) { \
+                NAME##Iter_inc(&floor); \
+                TreeIter_inc(&tfloor); \
+                assert(!tfloor.current == !floor.current && (!floor.current || floor.current->key == tfloor.current->key)); \
+            } \
+            TreeIter tceil = Tree_ceil_iter(TREE, key); \
+            NAME##Iter ceil = NAME##_ceil_iter(MAP, key); \
+            assert(!tceil.current == !ceil.current && (!ceil.current || ceil.current->key == tceil.current->key)); \
+            if (ceil.current) { \
+                NAME##Iter_dec(&ceil); \
+                TreeIter_dec(&tceil); \
+                assert(!tceil.current == !ceil.current && (!ceil.current || ceil.current->key == tceil.current->key)); \
+            } \
+        } \
+    } while (0)
+
+/* every size up to 200: building, merging in a second batch, and removing single keys */
+#define CHECK_SMALL(NAME) \
+    do { \
+        TreeEntry entries[400]; \
+        uint64_t queries[1200]; \
+        for (size_t q = 0; q < 1200; q++) \
+            queries[q] = q; \
+        for (size_t n = 0; n <= 200; n++) { \
+            gen_keys(entries, n); \
+            Tree tree = Tree_from_sorted(entries, n); \
+            NAME map = NAME##_from_sorted((const NAME##Entry*) entries, n); \
+            CHECK_AGAINST_TREE(NAME, &map, &tree, queries, 1200); \
+            \
+            /* a batch overlapping the map, with new values for existing keys */ \
+            size_t n_batch = 0; \
+            for (uint64_t key = rng_next() % 3; key < 1000; key += 1 + rng_next() % 7) { \
+                entries[n_batch].key = key; \
+                entries[n_batch++].value = key * 11; \
+                if (n_batch == 400) \
+                    break; \
+            } \
+            size_t n_new = 0; \
+            for (size_t i = 0; i < n_batch; i++) { \
+                n_new += !Tree_contains(&tree, &entries[i].key); \
+                Tree_insert(&tree, entries[i].key, entries[i].value); \
+            } \
+            size_t n_inserted = NAME##_insert_sorted(&map, (const NAME##Entry*) entries, n_batch); \
+            assert(n_inserted == n_new); \
+            CHECK_AGAINST_TREE(NAME, &map, &tree, queries, 1200); \
+            \
+            for (size_t i = 0; i < 20; i++) { \
+                uint64_t key = rng_next() % 1000; \
+                Tree_remove(&tree, &key); \
+                NAME##_remove(&map, &key); \
+                key = rng_next() % 1000; \
+                if (!Tree_contains(&tree, &key)) { \
+                    Tree_insert(&tree, key, 5); \
+                    NAME##_insert(&map, key, 5); \
+                } \
+            } \
+            CHECK_AGAINST_TREE(NAME, &map, &tree, queries, 1200); \
+            NAME##_free(&map); \
+            Tree_free(&tree); \
+        } \
+    } while (0)
+
+#define TIME_LOOKUPS(NAME, MAP, QUERIES, N_QUERIES, TITLE, MEMORY) \
+    do { \
+        uint64_t sum = 0; \
+        double start = omp_get_wtime(); \
+        for (size_t q = 0; q < (N_QUERIES); q++) { \
+            NAME##Entry* entry = NAME##_search(MAP, (QUERIES) + q, false); \
+            sum += entry ? entry->value : 0; \
+        } \
+        double search_time = omp_get_wtime() - start; \
+        start = omp_get_wtime(); \
+        for (size_t q = 0; q < (N_QUERIES); q++) { \
+            NAME##Iter it = NAME##_floor_iter(MAP, (QUERIES) + q); \
+            sum += it.current ? it.current->key : 0; \
+        } \
+        double floor_time = omp_get_wtime() - start; \
+        start = omp_get_wtime(); \
+        for (NAME##Iter it = NAME##_min_iter(MAP); it.current; NAME##Iter_inc(&it)) \
+            sum += it.current->value; \
+        double scan_time = omp_get_wtime() - start; \
+        printf("  %-12s search: %5.0lf ns, floor_iter: %5.0lf ns, scan: %.3lf s, %.1lf bytes per entry (%lu)\n", \
+               TITLE, search_time / (N_QUERIES) * 1e9, floor_time / (N_QUERIES) * 1e9, scan_time, \
+               (MEMORY) / (double) ((MAP)->size ? (MAP)->size : 1), (unsigned long) (sum & 0xff)); \
+    } while (0)
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    size_t n_queries = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000000;
+
+    CHECK_SMALL(Sorted);
+    CHECK_SMALL(Eytz);
+
+    TreeEntry* entries = malloc((n ? n : 1) * sizeof(TreeEntry));
+    uint64_t* queries = malloc((n_queries ? n_queries : 1) * sizeof(uint64_t));
+    assert(entries && queries);
+    gen_keys(entries, n);
+    uint64_t max_key = n ? entries[n-1].key + 1 : 1;
+    for (size_t q = 0; q < n_queries; q++)
+        queries[q] = rng_next() % max_key;
+
+    double start = omp_get_wtime();
+    Tree tree = Tree_from_sorted(entries, n);
+    double tree_build = omp_get_wtime() - start;
+    start = omp_get_wtime();
+    Sorted sorted = Sorted_from_sorted((const SortedEntry*) entries, n);
+    double sorted_build = omp_get_wtime() - start;
+    start = omp_get_wtime();
+    Eytz eytz = Eytz_from_sorted((const EytzEntry*) entries, n);
+    double eytz_build = omp_get_wtime() - start;
+    size_t n_checked = n_queries < 100000 ? n_queries : 100000;
+    CHECK_AGAINST_TREE(Sorted, &sorted, &tree, queries, n_checked);
+    CHECK_AGAINST_TREE(Eytz, &eytz, &tree, queries, n_checked);
+
+    printf("%zu keys, %zu queries:\n", n, n_queries);
+    printf("  built in TreeMap: %.3lf s, sorted: %.3lf s, Eytzinger: %.3lf s\n", tree_build, sorted_build, eytz_build);
+    TIME_LOOKUPS(Tree, &tree, queries, n_queries, "TreeMap", Tree_memory_usage(&tree));
+    TIME_LOOKUPS(Sorted, &sorted, queries, n_queries, "sorted", Sorted_memory_usage(&sorted));
+    TIME_LOOKUPS(Eytz, &eytz, queries, n_queries, "Eytzinger", Eytz_memory_usage(&eytz));
+
+    Eytz_free(&eytz);
+    Sorted_free(&sorted);
+    Tree_free(&tree);
+    free(queries);
+    free(entries);
+    return 0;
+}
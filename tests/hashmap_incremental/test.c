@@ -0,0 +1,92 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define HASHMAP_INCREMENTAL_RESIZE
+#include "../../datastructures/hashmap.h"
+
+/******************************************************************************
+ * Checks that lookups on a HashMap with HASHMAP_INCREMENTAL_RESIZE leave
+ * iterators valid while a resize is pending: every time the map has both
+ * bucket arrays, it is iterated while searching for every key seen and for
+ * absent keys, and the iterator must still visit every entry once.
+ * Then checks that lookups alone leave a resize pending, and that migrate
+ * finishes it without losing entries
+ *
+ * usage: ./test [n], default 10^6 keys
+ ******************************************************************************/
+
+#define HASH(key) (*(key) * UINT64_C(0x9E3779B97F4A7C15))
+#define EQ(a, b) (*(a) == *(b))
+
+HASHMAP_DEFINE(Map, uint64_t, uint64_t, HASH, EQ)
+
+static uint64_t rng_state = 42;
+
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+
+    Map map = Map_new(0);
+    size_t n_checked = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = rng_next() | 1;
+        Map_insert(&map, key, key * 3);
+        if (i % 7 == 0) {
+            uint64_t remove_key = rng_next() | 1;
+            Map_remove(&map, &remove_key);
+        }
+        if (!map._old_buckets || i % 16 != 0)
+            continue;
+
+        n_checked++;
+        size_t n_seen = 0;
+        for (MapIter it = Map_iter(&map); it.current; MapIter_inc(&it)) {
+            uint64_t absent = rng_next() & ~UINT64_C(1);
+            assert(Map_search(&map, &it.current->key, false) == it.current);
+            assert(Map_contains(&map, &it.current->key) && !Map_contains(&map, &absent));
+            assert(it.current->value == it.current->key * 3);
+            n_seen++;
+        }
+        assert(n_seen == map.size && map._old_buckets);
+    }
+    assert(n < 1000 || n_checked > 0);
+
+    // lookups alone never finish a resize, migrate does
+    uint64_t last_key = 0;
+    while (!map._old_buckets) {
+        last_key = rng_next() | 1;
+        Map_insert(&map, last_key, last_key * 3);
+    }
+    for (size_t i = 0; i < 10000; i++) {
+        uint64_t absent = rng_next() & ~UINT64_C(1);
+        assert(!Map_contains(&map, &absent) && Map_contains(&map, &last_key));
+    }
+    assert(map._old_buckets);
+    size_t size = map.size;
+    size_t n_steps = 0;
+    while (Map_migrate(&map, 64))
+        n_steps++;
+    assert(!map._old_buckets && map._n_old_buckets == 0 && map.size == size);
+    assert(Map_migrate(&map, SIZE_MAX) == false);
+    size_t n_seen = 0;
+    for (MapIter it = Map_iter(&map); it.current; MapIter_inc(&it)) {
+        assert(Map_contains(&map, &it.current->key) && it.current->value == it.current->key * 3);
+        n_seen++;
+    }
+    assert(n_seen == size && Map_contains(&map, &last_key));
+
+    printf("%zu keys, iterated with lookups %zu times during resizes, last resize finished in %zu migrate steps\n",
+           map.size, n_checked, n_steps + 1);
+    Map_free(&map);
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <omp.h>
+
+#include "../../datastructures/hashmap.h"
+#include "../../datastructures/hashmap_mmap.h"
+
+/******************************************************************************
+ * Compares building a set of n keys against saving it and opening the file
+ * with mmap, and queries on both. Also checks that a file claiming more
+ * entries than the load factor allows is rejected
+ *
+ * usage: ./test [n] [path], n defaults to 10^7, path to /tmp/hashmap_mmap.bin
+ ******************************************************************************/
+
+#define EQ(a, b) (*(a) == *(b))
+#define HASH(key) (byte_hasher((const char*)(key), sizeof(*(key))))
+
+HASHMAP_DEFINE(Set, uint64_t, HASHMAP_NO_VALUE, HASH, EQ)
+HASHMAP_MMAP_DEFINE(Set, HASH)
+
+static uint64_t next_key(uint64_t* state)
+{
+    uint64_t z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    const char* path = argc > 2 ? argv[2] : "/tmp/hashmap_mmap.bin";
+    uint64_t* keys = malloc(n * sizeof(uint64_t));
+    assert(keys);
+    uint64_t state = 42;
+    for (size_t i = 0; i < n; i++)
+        keys[i] = next_key(&state);
+
+    double start = omp_get_wtime();
+    Set set = Set_new(0);
+    for (size_t i = 0; i < n; i++)
+        Set_search(&set, keys+i, true);
+    printf("building took: %lf s\n", omp_get_wtime() - start);
+
+    start = omp_get_wtime();
+    bool saved = Set_save(&set, path);
+    printf("saving took: %lf s\n", omp_get_wtime() - start);
+    assert(saved);
+
+    Set mapped;
+    start = omp_get_wtime();
+    bool opened = Set_open_mmap(&mapped, path);
+    double open_time = omp_get_wtime() - start;
+    assert(opened);
+    bool first = Set_contains(&mapped, keys);
+    printf("opening took: %lf s, first query: %lf s\n", open_time, omp_get_wtime() - start - open_time);
+    assert(first && mapped.size == set.size);
+
+    size_t found = 0;
+    start = omp_get_wtime();
+    for (size_t i = 0; i < n; i++)
+        found += Set_contains(&set, keys+i);
+    printf("queries in memory took: %lf s\n", omp_get_wtime() - start);
+    start = omp_get_wtime();
+    for (size_t i = 0; i < n; i++)
+        found += Set_contains(&mapped, keys+i);
+    printf("queries on mapping took: %lf s\n", omp_get_wtime() - start);
+    assert(found == 2 * n);
+
+    size_t n_iterated = 0;
+    for (SetIter it = Set_iter(&mapped); it.current; SetIter_inc(&it))
+        n_iterated += Set_contains(&set, &it.current->key);
+    assert(n_iterated == set.size);
+
+    start = omp_get_wtime();
+    bool verified = Set_verify_mmap(&mapped);
+    printf("verifying the checksum took: %lf s\n", omp_get_wtime() - start);
+    assert(verified);
+
+    Set_close_mmap(&mapped);
+
+    // headers claiming more entries than the load factor allows are rejected, the original one is accepted again
+    FILE* file = fopen(path, "r+b");
+    assert(file);
+    uint64_t sizes[] = {(uint64_t) (set._n_buckets * _HASHMAP_LOAD_FACTOR) + 1, set._n_buckets, set.size};
+    for (size_t s = 0; s < 3; s++) {
+        fseek(file, offsetof(HashMapFileHeader, size), SEEK_SET);
+        size_t n_written = fwrite(sizes + s, sizeof(uint64_t), 1, file);
+        fflush(file);
+        assert(n_written == 1);
+        opened = Set_open_mmap(&mapped, path);
+        assert(opened == (s == 2));
+        if (opened)
+            Set_close_mmap(&mapped);
+    }
+
+    // a bucket count whose byte size wraps around to the real one is rejected
+    uint64_t bucket_size = sizeof(*set._buckets);
+    if ((bucket_size & (bucket_size - 1)) == 0) {
+        uint64_t n_buckets = set._n_buckets + (UINT64_MAX / bucket_size + 1);
+        assert(n_buckets * bucket_size == set._n_buckets * bucket_size);
+        fseek(file, offsetof(HashMapFileHeader, n_buckets), SEEK_SET);
+        size_t n_written = fwrite(&n_buckets, sizeof(uint64_t), 1, file);
+        fflush(file);
+        assert(n_written == 1);
+        opened = Set_open_mmap(&mapped, path);
+        assert(!opened);
+    }
+    fclose(file);
+
+    Set_free(&set);
+    free(keys);
+    remove(path);
+}
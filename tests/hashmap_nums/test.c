@@ -4,6 +4,7 @@
 
 #include "../../datastructures/hashmap.h"
 #include "../../datastructures/vec.h"
+#include "../../datastructures/ingest.h"
 
 #define EQ(a, b) (*(a) == *(b))
 //#define HASH(key) (byte_hasher((const char*)key, 4))
@@ -11,16 +12,24 @@
 
 HASHMAP_DEFINE(Set, int, HASHMAP_NO_VALUE, HASH, EQ)
 VEC_DEFINE(Vec, int)
+INGEST_DEFINE(Vec, int)
 
 int main() 
 {
     Set set = Set_new(0);
-    int n, d;
-    scanf("%d", &n);
+    IntReader reader;
+    int_reader_open(&reader, NULL);
+    int64_t n;
+    if (!int_reader_next(&reader, &n) || n < 0) {
+        fprintf(stderr, "expected the number of integers first\n");
+        return 1;
+    }
     Vec input = Vec_new(0);
-    for (int i = 0; i < n; i++) {
-        scanf("%d", &d);
-        Vec_push(&input, d); 
+    size_t n_read = Vec_read_ints(&input, &reader, n);
+    int_reader_close(&reader);
+    if (n_read < (size_t) n) {
+        fprintf(stderr, "expected %lld integers, read %zu\n", (long long) n, n_read);
+        return 1;
     }
 
     double start = omp_get_wtime();
@@ -44,6 +53,11 @@ int main()
     stop = omp_get_wtime();
     printf("iteration took: %lf s, %d\n", stop-start, sum);
 
+    HashMapStats stats;
+    Set_stats(&set, &stats);
+    printf("load factor: %.2lf, mean probes for hits: %.2lf, misses: %.2lf, longest cluster: %zu\n",
+           stats.load_factor, stats.mean_hit_probes, stats.mean_miss_probes, stats.longest_cluster);
+
     Set_free(&set);
     Vec_free(&input);
 }
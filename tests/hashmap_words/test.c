@@ -4,6 +4,7 @@
 
 #include "../../datastructures/hashmap.h"
 #include "../../datastructures/vec.h"
+#include "../../datastructures/ingest.h"
 
 #define MAX_STR_LEN 200
 
@@ -34,15 +35,37 @@ int main()
 {
     Set set = Set_new(0);
     Vec input = Vec_new(0);
+    LineReader reader;
+    line_reader_open(&reader, NULL);
     String buf;
-    while (fgets(buf.chars, MAX_STR_LEN, stdin)) {
-        buf.size = strlen(buf.chars)-1;
-        buf.chars[buf.size] = '\0';
-        buf.hash = byte_hasher(buf.chars, buf.size);
+    char* line;
+    size_t len;
+    while (line_reader_next(&reader, &line, &len)) {
+        if (len >= MAX_STR_LEN) {
+            fprintf(stderr, "line %zu is longer than %d characters\n", input.size + 1, MAX_STR_LEN - 1);
+            return 1;
+        }
+        memcpy(buf.chars, line, len + 1);
+        buf.size = len;
         Vec_push(&input, buf); 
     }
+    line_reader_close(&reader);
     int n = input.size;
 
+    // hashing keys in batches, computing several SipHashes at once
+    const char* batch_keys[64];
+    size_t batch_lens[64], batch_hashes[64];
+    for (int i = 0; i < n; i += 64) {
+        int batch_size = n - i < 64 ? n - i : 64;
+        for (int j = 0; j < batch_size; j++) {
+            batch_keys[j] = input.arr[i+j].chars;
+            batch_lens[j] = input.arr[i+j].size;
+        }
+        siphash_batch(batch_keys, batch_lens, batch_size, batch_hashes);
+        for (int j = 0; j < batch_size; j++)
+            input.arr[i+j].hash = batch_hashes[j];
+    }
+
     double start = omp_get_wtime();
     for (int i = 0; i < n; i++) {
         const String* key = input.arr+i; 
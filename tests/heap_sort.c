@@ -1,23 +1,29 @@
 
 /******************************************************************************
- * Runs a benchmark comparing libc's builting qsort to a simple heap-sort 
+ * Runs a benchmark comparing libc's builting qsort to a simple heap-sort,
+ * and to the parallel merge and radix sorts from sort.h
  * Generate the dataset before running using the nums_generator python script
  *
  * Tests simple behaviour of vectors and heap functions
+ * Compile with -fopenmp
  ******************************************************************************/
 
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <time.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <omp.h>
 
 #include "../datastructures/vec.h"
 #include "../datastructures/heap.h"
+#include "../datastructures/sort.h"
+#include "../datastructures/ingest.h"
 
 
 #define CMP(a, b) (*(a) > *(b) ? -1 : (*(a) < *(b) ? 1 : 0))
+#define ASC_CMP(a, b) (*(a) < *(b) ? -1 : (*(a) > *(b) ? 1 : 0))
 
 int cmp(const void* a, const void* b) 
 {
@@ -27,7 +33,10 @@ int cmp(const void* a, const void* b)
 }
 
 VEC_DEFINE(Vector, int)
-HEAP_DEFINE(Heap, Vector, int, CMP)
+INGEST_DEFINE(Vector, int)
+HEAP_DEFINE(Heap, int, CMP)
+SORT_DEFINE(IntSort, Vector, int, ASC_CMP)
+RADIX_SORT_DEFINE(IntSort, Vector, int32_t, sort_key_i32, 4)
 
 /**
 * ensures that sorting is not optimized away
@@ -58,45 +67,84 @@ int main()
 {
     Vector qsort_vec = Vector_new(0);
     Vector heap_sort_vec = Vector_new(0);
+    Vector parallel_heap_sort_vec = Vector_new(0);
+    Vector merge_sort_vec = Vector_new(0);
+    Vector radix_sort_vec = Vector_new(0);
 
-    FILE* nums_file = fopen("tests/nums.txt", "r");
-    size_t n;
-    int d;
-    fscanf(nums_file, "%lu", &n);
-    for (size_t i = 0; i < n; i++) {
-        fscanf(nums_file, "%d", &d);
-        Vector_push(&qsort_vec, d);
-        Vector_push(&heap_sort_vec, d);
-    }
-    fclose(nums_file);
-    assert(qsort_vec.size == n && heap_sort_vec.size == n);
+    IntReader reader;
+    bool opened = int_reader_open(&reader, "tests/nums.txt");
+    assert(opened);
+    int64_t n;
+    bool ok = int_reader_next(&reader, &n);
+    assert(ok && n >= 0);
+    Vector_read_ints(&qsort_vec, &reader, n);
+    int_reader_close(&reader);
+    Vector_extend(&heap_sort_vec, qsort_vec.arr, qsort_vec.size);
+    Vector_extend(&parallel_heap_sort_vec, qsort_vec.arr, qsort_vec.size);
+    Vector_extend(&merge_sort_vec, qsort_vec.arr, qsort_vec.size);
+    Vector_extend(&radix_sort_vec, qsort_vec.arr, qsort_vec.size);
+    assert(qsort_vec.size == (size_t) n && heap_sort_vec.size == (size_t) n);
 
     //qsort
-    clock_t start = clock();
+    double start = omp_get_wtime();
     qsort(qsort_vec.arr, qsort_vec.size, sizeof(int), cmp);
-    clock_t end = clock();
-    printf("qsort took %lf s\n", (double)(end - start) / CLOCKS_PER_SEC);
+    double end = omp_get_wtime();
+    printf("qsort took %lf s\n", end - start);
     assert(is_sorted(&qsort_vec));
 
 
     // heap sort
-    start = clock();
+    start = omp_get_wtime();
     Heap_heapify(&heap_sort_vec);
-    int tmp;
     while (heap_sort_vec.size > 1) {
         int tmp = heap_sort_vec.arr[0];
         heap_sort_vec.arr[0] = heap_sort_vec.arr[heap_sort_vec.size - 1];
         heap_sort_vec.arr[heap_sort_vec.size - 1] = tmp;
         heap_sort_vec.size--;
-        _Heap_sift_down(&heap_sort_vec, 0);
+        _Heap_sift_down((Heap*) &heap_sort_vec, 0);
     }
     heap_sort_vec.size = n;
-    end = clock();
-    printf("heapsort took %lf s\n", (double)(end - start) / CLOCKS_PER_SEC);
+    end = omp_get_wtime();
+    printf("heapsort took %lf s\n", end - start);
     assert(is_sorted(&heap_sort_vec));
     assert(sum_vec(&qsort_vec) == sum_vec(&heap_sort_vec));
 
+    // parallel heapify, only the heap construction is parallel
+    start = omp_get_wtime();
+    Heap_parallel_heapify(&parallel_heap_sort_vec);
+    double heapify_end = omp_get_wtime();
+    while (parallel_heap_sort_vec.size > 1) {
+        int tmp = parallel_heap_sort_vec.arr[0];
+        parallel_heap_sort_vec.arr[0] = parallel_heap_sort_vec.arr[parallel_heap_sort_vec.size - 1];
+        parallel_heap_sort_vec.arr[parallel_heap_sort_vec.size - 1] = tmp;
+        parallel_heap_sort_vec.size--;
+        _Heap_sift_down((Heap*) &parallel_heap_sort_vec, 0);
+    }
+    parallel_heap_sort_vec.size = n;
+    end = omp_get_wtime();
+    printf("heapsort with parallel heapify took %lf s (heapify %lf s)\n", end - start, heapify_end - start);
+    assert(is_sorted(&parallel_heap_sort_vec));
+
+    // parallel merge sort
+    start = omp_get_wtime();
+    IntSort_sort(&merge_sort_vec);
+    end = omp_get_wtime();
+    printf("parallel merge sort took %lf s\n", end - start);
+    assert(is_sorted(&merge_sort_vec));
+    assert(sum_vec(&qsort_vec) == sum_vec(&merge_sort_vec));
+
+    // parallel radix sort
+    start = omp_get_wtime();
+    IntSort_radix_sort(&radix_sort_vec);
+    end = omp_get_wtime();
+    printf("parallel radix sort took %lf s\n", end - start);
+    assert(is_sorted(&radix_sort_vec));
+    assert(sum_vec(&qsort_vec) == sum_vec(&radix_sort_vec));
+
     //freeing used memory
     free(heap_sort_vec.arr);
     free(qsort_vec.arr);
+    free(parallel_heap_sort_vec.arr);
+    free(merge_sort_vec.arr);
+    free(radix_sort_vec.arr);
 }
@@ -0,0 +1,118 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define VEC_USE_HUGEALLOC
+#define HASHMAP_USE_HUGEALLOC
+#include "../../datastructures/hugealloc.h"
+#include "../../datastructures/vec.h"
+#include "../../datastructures/hashmap.h"
+
+/******************************************************************************
+ * Checks that hugealloc keeps the contents of an allocation while it is
+ * grown with realloc from malloc into a mapping and further, and shrunk
+ * again, that calloc returns zeroed memory on both sides of the threshold,
+ * and that a Vec and a HashMap backed by it stay correct past the threshold
+ *
+ * Built with _GNU_SOURCE (make target hugealloc-mremap), mappings must be
+ * resized with mremap, otherwise by mapping new memory and copying
+ *
+ * usage: ./test [n], default 10^7 elements, at least 10^6
+ ******************************************************************************/
+
+#define HASH(key) (*(key) * UINT64_C(0x9E3779B97F4A7C15))
+#define EQ(a, b) (*(a) == *(b))
+
+VEC_DEFINE(Vec, uint64_t)
+HASHMAP_DEFINE(Map, uint64_t, uint64_t, HASH, EQ)
+
+static uint64_t pattern(size_t i)
+{
+    return i * UINT64_C(0x9E3779B97F4A7C15) + 7;
+}
+
+static void fill(uint64_t* arr, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        arr[i] = pattern(i);
+}
+
+static bool holds_pattern(const uint64_t* arr, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (arr[i] != pattern(i))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    assert(n >= 1000000);
+
+    // malloc, then growing past the threshold into a mapping, then growing and shrinking the mapping
+    size_t sizes[] = {16, 1000, 100000, n / 2, n, n + 1, 2 * n, n / 3, 1000, 4 * n};
+    uint64_t* arr = hugealloc_malloc(sizes[0] * sizeof(uint64_t));
+    assert(arr);
+    fill(arr, 0, sizes[0]);
+    size_t n_valid = sizes[0];
+    for (size_t s = 1; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        arr = hugealloc_realloc(arr, sizes[s] * sizeof(uint64_t));
+        assert(arr);
+        n_valid = n_valid < sizes[s] ? n_valid : sizes[s];
+        assert(holds_pattern(arr, n_valid));
+        fill(arr, n_valid, sizes[s]);
+        n_valid = sizes[s];
+    }
+    hugealloc_free(arr);
+
+    HugeAllocStats stats = hugealloc_stats();
+    assert(stats.n_mappings == 0 && stats.mapped_bytes == 0);
+    assert(stats.peak_mapped_bytes >= 4 * n * sizeof(uint64_t));
+    assert(stats.n_remaps + stats.n_copies >= 4);
+#ifdef MREMAP_MAYMOVE
+    assert(stats.n_copies == 0);
+#else
+    assert(stats.n_remaps == 0);
+#endif
+
+    // calloc on both sides of the threshold
+    size_t calloc_sizes[] = {10, _HUGEALLOC_THRESHOLD / 16, n};
+    for (size_t s = 0; s < 3; s++) {
+        uint64_t* zeroed = hugealloc_calloc(calloc_sizes[s], sizeof(uint64_t));
+        assert(zeroed);
+        for (size_t i = 0; i < calloc_sizes[s]; i++)
+            assert(zeroed[i] == 0);
+        hugealloc_free(zeroed);
+    }
+    hugealloc_free(NULL);
+
+    // a Vec and a HashMap grown far past the threshold
+    Vec vec = Vec_new(0);
+    Map map = Map_new(0);
+    for (size_t i = 0; i < n; i++) {
+        Vec_push(&vec, pattern(i));
+        if (i % 4 == 0)
+            Map_insert(&map, pattern(i), i);
+    }
+    assert(vec.size == n && holds_pattern(vec.arr, n));
+    assert(map.size == (n + 3) / 4);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = pattern(i);
+        MapEntry* entry = Map_search(&map, &key, false);
+        assert(i % 4 == 0 ? entry && entry->value == i : !entry);
+    }
+    stats = hugealloc_stats();
+    assert(stats.n_mappings == 2);
+    Vec_free(&vec);
+    Map_free(&map);
+
+    stats = hugealloc_stats();
+    printf("%zu elements, %zu remaps, %zu copies, %zu small allocations, peak %.1lf MB mapped\n",
+           n, stats.n_remaps, stats.n_copies, stats.n_malloc_fallbacks, stats.peak_mapped_bytes / 1e6);
+    assert(stats.n_mappings == 0 && stats.mapped_bytes == 0);
+    return 0;
+}
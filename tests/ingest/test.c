@@ -0,0 +1,196 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <omp.h>
+
+#include "../../datastructures/vec.h"
+#include "../../datastructures/hashmap.h"
+#include "../../datastructures/treemap.h"
+#include "../../datastructures/sort.h"
+#include "../../datastructures/ingest.h"
+
+/******************************************************************************
+ * Compares loading n integers with fscanf and one push per element against
+ * the buffered reader from ingest.h, and building a HashMap and TreeMap one
+ * insertion at a time against the bulk entry points. Also checks splitting
+ * lines, including empty ones and one longer than the read buffer
+ *
+ * usage: ./test [n] [path], n defaults to 10^7, path to /tmp/ingest.txt
+ ******************************************************************************/
+
+#define CMP(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+#define EQ(a, b) (*(a) == *(b))
+#define HASH(key) (byte_hasher((const char*)(key), sizeof(*(key))))
+
+VEC_DEFINE(Vec, int32_t)
+INGEST_DEFINE(Vec, int32_t)
+SORT_DEFINE(IntSort, Vec, int32_t, CMP)
+RADIX_SORT_DEFINE(IntSort, Vec, int32_t, sort_key_i32, 4)
+HASHMAP_DEFINE(Set, int32_t, HASHMAP_NO_VALUE, HASH, EQ)
+TREEMAP_DEFINE(Tree, int32_t, TREEMAP_NO_VALUE, CMP)
+
+/* minus signs only belong to a number when a digit follows them */
+static void check_signs(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    assert(file);
+    fputs("5 - -3 --7 x-\n12-4 -0 -", file);
+    fclose(file);
+    int64_t expected[] = {5, -3, -7, 12, -4, 0};
+    IntReader reader;
+    bool opened = int_reader_open(&reader, path);
+    assert(opened);
+    int64_t value;
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        bool ok = int_reader_next(&reader, &value);
+        assert(ok && value == expected[i]);
+    }
+    bool ok = int_reader_next(&reader, &value);
+    assert(!ok);
+    int_reader_close(&reader);
+}
+
+/* lines are returned without their newline, the last one even without a newline after it */
+static void check_lines(const char* path)
+{
+    size_t long_len = 3 * _INGEST_BUFFER_SIZE + 5;
+    char* long_line = malloc(long_len + 1);
+    assert(long_line);
+    for (size_t i = 0; i < long_len; i++)
+        long_line[i] = 'a' + i % 26;
+    long_line[long_len] = '\0';
+    const char* expected[] = {"first", "", "  spaces and\ttabs ", long_line, "", "last"};
+    size_t n_lines = sizeof(expected) / sizeof(expected[0]);
+
+    FILE* file = fopen(path, "w");
+    assert(file);
+    for (size_t i = 0; i < n_lines; i++)
+        fprintf(file, i + 1 < n_lines ? "%s\n" : "%s", expected[i]);
+    fclose(file);
+
+    LineReader reader;
+    bool opened = line_reader_open(&reader, path);
+    assert(opened);
+    char* line;
+    size_t len;
+    for (size_t i = 0; i < n_lines; i++) {
+        bool ok = line_reader_next(&reader, &line, &len);
+        assert(ok && len == strlen(expected[i]) && strcmp(line, expected[i]) == 0);
+    }
+    bool ok = line_reader_next(&reader, &line, &len);
+    assert(!ok);
+    line_reader_close(&reader);
+    free(long_line);
+
+    // a newline at the end does not start another line
+    file = fopen(path, "w");
+    assert(file);
+    fputs("x\n", file);
+    fclose(file);
+    opened = line_reader_open(&reader, path);
+    assert(opened);
+    ok = line_reader_next(&reader, &line, &len);
+    assert(ok && len == 1 && line[0] == 'x' && line[1] == '\0');
+    ok = line_reader_next(&reader, &line, &len);
+    assert(!ok);
+    line_reader_close(&reader);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    const char* path = argc > 2 ? argv[2] : "/tmp/ingest.txt";
+
+    check_signs(path);
+    check_lines(path);
+
+    FILE* file = fopen(path, "w");
+    assert(file);
+    srand(42);
+    fprintf(file, "%zu\n", n);
+    for (size_t i = 0; i < n; i++)
+        fprintf(file, "%d\n", (int32_t) ((uint32_t) rand() * 2654435761u));
+    size_t file_size = ftell(file);
+    fclose(file);
+
+    double start = omp_get_wtime();
+    file = fopen(path, "r");
+    size_t header;
+    int d;
+    bool ok = fscanf(file, "%zu", &header) == 1;
+    assert(ok && header == n);
+    Vec scanned = Vec_new(0);
+    for (size_t i = 0; i < n; i++) {
+        ok = fscanf(file, "%d", &d) == 1;
+        assert(ok);
+        Vec_push(&scanned, d);
+    }
+    fclose(file);
+    double scanf_time = omp_get_wtime() - start;
+    printf("fscanf and push took: %lf s, %.0lf MB/s\n", scanf_time, file_size / scanf_time / 1e6);
+
+    start = omp_get_wtime();
+    IntReader reader;
+    bool opened = int_reader_open(&reader, path);
+    assert(opened);
+    int64_t header_value;
+    ok = int_reader_next(&reader, &header_value);
+    assert(ok && (size_t) header_value == n);
+    Vec input = Vec_new(0);
+    size_t n_read = Vec_read_ints(&input, &reader, n);
+    int_reader_close(&reader);
+    double read_time = omp_get_wtime() - start;
+    printf("int_reader and read_ints took: %lf s, %.0lf MB/s\n", read_time, file_size / read_time / 1e6);
+    assert(n_read == n && input.size == n);
+    for (size_t i = 0; i < n; i++)
+        assert(input.arr[i] == scanned.arr[i]);
+
+    start = omp_get_wtime();
+    Set set = Set_new(0);
+    for (size_t i = 0; i < n; i++)
+        Set_search(&set, input.arr+i, true);
+    printf("hashmap insertion took: %lf s\n", omp_get_wtime() - start);
+    start = omp_get_wtime();
+    Set bulk_set = Set_new(0);
+    size_t n_inserted = Set_insert_keys(&bulk_set, input.arr, n);
+    printf("hashmap insert_keys took: %lf s\n", omp_get_wtime() - start);
+    assert(n_inserted == set.size && bulk_set.size == set.size);
+    for (size_t i = 0; i < n; i++)
+        assert(Set_contains(&bulk_set, input.arr+i));
+
+    start = omp_get_wtime();
+    Tree tree = Tree_new();
+    for (size_t i = 0; i < n; i++)
+        Tree_search(&tree, input.arr+i, true);
+    printf("treemap insertion took: %lf s\n", omp_get_wtime() - start);
+    start = omp_get_wtime();
+    Vec sorted = Vec_copy(&input);
+    IntSort_radix_sort(&sorted);
+    size_t n_unique = 0;
+    for (size_t i = 0; i < sorted.size; i++)
+        if (n_unique == 0 || sorted.arr[i] != sorted.arr[n_unique-1])
+            sorted.arr[n_unique++] = sorted.arr[i];
+    Tree bulk_tree = Tree_from_sorted_keys(sorted.arr, n_unique);
+    printf("treemap radix sort and from_sorted_keys took: %lf s\n", omp_get_wtime() - start);
+    assert(bulk_tree.size == tree.size);
+    TreeIter it = Tree_min_iter(&tree), bulk_it = Tree_min_iter(&bulk_tree);
+    for (; it.current; TreeIter_inc(&it), TreeIter_inc(&bulk_it))
+        assert(bulk_it.current && it.current->key == bulk_it.current->key);
+
+    TreeMapStats stats, bulk_stats;
+    Tree_stats(&tree, &stats);
+    Tree_stats(&bulk_tree, &bulk_stats);
+    printf("treemap height: %zu, mean node fill: %.2lf, bulk built: height %zu, mean node fill: %.2lf\n",
+           stats.height, stats.mean_fill, bulk_stats.height, bulk_stats.mean_fill);
+
+    Tree_free(&tree);
+    Tree_free(&bulk_tree);
+    Set_free(&set);
+    Set_free(&bulk_set);
+    Vec_free(&sorted);
+    Vec_free(&input);
+    Vec_free(&scanned);
+    remove(path);
+}
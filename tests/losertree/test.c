@@ -0,0 +1,215 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <omp.h>
+
+#include "../../datastructures/losertree.h"
+#include "../../datastructures/heap.h"
+
+/******************************************************************************
+ * Checks k-way merges with a loser tree against a sorted reference, for
+ * empty and uneven runs, k = 1 and k not a power of two, and checks that
+ * equal elements come out in the order of their runs. Then times merging
+ * k runs of n elements in total, against a k-way merge with a heap,
+ * taking the best of 3 rounds of each
+ *
+ * usage: ./test [n] [k], default 10^7 elements in 64 runs
+ ******************************************************************************/
+
+typedef struct
+{
+    uint64_t key;
+    uint32_t run;
+    uint32_t pos;
+} Item;
+
+#define KEY_CMP(a, b) (((a)->key > (b)->key) - ((a)->key < (b)->key))
+// order of a stable merge: by key, then by run, and within a run by position
+#define FULL_CMP(a, b) (KEY_CMP(a, b) ? KEY_CMP(a, b) : \
+    ((a)->run != (b)->run ? ((a)->run > (b)->run) - ((a)->run < (b)->run) : ((a)->pos > (b)->pos) - ((a)->pos < (b)->pos)))
+
+LOSER_TREE_DEFINE(Merger, Item, KEY_CMP)
+HEAP_DEFINE(Heap, Item, FULL_CMP)
+
+static uint64_t rng_state = 42;
+
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static int item_cmp(const void* a, const void* b)
+{
+    return FULL_CMP((const Item*) a, (const Item*) b);
+}
+
+/* fills k sorted runs of the given sizes, with keys below max_key, all stored in items */
+static void gen_runs(Item* items, MergerArrayRun* runs, const size_t* sizes, size_t k, uint64_t max_key)
+{
+    size_t offset = 0;
+    for (size_t r = 0; r < k; r++) {
+        for (size_t i = 0; i < sizes[r]; i++)
+            items[offset + i] = (Item) {rng_next() % max_key, r, 0};
+        qsort(items + offset, sizes[r], sizeof(Item), item_cmp);
+        for (size_t i = 0; i < sizes[r]; i++)
+            items[offset + i].pos = i;
+        runs[r] = (MergerArrayRun) {items + offset, sizes[r], 0};
+        offset += sizes[r];
+    }
+}
+
+static void check_merge(const size_t* sizes, size_t k, uint64_t max_key)
+{
+    size_t n = 0;
+    for (size_t r = 0; r < k; r++)
+        n += sizes[r];
+    Item* items = malloc((n ? n : 1) * sizeof(Item));
+    Item* expected = malloc((n ? n : 1) * sizeof(Item));
+    MergerArrayRun* runs = malloc(k * sizeof(MergerArrayRun));
+    MergerSource* sources = malloc(k * sizeof(MergerSource));
+    assert(items && expected && runs && sources);
+    gen_runs(items, runs, sizes, k, max_key);
+    memcpy(expected, items, n * sizeof(Item));
+    qsort(expected, n, sizeof(Item), item_cmp);
+
+    for (size_t r = 0; r < k; r++)
+        sources[r] = Merger_array_source(runs + r);
+    Merger merger = Merger_new(sources, k);
+    Item item;
+    for (size_t i = 0; i < n; i++) {
+        bool ok = Merger_pop(&merger, &item);
+        assert(ok && memcmp(&item, expected + i, sizeof(Item)) == 0);
+        (void) ok;
+    }
+    bool popped = Merger_pop(&merger, &item);
+    popped |= Merger_pop(&merger, &item);
+    assert(!popped);
+    Merger_free(&merger);
+
+    // the same merge through binary files
+    FILE** files = malloc(k * sizeof(FILE*));
+    assert(files);
+    for (size_t r = 0; r < k; r++) {
+        files[r] = tmpfile();
+        assert(files[r]);
+        for (size_t i = 0; i < sizes[r]; i++)
+            Merger_file_sink(files[r], runs[r].arr + i);
+        rewind(files[r]);
+        sources[r] = Merger_file_source(files[r]);
+    }
+    FILE* out = tmpfile();
+    assert(out);
+    merger = Merger_new(sources, k);
+    size_t n_merged = Merger_merge(&merger, Merger_file_sink, out);
+    assert(n_merged == n);
+    rewind(out);
+    for (size_t i = 0; i < n; i++) {
+        size_t n_read = fread(&item, sizeof(Item), 1, out);
+        assert(n_read == 1 && memcmp(&item, expected + i, sizeof(Item)) == 0);
+        (void) n_read;
+    }
+    Merger_free(&merger);
+    fclose(out);
+    for (size_t r = 0; r < k; r++)
+        fclose(files[r]);
+
+    free(files);
+    free(sources);
+    free(runs);
+    free(expected);
+    free(items);
+}
+
+/* the same merge as Merger_pop, with a heap holding the head of every run */
+static size_t heap_merge(MergerArrayRun* runs, size_t k, uint64_t* checksum)
+{
+    Heap heap = Heap_new();
+    for (size_t r = 0; r < k; r++) {
+        runs[r]._index = 0;
+        if (runs[r].size)
+            Heap_push(&heap, runs[r].arr[runs[r]._index++]);
+    }
+    size_t n = 0;
+    while (heap.size) {
+        Item item = Heap_pop(&heap);
+        *checksum = *checksum * 31 + item.key;
+        n++;
+        MergerArrayRun* run = runs + item.run;
+        if (run->_index < run->size)
+            Heap_push(&heap, run->arr[run->_index++]);
+    }
+    Heap_free(&heap);
+    return n;
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    size_t k = argc > 2 ? strtoull(argv[2], NULL, 10) : 64;
+    assert(k > 0);
+
+    size_t sizes[40];
+    for (size_t n_runs = 1; n_runs <= 40; n_runs++) {
+        // uneven runs, about every fourth empty, with many equal keys for small max_key
+        for (size_t r = 0; r < n_runs; r++)
+            sizes[r] = rng_next() % 4 == 0 ? 0 : rng_next() % (r % 3 == 0 ? 200 : 20);
+        check_merge(sizes, n_runs, 50);
+        check_merge(sizes, n_runs, UINT64_MAX);
+        for (size_t r = 0; r < n_runs; r++)
+            sizes[r] = 0;
+        check_merge(sizes, n_runs, 50);
+    }
+    sizes[0] = 1000;
+    check_merge(sizes, 1, 10);
+
+    size_t* run_sizes = malloc(k * sizeof(size_t));
+    MergerArrayRun* runs = malloc(k * sizeof(MergerArrayRun));
+    MergerSource* sources = malloc(k * sizeof(MergerSource));
+    Item* items = malloc((n ? n : 1) * sizeof(Item));
+    assert(run_sizes && runs && sources && items);
+    for (size_t r = 0; r < k; r++)
+        run_sizes[r] = n / k + (r < n % k);
+    gen_runs(items, runs, run_sizes, k, UINT64_MAX);
+
+    // best of a few alternating rounds, as a single run of either is noisy
+    double tree_time = 1e30, heap_time = 1e30;
+    for (int round = 0; round < 3; round++) {
+        uint64_t tree_checksum = 0, heap_checksum = 0;
+        double start = omp_get_wtime();
+        for (size_t r = 0; r < k; r++)
+            sources[r] = Merger_array_source(runs + r);
+        Merger merger = Merger_new(sources, k);
+        Item item;
+        size_t n_tree = 0;
+        while (Merger_pop(&merger, &item)) {
+            tree_checksum = tree_checksum * 31 + item.key;
+            n_tree++;
+        }
+        Merger_free(&merger);
+        double elapsed = omp_get_wtime() - start;
+        tree_time = elapsed < tree_time ? elapsed : tree_time;
+
+        start = omp_get_wtime();
+        size_t n_heap = heap_merge(runs, k, &heap_checksum);
+        elapsed = omp_get_wtime() - start;
+        heap_time = elapsed < heap_time ? elapsed : heap_time;
+        assert(n_tree == n && n_heap == n && tree_checksum == heap_checksum);
+        (void) n_tree;
+        (void) n_heap;
+    }
+
+    printf("merging %zu elements from %zu runs:\n", n, k);
+    printf("  loser tree: %.3lf s, %.1lf ns per element\n", tree_time, tree_time / (n ? n : 1) * 1e9);
+    printf("  heap:       %.3lf s, %.1lf ns per element\n", heap_time, heap_time / (n ? n : 1) * 1e9);
+
+    free(items);
+    free(sources);
+    free(runs);
+    free(run_sizes);
+    return 0;
+}
@@ -0,0 +1,63 @@
+import java.util.HashMap;
+import java.util.HashSet;
+import java.util.TreeMap;
+import java.util.TreeSet;
+
+/**
+ * Reports the heap bytes used per entry by the standard collections,
+ * estimated from the used heap after garbage collection, before and after
+ * building each collection. Boxed keys and values are included
+ *
+ * usage: java Test [n], n defaults to 10^6
+ */
+public class Test {
+    static int key32(long i) {
+        return (int) (i * 2654435761L);
+    }
+
+    static long key64(long i) {
+        return i * 0x9E3779B97F4A7C15L;
+    }
+
+    static long usedMemory() {
+        Runtime runtime = Runtime.getRuntime();
+        for (int i = 0; i < 4; i++)
+            System.gc();
+        return runtime.totalMemory() - runtime.freeMemory();
+    }
+
+    static void report(String name, long bytes, int n) {
+        System.out.printf("%-28s %8.2f bytes per entry%n", name, bytes / (double) n);
+    }
+
+    public static void main(String[] args) {
+        int n = args.length > 0 ? Integer.parseInt(args[0]) : 1000000;
+
+        long before = usedMemory();
+        HashSet<Integer> hashSet = new HashSet<>();
+        for (int i = 0; i < n; i++)
+            hashSet.add(key32(i));
+        report("HashSet<Integer>", usedMemory() - before, hashSet.size());
+        hashSet = null;
+
+        before = usedMemory();
+        HashMap<Long, Long> hashMap = new HashMap<>();
+        for (int i = 0; i < n; i++)
+            hashMap.put(key64(i), (long) i);
+        report("HashMap<Long, Long>", usedMemory() - before, hashMap.size());
+        hashMap = null;
+
+        before = usedMemory();
+        TreeSet<Integer> treeSet = new TreeSet<>();
+        for (int i = 0; i < n; i++)
+            treeSet.add(key32(i));
+        report("TreeSet<Integer>", usedMemory() - before, treeSet.size());
+        treeSet = null;
+
+        before = usedMemory();
+        TreeMap<Long, Long> treeMap = new TreeMap<>();
+        for (int i = 0; i < n; i++)
+            treeMap.put(key64(i), (long) i);
+        report("TreeMap<Long, Long>", usedMemory() - before, treeMap.size());
+    }
+}
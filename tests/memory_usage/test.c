@@ -0,0 +1,89 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../../datastructures/vec.h"
+#include "../../datastructures/heap.h"
+#include "../../datastructures/queue.h"
+#include "../../datastructures/hashmap.h"
+#include "../../datastructures/treemap.h"
+
+/******************************************************************************
+ * Reports the bytes used per entry by each container, as given by the
+ * _memory_usage functions, after inserting n distinct keys
+ *
+ * usage: ./test [n], n defaults to 10^6
+ ******************************************************************************/
+
+#define EQ(a, b) (*(a) == *(b))
+#define HASH(key) (byte_hasher((const char*)(key), sizeof(*(key))))
+#define CMP(a, b) (*(a) < *(b) ? -1 : (*(a) == *(b) ? 0 : 1))
+
+HASHMAP_DEFINE(HashSet32, int32_t, HASHMAP_NO_VALUE, HASH, EQ)
+HASHMAP_DEFINE(HashMap64, int64_t, int64_t, HASH, EQ)
+TREEMAP_DEFINE(TreeSet32, int32_t, TREEMAP_NO_VALUE, CMP)
+TREEMAP_DEFINE(TreeMap64, int64_t, int64_t, CMP)
+VEC_DEFINE(Vec32, int32_t)
+HEAP_DEFINE(Heap32, int32_t, CMP)
+QUEUE_DEFINE(Queue32, int32_t)
+
+/* distinct keys, as multiplication by an odd constant is a bijection */
+static int32_t key32(size_t i) { return (int32_t) (uint32_t) (i * UINT32_C(2654435761)); }
+static int64_t key64(size_t i) { return (int64_t) (i * UINT64_C(0x9E3779B97F4A7C15)); }
+
+static void report(const char* name, size_t bytes, size_t n)
+{
+    printf("%-28s %8.2f bytes per entry\n", name, bytes / (double) n);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+
+    HashSet32 hash_set = HashSet32_new(0);
+    for (size_t i = 0; i < n; i++) {
+        int32_t key = key32(i);
+        HashSet32_search(&hash_set, &key, true);
+    }
+    report("hashmap.h set<int32>", HashSet32_memory_usage(&hash_set), n);
+    HashSet32_free(&hash_set);
+
+    HashMap64 hash_map = HashMap64_new(0);
+    for (size_t i = 0; i < n; i++)
+        HashMap64_insert(&hash_map, key64(i), i);
+    report("hashmap.h map<int64,int64>", HashMap64_memory_usage(&hash_map), n);
+    HashMap64_free(&hash_map);
+
+    TreeSet32 tree_set = TreeSet32_new();
+    for (size_t i = 0; i < n; i++) {
+        int32_t key = key32(i);
+        TreeSet32_search(&tree_set, &key, true);
+    }
+    report("treemap.h set<int32>", TreeSet32_memory_usage(&tree_set), n);
+    TreeSet32_free(&tree_set);
+
+    TreeMap64 tree_map = TreeMap64_new();
+    for (size_t i = 0; i < n; i++)
+        TreeMap64_insert(&tree_map, key64(i), i);
+    report("treemap.h map<int64,int64>", TreeMap64_memory_usage(&tree_map), n);
+    TreeMap64_free(&tree_map);
+
+    Vec32 vec = Vec32_new(0);
+    for (size_t i = 0; i < n; i++)
+        Vec32_push(&vec, key32(i));
+    report("vec.h <int32>", Vec32_memory_usage(&vec), n);
+    Vec32_free(&vec);
+
+    Heap32 heap = Heap32_new();
+    for (size_t i = 0; i < n; i++)
+        Heap32_push(&heap, key32(i));
+    report("heap.h <int32>", Heap32_memory_usage(&heap), n);
+    Heap32_free(&heap);
+
+    Queue32 queue = Queue32_new(0);
+    for (size_t i = 0; i < n; i++)
+        Queue32_push(&queue, key32(i));
+    report("queue.h <int32>", Queue32_memory_usage(&queue), n);
+    free(queue._arr);
+}
@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+/******************************************************************************
+ * Reports the bytes allocated per entry by the standard library containers,
+ * counted by replacing the global operator new and delete
+ *
+ * usage: ./test [n], n defaults to 10^6
+ ******************************************************************************/
+
+static size_t live_bytes = 0;
+
+void* operator new(size_t size)
+{
+    void* ptr = std::malloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    live_bytes += size;
+    return ptr;
+}
+
+// the standard containers release their memory through std::allocator,
+// which passes the size on to the sized operator delete
+void operator delete(void* ptr, size_t size) noexcept
+{
+    live_bytes -= size;
+    std::free(ptr);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+static int32_t key32(size_t i) { return (int32_t) (uint32_t) (i * UINT32_C(2654435761)); }
+static int64_t key64(size_t i) { return (int64_t) (i * UINT64_C(0x9E3779B97F4A7C15)); }
+
+static void report(const char* name, size_t bytes, size_t n)
+{
+    std::printf("%-36s %8.2f bytes per entry\n", name, bytes / (double) n);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? std::strtoull(argv[1], NULL, 10) : 1000000;
+    size_t before;
+
+    {
+        before = live_bytes;
+        std::unordered_set<int32_t> s;
+        for (size_t i = 0; i < n; i++)
+            s.insert(key32(i));
+        report("std::unordered_set<int32>", live_bytes - before + sizeof(s), n);
+    }
+    {
+        before = live_bytes;
+        std::unordered_map<int64_t, int64_t> m;
+        for (size_t i = 0; i < n; i++)
+            m[key64(i)] = i;
+        report("std::unordered_map<int64,int64>", live_bytes - before + sizeof(m), n);
+    }
+    {
+        before = live_bytes;
+        std::set<int32_t> s;
+        for (size_t i = 0; i < n; i++)
+            s.insert(key32(i));
+        report("std::set<int32>", live_bytes - before + sizeof(s), n);
+    }
+    {
+        before = live_bytes;
+        std::map<int64_t, int64_t> m;
+        for (size_t i = 0; i < n; i++)
+            m[key64(i)] = i;
+        report("std::map<int64,int64>", live_bytes - before + sizeof(m), n);
+    }
+}
@@ -0,0 +1,79 @@
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::collections::{BTreeMap, BTreeSet, HashMap, HashSet};
+use std::mem::size_of_val;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+// Reports the bytes allocated per entry by the standard library collections,
+// counted by a global allocator wrapping the system allocator
+//
+// usage: ./test [n], n defaults to 10^6
+
+struct CountingAlloc;
+
+static LIVE_BYTES: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        LIVE_BYTES.fetch_add(layout.size(), Ordering::Relaxed);
+        unsafe { System.alloc(layout) }
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        LIVE_BYTES.fetch_sub(layout.size(), Ordering::Relaxed);
+        unsafe { System.dealloc(ptr, layout) }
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+fn key32(i: usize) -> i32 {
+    (i as u32).wrapping_mul(2654435761) as i32
+}
+
+fn key64(i: usize) -> i64 {
+    (i as u64).wrapping_mul(0x9E3779B97F4A7C15) as i64
+}
+
+fn report(name: &str, bytes: usize, n: usize) {
+    println!("{:<32} {:8.2} bytes per entry", name, bytes as f64 / n as f64);
+}
+
+fn main() {
+    let n: usize = std::env::args()
+        .nth(1)
+        .map(|s| s.parse().unwrap())
+        .unwrap_or(1000000);
+
+    let before = LIVE_BYTES.load(Ordering::Relaxed);
+    let mut hash_set = HashSet::new();
+    for i in 0..n {
+        hash_set.insert(key32(i));
+    }
+    report("HashSet<i32>", LIVE_BYTES.load(Ordering::Relaxed) - before + size_of_val(&hash_set), n);
+    drop(hash_set);
+
+    let before = LIVE_BYTES.load(Ordering::Relaxed);
+    let mut hash_map = HashMap::new();
+    for i in 0..n {
+        hash_map.insert(key64(i), i as i64);
+    }
+    report("HashMap<i64, i64>", LIVE_BYTES.load(Ordering::Relaxed) - before + size_of_val(&hash_map), n);
+    drop(hash_map);
+
+    let before = LIVE_BYTES.load(Ordering::Relaxed);
+    let mut tree_set = BTreeSet::new();
+    for i in 0..n {
+        tree_set.insert(key32(i));
+    }
+    report("BTreeSet<i32>", LIVE_BYTES.load(Ordering::Relaxed) - before + size_of_val(&tree_set), n);
+    drop(tree_set);
+
+    let before = LIVE_BYTES.load(Ordering::Relaxed);
+    let mut tree_map = BTreeMap::new();
+    for i in 0..n {
+        tree_map.insert(key64(i), i as i64);
+    }
+    report("BTreeMap<i64, i64>", LIVE_BYTES.load(Ordering::Relaxed) - before + size_of_val(&tree_map), n);
+    drop(tree_map);
+}
@@ -0,0 +1,222 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+
+#include "../../datastructures/hashmap.h"
+#include "../../datastructures/treemap.h"
+
+/******************************************************************************
+ * Checks range-partitioned iteration of HashMap and TreeMap, and their
+ * parallel_for_each and parallel_reduce, then measures how the time to sum
+ * the values of n entries scales with 1, 2, 4, ... threads, against a
+ * sequential loop over an iterator
+ *
+ * Built with HASHMAP_INCREMENTAL_RESIZE, also runs them while HashMaps
+ * have a resize pending
+ *
+ * usage: ./test [n] [max_threads], default 10^7 entries and the number of
+ * cores, at least 4
+ ******************************************************************************/
+
+#define CMP(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+#define HASH(key) (*(key) * UINT64_C(0x9E3779B97F4A7C15))
+#define EQ(a, b) (*(a) == *(b))
+
+HASHMAP_DEFINE(Map, uint64_t, uint64_t, HASH, EQ)
+TREEMAP_DEFINE(Tree, uint64_t, uint64_t, CMP)
+
+static uint64_t rng_state = 42;
+
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+typedef struct
+{
+    uint64_t sum;
+    uint64_t n;
+} Sum;
+
+static void map_add(void* acc, const MapEntry* entry) { ((Sum*) acc)->sum += entry->value; ((Sum*) acc)->n++; }
+static void tree_add(void* acc, const TreeEntry* entry) { ((Sum*) acc)->sum += entry->value; ((Sum*) acc)->n++; }
+
+static void sum_merge(void* acc, const void* other)
+{
+    ((Sum*) acc)->sum += ((const Sum*) other)->sum;
+    ((Sum*) acc)->n += ((const Sum*) other)->n;
+}
+
+static void map_double(MapEntry* entry, void* ctx) { (void) ctx; entry->value *= 2; }
+static void tree_double(TreeEntry* entry, void* ctx) { (void) ctx; entry->value *= 2; }
+
+static void check_map(size_t n)
+{
+    Map map = Map_new(0);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = rng_next();
+        if (!Map_contains(&map, &key))
+            sum += key % 1000;
+        Map_insert(&map, key, key % 1000);
+    }
+
+    // every split of the buckets into ranges visits each entry once
+    size_t n_buckets = Map_bucket_count(&map);
+    for (size_t n_ranges = 1; n_ranges <= 17; n_ranges += 4) {
+        Sum acc = {0, 0};
+        for (size_t r = 0; r < n_ranges; r++) {
+            for (MapIter it = Map_iter_range(&map, r * n_buckets / n_ranges, (r + 1) * n_buckets / n_ranges); it.current; MapIter_inc(&it))
+                map_add(&acc, it.current);
+        }
+        assert(acc.n == map.size && acc.sum == sum);
+    }
+    assert(!Map_iter_range(&map, n_buckets, n_buckets).current);
+
+    Sum acc = {0, 0};
+    Map_parallel_reduce(&map, &acc, sizeof(acc), map_add, sum_merge);
+    assert(acc.n == map.size && acc.sum == sum);
+    Map_parallel_for_each(&map, map_double, NULL);
+    acc = (Sum) {0, 0};
+    Map_parallel_reduce(&map, &acc, sizeof(acc), map_add, sum_merge);
+    assert(acc.n == map.size && acc.sum == 2 * sum);
+    Map_free(&map);
+}
+
+#ifdef HASHMAP_INCREMENTAL_RESIZE
+typedef struct
+{
+    const Map* map;
+    uint64_t n_found;
+} LookupCtx;
+
+// looks up the key of every entry from fn, which must not move entries during a resize
+static void map_lookup(MapEntry* entry, void* ctx)
+{
+    LookupCtx* lookup = ctx;
+    bool found = Map_contains(lookup->map, &entry->key);
+    #pragma omp atomic
+    lookup->n_found += found;
+}
+
+// parallel_reduce and parallel_for_each with lookups, while both bucket arrays are in use
+static void check_map_resizing(size_t n)
+{
+    Map map = Map_new(0);
+    uint64_t sum = 0;
+    size_t n_checked = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = rng_next();
+        if (!Map_contains(&map, &key))
+            sum += key % 1000;
+        Map_insert(&map, key, key % 1000);
+        if (!map._old_buckets || i % 32 != 0)
+            continue;
+        n_checked++;
+        Sum acc = {0, 0};
+        Map_parallel_reduce(&map, &acc, sizeof(acc), map_add, sum_merge);
+        assert(acc.n == map.size && acc.sum == sum);
+        LookupCtx lookup = {&map, 0};
+        Map_parallel_for_each(&map, map_lookup, &lookup);
+        assert(lookup.n_found == map.size && map._old_buckets);
+    }
+    assert(n < 1000 || n_checked > 0);
+    Map_free(&map);
+}
+#endif
+
+static void check_tree(size_t n)
+{
+    Tree tree = Tree_new();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = rng_next() % (4 * n + 1);
+        if (!Tree_contains(&tree, &key))
+            sum += key % 1000;
+        Tree_insert(&tree, key, key % 1000);
+    }
+
+    // the ranges of a split are non-empty and together visit every entry once, in key order
+    TreeIter begins[300];
+    for (size_t k = 0; k <= 300; k += 1 + k / 4) {
+        size_t n_ranges = Tree_split(&tree, begins, k);
+        assert(n_ranges <= k && (n_ranges > 0 || k == 0 || tree.size == 0));
+        assert(n_ranges == k || tree.size < 300 || k == 0 || n_ranges > k / 2);
+        TreeIter tit = Tree_min_iter(&tree);
+        for (size_t r = 0; r < n_ranges; r++) {
+            const TreeEntry* end = r + 1 < n_ranges ? begins[r+1].current : NULL;
+            assert(begins[r].current && begins[r].current != end);
+            for (TreeIter it = begins[r]; it.current != end; TreeIter_inc(&it), TreeIter_inc(&tit))
+                assert(it.current == tit.current);
+        }
+        assert(!tit.current || n_ranges == 0);
+    }
+
+    Sum acc = {0, 0};
+    Tree_parallel_reduce(&tree, &acc, sizeof(acc), tree_add, sum_merge);
+    assert(acc.n == tree.size && acc.sum == sum);
+    Tree_parallel_for_each(&tree, tree_double, NULL);
+    acc = (Sum) {0, 0};
+    Tree_parallel_reduce(&tree, &acc, sizeof(acc), tree_add, sum_merge);
+    assert(acc.n == tree.size && acc.sum == 2 * sum);
+    Tree_free(&tree);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : (omp_get_num_procs() > 4 ? omp_get_num_procs() : 4);
+
+    for (size_t size = 0; size < 100; size++) {
+        check_map(size);
+        check_tree(size);
+    }
+    check_map(100000);
+#ifdef HASHMAP_INCREMENTAL_RESIZE
+    check_map_resizing(100000);
+#endif
+    check_tree(100000);
+
+    Map map = Map_new(n);
+    Tree tree = Tree_new();
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = rng_next();
+        Map_insert(&map, key, key % 1000);
+        Tree_insert(&tree, key, key % 1000);
+    }
+
+    Sum map_seq = {0, 0}, tree_seq = {0, 0};
+    double start = omp_get_wtime();
+    for (MapIter it = Map_iter(&map); it.current; MapIter_inc(&it))
+        map_add(&map_seq, it.current);
+    double map_seq_time = omp_get_wtime() - start;
+    start = omp_get_wtime();
+    for (TreeIter it = Tree_min_iter(&tree); it.current; TreeIter_inc(&it))
+        tree_add(&tree_seq, it.current);
+    double tree_seq_time = omp_get_wtime() - start;
+
+    printf("%zu entries, %d cores, summing all values:\n", n, omp_get_num_procs());
+    printf("  %-10s %12s %12s\n", "threads", "HashMap", "TreeMap");
+    printf("  %-10s %10.1lf ms %10.1lf ms\n", "iterator", map_seq_time * 1e3, tree_seq_time * 1e3);
+    for (int n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+        omp_set_num_threads(n_threads);
+        Sum map_acc = {0, 0}, tree_acc = {0, 0};
+        start = omp_get_wtime();
+        Map_parallel_reduce(&map, &map_acc, sizeof(map_acc), map_add, sum_merge);
+        double map_time = omp_get_wtime() - start;
+        start = omp_get_wtime();
+        Tree_parallel_reduce(&tree, &tree_acc, sizeof(tree_acc), tree_add, sum_merge);
+        double tree_time = omp_get_wtime() - start;
+        assert(map_acc.sum == map_seq.sum && map_acc.n == map.size);
+        assert(tree_acc.sum == tree_seq.sum && tree_acc.n == tree.size);
+        printf("  %-10d %10.1lf ms %10.1lf ms\n", n_threads, map_time * 1e3, tree_time * 1e3);
+    }
+    Map_free(&map);
+    Tree_free(&tree);
+    return 0;
+}
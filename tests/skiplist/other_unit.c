@@ -0,0 +1,20 @@
+#include <stdint.h>
+
+#include "../../datastructures/skiplist.h"
+
+/******************************************************************************
+ * A second translation unit for tests/skiplist, which removes entries of a
+ * map while the main one is pinned, see check_translation_units
+ ******************************************************************************/
+
+#define CMP(a, b) (*(a) < *(b) ? -1 : (*(a) == *(b) ? 0 : 1))
+
+SKIPLIST_DEFINE(List, uint64_t, uint64_t, CMP)
+
+/* removes keys 0 to n - 1 and returns how many removed nodes are not freed */
+size_t other_unit_remove(List* list, uint64_t n)
+{
+    for (uint64_t key = 0; key < n; key++)
+        List_remove(list, &key);
+    return List_retired_count(list);
+}
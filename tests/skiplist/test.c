@@ -0,0 +1,269 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+
+#include "../../datastructures/treemap.h"
+#include "../../datastructures/skiplist.h"
+
+/******************************************************************************
+ * Checks a SkipList against a TreeMap on one thread, and with many threads
+ * inserting and removing the same keys at once, checks that removed nodes
+ * are freed while threads keep inserting and removing, and that a thread
+ * pinned in one translation unit keeps nodes removed in another one from
+ * being freed, see other_unit.c, then measures the throughput
+ * of a mix of 50% searches, 25% insertions and 25% removals on n keys for
+ * 1, 2, 4, ... threads, against a TreeMap behind a single lock
+ *
+ * usage: ./test [n] [n_ops] [max_threads], default 10^6 keys, 4*10^6
+ * operations per run, and the number of cores, at least 4
+ ******************************************************************************/
+
+#define CMP(a, b) (*(a) < *(b) ? -1 : (*(a) == *(b) ? 0 : 1))
+
+TREEMAP_DEFINE(Tree, uint64_t, uint64_t, CMP)
+SKIPLIST_DEFINE(List, uint64_t, uint64_t, CMP)
+
+static uint64_t rng_next(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void check_single_thread()
+{
+    uint64_t rng = 42;
+    Tree tree = Tree_new();
+    List list = List_new();
+    for (size_t round = 0; round < 5; round++) {
+        for (size_t i = 0; i < 5000; i++) {
+            uint64_t key = rng_next(&rng) % 3000;
+            if (rng_next(&rng) % 3 == 0) {
+                bool removed = List_remove(&list, &key);
+                assert(removed == Tree_contains(&tree, &key));
+                Tree_remove(&tree, &key);
+            } else {
+                bool inserted = List_insert(&list, key, i);
+                assert(inserted == !Tree_contains(&tree, &key));
+                Tree_insert(&tree, key, i);
+            }
+            // with a single thread every removed node is freed two reclaims later
+            assert(List_retired_count(&list) <= 2 * _SKIPLIST_RECLAIM_THRESHOLD);
+        }
+        assert(list.size == tree.size);
+        ListIter it = List_min_iter(&list);
+        for (TreeIter tit = Tree_min_iter(&tree); tit.current; TreeIter_inc(&tit), ListIter_inc(&it))
+            assert(it.current && it.current->key == tit.current->key && it.current->value == tit.current->value);
+        assert(!it.current);
+        it = List_max_iter(&list);
+        for (TreeIter tit = Tree_max_iter(&tree); tit.current; TreeIter_dec(&tit), ListIter_dec(&it))
+            assert(it.current && it.current->key == tit.current->key);
+        assert(!it.current);
+        for (uint64_t key = 0; key < 3010; key++) {
+            TreeEntry* tree_entry = Tree_search(&tree, &key, false);
+            ListEntry* entry = List_search(&list, &key, false);
+            uint64_t value = 0;
+            assert(!tree_entry == !entry && (!entry || entry->value == tree_entry->value));
+            assert(List_get(&list, &key, &value) == !!entry && (!entry || value == entry->value));
+            assert(List_iter(&list, &key).current == entry);
+            TreeIter tfloor = Tree_floor_iter(&tree, &key);
+            ListIter floor = List_floor_iter(&list, &key);
+            assert(!tfloor.current == !floor.current && (!floor.current || floor.current->key == tfloor.current->key));
+            TreeIter tceil = Tree_ceil_iter(&tree, &key);
+            ListIter ceil = List_ceil_iter(&list, &key);
+            assert(!tceil.current == !ceil.current && (!ceil.current || ceil.current->key == tceil.current->key));
+        }
+    }
+    List_reclaim(&list);
+    List_free(&list);
+    Tree_free(&tree);
+}
+
+/* every key is inserted and removed exactly once, however many threads try, while others iterate */
+static void check_threads(size_t n, int n_threads)
+{
+    List list = List_new();
+    size_t n_inserted = 0, n_removed = 0, n_out_of_order = 0;
+    #pragma omp parallel num_threads(n_threads) reduction(+:n_inserted, n_removed, n_out_of_order)
+    {
+        uint64_t rng = 1 + omp_get_thread_num();
+        for (size_t i = 0; i < n; i++) {
+            uint64_t key = rng_next(&rng) % n;
+            n_inserted += List_insert(&list, key, key * 3);
+            if (i % 64 == 0) {
+                uint64_t prev = 0;
+                bool first = true;
+                skiplist_pin();
+                for (ListIter it = List_ceil_iter(&list, &key); it.current && it.current->key < key + 100; ListIter_inc(&it)) {
+                    n_out_of_order += !first && it.current->key <= prev;
+                    prev = it.current->key;
+                    first = false;
+                }
+                skiplist_unpin();
+            }
+        }
+        #pragma omp barrier
+        for (size_t i = 0; i < n; i++) {
+            uint64_t key = rng_next(&rng) % n;
+            uint64_t value = 0;
+            n_out_of_order += List_get(&list, &key, &value) && value != key * 3;
+            n_removed += List_remove(&list, &key);
+        }
+    }
+    assert(n_out_of_order == 0);
+    assert(n_inserted - n_removed == list.size);
+    size_t n_left = 0;
+    for (ListIter it = List_min_iter(&list); it.current; ListIter_inc(&it))
+        n_left++;
+    assert(n_left == list.size);
+    for (uint64_t key = 0; key < n; key++)
+        List_remove(&list, &key);
+    assert(list.size == 0 && !List_min_iter(&list).current && !List_max_iter(&list).current);
+    List_free(&list);
+}
+
+size_t other_unit_remove(List* list, uint64_t n);
+
+/* both translation units share one epoch, so nodes removed by the other one stay until this one unpins */
+static void check_translation_units()
+{
+    List list = List_new();
+    uint64_t n = 10 * _SKIPLIST_RECLAIM_THRESHOLD;
+    for (uint64_t key = 0; key < n; key++)
+        List_insert(&list, key, key);
+    skiplist_pin();
+    ListEntry* entry = List_search(&list, &(uint64_t) {n - 1}, false);
+    size_t n_retired = other_unit_remove(&list, n);
+    assert(n_retired == n && entry->value == n - 1);
+    skiplist_unpin();
+
+    // afterwards, later removals free them again
+    for (uint64_t key = 0; key < 2 * _SKIPLIST_RECLAIM_THRESHOLD; key++) {
+        List_insert(&list, key, key);
+        List_remove(&list, &key);
+    }
+    n_retired = List_retired_count(&list);
+    assert(n_retired <= 2 * _SKIPLIST_RECLAIM_THRESHOLD);
+    List_free(&list);
+}
+
+/* threads insert and remove a few keys over and over, while others iterate, and the removed nodes are freed meanwhile */
+static void check_churn(size_t n_ops, int n_threads)
+{
+    List list = List_new();
+    size_t n_removed = 0, max_retired = 0, n_wrong = 0;
+    #pragma omp parallel num_threads(n_threads) reduction(+:n_removed, n_wrong) reduction(max:max_retired)
+    {
+        uint64_t rng = 100 + omp_get_thread_num();
+        for (size_t i = 0; i < n_ops; i++) {
+            uint64_t key = rng_next(&rng) % 1000;
+            if (i % 2 == 0) {
+                List_insert(&list, key, key + 1);
+            } else {
+                n_removed += List_remove(&list, &key);
+            }
+            if (i % 256 == 0) {
+                skiplist_pin();
+                // other threads write values meanwhile, so they are read under the lock of their node
+                for (ListIter it = List_ceil_iter(&list, &key); it.current && it.current->key < key + 50; ListIter_inc(&it)) {
+                    uint64_t value = 0;
+                    n_wrong += List_get(&list, &it.current->key, &value) && value != it.current->key + 1;
+                }
+                skiplist_unpin();
+            }
+            size_t n_retired = List_retired_count(&list);
+            max_retired = n_retired > max_retired ? n_retired : max_retired;
+        }
+    }
+    assert(n_wrong == 0);
+    // threads preempted while pinned hold back reclamation for a while, but most nodes are freed during the run
+    size_t n_left = List_retired_count(&list);
+    assert(n_removed > 100 * _SKIPLIST_RECLAIM_THRESHOLD && n_left < n_removed / 2);
+
+    // once no other thread is pinned, removals free the rest
+    for (uint64_t key = 0; key < 1000; key++) {
+        List_insert(&list, key, key + 1);
+        List_remove(&list, &key);
+    }
+    size_t n_retired = List_retired_count(&list);
+    assert(n_retired <= 2 * _SKIPLIST_RECLAIM_THRESHOLD);
+    size_t bytes = List_memory_usage(&list);
+    printf("churn: %zu removals on %d threads, at most %zu nodes waiting to be freed, %zu left, %zu bytes used\n",
+           n_removed, n_threads, max_retired, n_retired, bytes);
+    List_free(&list);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    size_t n_ops = argc > 2 ? strtoull(argv[2], NULL, 10) : 4000000;
+    int max_threads = argc > 3 ? atoi(argv[3]) : (omp_get_num_procs() > 4 ? omp_get_num_procs() : 4);
+
+    check_single_thread();
+    check_threads(20000, 8);
+    check_churn(200000, 8);
+    check_translation_units();
+
+    printf("%zu keys, %zu operations, %d cores:\n", n, n_ops, omp_get_num_procs());
+    printf("  %-8s %24s %24s\n", "threads", "TreeMap + lock, Mops/s", "SkipList, Mops/s");
+    for (int n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+        Tree tree = Tree_new();
+        List list = List_new();
+        uint64_t rng = 7;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t key = rng_next(&rng) % (2 * n);
+            Tree_insert(&tree, key, key);
+            List_insert(&list, key, key);
+        }
+
+        omp_lock_t lock;
+        omp_init_lock(&lock);
+        size_t sum = 0;
+        double start = omp_get_wtime();
+        #pragma omp parallel num_threads(n_threads) reduction(+:sum)
+        {
+            uint64_t thread_rng = 11 + omp_get_thread_num();
+            #pragma omp for schedule(static)
+            for (size_t i = 0; i < n_ops; i++) {
+                uint64_t r = rng_next(&thread_rng);
+                uint64_t key = (r >> 2) % (2 * n);
+                omp_set_lock(&lock);
+                if (r % 4 < 2)
+                    sum += Tree_contains(&tree, &key);
+                else if (r % 4 == 2)
+                    Tree_insert(&tree, key, key);
+                else
+                    Tree_remove(&tree, &key);
+                omp_unset_lock(&lock);
+            }
+        }
+        double tree_time = omp_get_wtime() - start;
+        omp_destroy_lock(&lock);
+
+        start = omp_get_wtime();
+        #pragma omp parallel num_threads(n_threads) reduction(+:sum)
+        {
+            uint64_t thread_rng = 11 + omp_get_thread_num();
+            #pragma omp for schedule(static)
+            for (size_t i = 0; i < n_ops; i++) {
+                uint64_t r = rng_next(&thread_rng);
+                uint64_t key = (r >> 2) % (2 * n);
+                if (r % 4 < 2)
+                    sum += List_contains(&list, &key);
+                else if (r % 4 == 2)
+                    List_insert(&list, key, key);
+                else
+                    List_remove(&list, &key);
+            }
+        }
+        double list_time = omp_get_wtime() - start;
+
+        printf("  %-8d %24.2lf %24.2lf (%zu)\n", n_threads, n_ops / tree_time / 1e6, n_ops / list_time / 1e6, sum & 0xff);
+        Tree_free(&tree);
+        List_free(&list);
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../datastructures/smallvec.h"
+
+/******************************************************************************
+ * Checks SmallVec against a plain array: push and pop across the boundary
+ * between the inline storage and the heap, insert and remove at the front,
+ * middle and back with either storage, copy and clear, and free after the
+ * elements have spilled to the heap. Run it under ASan with `make check`,
+ * which builds it as $(BUILD)/smallvec-asan too
+ *
+ * usage: ./test [n], default 10^5 random operations
+ ******************************************************************************/
+
+SMALLVEC_DEFINE(Small, uint64_t, 4)
+SMALLVEC_DEFINE(Single, uint64_t, 1)
+
+static uint64_t rng_state = 42;
+
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void check_equal(Small* vec, const uint64_t* expected, size_t size)
+{
+    assert(vec->size == size);
+    assert(vec->_arr_cap >= size);
+    // the elements are inline exactly when the capacity is the inline one
+    uint64_t* data = Small_data(vec);
+    assert((data == vec->_inline) == (vec->_arr_cap == 4));
+    assert(memcmp(data, expected, size * sizeof(uint64_t)) == 0);
+    assert(Small_memory_usage(vec) == sizeof(Small) + (vec->_arr_cap > 4 ? vec->_arr_cap * sizeof(uint64_t) : 0));
+}
+
+static void check_copy(Small* vec, const uint64_t* expected, size_t size)
+{
+    Small copy = Small_copy(vec);
+    check_equal(&copy, expected, size);
+    if (vec->_arr_cap > 4)
+        assert(copy._heap != vec->_heap);
+    // changing the copy leaves the original alone
+    Small_push(&copy, 7);
+    Small_free(&copy);
+    check_equal(vec, expected, size);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000;
+    uint64_t expected[64];
+
+    // push across the boundary, the elements move to the heap on the fifth push
+    Small vec = Small_new();
+    for (size_t i = 0; i < 20; i++) {
+        Small_push(&vec, i);
+        expected[i] = i;
+        check_equal(&vec, expected, i + 1);
+        assert(i < 4 ? vec._arr_cap == 4 : vec._arr_cap > 4);
+        check_copy(&vec, expected, i + 1);
+    }
+    // and back inline when popping
+    for (size_t i = 20; i > 0; i--) {
+        uint64_t popped = Small_pop(&vec);
+        assert(popped == i - 1);
+        check_equal(&vec, expected, i - 1);
+        check_copy(&vec, expected, i - 1);
+    }
+    assert(vec._arr_cap == 4);
+
+    // insert and remove at the front, middle and back, inline and on the heap
+    for (size_t size = 0; size < 12; size++) {
+        for (size_t index = 0; index <= size; index++) {
+            Small_clear(&vec);
+            for (size_t i = 0; i < size; i++) {
+                Small_push(&vec, i);
+                expected[i] = i;
+            }
+            Small_insert(&vec, index, 100);
+            memmove(expected + index + 1, expected + index, (size - index) * sizeof(uint64_t));
+            expected[index] = 100;
+            check_equal(&vec, expected, size + 1);
+            check_copy(&vec, expected, size + 1);
+
+            uint64_t removed = Small_remove(&vec, index);
+            assert(removed == 100);
+            memmove(expected + index, expected + index + 1, (size - index) * sizeof(uint64_t));
+            check_equal(&vec, expected, size);
+            check_copy(&vec, expected, size);
+        }
+    }
+
+    // free after spilling to the heap, ASan reports the array if it leaks
+    Small_free(&vec);
+    vec = Small_new();
+    for (size_t i = 0; i < 9; i++)
+        Small_insert(&vec, 0, i);
+    assert(vec._arr_cap > 4 && Small_data(&vec)[0] == 8 && Small_data(&vec)[8] == 0);
+    Small_free(&vec);
+
+    // random operations, the size staying around the inline capacity
+    vec = Small_new();
+    size_t size = 0;
+    size_t n_spills = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t r = rng_next();
+        int was_inline = vec._arr_cap == 4;
+        if (size == 0 || (size < 64 && r % 16 < 8 - (size > 8) * 3)) {
+            size_t index = (r >> 8) % (size + 1);
+            if (r % 2) {
+                Small_insert(&vec, index, r);
+                memmove(expected + index + 1, expected + index, (size - index) * sizeof(uint64_t));
+                expected[index] = r;
+            } else {
+                Small_push(&vec, r);
+                expected[size] = r;
+            }
+            size++;
+        } else {
+            size_t index = (r >> 8) % size;
+            uint64_t value;
+            if (r % 2) {
+                value = Small_remove(&vec, index);
+                assert(value == expected[index]);
+                memmove(expected + index, expected + index + 1, (size - index - 1) * sizeof(uint64_t));
+            } else {
+                value = Small_pop(&vec);
+                assert(value == expected[size - 1]);
+            }
+            size--;
+        }
+        n_spills += was_inline && vec._arr_cap > 4;
+        check_equal(&vec, expected, size);
+        if (r % 64 == 0)
+            check_copy(&vec, expected, size);
+        if (r % 1024 == 0) {
+            Small_clear(&vec);
+            size = 0;
+        }
+    }
+    assert(n < 1000 || n_spills > 0);
+    Small_free(&vec);
+
+    // a single inline element
+    Single single = Single_new();
+    for (size_t i = 0; i < 10; i++)
+        Single_insert(&single, 0, i);
+    for (size_t i = 0; i < 10; i++) {
+        uint64_t removed = Single_remove(&single, 0);
+        assert(removed == 9 - i);
+    }
+    // pop moves back inline below half the inline size, never with one element, but clear does
+    assert(single.size == 0 && single._arr_cap == 2);
+    Single_clear(&single);
+    assert(single._arr_cap == 1);
+    Single_push(&single, 5);
+    assert(single._arr_cap == 1 && Single_data(&single)[0] == 5);
+    Single_free(&single);
+
+    printf("smallvec checked with %zu random operations, %zu spills to the heap\n", n, n_spills);
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <malloc.h>
+#include <omp.h>
+
+#include "../../datastructures/hashmap.h"
+#include "../../datastructures/strmap.h"
+
+/******************************************************************************
+ * Compares the memory use and speed of counting words with a StrMap, and with
+ * HashMaps keyed by fixed size char arrays, as in the README example, and by
+ * pointers to malloc'ed strings
+ *
+ * The vocabulary consists of n_words random lowercase words of 1 to 24
+ * letters, mostly short, and the text of n_tokens words drawn from it
+ *
+ * usage: ./test [n_words] [n_tokens], default 10^6 words and 10^7 tokens
+ ******************************************************************************/
+
+#define MAX_WORD_LEN 50
+
+typedef struct { char chars[MAX_WORD_LEN]; } FixedString;
+typedef char* CString;
+
+#define FIXED_EQ(a, b) (strcmp((a)->chars, (b)->chars) == 0)
+#define FIXED_HASH(key) (byte_hasher((key)->chars, strlen((key)->chars)))
+#define PTR_EQ(a, b) (strcmp(*(a), *(b)) == 0)
+#define PTR_HASH(key) (byte_hasher(*(key), strlen(*(key))))
+
+HASHMAP_DEFINE(FixedMap, FixedString, uint32_t, FIXED_HASH, FIXED_EQ)
+HASHMAP_DEFINE(PtrMap, CString, uint32_t, PTR_HASH, PTR_EQ)
+STRMAP_DEFINE(Vocab, uint32_t)
+STRMAP_DEFINE(Interned, HASHMAP_NO_VALUE)
+
+static uint64_t rng_state = 42;
+
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// bytes taken from the heap by a malloc'ed block, including its header
+static size_t heap_bytes(void* ptr)
+{
+    return malloc_usable_size(ptr) + sizeof(size_t);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n_words = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    size_t n_tokens = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000000;
+
+    /* null terminated words, one after the other, some may repeat */
+    char* words = malloc(n_words * 25);
+    size_t* offsets = malloc(n_words * sizeof(size_t));
+    size_t* lens = malloc(n_words * sizeof(size_t));
+    assert(words && offsets && lens);
+    size_t pos = 0;
+    for (size_t i = 0; i < n_words; i++) {
+        uint64_t r = rng_next();
+        size_t len = 1 + (r % 8) + (r >> 8) % 8 + ((r >> 16) % 4 == 0 ? (r >> 24) % 9 : 0);
+        offsets[i] = pos;
+        lens[i] = len;
+        for (size_t j = 0; j < len; j++)
+            words[pos++] = 'a' + rng_next() % 26;
+        words[pos++] = '\0';
+    }
+    uint32_t* tokens = malloc(n_tokens * sizeof(uint32_t));
+    assert(tokens);
+    for (size_t i = 0; i < n_tokens; i++)
+        tokens[i] = rng_next() % n_words;
+
+    /* fixed size keys, copied into a FixedString for every lookup */
+    double start = omp_get_wtime();
+    FixedMap fixed = FixedMap_new(0);
+    for (size_t i = 0; i < n_tokens; i++) {
+        FixedString key;
+        memset(&key, 0, sizeof(key));
+        memcpy(key.chars, words + offsets[tokens[i]], lens[tokens[i]]);
+        FixedMap_search(&fixed, &key, true)->value++;
+    }
+    double fixed_time = omp_get_wtime() - start;
+    size_t fixed_bytes = FixedMap_memory_usage(&fixed);
+
+    /* pointer keys, every new word is copied to the heap */
+    start = omp_get_wtime();
+    PtrMap ptrs = PtrMap_new(0);
+    for (size_t i = 0; i < n_tokens; i++) {
+        char* word = words + offsets[tokens[i]];
+        PtrMapEntry* entry = PtrMap_search(&ptrs, &word, false);
+        if (!entry) {
+            char* copy = strdup(word);
+            entry = PtrMap_search(&ptrs, &copy, true);
+        }
+        entry->value++;
+    }
+    double ptr_time = omp_get_wtime() - start;
+    size_t ptr_bytes = PtrMap_memory_usage(&ptrs);
+    for (PtrMapIter it = PtrMap_iter(&ptrs); it.current; PtrMapIter_inc(&it))
+        ptr_bytes += heap_bytes(it.current->key);
+
+    start = omp_get_wtime();
+    Vocab vocab = Vocab_new(0);
+    for (size_t i = 0; i < n_tokens; i++)
+        Vocab_search(&vocab, words + offsets[tokens[i]], lens[tokens[i]], true)->value++;
+    double vocab_time = omp_get_wtime() - start;
+    size_t vocab_bytes = Vocab_memory_usage(&vocab);
+
+    /* the same counts everywhere */
+    assert(fixed.size == vocab.size && ptrs.size == vocab.size);
+    for (uint32_t id = 0; id < vocab.size; id++) {
+        size_t len;
+        const char* str = Vocab_str(&vocab, id, &len);
+        FixedString key;
+        memset(&key, 0, sizeof(key));
+        memcpy(key.chars, str, len);
+        char* ptr_key = key.chars;
+        assert(Vocab_id(&vocab, str, len) == id);
+        assert(FixedMap_search(&fixed, &key, false)->value == Vocab_entry(&vocab, id)->value);
+        assert(PtrMap_search(&ptrs, &ptr_key, false)->value == Vocab_entry(&vocab, id)->value);
+    }
+
+    /* interning every token gives the ids in order of first appearance, also in batches */
+    const char** token_strs = malloc(n_tokens * sizeof(const char*));
+    size_t* token_lens = malloc(n_tokens * sizeof(size_t));
+    uint32_t* ids = malloc(n_tokens * sizeof(uint32_t));
+    uint32_t* batch_ids = malloc(n_tokens * sizeof(uint32_t));
+    assert(token_strs && token_lens && ids && batch_ids);
+    for (size_t i = 0; i < n_tokens; i++) {
+        token_strs[i] = words + offsets[tokens[i]];
+        token_lens[i] = lens[tokens[i]];
+    }
+    start = omp_get_wtime();
+    Interned interned = Interned_new(0);
+    for (size_t i = 0; i < n_tokens; i++)
+        ids[i] = Interned_intern(&interned, token_strs[i], token_lens[i]);
+    double intern_time = omp_get_wtime() - start;
+    Interned batched = Interned_new(0);
+    start = omp_get_wtime();
+    Interned_intern_batch(&batched, token_strs, token_lens, n_tokens, batch_ids);
+    double batch_time = omp_get_wtime() - start;
+    assert(interned.size == vocab.size && batched.size == vocab.size);
+    for (size_t i = 0; i < n_tokens; i++) {
+        assert(ids[i] == Vocab_id(&vocab, token_strs[i], token_lens[i]));
+        assert(ids[i] == Interned_id(&interned, token_strs[i], token_lens[i]));
+        assert(batch_ids[i] == ids[i] && Interned_id(&batched, token_strs[i], token_lens[i]) == ids[i]);
+    }
+    assert(Interned_id(&interned, "", 0) == STRMAP_NO_ID && !Interned_contains(&interned, "-", 1));
+
+    printf("%zu tokens, %zu distinct words:\n", n_tokens, vocab.size);
+    printf("  %-24s %.2lf s, %.1lf bytes per word\n", "HashMap, char[50] keys", fixed_time, fixed_bytes / (double) vocab.size);
+    printf("  %-24s %.2lf s, %.1lf bytes per word\n", "HashMap, char* keys", ptr_time, ptr_bytes / (double) vocab.size);
+    printf("  %-24s %.2lf s, %.1lf bytes per word\n", "StrMap", vocab_time, vocab_bytes / (double) vocab.size);
+    printf("  %-24s %.2lf s, %.1lf bytes per word\n", "StrMap intern", intern_time, Interned_memory_usage(&interned) / (double) vocab.size);
+    printf("  %-24s %.2lf s\n", "StrMap intern_batch", batch_time);
+
+    for (PtrMapIter it = PtrMap_iter(&ptrs); it.current; PtrMapIter_inc(&it))
+        free(it.current->key);
+    PtrMap_free(&ptrs);
+    FixedMap_free(&fixed);
+    Vocab_free(&vocab);
+    Interned_free(&interned);
+    Interned_free(&batched);
+    free(token_strs);
+    free(token_lens);
+    free(ids);
+    free(batch_ids);
+    free(tokens);
+    free(lens);
+    free(offsets);
+    free(words);
+    return 0;
+}
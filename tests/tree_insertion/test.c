@@ -4,21 +4,30 @@
 
 #include "../../datastructures/treemap.h"
 #include "../../datastructures/vec.h"
+#include "../../datastructures/ingest.h"
 
 #define CMP(a, b) (*(a) < *(b) ? -1 : (*(a) == *(b) ? 0 : 1))
 
 TREEMAP_DEFINE(Set, int, TREEMAP_NO_VALUE, CMP)
 VEC_DEFINE(Vec, int)
+INGEST_DEFINE(Vec, int)
 
 int main() 
 {
     Set tree = Set_new();
-    int n, d;
-    scanf("%d", &n);
+    IntReader reader;
+    int_reader_open(&reader, NULL);
+    int64_t n;
+    if (!int_reader_next(&reader, &n) || n < 0) {
+        fprintf(stderr, "expected the number of integers first\n");
+        return 1;
+    }
     Vec input = Vec_new(0);
-    for (int i = 0; i < n; i++) {
-        scanf("%d", &d);
-        Vec_push(&input, d); 
+    size_t n_read = Vec_read_ints(&input, &reader, n);
+    int_reader_close(&reader);
+    if (n_read < (size_t) n) {
+        fprintf(stderr, "expected %lld integers, read %zu\n", (long long) n, n_read);
+        return 1;
     }
 
     double start = omp_get_wtime();
@@ -43,6 +52,11 @@ int main()
     stop = omp_get_wtime();
     printf("iteration took: %lf s, %d\n", stop-start, sum);
 
+    TreeMapStats stats;
+    Set_stats(&tree, &stats);
+    printf("height: %zu, nodes: %zu, mean node fill: %.2lf, bytes per entry: %.1lf\n",
+           stats.height, stats.n_nodes, stats.mean_fill, stats.bytes_per_entry);
+
     Set_free(&tree);
     Vec_free(&input);
 }
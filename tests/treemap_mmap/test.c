@@ -0,0 +1,124 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+
+#include "../../datastructures/treemap.h"
+#include "../../datastructures/treemap_mmap.h"
+
+/******************************************************************************
+ * Compares building a map of n keys against saving a snapshot of it and
+ * opening the snapshot with mmap, and checks searches, floor and ceil
+ * queries and scans on the snapshot against the map
+ *
+ * usage: ./test [n] [path], n defaults to 10^7, path to /tmp/treemap_mmap.bin
+ ******************************************************************************/
+
+#define CMP(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+
+TREEMAP_DEFINE(Map, uint64_t, uint64_t, CMP)
+TREEMAP_MMAP_DEFINE(Map, uint64_t, CMP)
+
+static uint64_t next_key(uint64_t* state)
+{
+    uint64_t z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    const char* path = argc > 2 ? argv[2] : "/tmp/treemap_mmap.bin";
+    uint64_t* keys = malloc(n * sizeof(uint64_t));
+    assert(keys);
+    uint64_t state = 42;
+    for (size_t i = 0; i < n; i++)
+        keys[i] = next_key(&state);
+
+    /* every snapshot shape up to a few levels, including an empty one and an empty last leaf */
+    for (size_t small_n = 0; small_n < 3000 && small_n <= n; small_n += small_n < 300 ? 1 : 97) {
+        Map map = Map_new();
+        for (size_t i = 0; i < small_n; i++)
+            Map_search(&map, keys+i, true)->value = i;
+        bool saved = Map_save(&map, path);
+        MapSnapshot snapshot;
+        bool opened = MapSnapshot_open(&snapshot, path);
+        assert(saved && opened && snapshot.size == map.size);
+        MapIter it = Map_min_iter(&map);
+        MapSnapshotIter s_it = MapSnapshot_min_iter(&snapshot);
+        for (; it.current; MapIter_inc(&it), MapSnapshotIter_inc(&s_it))
+            assert(s_it.current && s_it.current->key == it.current->key && s_it.current->value == it.current->value);
+        assert(!s_it.current);
+        it = Map_max_iter(&map);
+        s_it = MapSnapshot_max_iter(&snapshot);
+        for (; it.current; MapIter_dec(&it), MapSnapshotIter_dec(&s_it))
+            assert(s_it.current && s_it.current->key == it.current->key);
+        assert(!s_it.current);
+        MapSnapshot_close(&snapshot);
+        Map_free(&map);
+    }
+
+    double start = omp_get_wtime();
+    Map map = Map_new();
+    for (size_t i = 0; i < n; i++)
+        Map_search(&map, keys+i, true)->value = i;
+    printf("building took: %lf s\n", omp_get_wtime() - start);
+
+    start = omp_get_wtime();
+    bool saved = Map_save(&map, path);
+    printf("saving took: %lf s\n", omp_get_wtime() - start);
+    assert(saved);
+
+    MapSnapshot snapshot;
+    start = omp_get_wtime();
+    bool opened = MapSnapshot_open(&snapshot, path);
+    double open_time = omp_get_wtime() - start;
+    assert(opened);
+    bool first = MapSnapshot_contains(&snapshot, keys);
+    printf("opening took: %lf s, first query: %lf s\n", open_time, omp_get_wtime() - start - open_time);
+    printf("snapshot height: %zu, %zu byte nodes\n", snapshot.height, (size_t) snapshot._layout.node_size);
+    assert(first && snapshot.size == map.size);
+
+    size_t found = 0;
+    start = omp_get_wtime();
+    for (size_t i = 0; i < n; i++)
+        found += Map_search(&map, keys+i, false)->value == i;
+    printf("queries in memory took: %lf s\n", omp_get_wtime() - start);
+    start = omp_get_wtime();
+    for (size_t i = 0; i < n; i++)
+        found += MapSnapshot_search(&snapshot, keys+i)->value == i;
+    printf("queries on snapshot took: %lf s\n", omp_get_wtime() - start);
+    assert(found == 2 * n);
+
+    /* floor and ceil of keys that are mostly absent */
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = next_key(&state);
+        MapIter floor = Map_floor_iter(&map, &key), ceil = Map_ceil_iter(&map, &key);
+        MapSnapshotIter s_floor = MapSnapshot_floor_iter(&snapshot, &key), s_ceil = MapSnapshot_ceil_iter(&snapshot, &key);
+        assert(!floor.current == !s_floor.current && (!floor.current || floor.current->key == s_floor.current->key));
+        assert(!ceil.current == !s_ceil.current && (!ceil.current || ceil.current->key == s_ceil.current->key));
+        MapSnapshotIter_inc(&s_floor);
+        MapSnapshotIter_dec(&s_ceil);
+        if (floor.current && ceil.current && floor.current != ceil.current)
+            assert(s_floor.current->key == ceil.current->key && s_ceil.current->key == floor.current->key);
+    }
+
+    uint64_t sum = 0, s_sum = 0;
+    start = omp_get_wtime();
+    for (MapIter it = Map_min_iter(&map); it.current; MapIter_inc(&it))
+        sum += it.current->value;
+    printf("scan in memory took: %lf s\n", omp_get_wtime() - start);
+    start = omp_get_wtime();
+    for (MapSnapshotIter it = MapSnapshot_min_iter(&snapshot); it.current; MapSnapshotIter_inc(&it))
+        s_sum += it.current->value;
+    printf("scan on snapshot took: %lf s\n", omp_get_wtime() - start);
+    assert(sum == s_sum);
+
+    MapSnapshot_close(&snapshot);
+    Map_free(&map);
+    free(keys);
+    remove(path);
+}
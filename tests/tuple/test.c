@@ -0,0 +1,181 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "../../tuple.h"
+
+/******************************************************************************
+ * Checks that eq and hash of tuples ignore the padding between fields,
+ * that tuples can be initialized positionally, and that cmp orders signed
+ * integers, floats (-0.0 before 0.0, NaNs at the ends) and char arrays.
+ * Then checks on n random pairs of tuples that memcmp on their normalized
+ * keys orders them as cmp does
+ *
+ * usage: ./test [n], default 10^6 pairs
+ ******************************************************************************/
+
+TUPLE_DEFINE(Triple, int a, int b, char c[20])
+TUPLE_DEFINE(Padded, char c, int64_t i, short s, double d, char name[3], float f)
+TUPLE_DEFINE(Mixed, int8_t i8, uint16_t u16, int32_t i32, float f, uint64_t u64, double d, unsigned char bytes[3], int64_t i64)
+
+static uint64_t rng_state = 42;
+
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* random bits, or one of a few values near the edges, so that fields are often equal */
+static uint64_t random_bits(size_t size)
+{
+    uint64_t bits = rng_next();
+    uint64_t edges[] = {0, 1, UINT64_MAX, UINT64_C(1) << (8 * size - 1), (UINT64_C(1) << (8 * size - 1)) - 1};
+    uint64_t r = rng_next() % 8;
+    return r < 5 ? edges[r] : (r == 5 ? bits % 4 : bits);
+}
+
+static Mixed random_mixed()
+{
+    Mixed m;
+    memset(&m, (int) rng_next(), sizeof(m));
+    uint64_t bits;
+    bits = random_bits(1); memcpy(&m.i8, &bits, 1);
+    bits = random_bits(2); memcpy(&m.u16, &bits, 2);
+    bits = random_bits(4); memcpy(&m.i32, &bits, 4);
+    bits = random_bits(4); memcpy(&m.f, &bits, 4);   // any bits, including NaNs and denormals
+    m.u64 = random_bits(8);
+    bits = random_bits(8); memcpy(&m.d, &bits, 8);
+    bits = random_bits(3); memcpy(m.bytes, &bits, 3);
+    m.i64 = (int64_t) random_bits(8);
+    return m;
+}
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+static Padded padded(unsigned char garbage, char c, int64_t i, short s, double d, const char* name, float f)
+{
+    Padded p;
+    memset(&p, garbage, sizeof(p));
+    p.c = c;
+    p.i = i;
+    p.s = s;
+    p.d = d;
+    memcpy(p.name, name, sizeof(p.name));
+    p.f = f;
+    return p;
+}
+
+/* every pair of values in the array, given in ascending order, compares as their indices do */
+static void check_order(const Padded* values, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            int expected = (i > j) - (i < j);
+            assert(sign(Padded_cmp(values + i, values + j)) == expected);
+            assert(Padded_eq(values + i, values + j) == (i == j));
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    assert(sizeof(Padded) > sizeof(char) + sizeof(int64_t) + sizeof(short) + sizeof(double) + 3 + sizeof(float));
+
+    // positional initialization, as for any struct
+    Triple t = {4, 2, "hi"};
+    Triple u = {4, 2, "hi"};
+    assert(t.a == 4 && t.b == 2 && !strcmp(t.c, "hi"));
+    assert(Triple_eq(&t, &u) && Triple_hash(&t) == Triple_hash(&u) && Triple_cmp(&t, &u) == 0);
+
+    // only the padding differs
+    Padded x = padded(0xAA, 'x', -5, 7, 2.5, "ab", -1.0f);
+    Padded y = padded(0x55, 'x', -5, 7, 2.5, "ab", -1.0f);
+    assert(memcmp(&x, &y, sizeof(Padded)) != 0);
+    assert(Padded_eq(&x, &y) && Padded_hash(&x) == Padded_hash(&y) && Padded_cmp(&x, &y) == 0);
+    // every field takes part
+    Padded fields[] = {
+        padded(0, 'y', -5, 7, 2.5, "ab", -1.0f),
+        padded(0, 'x', -4, 7, 2.5, "ab", -1.0f),
+        padded(0, 'x', -5, 8, 2.5, "ab", -1.0f),
+        padded(0, 'x', -5, 7, 2.0, "ab", -1.0f),
+        padded(0, 'x', -5, 7, 2.5, "ac", -1.0f),
+        padded(0, 'x', -5, 7, 2.5, "ab", -2.0f),
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+        assert(!Padded_eq(&x, fields + i) && Padded_hash(&x) != Padded_hash(fields + i) && Padded_cmp(&x, fields + i) != 0);
+
+    // signed integers, in ascending order
+    int64_t ints[] = {INT64_MIN, -1000000, -1, 0, 1, 255, 256, INT64_MAX};
+    Padded by_int[8];
+    for (size_t i = 0; i < 8; i++)
+        by_int[i] = padded(0x11 * i, 'x', ints[i], 0, 0.0, "ab", 0.0f);
+    check_order(by_int, 8);
+
+    // doubles in the IEEE 754 total order
+    double doubles[] = {-NAN, -INFINITY, -1e300, -1.0, -1e-310, -0.0, 0.0, 1e-310, 1.0, 1e300, INFINITY, NAN};
+    Padded by_double[12];
+    for (size_t i = 0; i < 12; i++)
+        by_double[i] = padded(0x11 * i, 'x', 0, 0, doubles[i], "ab", 0.0f);
+    check_order(by_double, 12);
+
+    // floats, the last field, in the same order
+    float floats[] = {-NAN, -INFINITY, -3.0f, -0.0f, 0.0f, 1e-40f, 3.0f, INFINITY, NAN};
+    Padded by_float[9];
+    for (size_t i = 0; i < 9; i++)
+        by_float[i] = padded(0x11 * i, 'x', 0, 0, 0.0, "ab", floats[i]);
+    check_order(by_float, 9);
+
+    // char arrays byte by byte, and chars and shorts by value
+    const char* names[] = {"", "\x01", "A", "a\0", "ab", "b", "\x7f", "\x80", "\xff"};
+    Padded by_name[9];
+    for (size_t i = 0; i < 9; i++)
+        by_name[i] = padded(0x11 * i, 'x', 0, 0, 0.0, names[i], 0.0f);
+    check_order(by_name, 9);
+    short shorts[] = {SHRT_MIN, -256, -1, 0, 1, SHRT_MAX};
+    Padded by_short[6];
+    for (size_t i = 0; i < 6; i++)
+        by_short[i] = padded(0x11 * i, CHAR_MIN, 0, shorts[i], 0.0, "ab", 0.0f);
+    check_order(by_short, 6);
+
+    // earlier fields decide first
+    Padded a = padded(0, 'a', INT64_MAX, SHRT_MAX, INFINITY, "zz", NAN);
+    Padded b = padded(0, 'b', INT64_MIN, SHRT_MIN, -INFINITY, "", -NAN);
+    assert(Padded_cmp(&a, &b) < 0 && Padded_cmp(&b, &a) > 0);
+
+    // normalized keys, as long as the concatenated fields without padding
+    assert(sizeof(MixedKey) == 1 + 2 + 4 + 4 + 8 + 8 + 3 + 8);
+    size_t n_equal = 0;
+    for (size_t i = 0; i < n; i++) {
+        Mixed ma = random_mixed();
+        // often a copy with one field changed, so that later fields decide
+        Mixed mb = rng_next() % 2 ? random_mixed() : ma;
+        if (rng_next() % 2) {
+            Mixed other = random_mixed();
+            size_t field = rng_next() % 8;
+            size_t offsets[] = {offsetof(Mixed, i8), offsetof(Mixed, u16), offsetof(Mixed, i32), offsetof(Mixed, f),
+                                offsetof(Mixed, u64), offsetof(Mixed, d), offsetof(Mixed, bytes), offsetof(Mixed, i64)};
+            size_t sizes[] = {1, 2, 4, 4, 8, 8, 3, 8};
+            memcpy((char*) &mb + offsets[field], (char*) &other + offsets[field], sizes[field]);
+        }
+        MixedKey ka = Mixed_key(&ma);
+        MixedKey kb = Mixed_key(&mb);
+        int cmp_res = sign(Mixed_cmp(&ma, &mb));
+        assert(sign(MixedKey_cmp(&ka, &kb)) == cmp_res);
+        assert((cmp_res == 0) == Mixed_eq(&ma, &mb));
+        n_equal += cmp_res == 0;
+    }
+    assert(n < 100 || n_equal > 0);
+
+    printf("tuples checked, keys of %zu random pairs agree with cmp, %zu equal\n", n, n_equal);
+    return 0;
+}
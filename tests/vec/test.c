@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DATASTRUCTURES_TRACE
+#include "../../datastructures/vec.h"
+
+/******************************************************************************
+ * Checks the constructors of Vec that leave memory uninitialized or zeroed,
+ * with_capacity, new_zeroed and resize_uninit, that resize_uninit grows the
+ * array through reserve, reporting a vec_grow event, and that copy keeps the
+ * elements and allocates exactly as many as it holds
+ *
+ * usage: ./test [n], default 10^5 elements
+ ******************************************************************************/
+
+VEC_DEFINE(Vec, uint64_t)
+
+static size_t n_grows = 0;
+
+static void count_grows(const TraceEvent* event, void* ctx)
+{
+    (void) ctx;
+    n_grows += event->type == TRACE_VEC_GROW;
+}
+
+static void check_copy(const Vec* vec)
+{
+    Vec copy = Vec_copy(vec);
+    assert(copy.size == vec->size);
+    assert(copy._arr_cap == (vec->size ? vec->size : 1));
+    assert(copy.arr != vec->arr && memcmp(copy.arr, vec->arr, vec->size * sizeof(uint64_t)) == 0);
+    // the copy grows as any other Vec
+    Vec_push(&copy, 7);
+    assert(copy.size == vec->size + 1 && copy.arr[vec->size] == 7 && copy._arr_cap >= copy.size);
+    Vec_free(&copy);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000;
+    trace_set_callback(count_grows, NULL);
+
+    for (size_t size = 0; size <= n; size = size < 20 ? size + 1 : size * 3) {
+        // with_capacity, pushing up to the capacity does not move the array
+        Vec vec = Vec_with_capacity(size);
+        assert(vec.size == 0 && vec._arr_cap >= size && vec._arr_cap >= 1);
+        uint64_t* arr = vec.arr;
+        for (size_t i = 0; i < size; i++)
+            Vec_push(&vec, i);
+        assert(vec.arr == arr && vec.size == size);
+        check_copy(&vec);
+        Vec_free(&vec);
+
+        // new_zeroed
+        vec = Vec_new_zeroed(size);
+        assert(vec.size == size && vec._arr_cap >= size);
+        for (size_t i = 0; i < size; i++)
+            assert(vec.arr[i] == 0);
+        check_copy(&vec);
+        Vec_free(&vec);
+
+        // resize_uninit keeps the elements already there, and grows through reserve
+        vec = Vec_new(0);
+        Vec_push(&vec, 42);
+        size_t grows_before = n_grows;
+        Vec_resize_uninit(&vec, size);
+        assert(vec.size == size && vec._arr_cap >= size);
+        assert(size <= 1 ? n_grows == grows_before : n_grows == grows_before + 1);
+        if (size > 0)
+            assert(vec.arr[0] == 42);
+        for (size_t i = 0; i < size; i++)
+            vec.arr[i] = 3 * i;
+        check_copy(&vec);
+        // shrinking only truncates
+        size_t cap = vec._arr_cap;
+        Vec_resize_uninit(&vec, size / 2);
+        assert(vec.size == size / 2 && vec._arr_cap == cap);
+        for (size_t i = 0; i < size / 2; i++)
+            assert(vec.arr[i] == 3 * i);
+        check_copy(&vec);
+        Vec_free(&vec);
+    }
+
+    // copy of an empty Vec that once held elements
+    Vec vec = Vec_new(0);
+    for (size_t i = 0; i < 100; i++)
+        Vec_push(&vec, i);
+    Vec_resize_uninit(&vec, 0);
+    check_copy(&vec);
+    Vec_free(&vec);
+
+    trace_set_callback(NULL, NULL);
+    printf("vec checked up to %zu elements, %zu grows\n", n, n_grows);
+    return 0;
+}
@@ -7,7 +7,11 @@
  * Requires C20 or newer
  **************************/
 
+#include <assert.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include "datastructures/hashmap.h"
 
 // Recursive macros with C++20 __VA_OPT__
@@ -33,15 +37,167 @@
 
 #define _TUPLE_ADD_SEMICOLON(type_and_name) type_and_name;
 
+/*
+ * Fields are laid out as in any struct, each at the first offset after the previous
+ * field that is a multiple of its alignment. Generated functions walk the fields
+ * in order with a running offset, which the compiler folds into constants,
+ * so the struct stays a plain struct, initialized positionally like any other
+ */
+#define _TUPLE_FIELD_SIZE(type_and_name) sizeof(struct { type_and_name; })
+#define _TUPLE_FIELD_ALIGN(type_and_name) _Alignof(struct { type_and_name; })
+#define _TUPLE_ALIGN_UP(offset, align) (((offset) + (align) - 1) / (align) * (align))
+
+#define _TUPLE_NEXT_FIELD(type_and_name) \
+    offset = _TUPLE_ALIGN_UP(offset, _TUPLE_FIELD_ALIGN(type_and_name));
+
+#define _TUPLE_HASH_FIELD(type_and_name) \
+    _TUPLE_NEXT_FIELD(type_and_name) \
+    h = _tuple_hash_bytes(h, (const unsigned char*)(p) + offset, _TUPLE_FIELD_SIZE(type_and_name)); \
+    offset += _TUPLE_FIELD_SIZE(type_and_name);
+
+#define _TUPLE_EQ_FIELD(type_and_name) \
+    _TUPLE_NEXT_FIELD(type_and_name) \
+    if (memcmp((const char*)(a) + offset, (const char*)(b) + offset, _TUPLE_FIELD_SIZE(type_and_name))) \
+        return false; \
+    offset += _TUPLE_FIELD_SIZE(type_and_name);
+
+#define _TUPLE_CMP_FIELD(type_and_name) \
+    _TUPLE_NEXT_FIELD(type_and_name) \
+    cmp_res = _tuple_cmp_field((const unsigned char*)(a) + offset, (const unsigned char*)(b) + offset, \
+                               _TUPLE_FIELD_SIZE(type_and_name), _TUPLE_FIELD_KIND(type_and_name)); \
+    if (cmp_res) \
+        return cmp_res; \
+    offset += _TUPLE_FIELD_SIZE(type_and_name);
+
+#define _TUPLE_ENCODE_FIELD(type_and_name) \
+    _TUPLE_NEXT_FIELD(type_and_name) \
+    _tuple_encode_field(out, (const unsigned char*)(p) + offset, \
+        _TUPLE_FIELD_SIZE(type_and_name), _TUPLE_FIELD_KIND(type_and_name)); \
+    out += _TUPLE_FIELD_SIZE(type_and_name); \
+    offset += _TUPLE_FIELD_SIZE(type_and_name);
+
+#define _TUPLE_ADD_FIELD_SIZE(type_and_name) + _TUPLE_FIELD_SIZE(type_and_name)
+
+/* how a field is ordered by TUPLE_NAME##_cmp */
+enum
+{
+    _TUPLE_KIND_SIGNED,
+    _TUPLE_KIND_UNSIGNED,
+    _TUPLE_KIND_FLOAT,
+    _TUPLE_KIND_BYTES,
+};
+
+/*
+ * Finds the kind of a field from its declaration, by using it as the parameter of
+ * a function pointer type. Parameters of array type decay to pointers,
+ * so arrays (and pointers) are compared as raw bytes
+ */
+#define _TUPLE_FIELD_KIND(type_and_name) _Generic((void (*)(type_and_name)) 0, \
+    void (*)(char): CHAR_MIN < 0 ? _TUPLE_KIND_SIGNED : _TUPLE_KIND_UNSIGNED, \
+    void (*)(signed char): _TUPLE_KIND_SIGNED, \
+    void (*)(short): _TUPLE_KIND_SIGNED, \
+    void (*)(int): _TUPLE_KIND_SIGNED, \
+    void (*)(long): _TUPLE_KIND_SIGNED, \
+    void (*)(long long): _TUPLE_KIND_SIGNED, \
+    void (*)(_Bool): _TUPLE_KIND_UNSIGNED, \
+    void (*)(unsigned char): _TUPLE_KIND_UNSIGNED, \
+    void (*)(unsigned short): _TUPLE_KIND_UNSIGNED, \
+    void (*)(unsigned int): _TUPLE_KIND_UNSIGNED, \
+    void (*)(unsigned long): _TUPLE_KIND_UNSIGNED, \
+    void (*)(unsigned long long): _TUPLE_KIND_UNSIGNED, \
+    void (*)(float): _TUPLE_KIND_FLOAT, \
+    void (*)(double): _TUPLE_KIND_FLOAT, \
+    default: _TUPLE_KIND_BYTES)
+
+/*****************************************************************************
+ * Loads an integer or floating point field as an unsigned integer,
+ * ordered the same way as the field itself
+ *
+ * Signed integers get their sign bit flipped, and floats are ordered
+ * by the IEEE 754 total order (-0.0 < 0.0, NaNs at the ends)
+ *****************************************************************************/
+static inline uint64_t _tuple_ordered_bits(const unsigned char* field, size_t size, int kind)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, field, size);  // little endian hosts only
+    uint64_t sign = UINT64_C(1) << (8 * size - 1);
+    if (kind == _TUPLE_KIND_SIGNED)
+        return bits ^ sign;
+    if (kind == _TUPLE_KIND_FLOAT) {
+        uint64_t mask = size == 8 ? UINT64_MAX : (UINT64_C(1) << (8 * size)) - 1;
+        return bits & sign ? ~bits & mask : bits | sign;
+    }
+    return bits;
+}
+
+/* compares a single field, size and kind are compile time constants */
+static inline int _tuple_cmp_field(const unsigned char* a, const unsigned char* b, size_t size, int kind)
+{
+    if (kind == _TUPLE_KIND_BYTES || size > 8)
+        return memcmp(a, b, size);
+    uint64_t x = _tuple_ordered_bits(a, size, kind);
+    uint64_t y = _tuple_ordered_bits(b, size, kind);
+    return (x > y) - (x < y);
+}
+
+/* writes a field as big endian ordered bytes, so that keys can be compared with memcmp */
+static inline void _tuple_encode_field(unsigned char* out, const unsigned char* field, size_t size, int kind)
+{
+    if (kind == _TUPLE_KIND_BYTES || size > 8) {
+        memcpy(out, field, size);
+        return;
+    }
+    uint64_t bits = _tuple_ordered_bits(field, size, kind);
+    for (size_t i = 0; i < size; i++)
+        out[i] = (unsigned char)(bits >> (8 * (size - 1 - i)));
+}
+
+/*****************************************************************************
+ * Mixes n bytes into the hash h, 8 bytes at a time
+ *
+ * n is a compile time constant for every tuple field, 
+ * so fields of 1, 2, 4 and 8 bytes are hashed with a single load and multiply
+ *****************************************************************************/
+static inline uint64_t _tuple_hash_bytes(uint64_t h, const unsigned char* bytes, size_t n)
+{
+    for (;;) {
+        uint64_t word = 0;
+        size_t n_word = n < 8 ? n : 8;
+        memcpy(&word, bytes, n_word);
+        h = (h ^ word) * UINT64_C(0x9E3779B97F4A7C15);
+        h ^= h >> 32;
+        if (n <= 8)
+            return h;
+        bytes += 8;
+        n -= 8;
+    }
+}
+
+/* final avalanche, from MurmurHash3's fmix64 */
+static inline uint64_t _tuple_hash_finish(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+    return h;
+}
+
 /*******************************************************************
 * Generates code for a hashable tuple
 *
 * equality and hash is done on values directly stored, 
 * so if fields contain pointers the behaviour might be unexpected
 *
+* Both are done field by field, so padding bytes between fields are never read,
+* and tuples do not need to be zeroed before they are filled in. A field that is
+* itself a struct is compared and hashed as raw bytes, including the padding
+* inside it, so such fields must be zeroed, e.g. with memset, before they are set
+*
 * @param TUPLE_NAME name of struct and prefix of related functions
 * @param fields valid field declarations, only one per line, 
-*   currently up to 256 field declarations are supported
+*   currently up to 256 field declarations are supported, bit-fields are not
 *
 * EXAMPLE USAGE:
 *
@@ -52,7 +208,13 @@
 * Triple t = {4, 2, "hi"};
 *
 * // it also has a hash function implemented
-* size_t hashcode = Triple_hasher(&t);
+* size_t hashcode = Triple_hash(&t);
+*
+* // and can be used as key in a TreeMap, or in a Heap
+* TREEMAP_DEFINE(Index, Triple, int, Triple_cmp)
+*
+* // or be encoded to a key comparable with memcmp
+* TripleKey key = Triple_key(&t);
 ********************************************************************/
 #define TUPLE_DEFINE(TUPLE_NAME, fields...) \
     typedef struct \
@@ -63,22 +225,79 @@
     \
     /***********************************************************
      * Hashes Tuple, 
-     * the byte representation of the tuple is hashed, 
-     * i.e. all fields as they are stored combined in one hash 
+     * the bytes of each field are mixed into one hash,
+     * skipping any padding between fields
      ***********************************************************/ \
     size_t TUPLE_NAME##_hash(const TUPLE_NAME* p) \
     { \
-        return byte_hasher((const char*)(p), sizeof(TUPLE_NAME)); \
+        size_t offset = 0; \
+        uint64_t h = 0; \
+        _TUPLE_FOR_EACH(_TUPLE_HASH_FIELD, fields) \
+        assert(_TUPLE_ALIGN_UP(offset, _Alignof(TUPLE_NAME)) == sizeof(TUPLE_NAME)); \
+        return _tuple_hash_finish(h); \
     } \
     \
     \
     /*************************************************************
-     * Checks if the byte representation of the tuples are equal
+     * Checks if the byte representation of each field are equal
      * i.e. if the fields contain the same values
      *************************************************************/ \
     bool TUPLE_NAME##_eq(const TUPLE_NAME* a, const TUPLE_NAME* b) \
     { \
-        return memcmp(a, b, sizeof(TUPLE_NAME)) == 0; \
+        size_t offset = 0; \
+        _TUPLE_FOR_EACH(_TUPLE_EQ_FIELD, fields) \
+        return true; \
+    } \
+    \
+    \
+    /***********************************************************************
+     * Compares tuples lexicographically, field by field in declared order
+     *
+     * Integer and floating point fields are compared by value,
+     * floats following the IEEE 754 total order so that it agrees with eq.
+     * Any other fields, including arrays, are compared with memcmp
+     *
+     * @returns less than 0 if a < b, more than 0 if a > b and 0 if a == b
+     ***********************************************************************/ \
+    int TUPLE_NAME##_cmp(const TUPLE_NAME* a, const TUPLE_NAME* b) \
+    { \
+        size_t offset = 0; \
+        int cmp_res; \
+        _TUPLE_FOR_EACH(_TUPLE_CMP_FIELD, fields) \
+        return 0; \
+    } \
+    \
+    \
+    /******************************************************************
+     * Normalized key of a tuple, the fields are concatenated without
+     * padding, in a byte order where memcmp gives the same ordering
+     * as TUPLE_NAME##_cmp
+     ******************************************************************/ \
+    typedef struct \
+    { \
+        unsigned char bytes[0 _TUPLE_FOR_EACH(_TUPLE_ADD_FIELD_SIZE, fields)]; \
+    } TUPLE_NAME##Key; \
+    \
+    \
+    /***************************************************
+     * Encodes a tuple as a normalized key
+     ***************************************************/ \
+    TUPLE_NAME##Key TUPLE_NAME##_key(const TUPLE_NAME* p) \
+    { \
+        size_t offset = 0; \
+        TUPLE_NAME##Key ret; \
+        unsigned char* out = ret.bytes; \
+        _TUPLE_FOR_EACH(_TUPLE_ENCODE_FIELD, fields) \
+        return ret; \
+    } \
+    \
+    \
+    /*************************************************
+     * Compares two normalized keys with one memcmp
+     *************************************************/ \
+    int TUPLE_NAME##Key_cmp(const TUPLE_NAME##Key* a, const TUPLE_NAME##Key* b) \
+    { \
+        return memcmp(a->bytes, b->bytes, sizeof(a->bytes)); \
     }
 
 #endif